@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -48,11 +49,13 @@ struct Token
   Type *ty;
   char *str;
   int line_no;
+  char *pragma; // text after "#pragma" on the line before the token
 };
 
 void error(char *fmt, ...);
 void error_at(char *loc, char *fmt, ...);
 void error_tok(Token *tok, char *fmt, ...);
+void note_tok(Token *tok, char *kind, char *fmt, ...);
 bool equal(Token *tok, char *op);
 Token *skip(Token *tok, char *op);
 bool consume(Token **rest, Token *tok, char *str);
@@ -68,6 +71,7 @@ Token *tokenize_file(char *filename);
 typedef struct Obj Obj;
 typedef struct Member Member;
 typedef struct Relocation Relocation;
+typedef struct IRFunc IRFunc;
 
 typedef enum
 {
@@ -113,6 +117,17 @@ typedef enum
   ND_COND,      // ?:
   ND_NULL_EXPR, // Do nothing
   ND_MEMZERO,   // Zero-clear a stack variable
+  ND_MEMSET,    // Fill `cond` bytes at address lhs with the byte `val`
+  ND_MEMCPY,    // Copy `cond` bytes from rhs to lhs in order, `val` at most at once
+  ND_STRLEN,    // Length of the string at address lhs
+  ND_VLOAD,     // Vector load from address lhs
+  ND_VSPLAT,    // Vector with lhs in every lane
+  ND_VOP,       // Lane-wise `vop` of vectors lhs and rhs
+  ND_VREG,      // Vector register `vreg`
+  ND_VSET,      // Vector register `vreg` = lhs
+  ND_VSTORE,    // Vector store of rhs to address lhs
+  ND_VREDUCE,   // `vop` of the lanes of vector register `vreg`
+  ND_VEND,      // End of vector code
 } NodeKind;
 
 typedef struct Node Node;
@@ -146,6 +161,22 @@ struct Node
   // Switch-cases
   Node *case_next;
   Node *default_case;
+
+  // Number of registers needed to evaluate the expression without
+  // spilling (Sethi-Ullman number), or 0 if not computed yet
+  int regs;
+
+  // Loop unrolling hint from "#pragma unroll": the unroll factor, 1
+  // for "nounroll", -1 for full unrolling, or 0 if there is none
+  int unroll;
+
+  // Return of a call that codegen emits as a jump to the callee (see
+  // tailcall.c)
+  bool tail_call;
+
+  // Vector code. The element type is `ty`.
+  int vreg;
+  NodeKind vop;
 };
 
 struct Obj
@@ -166,6 +197,18 @@ struct Obj
   Relocation *rel;
   int align; // alignment
   Obj *va_area;
+
+  // Local variable that mem2reg() promoted to registers
+  bool is_promoted;
+
+  // Function declared "inline", __attribute__((always_inline)) or
+  // __attribute__((noinline))
+  bool is_inline;
+  bool always_inline;
+  bool noinline;
+
+  // Function lowered to the IR, if the IR pipeline is enabled
+  IRFunc *ir;
 };
 
 // Global variable can be initialized either by a constant expression
@@ -180,16 +223,399 @@ struct Relocation {
 };
 
 Node *new_cast(Node *expr, Type *ty);
+char *new_unique_name(void);
 Obj *parse();
 
 extern Node *code[100];
 
+//
+// optimize.c
+//
+
+void optimize(Obj *prog);
+Node *fold_stmt(Node *node);
+bool has_side_effects(Node *node);
+
+//
+// consteval.c
+//
+
+extern int opt_consteval_steps;
+bool eval_funcall(Node *node, Obj *prog, bool gvar_init, int64_t *val, char **why);
+void fold_const_calls(Obj *prog);
+
+//
+// inline.c
+//
+
+void inline_functions(Obj *prog);
+Obj *clone_function(Obj *fn, char *name);
+
+//
+// specialize.c
+//
+
+extern int opt_specialize_budget;
+void specialize_functions(Obj *prog);
+
+//
+// tailcall.c
+//
+
+void eliminate_tail_calls(Obj *prog);
+
+//
+// unroll.c
+//
+
+// A counted loop `for (init; i < limit; i += step)`, or `<=`
+typedef struct
+{
+  Node *loop;
+  Obj *var;
+  int64_t step;
+  Node *inc;        // the assignment `i = i + step`
+  Node *limit;      // the right-hand side of the condition
+  bool inclusive;   // `<=` rather than `<`
+  bool has_start;   // whether the start value is known
+  int64_t start;
+} CountedLoop;
+
+void unroll_loops(Obj *prog);
+bool match_counted_loop(Node *node, CountedLoop *c);
+Node *remaining_cond(CountedLoop *c, int factor);
+Node *copy_node(Node *node);
+bool any_node(Node *node, bool (*fn)(Node *, void *), void *arg);
+
+//
+// idiom.c
+//
+
+void replace_idioms(Obj *prog);
+
+//
+// vectorize.c
+//
+
+void vectorize(Obj *prog);
+
+//
+// gen_ir.c
+//
+
+// The IR is a control flow graph of basic blocks. Each instruction
+// defines at most one virtual register and each virtual register is
+// defined exactly once (SSA form), so values that merge at a join
+// point go through IR_PHI. Local variables live in memory and are
+// accessed with IR_LOAD/IR_STORE on the address from IR_LVAR.
+
+typedef enum
+{
+  IR_IMM,     // dst = imm
+  IR_COPY,    // dst = a
+  IR_ADD,     // dst = a + b
+  IR_SUB,     // dst = a - b
+  IR_MUL,     // dst = a * b
+  IR_DIV,     // dst = a / b
+  IR_MOD,     // dst = a % b
+  IR_AND,     // dst = a & b
+  IR_OR,      // dst = a | b
+  IR_XOR,     // dst = a ^ b
+  IR_SHL,     // dst = a << b
+  IR_SAR,     // dst = a >> b
+  IR_EQ,      // dst = a == b
+  IR_NE,      // dst = a != b
+  IR_LT,      // dst = a < b
+  IR_LE,      // dst = a <= b
+  IR_NEG,     // dst = -a
+  IR_NOT,     // dst = ~a
+  IR_SEXT,    // dst = sign-extend the lower `size` bytes of a
+  IR_LVAR,    // dst = address of local variable `var`
+  IR_GVAR,    // dst = address of global variable `var`
+  IR_LOAD,    // dst = *a
+  IR_STORE,   // *a = b
+  IR_MEMCPY,  // copy `size` bytes from b to a
+  IR_MEMZERO, // zero-clear `size` bytes at a
+  IR_MEMSET,  // fill b bytes at a with the byte imm
+  IR_MEMCOPY, // copy args[0] bytes from b to a in order, moving at most imm at once
+  IR_STRLEN,  // dst = length of the string at a
+  IR_PREFETCH, // prefetch the line at a + imm with locality `size` (0-3)
+  IR_CALL,    // dst = name(args...)
+  IR_PARAM,   // dst = imm'th parameter of the function
+  IR_PHI,     // dst = args[i] if control came from from[i]
+  IR_SELECT,  // dst = a ? args[0] : args[1]
+  IR_BR,      // if (a) goto then; else goto els
+  IR_JMP,     // goto then
+  IR_RET,     // return a
+  IR_RELOAD,  // dst = value saved in stack slot `var`
+  IR_SPILL,   // save a to stack slot `var`
+  IR_VLOAD,   // vector vd = *a
+  IR_VSTORE,  // *a = vector va
+  IR_VSPLAT,  // vector vd = a in every lane
+  IR_VMOV,    // vector vd = va
+  IR_VOP,     // vector vd = va op vb, where imm is the op (ND_ADD, ...)
+  IR_VREDUCE, // dst = op of the lanes of vector va, where imm is the op
+  IR_VEND,    // end of vector code
+} IROp;
+
+typedef struct Reg Reg;
+typedef struct IR IR;
+typedef struct BB BB;
+
+// General-purpose registers available to the register allocator.
+// Registers before REG_RBX are caller-saved; the rest are callee-saved.
+enum
+{
+  REG_RAX,
+  REG_RCX,
+  REG_RDX,
+  REG_RSI,
+  REG_RDI,
+  REG_R8,
+  REG_R9,
+  REG_R10,
+  REG_R11,
+  REG_RBX,
+  REG_R12,
+  REG_R13,
+  REG_R14,
+  REG_R15,
+  NUM_REGS,
+};
+
+// Virtual register
+struct Reg
+{
+  int vn;  // virtual register number
+  IR *def; // defining instruction
+  int rn;  // physical register assigned by the register allocator
+
+  // Registers that reload or save a spilled value. They live across
+  // a single instruction and are never spilled themselves.
+  bool unspillable;
+};
+
+struct IR
+{
+  IROp op;
+  IR *next;
+  IR *prev;
+  BB *bb;
+  Token *tok;
+
+  Reg *dst;
+  Reg *a;
+  Reg *b;
+
+  int64_t imm;
+  // Operation width (4 or 8) for arithmetic, access size for memory
+  // operations
+  int size;
+  Obj *var;
+
+  // Function call
+  char *name;
+  Type *ty;
+  bool tail; // in tail position, from a return with `tail_call`
+  Obj *stack_args; // array of the arguments after the sixth, or NULL
+
+  // Call arguments, or phi operands together with their predecessors
+  Reg **args;
+  BB **from;
+  int nargs;
+
+  // Branch targets
+  BB *then;
+  BB *els;
+
+  // Vector registers of vector instructions, which `size` is the
+  // element size of. They are numbered like %xmm0-15 and are not
+  // allocated.
+  int vd;
+  int va;
+  int vb;
+};
+
+// Basic block
+struct BB
+{
+  BB *next;
+  int label;
+
+  // Instruction list. The last instruction is always a terminator
+  // (IR_BR, IR_JMP or IR_RET).
+  IR *first;
+  IR *last;
+
+  BB **preds;
+  int npreds;
+
+  // Dominator tree
+  BB *idom;
+  int rpo; // reverse postorder number
+  BB **df; // dominance frontier
+  int ndf;
+
+  // Liveness, as sets of virtual register numbers
+  uint64_t *live_in;
+  uint64_t *live_out;
+};
+
+struct IRFunc
+{
+  Obj *obj;
+  BB *bbs; // the first one is the entry block
+  Reg **regs;
+  int nregs;
+  BB **rpo; // blocks in reverse postorder
+  int nbbs;
+
+  // Stack slots where the prologue saves callee-saved registers
+  // that the function uses
+  Obj *save_slot[NUM_REGS];
+
+  // Interprocedural register allocation (see regalloc.c). `clobbers`
+  // is the set of caller-saved registers a call of the function may
+  // change; it is valid if `has_clobbers` is set.
+  bool has_clobbers;
+  int clobbers;
+
+  // Private calling convention: the i'th parameter arrives in
+  // param_reg[i], or is not passed if that is -1, and a small struct
+  // return value comes back in %rax and %rdx.
+  bool is_private;
+  int param_reg[6];
+};
+
+IRFunc *gen_ir(Obj *fn);
+BB *new_bb(void);
+Reg *new_reg(IRFunc *fn);
+IR *new_ir(IROp op, Token *tok);
+void insert_before(IR *pos, IR *ir);
+void remove_ir(IR *ir);
+bool is_terminator(IR *ir);
+bool has_side_effect(IR *ir);
+
+//
+// cfg.c
+//
+
+// Natural loop
+typedef struct Loop Loop;
+struct Loop
+{
+  BB *head;
+  BB **bbs; // in reverse postorder, starting with the head
+  int nbbs;
+  bool *contains; // indexed by rpo number
+};
+
+int get_succs(BB *bb, BB **succs);
+void build_cfg(IRFunc *fn);
+void build_dom_tree(IRFunc *fn);
+bool dominates(BB *x, BB *y);
+Loop **find_loops(IRFunc *fn, int *nloops);
+bool in_loop(Loop *loop, BB *bb);
+BB *preheader_of(Loop *loop);
+BB *add_preheader(IRFunc *fn, Loop *loop);
+void compute_liveness(IRFunc *fn);
+bool bs_test(uint64_t *set, int i);
+
+//
+// iropt.c
+//
+
+void optimize_ir(IRFunc *fn);
+bool remove_dead_code(IRFunc *fn);
+void eliminate_exts(IRFunc *fn);
+void leave_ssa(IRFunc *fn);
+
+//
+// mem2reg.c
+//
+
+void mem2reg(IRFunc *fn);
+
+//
+// licm.c
+//
+
+void hoist_invariants(IRFunc *fn);
+
+//
+// ivopt.c
+//
+
+void optimize_ivs(IRFunc *fn);
+
+//
+// prefetch.c
+//
+
+extern int opt_prefetch_distance;
+void insert_prefetches(IRFunc *fn);
+
+//
+// regalloc.c
+//
+
+extern bool opt_ipa_ra;
+IRFunc **regalloc_order(Obj *prog, int *n);
+void alloc_regs(IRFunc *fn);
+int call_clobbers(IR *call);
+IRFunc *private_callee(IR *call);
+bool ret_in_regs(IRFunc *fn);
+
+//
+// irdump.c
+//
+
+void dump_ir(Obj *prog, FILE *out);
+
 //
 // codegen.c
 //
 
+extern bool opt_tree_regs;
+extern bool opt_isel;
+extern bool opt_branch_fusion;
+extern bool opt_branchless;
+extern bool opt_ext;
+extern bool opt_strength_reduce;
+extern bool opt_loop_rotate;
+extern bool opt_align_loops;
+extern bool opt_avx2;
+bool is_branchless(Node *node);
+bool is_rotatable(Node *node);
 void codegen(Obj *prog, FILE *out);
 
+//
+// peephole.c
+//
+
+extern bool opt_peephole;
+extern int opt_peephole_window;
+void peephole_add(char *line);
+void peephole_flush(Obj *prog, FILE *out);
+void print_peephole_stats(FILE *out);
+void get_peephole_stats(double *time, long *before, long *after);
+
+//
+// pass.c
+//
+
+extern int opt_level;
+bool set_pass_option(char *arg);
+void print_passes(FILE *out);
+double get_time(void);
+void run_passes(Obj *prog, bool need_ir);
+void run_codegen(Obj *prog, FILE *out);
+void print_pass_stats(FILE *out);
+void count_stat(char *name, char *unit, long n);
+bool set_remark_option(char *arg);
+void remark(char *pass, Token *tok, char *fmt, ...);
+void remark_missed(char *pass, Token *tok, char *fmt, ...);
+
 //
 // type.c
 //
@@ -0,0 +1,58 @@
+// Array-walking kernels: a histogram, prefix sums and a scan for
+// separators, where indexing is a large part of each iteration.
+//
+// bench: -O2
+// bench: -O2 -fno-ivopts
+
+int printf(char *fmt, ...);
+void *malloc(long size);
+
+#define N 1000000
+#define REPEAT 50
+
+long seed = 88172645463325252;
+
+int rand31(void) {
+  seed = seed * 6364136223846793005 + 1442695040888963407;
+  return (seed >> 33) & 2147483647;
+}
+
+void histogram(char *s, int n, int *h) {
+  for (int i = 0; i < n; i++)
+    h[s[i]]++;
+}
+
+void prefix_sum(int *a, int *sum, int n) {
+  sum[0] = a[0];
+  for (int i = 1; i < n; i++)
+    sum[i] = sum[i - 1] + a[i];
+}
+
+int count_fields(char *s, int n) {
+  int fields = 0;
+  for (int i = 0; i < n; i++)
+    if (s[i] == ',' || s[i] == '\n')
+      fields++;
+  return fields;
+}
+
+int main() {
+  char *s = malloc(N);
+  int *a = malloc(sizeof(int) * N);
+  int *sum = malloc(sizeof(int) * N);
+  int h[128] = {};
+
+  for (int i = 0; i < N; i++) {
+    s[i] = "abc,def\n0123"[rand31() % 12];
+    a[i] = rand31() % 100;
+  }
+
+  long total = 0;
+  for (int r = 0; r < REPEAT; r++) {
+    histogram(s, N, h);
+    prefix_sum(a, sum, N);
+    total += sum[N - 1] + count_fields(s, N);
+  }
+  printf("%ld %d\n", total, h['a']);
+  return 0;
+}
@@ -0,0 +1,42 @@
+// A hash loop that calls helpers with constant arguments for its
+// parameters instead of spelling out magic numbers. Evaluated at
+// compile time, the calls turn into the constants; otherwise every
+// iteration searches for the prime again.
+//
+// bench: -O2
+// bench: -O2 -fno-consteval
+
+int printf(char *fmt, ...);
+
+#define N 20000000
+
+static int largest_prime_below(int n) {
+  for (int p = n - 1; p > 1; p--) {
+    int prime = 1;
+    for (int d = 2; d * d <= p; d++)
+      if (p % d == 0) {
+        prime = 0;
+        break;
+      }
+    if (prime)
+      return p;
+  }
+  return 2;
+}
+
+static int bit_mask(int bits) {
+  int m = 0;
+  for (int i = 0; i < bits; i++)
+    m = m << 1 | 1;
+  return m;
+}
+
+int main() {
+  long h = 0;
+  for (int i = 0; i < N; i++) {
+    h = (h * 31 + i) % largest_prime_below(1000);
+    h ^= i & bit_mask(12);
+  }
+  printf("%ld\n", h);
+  return 0;
+}
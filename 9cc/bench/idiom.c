@@ -0,0 +1,63 @@
+// Hand-written memory loops: clearing a buffer, copying an array of
+// structs and measuring strings, which the loop idiom pass turns into
+// block operations.
+//
+// bench: -O1
+// bench: -O1 -fno-loop-idiom
+// bench: -O2
+// bench: -O2 -fno-loop-idiom
+
+int printf(char *fmt, ...);
+void *malloc(long size);
+
+#define N 100000
+#define REPEAT 2000
+
+struct Rec {
+  int id;
+  char tag;
+  long value;
+};
+
+void clear(int *a, int n) {
+  for (int i = 0; i < n; i++)
+    a[i] = 0;
+}
+
+void copy(struct Rec *dst, struct Rec *src, int n) {
+  for (int i = 0; i < n; i++)
+    dst[i] = src[i];
+}
+
+long length(char *s) {
+  char *p = s;
+  while (*p)
+    p++;
+  return p - s;
+}
+
+int main() {
+  int *a = malloc(sizeof(int) * N);
+  struct Rec *r = malloc(sizeof(struct Rec) * N / 4);
+  struct Rec *t = malloc(sizeof(struct Rec) * N / 4);
+  char *s = malloc(N);
+
+  for (int i = 0; i < N / 4; i++) {
+    r[i].id = i;
+    r[i].tag = i;
+    r[i].value = i * 3;
+  }
+  for (int i = 0; i < N - 1; i++)
+    s[i] = 'a' + i % 26;
+  s[N - 1] = 0;
+
+  long total = 0;
+  for (int k = 0; k < REPEAT; k++) {
+    a[k] = k;
+    clear(a, N);
+    copy(t, r, N / 4);
+    total += a[k] + t[k].value + length(s + k);
+  }
+  printf("%ld\n", total);
+  return 0;
+}
@@ -0,0 +1,57 @@
+// A particle update written with small accessor functions, the way
+// code that hides a struct behind getters and setters looks. Every
+// accessor is a call unless it is inlined.
+//
+// bench: -O1
+// bench: -O1 -fno-inline
+// bench: -O2
+// bench: -O2 -fno-inline
+
+int printf(char *fmt, ...);
+void *malloc(long size);
+
+#define N 10000
+#define REPEAT 5000
+
+struct Particle {
+  long x;
+  long v;
+};
+
+static long get_x(struct Particle *p) { return p->x; }
+static long get_v(struct Particle *p) { return p->v; }
+static void set_x(struct Particle *p, long x) { p->x = x; }
+static void set_v(struct Particle *p, long v) { p->v = v; }
+
+static long clamp(long x, long lo, long hi) {
+  if (x < lo)
+    return lo;
+  if (x > hi)
+    return hi;
+  return x;
+}
+
+static void step(struct Particle *p) {
+  long x = get_x(p) + get_v(p);
+  if (x != clamp(x, 0, 1000000))
+    set_v(p, -get_v(p));
+  set_x(p, clamp(x, 0, 1000000));
+}
+
+int main() {
+  struct Particle *ps = malloc(sizeof(struct Particle) * N);
+  for (int i = 0; i < N; i++) {
+    ps[i].x = i * 100;
+    ps[i].v = i % 17 - 8;
+  }
+
+  for (int k = 0; k < REPEAT; k++)
+    for (int i = 0; i < N; i++)
+      step(&ps[i]);
+
+  long total = 0;
+  for (int i = 0; i < N; i++)
+    total += get_x(&ps[i]);
+  printf("%ld\n", total);
+  return 0;
+}
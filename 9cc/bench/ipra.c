@@ -0,0 +1,48 @@
+// Small functions that keep a few values live across a call of an even
+// smaller one, and return a pair of values, like the helpers of a hash
+// function or a parser. With the standard convention every such value
+// needs a callee-saved register that is saved and restored on each
+// call, and the pair is returned through memory. With -fipa-ra the
+// values stay in registers the callee doesn't touch, and the pair
+// comes back in %rax and %rdx.
+//
+// bench: -O2
+// bench: -O2 -fno-ipa-ra
+
+int printf(char *fmt, ...);
+
+struct Pair {
+  long a;
+  long b;
+};
+
+__attribute__((noinline)) static long scramble(long x) {
+  return x * 1099511628211 + 7;
+}
+
+__attribute__((noinline)) static struct Pair step(long h, long x) {
+  long s = h * 31;
+  long t = h + x;
+  long u = scramble(x);
+  struct Pair p;
+  p.a = s + u;
+  p.b = t - u;
+  return p;
+}
+
+__attribute__((noinline)) static long run(long n) {
+  long h = 0;
+  long k = 0;
+  struct Pair p;
+  for (long i = 0; i < n; i++) {
+    p = step(h, i);
+    h += p.a;
+    k += p.b;
+  }
+  return h + k;
+}
+
+int main() {
+  printf("%ld\n", run(200000000));
+  return 0;
+}
@@ -0,0 +1,48 @@
+// Tight counting loops, where the loop branches are a large part of
+// each iteration.
+//
+// bench: -O1
+// bench: -O1 -fno-loop-rotate
+// bench: -O1 -falign-loops
+// bench: -O2
+// bench: -O2 -fno-loop-rotate
+// bench: -O2 -fno-align-loops
+// bench: -O2 -fno-unroll
+
+int printf(char *fmt, ...);
+void *malloc(long size);
+
+#define N 1000
+#define REPEAT 200000
+
+long dot(int *a, int *b, int n) {
+  long sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+int count(int *a, int n, int x) {
+  int k = 0;
+  int i = 0;
+  while (i < n) {
+    k += a[i] == x;
+    i++;
+  }
+  return k;
+}
+
+int main() {
+  int *a = malloc(sizeof(int) * N);
+  int *b = malloc(sizeof(int) * N);
+  for (int i = 0; i < N; i++) {
+    a[i] = i % 7;
+    b[i] = i % 5;
+  }
+
+  long sum = 0;
+  for (int i = 0; i < REPEAT; i++)
+    sum += dot(a, b, N) + count(a, N, i % 7);
+  printf("%ld\n", sum);
+  return 0;
+}
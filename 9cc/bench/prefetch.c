@@ -0,0 +1,56 @@
+// Scans over a 1 GB table, far larger than the caches: hashing one
+// field of every row, and summing a column, which jumps a whole row
+// per iteration. Every row is a cache miss that the prefetches start
+// many iterations early.
+//
+// bench: -O2
+// bench: -O2 -fprefetch-loop-arrays
+// bench: -O2 -fprefetch-loop-arrays -fprefetch-distance=200
+
+int printf(char *fmt, ...);
+void *malloc(long size);
+
+#define SIZE (1024 * 1024 * 1024)
+#define COLS 520
+#define REPEAT 8
+
+struct Row {
+  long key;
+  long value;
+  long pad[6];
+};
+
+long hash(struct Row *r, long n) {
+  long h = 0;
+  for (long i = 0; i < n; i++) {
+    h = (h ^ r[i].key) * 31 + 7;
+    h = (h ^ (h >> 7)) * 31;
+    h = (h ^ (h >> 5)) * 17;
+  }
+  return h;
+}
+
+long column(long *a, long rows) {
+  long h = 0;
+  for (long i = 0; i < rows; i++) {
+    h = (h ^ a[i * COLS]) * 31 + 7;
+    h = (h ^ (h >> 7)) * 31;
+  }
+  return h;
+}
+
+int main() {
+  long *a = malloc(SIZE);
+  long n = SIZE / sizeof(long);
+  for (long i = 0; i < n; i++)
+    a[i] = i;
+
+  long total = 0;
+  for (int k = 0; k < REPEAT; k++) {
+    total += hash((struct Row *)a, SIZE / sizeof(struct Row));
+    for (int c = 0; c < 8; c++)
+      total += column(a + c * 8 + k, n / COLS - 1);
+  }
+  printf("%ld\n", total);
+  return 0;
+}
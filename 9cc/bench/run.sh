@@ -0,0 +1,21 @@
+#!/bin/bash
+#
+# Compiles each bench/*.c with every set of flags listed on its
+# "// bench:" lines and prints the run times, so that the effect of an
+# optimization can be compared on this machine.
+#
+tmp=`mktemp -d /tmp/9cc-bench-XXXXXX`
+trap 'rm -rf $tmp' INT TERM HUP EXIT
+
+for src in ${@:-bench/*.c}; do
+  name=`basename $src .c`
+  sed -n 's|^// bench: ||p' $src | while read flags; do
+    ${CC:-cc} -E -P -C $src | ./9cc $flags -o $tmp/$name.s - || exit 1
+    ${CC:-cc} -o $tmp/$name $tmp/$name.s || exit 1
+
+    start=`date +%s%N`
+    out=`$tmp/$name`
+    end=`date +%s%N`
+    printf "%-12s %-30s %8d ms  %s\n" $name "$flags" $(((end - start) / 1000000)) "$out"
+  done
+done
@@ -0,0 +1,46 @@
+// Clamping and min/max over random data. The conditions are taken
+// about half the time in no particular order, so branches on them are
+// mispredicted often.
+//
+// bench: -O1
+// bench: -O1 -fno-branchless
+// bench: -O2
+// bench: -O2 -fno-branchless
+
+int printf(char *fmt, ...);
+void *malloc(long size);
+
+#define N 1000000
+#define REPEAT 50
+
+long seed = 88172645463325252;
+
+int rand31(void) {
+  seed = seed * 6364136223846793005 + 1442695040888963407;
+  return (seed >> 33) & 2147483647;
+}
+
+long run(int *a, int n) {
+  long sum = 0;
+  int lo = 2147483647;
+  int hi = 0;
+  for (int i = 0; i < n; i++) {
+    int x = a[i];
+    sum += x < 1073741824 ? x : 1073741824;
+    lo = x < lo ? x : lo;
+    hi = x > hi ? x : hi;
+  }
+  return sum + lo + hi;
+}
+
+int main() {
+  int *a = malloc(sizeof(int) * N);
+  for (int i = 0; i < N; i++)
+    a[i] = rand31();
+
+  long sum = 0;
+  for (int i = 0; i < REPEAT; i++)
+    sum += run(a, N);
+  printf("%ld\n", sum);
+  return 0;
+}
@@ -0,0 +1,56 @@
+// A generic reduction that takes the operation and the element size
+// as arguments and checks them for every element, the way C code
+// without templates often looks. Specialization gives each call its
+// own copy with the checks folded away.
+//
+// bench: -O2
+// bench: -O2 -fno-specialize
+
+int printf(char *fmt, ...);
+void *malloc(long size);
+
+#define N 10000
+#define REPEAT 20000
+
+enum { SUM, MAX, XOR };
+
+static long reduce(void *p, long n, int size, int op) {
+  long acc = 0;
+  for (long i = 0; i < n; i++) {
+    long x;
+    if (size == 1)
+      x = ((char *)p)[i];
+    else if (size == 4)
+      x = ((int *)p)[i];
+    else
+      x = ((long *)p)[i];
+
+    if (op == SUM)
+      acc += x;
+    else if (op == MAX)
+      acc = x > acc ? x : acc;
+    else
+      acc ^= x;
+  }
+  return acc;
+}
+
+int main() {
+  char *c = malloc(N);
+  int *a = malloc(sizeof(int) * N);
+  long *l = malloc(sizeof(long) * N);
+  for (int i = 0; i < N; i++) {
+    c[i] = i % 100;
+    a[i] = i * 7 % 1000;
+    l[i] = i * 13;
+  }
+
+  long total = 0;
+  for (int k = 0; k < REPEAT; k++) {
+    total += reduce(c, N, 1, SUM);
+    total += reduce(a, N, 4, MAX);
+    total ^= reduce(l, N, 8, XOR);
+  }
+  printf("%ld\n", total);
+  return 0;
+}
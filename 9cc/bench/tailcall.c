@@ -0,0 +1,58 @@
+// A scanner written as a state machine where each state calls the
+// function for the next one, counting the words and numbers in a
+// text. Without tail calls, every character is a call and a return,
+// and the stack grows with the length of the text.
+//
+// bench: -O1
+// bench: -O1 -fno-tail-calls
+// bench: -O2
+// bench: -O2 -fno-tail-calls
+
+int printf(char *fmt, ...);
+void *malloc(long size);
+
+#define N 100000
+#define REPEAT 2000
+
+long in_space(char *s, long n);
+long in_word(char *s, long n);
+long in_number(char *s, long n);
+
+long in_space(char *s, long n) {
+  if (!*s)
+    return n;
+  if ('0' <= *s && *s <= '9')
+    return in_number(s + 1, n + 1000);
+  if (*s != ' ')
+    return in_word(s + 1, n + 1);
+  return in_space(s + 1, n);
+}
+
+long in_word(char *s, long n) {
+  if (!*s)
+    return n;
+  if (*s == ' ')
+    return in_space(s + 1, n);
+  return in_word(s + 1, n);
+}
+
+long in_number(char *s, long n) {
+  if (!*s)
+    return n;
+  if (*s == ' ')
+    return in_space(s + 1, n);
+  return in_number(s + 1, n);
+}
+
+int main() {
+  char *s = malloc(N + 1);
+  for (int i = 0; i < N; i++)
+    s[i] = (i % 7 == 0) ? ' ' : (i % 3 == 0) ? '0' + i % 10 : 'a' + i % 26;
+  s[N] = 0;
+
+  long total = 0;
+  for (int k = 0; k < REPEAT; k++)
+    total += in_space(s + k, 0);
+  printf("%ld\n", total);
+  return 0;
+}
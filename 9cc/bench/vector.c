@@ -0,0 +1,61 @@
+// Element-wise kernels over arrays: sums of two arrays, scaling of
+// shorts, masking of bytes and a reduction, which the vectorizer runs
+// several elements at a time.
+//
+// bench: -O2
+// bench: -O2 -fno-vectorize
+// bench: -O2 -mavx2
+
+int printf(char *fmt, ...);
+void *malloc(long size);
+
+#define N 100000
+#define REPEAT 2000
+
+void add(int *dst, int *a, int *b, int n) {
+  for (int i = 0; i < n; i++)
+    dst[i] = a[i] + b[i];
+}
+
+void scale(short *a, int n, int k) {
+  for (int i = 0; i < n; i++)
+    a[i] = a[i] * k + 1;
+}
+
+void mask(char *dst, char *src, int n) {
+  for (int i = 0; i < n; i++)
+    dst[i] = src[i] & 95;
+}
+
+int sum(int *a, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += a[i];
+  return s;
+}
+
+int main() {
+  int *a = malloc(sizeof(int) * N);
+  int *b = malloc(sizeof(int) * N);
+  int *c = malloc(sizeof(int) * N);
+  short *h = malloc(sizeof(short) * N);
+  char *s = malloc(N);
+  char *t = malloc(N);
+
+  for (int i = 0; i < N; i++) {
+    a[i] = i % 1000;
+    b[i] = i % 7;
+    h[i] = i;
+    s[i] = 'a' + i % 26;
+  }
+
+  long total = 0;
+  for (int r = 0; r < REPEAT; r++) {
+    add(c, a, b, N);
+    scale(h, N, 3);
+    mask(t, s, N);
+    total += sum(c, N) + h[r] + t[r];
+  }
+  printf("%ld\n", total);
+  return 0;
+}
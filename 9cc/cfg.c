@@ -0,0 +1,469 @@
+#include "9cc.h"
+
+//
+// Control flow graph analysis
+//
+// This file computes predecessors, the dominator tree, dominance
+// frontiers, natural loops and register liveness for a function in
+// the IR.
+//
+
+int get_succs(BB *bb, BB **succs)
+{
+  IR *ir = bb->last;
+  switch (ir->op)
+  {
+  case IR_JMP:
+    succs[0] = ir->then;
+    return 1;
+  case IR_BR:
+    succs[0] = ir->then;
+    succs[1] = ir->els;
+    return 2;
+  }
+  return 0;
+}
+
+static void visit(BB *bb, bool *seen, BB **order, int *n)
+{
+  if (seen[bb->label])
+    return;
+  seen[bb->label] = true;
+
+  BB *succs[2];
+  int nsuccs = get_succs(bb, succs);
+  for (int i = nsuccs - 1; i >= 0; i--)
+    visit(succs[i], seen, order, n);
+  order[(*n)++] = bb;
+}
+
+static int max_label(IRFunc *fn)
+{
+  int max = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    max = MAX(max, bb->label);
+  return max;
+}
+
+static void add_pred(BB *bb, BB *pred)
+{
+  bb->preds = realloc(bb->preds, sizeof(BB *) * (bb->npreds + 1));
+  bb->preds[bb->npreds++] = pred;
+}
+
+static bool is_pred(BB *bb, BB *pred)
+{
+  for (int i = 0; i < bb->npreds; i++)
+    if (bb->preds[i] == pred)
+      return true;
+  return false;
+}
+
+// Recompute the predecessor lists and the reverse postorder of blocks,
+// removing blocks that are not reachable from the entry.
+void build_cfg(IRFunc *fn)
+{
+  int nlabels = max_label(fn) + 1;
+  bool *seen = calloc(nlabels, sizeof(bool));
+  BB **order = calloc(nlabels, sizeof(BB *));
+  int n = 0;
+  visit(fn->bbs, seen, order, &n);
+
+  // Unlink unreachable blocks.
+  for (BB **p = &fn->bbs; *p;)
+  {
+    if (seen[(*p)->label])
+      p = &(*p)->next;
+    else
+      *p = (*p)->next;
+  }
+
+  int nlisted = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    nlisted++;
+  if (nlisted != n)
+    unreachable();
+
+  fn->nbbs = n;
+  fn->rpo = calloc(n, sizeof(BB *));
+  for (int i = 0; i < n; i++)
+  {
+    BB *bb = order[n - i - 1];
+    bb->rpo = i;
+    bb->npreds = 0;
+    fn->rpo[i] = bb;
+  }
+
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    BB *succs[2];
+    int nsuccs = get_succs(bb, succs);
+    for (int i = 0; i < nsuccs; i++)
+      if (!is_pred(succs[i], bb))
+        add_pred(succs[i], bb);
+  }
+
+  // Drop phi operands that came from removed edges.
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir && ir->op == IR_PHI; ir = ir->next)
+    {
+      int j = 0;
+      for (int i = 0; i < ir->nargs; i++)
+      {
+        if (!is_pred(bb, ir->from[i]))
+          continue;
+        ir->args[j] = ir->args[i];
+        ir->from[j] = ir->from[i];
+        j++;
+      }
+      ir->nargs = j;
+    }
+  }
+
+  free(seen);
+  free(order);
+}
+
+static BB *intersect(BB *x, BB *y)
+{
+  while (x != y)
+  {
+    while (x->rpo > y->rpo)
+      x = x->idom;
+    while (y->rpo > x->rpo)
+      y = y->idom;
+  }
+  return x;
+}
+
+static void add_df(BB *bb, BB *x)
+{
+  for (int i = 0; i < bb->ndf; i++)
+    if (bb->df[i] == x)
+      return;
+  bb->df = realloc(bb->df, sizeof(BB *) * (bb->ndf + 1));
+  bb->df[bb->ndf++] = x;
+}
+
+// Compute immediate dominators with the iterative algorithm from
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm",
+// and then the dominance frontier of each block.
+void build_dom_tree(IRFunc *fn)
+{
+  for (int i = 0; i < fn->nbbs; i++)
+  {
+    fn->rpo[i]->idom = NULL;
+    fn->rpo[i]->ndf = 0;
+  }
+
+  BB *entry = fn->rpo[0];
+  entry->idom = entry;
+
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    for (int i = 1; i < fn->nbbs; i++)
+    {
+      BB *bb = fn->rpo[i];
+      BB *idom = NULL;
+      for (int j = 0; j < bb->npreds; j++)
+      {
+        BB *p = bb->preds[j];
+        if (!p->idom)
+          continue;
+        idom = idom ? intersect(p, idom) : p;
+      }
+      if (bb->idom != idom)
+      {
+        bb->idom = idom;
+        changed = true;
+      }
+    }
+  }
+
+  for (int i = 0; i < fn->nbbs; i++)
+  {
+    BB *bb = fn->rpo[i];
+    if (bb->npreds < 2)
+      continue;
+    for (int j = 0; j < bb->npreds; j++)
+      for (BB *r = bb->preds[j]; r != bb->idom; r = r->idom)
+        add_df(r, bb);
+  }
+}
+
+// Returns true if x dominates y.
+bool dominates(BB *x, BB *y)
+{
+  for (;;)
+  {
+    if (x == y)
+      return true;
+    if (y->idom == y)
+      return false;
+    y = y->idom;
+  }
+}
+
+//
+// Loops
+//
+// An edge from B to H where H dominates B is a back edge, and the
+// natural loop of H consists of H and the blocks that reach B without
+// going through H. Back edges to the same header form a single loop.
+//
+
+static Loop *new_loop(IRFunc *fn, BB *head)
+{
+  Loop *loop = calloc(1, sizeof(Loop));
+  loop->head = head;
+  loop->contains = calloc(fn->nbbs, sizeof(bool));
+  loop->contains[head->rpo] = true;
+  return loop;
+}
+
+static void add_latch(IRFunc *fn, Loop *loop, BB *latch)
+{
+  BB **worklist = calloc(fn->nbbs, sizeof(BB *));
+  int n = 0;
+
+  if (!loop->contains[latch->rpo])
+  {
+    loop->contains[latch->rpo] = true;
+    worklist[n++] = latch;
+  }
+
+  while (n > 0)
+  {
+    BB *bb = worklist[--n];
+    for (int i = 0; i < bb->npreds; i++)
+    {
+      BB *p = bb->preds[i];
+      if (loop->contains[p->rpo])
+        continue;
+      loop->contains[p->rpo] = true;
+      worklist[n++] = p;
+    }
+  }
+  free(worklist);
+}
+
+static int compare_loops(const void *x, const void *y)
+{
+  return (*(Loop **)x)->nbbs - (*(Loop **)y)->nbbs;
+}
+
+// Finds the natural loops of a function. Inner loops come before the
+// loops that contain them. Requires build_dom_tree().
+Loop **find_loops(IRFunc *fn, int *nloops)
+{
+  Loop **loops = NULL;
+  int n = 0;
+
+  for (int i = 0; i < fn->nbbs; i++)
+  {
+    BB *head = fn->rpo[i];
+    Loop *loop = NULL;
+
+    for (int j = 0; j < head->npreds; j++)
+    {
+      BB *latch = head->preds[j];
+      if (!dominates(head, latch))
+        continue;
+      if (!loop)
+        loop = new_loop(fn, head);
+      add_latch(fn, loop, latch);
+    }
+
+    if (!loop)
+      continue;
+
+    loop->bbs = calloc(fn->nbbs, sizeof(BB *));
+    for (int j = 0; j < fn->nbbs; j++)
+      if (loop->contains[j])
+        loop->bbs[loop->nbbs++] = fn->rpo[j];
+
+    loops = realloc(loops, sizeof(Loop *) * (n + 1));
+    loops[n++] = loop;
+  }
+
+  qsort(loops, n, sizeof(Loop *), compare_loops);
+  *nloops = n;
+  return loops;
+}
+
+bool in_loop(Loop *loop, BB *bb)
+{
+  return loop->contains[bb->rpo];
+}
+
+// Makes sure that the loop has a preheader, and returns it. If the
+// header has a single predecessor outside the loop that jumps
+// elsewhere too, a new block is inserted on that edge, after which
+// the CFG must be rebuilt.
+BB *add_preheader(IRFunc *fn, Loop *loop)
+{
+  BB *head = loop->head;
+  BB *outside = NULL;
+  for (int i = 0; i < head->npreds; i++)
+  {
+    if (in_loop(loop, head->preds[i]))
+      continue;
+    if (outside)
+      return NULL;
+    outside = head->preds[i];
+  }
+
+  if (!outside)
+    return NULL;
+  if (outside->last->op == IR_JMP)
+    return outside;
+
+  BB *pre = new_bb();
+  IR *jmp = new_ir(IR_JMP, head->first->tok);
+  jmp->bb = pre;
+  jmp->then = head;
+  pre->first = pre->last = jmp;
+
+  IR *br = outside->last;
+  if (br->then == head)
+    br->then = pre;
+  if (br->els == head)
+    br->els = pre;
+  for (IR *ir = head->first; ir && ir->op == IR_PHI; ir = ir->next)
+    for (int i = 0; i < ir->nargs; i++)
+      if (ir->from[i] == outside)
+        ir->from[i] = pre;
+
+  // Place it right before the header, so that it falls through.
+  BB **p = &fn->bbs;
+  while (*p != head)
+    p = &(*p)->next;
+  pre->next = head;
+  *p = pre;
+  return pre;
+}
+
+// Returns the loop's preheader, the only block outside the loop that
+// jumps to the header, if it jumps nowhere else.
+BB *preheader_of(Loop *loop)
+{
+  BB *head = loop->head;
+  BB *pre = NULL;
+  for (int i = 0; i < head->npreds; i++)
+  {
+    if (in_loop(loop, head->preds[i]))
+      continue;
+    if (pre)
+      return NULL;
+    pre = head->preds[i];
+  }
+  return (pre && pre->last->op == IR_JMP) ? pre : NULL;
+}
+
+//
+// Liveness analysis
+//
+
+static uint64_t *new_bitset(int n)
+{
+  return calloc((n + 63) / 64, sizeof(uint64_t));
+}
+
+static void bs_set(uint64_t *set, int i)
+{
+  set[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+static void bs_clear(uint64_t *set, int i)
+{
+  set[i / 64] &= ~((uint64_t)1 << (i % 64));
+}
+
+bool bs_test(uint64_t *set, int i)
+{
+  return set[i / 64] & ((uint64_t)1 << (i % 64));
+}
+
+static void use(uint64_t *live, Reg *r)
+{
+  if (r)
+    bs_set(live, r->vn);
+}
+
+// Add registers live on entry to `bb` to `live`, given the registers
+// live on exit. Phi operands are not uses in the block itself; they
+// are live out of the corresponding predecessor.
+static void transfer(BB *bb, uint64_t *live)
+{
+  for (IR *ir = bb->last; ir; ir = ir->prev)
+  {
+    if (ir->dst)
+      bs_clear(live, ir->dst->vn);
+    if (ir->op == IR_PHI)
+      continue;
+    use(live, ir->a);
+    use(live, ir->b);
+    for (int i = 0; i < ir->nargs; i++)
+      use(live, ir->args[i]);
+  }
+
+  // Phi results are defined on entry to the block.
+  for (IR *ir = bb->first; ir && ir->op == IR_PHI; ir = ir->next)
+    bs_set(live, ir->dst->vn);
+}
+
+void compute_liveness(IRFunc *fn)
+{
+  int words = (fn->nregs + 63) / 64;
+
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    bb->live_in = new_bitset(fn->nregs);
+    bb->live_out = new_bitset(fn->nregs);
+  }
+
+  uint64_t *live = new_bitset(fn->nregs);
+  uint64_t *tmp = new_bitset(fn->nregs);
+
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+
+    // Visiting blocks in postorder makes this converge quickly.
+    for (int i = fn->nbbs - 1; i >= 0; i--)
+    {
+      BB *bb = fn->rpo[i];
+      memset(live, 0, words * sizeof(uint64_t));
+
+      BB *succs[2];
+      int nsuccs = get_succs(bb, succs);
+      for (int j = 0; j < nsuccs; j++)
+      {
+        BB *s = succs[j];
+        memcpy(tmp, s->live_in, words * sizeof(uint64_t));
+        for (IR *ir = s->first; ir && ir->op == IR_PHI; ir = ir->next)
+          bs_clear(tmp, ir->dst->vn);
+        for (int k = 0; k < words; k++)
+          live[k] |= tmp[k];
+
+        for (IR *ir = s->first; ir && ir->op == IR_PHI; ir = ir->next)
+          for (int k = 0; k < ir->nargs; k++)
+            if (ir->from[k] == bb)
+              use(live, ir->args[k]);
+      }
+
+      memcpy(bb->live_out, live, words * sizeof(uint64_t));
+      transfer(bb, live);
+
+      if (memcmp(bb->live_in, live, words * sizeof(uint64_t)))
+      {
+        memcpy(bb->live_in, live, words * sizeof(uint64_t));
+        changed = true;
+      }
+    }
+  }
+  free(live);
+  free(tmp);
+}
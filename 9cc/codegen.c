@@ -4,20 +4,49 @@
 static FILE *output_file;
 static void gen_stmt(Node *node);
 static void gen_expr(Node *node);
+static void gen_cond(Node *node, char *t, char *f);
+static bool gen_select(Node *node);
 static int depth;
 static char *argreg8[] = {"dil", "sil", "dl", "cl", "r8b", "r9b"};
 static char *argreg16[] = {"di", "si", "dx", "cx", "r8w", "r9w"};
 static char *argreg32[] = {"edi", "esi", "edx", "ecx", "r8d", "r9d"};
 static char *argreg64[] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+static int argreg[] = {REG_RDI, REG_RSI, REG_RDX, REG_RCX, REG_R8, REG_R9};
+
+// Register names indexed by REG_* numbers
+static char *reg8[] = {"al", "cl", "dl", "sil", "dil", "r8b", "r9b",
+                       "r10b", "r11b", "bl", "r12b", "r13b", "r14b", "r15b"};
+static char *reg16[] = {"ax", "cx", "dx", "si", "di", "r8w", "r9w",
+                        "r10w", "r11w", "bx", "r12w", "r13w", "r14w", "r15w"};
+static char *reg32[] = {"eax", "ecx", "edx", "esi", "edi", "r8d", "r9d",
+                        "r10d", "r11d", "ebx", "r12d", "r13d", "r14d", "r15d"};
+static char *reg64[] = {"rax", "rcx", "rdx", "rsi", "rdi", "r8", "r9",
+                        "r10", "r11", "rbx", "r12", "r13", "r14", "r15"};
 static Obj *current_fn;
 
+// If true, lines go to the peephole optimizer instead of the file.
+static bool buffering;
+
 static void println(char *fmt, ...)
 {
   va_list ap;
   va_start(ap, fmt);
-  vfprintf(output_file, fmt, ap);
+
+  if (buffering)
+  {
+    char *buf;
+    size_t buflen;
+    FILE *out = open_memstream(&buf, &buflen);
+    vfprintf(out, fmt, ap);
+    fclose(out);
+    peephole_add(buf);
+  }
+  else
+  {
+    vfprintf(output_file, fmt, ap);
+    fprintf(output_file, "\n");
+  }
   va_end(ap);
-  fprintf(output_file, "\n");
 }
 
 static int count(void)
@@ -180,8 +209,8 @@ static int getTypeId(Type *ty)
 }
 
 // The table for type casts
-static char i32i8[] = "movsbl eax, al";
-static char i32i16[] = "movswl eax, ax";
+static char i32i8[] = "movsx eax, al";
+static char i32i16[] = "movsx eax, ax";
 static char i32i64[] = "movsxd rax, eax";
 
 static char *cast_table[][10] = {
@@ -210,286 +239,2715 @@ static void cast(Type *from, Type *to)
     println("  %s", cast_table[t1][t2]);
 }
 
-// Generate code for a given node.
-static void gen_expr(Node *node)
-{
-  println(" .loc 1 %d", node->tok->line_no);
-  switch (node->kind)
-  {
-  case ND_NULL_EXPR:
-    return;
-  case ND_NUM:
-    println("  mov rax, %ld", node->val);
-    return;
-  case ND_NEG:
-    gen_expr(node->lhs);
-    println("  neg rax");
-    return;
-  case ND_VAR:
-  case ND_MEMBER:
-    gen_addr(node);
-    load(node->ty);
-    return;
-  case ND_DEREF:
-    gen_expr(node->lhs);
-    load(node->ty);
-    return;
-  case ND_ADDR:
-    gen_addr(node->lhs);
-    return;
-  case ND_ASSIGN:
-    gen_addr(node->lhs);
-    push();
-    gen_expr(node->rhs);
-    store(node->ty);
-    return;
-  case ND_STMT_EXPR:
-    for (Node *n = node->body; n; n = n->next)
-      gen_stmt(n);
-    return;
-  case ND_COMMA:
-    gen_expr(node->lhs);
-    gen_expr(node->rhs);
-    return;
-  case ND_CAST:
-    gen_expr(node->lhs);
-    cast(node->lhs->ty, node->ty);
-    return;
-  case ND_MEMZERO:
-    // `rep stosb` is equivalent to `memset(%rdi, %al, %rcx)`.
-    println("  mov rcx, %d", node->var->ty->size);
-    println("  lea rdi, %d[rbp]", node->var->offset);
-    println("  mov al, 0");
-    println("  rep stosb");
-    return;
-  case ND_COND:
-  {
-    int c = count();
-    gen_expr(node->cond);
-    println("  cmp rax, 0");
-    println("  je .L.else.%d", c);
-    gen_expr(node->then);
-    println("  jmp .L.end.%d", c);
-    println(".L.else.%d:", c);
-    gen_expr(node->els);
-    println(".L.end.%d:", c);
-    return;
-  }
-  case ND_NOT:
-    gen_expr(node->lhs);
-    println("  cmp rax, 0");
-    println("  sete al");
-    println("  movzx rax, al");
-    return;
-  case ND_BITNOT:
-    gen_expr(node->lhs);
-    println("  not rax");
-    return;
+//
+// Register-tree code generation
+//
+// The stack machine above pushes the right-hand side of every binary
+// operator and pops it again. For expression trees made of loads,
+// arithmetic and casts, we instead evaluate into a stack of registers.
+// Each subtree is labeled with the number of registers it needs
+// (Sethi and Ullman, "The Generation of Optimal Code for Arithmetic
+// Expressions"), and the child that needs more is evaluated first so
+// that the other one can use the remaining registers. We spill to the
+// machine stack only if a subtree needs more registers than we have.
+//
+// gen_tree(node, k) computes a value into tree_regs[k] and may use
+// tree_regs[k..] as scratch. Registers below k hold live values. The
+// last register is kept free so that a spilled value can be popped
+// into it.
+//
+// Other expressions (calls, assignments, control flow, ...) are
+// compiled by gen_expr(), which may use any register, so the live
+// registers are saved around them.
+//
 
-  case ND_LOGAND:
-  {
-    int c = count();
-    gen_expr(node->lhs);
-    println("  cmp rax, 0");
-    println("  je .L.false.%d", c);
-    gen_expr(node->rhs);
-    println("  cmp rax, 0");
-    println("  je .L.false.%d", c);
-    println("  mov rax, 1");
-    println("  jmp .L.end.%d", c);
-    println(".L.false.%d:", c);
-    println("  mov rax, 0");
-    println(".L.end.%d:", c);
-    return;
-  }
-  case ND_LOGOR:
-  {
-    int c = count();
-    gen_expr(node->lhs);
-    println("  cmp rax, 0");
-    println("  jne .L.true.%d", c);
-    gen_expr(node->rhs);
-    println("  cmp rax, 0");
-    println("  jne .L.true.%d", c);
-    println("  mov rax, 0");
-    println("  jmp .L.end.%d", c);
-    println(".L.true.%d:", c);
-    println("  mov rax, 1");
-    println(".L.end.%d:", c);
-    return;
-  }
+bool opt_tree_regs = true;
 
-  case ND_FUNCALL:
-  {
-    int nargs = 0;
-    for (Node *arg = node->args; arg; arg = arg->next)
-    {
-      gen_expr(arg);
-      push();
-      nargs++;
-    }
-    for (int i = nargs - 1; i >= 0; i--)
-      pop(argreg64[i]);
-    println("  mov rax, 0");
-    if (depth % 2 == 0) {
-      println("  call %s", node->funcname);
-    } else {
-      println("  sub rsp, 8");
-      println("  call %s", node->funcname);
-      println("  add rsp, 8");
-    }
+static int tree_regs[] = {REG_RAX, REG_RDI, REG_RSI, REG_RDX, REG_RCX,
+                          REG_R8, REG_R9, REG_R10, REG_R11};
 
-    // It looks like the most significant 48 or 56 bits in RAX may
-    // contain garbage if a function return type is short or bool/char,
-    // respectively. We clear the upper bits here.
-    switch (node->ty->kind) {
-    case TY_BOOL:
-      println("  movzx eax, al");
-      return;
-    case TY_CHAR:
-      println("  movsbl eax, al");
-      return;
-    case TY_SHORT:
-      println("  movswl eax, ax");
-      return;
-    }
-    return;
-  }
-  }
+#define NUM_TREE_REGS (sizeof(tree_regs) / sizeof(*tree_regs))
 
-  gen_expr(node->rhs);
-  push();
-  gen_expr(node->lhs);
-  pop("rdi");
+// Any value greater than what a tree can use without spilling
+#define OPAQUE (NUM_TREE_REGS - 1)
 
-  char *ax, *di;
+static void gen_tree(Node *node, int k);
 
-  if (node->lhs->ty->kind == TY_LONG || node->lhs->ty->base)
-  {
-    ax = "rax";
-    di = "rdi";
-  }
-  else
-  {
-    ax = "eax";
-    di = "edi";
-  }
+static void push_reg(int r)
+{
+  println("  push %s", reg64[r]);
+  depth++;
+}
+
+static void pop_reg(int r)
+{
+  println("  pop %s", reg64[r]);
+  depth--;
+}
 
+static bool is_tree_binary(Node *node)
+{
   switch (node->kind)
   {
   case ND_ADD:
-    println("  add %s, %s", ax, di);
-    return;
   case ND_SUB:
-    println("  sub %s, %s", ax, di);
-    return;
   case ND_MUL:
-    println("  imul %s, %s", ax, di);
-    return;
   case ND_DIV:
   case ND_MOD:
-    if (node->lhs->ty->size == 8)
-      println("  cqo");
-    else
-      println("  cdq");
-    println("  idiv %s", di);
-
-    if (node->kind == ND_MOD)
-      println("  mov rax, rdx");
-    return;
   case ND_BITAND:
-    println("  and rax, rdi");
-    return;
   case ND_BITOR:
-    println("  or rax, rdi");
-    return;
   case ND_BITXOR:
-    println("  xor rax, rdi");
-    return;
+  case ND_SHL:
+  case ND_SHR:
   case ND_EQ:
-    println("  cmp %s, %s", ax, di);
-    println("  sete al");
-    println("  movzb rax, al");
-    return;
   case ND_NE:
-    println("  cmp %s, %s", ax, di);
-    println("  setne al");
-    println("  movzb rax, al");
-    return;
   case ND_LT:
-    println("  cmp %s, %s", ax, di);
-    println("  setl al");
-    println("  movzb rax, al");
-    return;
   case ND_LE:
-    println("  cmp %s, %s", ax, di);
-    println("  setle al");
-    println("  movzb rax, al");
-    return;
-  case ND_SHL:
-    println("  mov rcx, rdi");
-    println("  shl %s, cl", ax);
-    return;
-  case ND_SHR:
-    println("  mov rcx, rdi");
-    if (node->ty->size == 8)
-      println("  sar %s, cl", ax);
-    else
-      println("  sar %s, cl", ax);
-    return;
+    return true;
   }
-  error_tok(node->tok, "invalid expression");
+  return false;
 }
 
-static void gen_stmt(Node *node)
+static int addr_regs(Node *node);
+static int isel_regs(Node *node);
+
+static int tree_regs_needed(Node *node)
 {
-  println(" .loc 1 %d", node->tok->line_no);
-  switch (node->kind)
+  if (node->regs)
+    return node->regs;
+
+  int n = opt_isel ? isel_regs(node) : 0;
+  if (n)
   {
-  case ND_IF:
+    node->regs = n;
+    return n;
+  }
+
+  switch (node->kind)
   {
-    int c = count();
-    gen_expr(node->cond);
-    println("  cmp rax, 0");
-    println("  je  .L.else%d", c);
-    gen_stmt(node->then);
-    println("  jmp .L.end%d", c);
-    println(".L.else%d:", c);
-    if (node->els)
+  case ND_NUM:
+    n = 1;
+    break;
+  case ND_VAR:
+  case ND_MEMBER:
+    n = addr_regs(node);
+    break;
+  case ND_DEREF:
+  case ND_CAST:
+  case ND_NEG:
+  case ND_BITNOT:
+  case ND_NOT:
+    n = tree_regs_needed(node->lhs);
+    break;
+  default:
+    if (is_tree_binary(node))
     {
-      gen_stmt(node->els);
+      int l = tree_regs_needed(node->lhs);
+      int r = tree_regs_needed(node->rhs);
+      n = (l == r) ? l + 1 : MAX(l, r);
     }
-    println(".L.end%d:", c);
-    return;
-  }
-  case ND_FOR:
-  {
-    int c = count();
-    if (node->init)
-      gen_stmt(node->init);
-    println(".L.begin%d:", c);
-    if (node->cond)
+    else
     {
-      gen_expr(node->cond);
-      println("  cmp rax, 0");
-      println("  je %s", node->brk_label);
+      n = OPAQUE;
     }
-    gen_stmt(node->then);
-    println("%s:", node->cont_label);
-    if (node->inc)
-      gen_expr(node->inc);
-    println("  jmp .L.begin%d", c);
-    println("%s:", node->brk_label);
-    return;
   }
-  case ND_DO: {
-    int c = count();
+  node->regs = n;
+  return n;
+}
+
+static int addr_regs(Node *node)
+{
+  switch (node->kind)
+  {
+  case ND_VAR:
+    return 1;
+  case ND_DEREF:
+    return tree_regs_needed(node->lhs);
+  case ND_MEMBER:
+    return addr_regs(node->lhs);
+  }
+  return OPAQUE;
+}
+
+// Compile an expression that is not a tree with gen_expr() or
+// gen_addr(), saving the registers that are live.
+static void gen_opaque(Node *node, int k, bool addr)
+{
+  for (int i = 0; i < k; i++)
+    push_reg(tree_regs[i]);
+  if (addr)
+    gen_addr(node);
+  else
+    gen_expr(node);
+  if (k > 0)
+    println("  mov %s, rax", reg64[tree_regs[k]]);
+  for (int i = k - 1; i >= 0; i--)
+    pop_reg(tree_regs[i]);
+}
+
+static void gen_tree_addr(Node *node, int k)
+{
+  int r = tree_regs[k];
+
+  switch (node->kind)
+  {
+  case ND_VAR:
+    if (node->var->is_local)
+      println("  lea %s, [rbp + %d]", reg64[r], node->var->offset);
+    else
+      println("  lea %s, [rip + %s]", reg64[r], node->var->name);
+    return;
+  case ND_DEREF:
+    gen_tree(node->lhs, k);
+    return;
+  case ND_MEMBER:
+    gen_tree_addr(node->lhs, k);
+    println("  add %s, %d", reg64[r], node->member->offset);
+    return;
+  }
+  gen_opaque(node, k, true);
+}
+
+// Same as load(), but loads to a register from where it is pointing to.
+static void load_reg(Type *ty, int r)
+{
+  if (ty->kind == TY_ARRAY || ty->kind == TY_STRUCT || ty->kind == TY_UNION)
+    return;
+
+  if (ty->size == 1)
+    println("  movsx %s, byte ptr [%s]", reg32[r], reg64[r]);
+  else if (ty->size == 2)
+    println("  movsx %s, word ptr [%s]", reg32[r], reg64[r]);
+  else if (ty->size == 4)
+    println("  movsxd %s, dword ptr [%s]", reg64[r], reg64[r]);
+  else
+    println("  mov %s, [%s]", reg64[r], reg64[r]);
+}
+
+// Same as cast(), but on a given register.
+static void cast_reg(Type *from, Type *to, int r)
+{
+  if (to->kind == TY_VOID)
+    return;
+
+  if (to->kind == TY_BOOL)
+  {
+    bool small = is_integer(from) && from->size <= 4;
+    println("  cmp %s, 0", small ? reg32[r] : reg64[r]);
+    println("  setne %s", reg8[r]);
+    println("  movzx %s, %s", reg32[r], reg8[r]);
+    return;
+  }
+
+  char *insn = cast_table[getTypeId(from)][getTypeId(to)];
+  if (insn == i32i8)
+    println("  movsx %s, %s", reg32[r], reg8[r]);
+  else if (insn == i32i16)
+    println("  movsx %s, %s", reg32[r], reg16[r]);
+  else if (insn == i32i64)
+    println("  movsxd %s, %s", reg64[r], reg32[r]);
+}
+
+//
+// Instruction selection
+//
+// Rather than computing every address into a register and loading
+// from it, we match the largest subtree we can against the x86
+// addressing mode `base + index*scale + disp` (maximal munch). For
+// example, `a[i]` for `int *a` becomes a single
+// `movsxd rax, dword ptr [rax + rdi*4]`. The same match computes
+// additions with lea, and lets assignments and compound assignments
+// operate on memory directly. Constant operands become immediates.
+//
+
+bool opt_isel = true;
+
+typedef struct
+{
+  Node *base;        // evaluated into a register
+  bool base_is_addr; // the address of lvalue `base` is the base
+  Node *index;
+  int scale;
+  int64_t disp;
+  Obj *var; // rbp- or rip-relative base instead of `base`
+} AddrMode;
+
+static bool is_wide(Type *ty)
+{
+  return ty->kind == TY_LONG || ty->base;
+}
+
+static bool fits_disp(int64_t disp)
+{
+  return -(1 << 30) < disp && disp < (1 << 30);
+}
+
+static char *ptr_size(int size)
+{
+  switch (size)
+  {
+  case 1:
+    return "byte";
+  case 2:
+    return "word";
+  case 4:
+    return "dword";
+  }
+  return "qword";
+}
+
+static char *reg_sized(int r, int size)
+{
+  switch (size)
+  {
+  case 1:
+    return reg8[r];
+  case 2:
+    return reg16[r];
+  case 4:
+    return reg32[r];
+  }
+  return reg64[r];
+}
+
+// The lower `size` bytes of `val` as a signed number
+static int64_t trunc_imm(int64_t val, int size)
+{
+  switch (size)
+  {
+  case 1:
+    return (int8_t)val;
+  case 2:
+    return (int16_t)val;
+  case 4:
+    return (int32_t)val;
+  }
+  return val;
+}
+
+// Returns true if `node` is a constant that fits in the 32-bit
+// immediate operand of an instruction.
+static bool is_imm(Node *node, int64_t *val)
+{
+  // Widening a constant doesn't change its value.
+  while (node->kind == ND_CAST && node->ty->kind != TY_BOOL && node->ty->size >= 4)
+    node = node->lhs;
+  if (node->kind != ND_NUM || node->val != (int32_t)node->val)
+    return false;
+  *val = node->val;
+  return true;
+}
+
+// Returns true if `node` is a 32-bit integer operation, or a 64-bit
+// one if `wide` is true.
+static bool same_width(Node *node, bool wide)
+{
+  if (wide)
+    return is_wide(node->ty);
+  return is_integer(node->ty) && node->ty->kind != TY_BOOL && node->ty->size == 4;
+}
+
+static bool is_scale(int64_t val)
+{
+  return val == 1 || val == 2 || val == 4 || val == 8;
+}
+
+// Conversions between pointers and longs, and truncation to int,
+// keep the bits we use.
+static bool is_nop_cast(Node *node, bool wide)
+{
+  if (node->kind != ND_CAST)
+    return false;
+  Type *from = node->lhs->ty;
+  if (wide)
+    return is_wide(from) && is_wide(node->ty);
+  return same_width(node, false) && from->kind != TY_BOOL &&
+         (from->base || from->size >= 4);
+}
+
+static void match_value(Node *node, AddrMode *am, bool wide);
+
+static void match_index(Node *node, AddrMode *am, bool wide)
+{
+  int64_t val;
+  while (is_nop_cast(node, wide))
+    node = node->lhs;
+  am->index = node;
+  am->scale = 1;
+
+  if (!same_width(node, wide))
+    return;
+
+  if (node->kind == ND_MUL && is_imm(node->rhs, &val) && is_scale(val))
+  {
+    am->index = node->lhs;
+    am->scale = val;
+  }
+  else if (node->kind == ND_MUL && is_imm(node->lhs, &val) && is_scale(val))
+  {
+    am->index = node->rhs;
+    am->scale = val;
+  }
+  else if (node->kind == ND_SHL && is_imm(node->rhs, &val) && 0 <= val && val <= 3)
+  {
+    am->index = node->lhs;
+    am->scale = 1 << val;
+  }
+}
+
+// Matches the address of an lvalue.
+static void match_addr(Node *node, AddrMode *am)
+{
+  switch (node->kind)
+  {
+  case ND_VAR:
+    // rip-relative addresses can't have an index.
+    if (node->var->is_local || !am->index)
+    {
+      am->var = node->var;
+      return;
+    }
+    break;
+  case ND_DEREF:
+    match_value(node->lhs, am, true);
+    return;
+  case ND_MEMBER:
+    if (fits_disp(am->disp + node->member->offset))
+    {
+      am->disp += node->member->offset;
+      match_addr(node->lhs, am);
+      return;
+    }
+    break;
+  }
+
+  am->base = node;
+  am->base_is_addr = true;
+}
+
+// Matches an integer or pointer value. A 32-bit value is only ever
+// used with lea, so the upper half of the registers doesn't matter.
+static void match_value(Node *node, AddrMode *am, bool wide)
+{
+  int64_t val;
+
+  switch (node->kind)
+  {
+  case ND_VAR:
+  case ND_MEMBER:
+  case ND_DEREF:
+    // The value of an array is its address.
+    if (wide && node->ty->kind == TY_ARRAY)
+    {
+      match_addr(node, am);
+      return;
+    }
+    break;
+  case ND_ADDR:
+    if (wide)
+    {
+      match_addr(node->lhs, am);
+      return;
+    }
+    break;
+  case ND_ADD:
+    if (!same_width(node, wide))
+      break;
+    if (is_imm(node->rhs, &val) && fits_disp(am->disp + val))
+    {
+      am->disp += val;
+      match_value(node->lhs, am, wide);
+      return;
+    }
+    if (is_imm(node->lhs, &val) && fits_disp(am->disp + val))
+    {
+      am->disp += val;
+      match_value(node->rhs, am, wide);
+      return;
+    }
+    if (!am->index)
+    {
+      match_index(node->rhs, am, wide);
+      match_value(node->lhs, am, wide);
+      return;
+    }
+    break;
+  case ND_SUB:
+    if (same_width(node, wide) && is_imm(node->rhs, &val) &&
+        fits_disp(am->disp - val))
+    {
+      am->disp -= val;
+      match_value(node->lhs, am, wide);
+      return;
+    }
+    break;
+  case ND_CAST:
+    if (is_nop_cast(node, wide))
+    {
+      match_value(node->lhs, am, wide);
+      return;
+    }
+    break;
+  }
+
+  am->base = node;
+}
+
+static int base_regs(AddrMode *am)
+{
+  if (!am->base)
+    return 0;
+  return am->base_is_addr ? addr_regs(am->base) : tree_regs_needed(am->base);
+}
+
+static int mode_regs(AddrMode *am)
+{
+  int b = base_regs(am);
+  int i = am->index ? tree_regs_needed(am->index) : 0;
+  if (b && i)
+    return (b == i) ? b + 1 : MAX(b, i);
+  return MAX(1, MAX(b, i));
+}
+
+// Returns true if lea computes `node` in fewer instructions than
+// add, sub, imul and shl would.
+static bool match_lea(Node *node, AddrMode *am)
+{
+  if (node->kind != ND_ADD && node->kind != ND_SUB)
+    return false;
+  bool wide = is_wide(node->ty);
+  if (!wide && !same_width(node, false))
+    return false;
+
+  *am = (AddrMode){0};
+  match_value(node, am, wide);
+
+  int cost = (am->base && am->index) + (am->scale > 1) + (am->disp != 0) +
+             (am->var != NULL);
+  return cost > 1;
+}
+
+static void gen_base(AddrMode *am, int k)
+{
+  if (am->base_is_addr)
+    gen_tree_addr(am->base, k);
+  else
+    gen_tree(am->base, k);
+}
+
+// Computes the registers of an addressing mode in tree_regs[k..] and
+// returns the memory operand.
+static char *gen_mode(AddrMode *am, int k)
+{
+  int b = -1;
+  int i = -1;
+
+  if (am->base && am->index)
+  {
+    if (mode_regs(am) > NUM_TREE_REGS - 1 - k)
+    {
+      gen_tree(am->index, k);
+      push_reg(tree_regs[k]);
+      gen_base(am, k);
+      pop_reg(tree_regs[k + 1]);
+      b = k;
+      i = k + 1;
+    }
+    else if (base_regs(am) >= tree_regs_needed(am->index))
+    {
+      gen_base(am, k);
+      gen_tree(am->index, k + 1);
+      b = k;
+      i = k + 1;
+    }
+    else
+    {
+      gen_tree(am->index, k);
+      gen_base(am, k + 1);
+      i = k;
+      b = k + 1;
+    }
+  }
+  else if (am->base)
+  {
+    gen_base(am, k);
+    b = k;
+  }
+  else if (am->index)
+  {
+    gen_tree(am->index, k);
+    i = k;
+  }
+
+  int64_t disp = am->disp;
+  char *s = NULL;
+  if (am->var && am->var->is_local)
+  {
+    s = "rbp";
+    disp += am->var->offset;
+  }
+  else if (am->var)
+  {
+    s = format("rip + %s", am->var->name);
+  }
+  else if (b != -1)
+  {
+    s = reg64[tree_regs[b]];
+  }
+
+  if (i != -1)
+  {
+    char *idx = reg64[tree_regs[i]];
+    if (am->scale > 1)
+      idx = format("%s*%d", idx, am->scale);
+    s = s ? format("%s + %s", s, idx) : idx;
+  }
+
+  if (disp > 0)
+    return format("[%s + %ld]", s, disp);
+  if (disp < 0)
+    return format("[%s - %ld]", s, -disp);
+  return format("[%s]", s);
+}
+
+static void lea_mode(int r, char *m)
+{
+  if (strcmp(m, format("[%s]", reg64[r])))
+    println("  lea %s, %s", reg64[r], m);
+}
+
+// Same as load_reg(), but loads from a memory operand.
+static void load_mode(Type *ty, int r, char *m)
+{
+  if (ty->kind == TY_ARRAY || ty->kind == TY_STRUCT || ty->kind == TY_UNION)
+  {
+    lea_mode(r, m);
+    return;
+  }
+
+  if (ty->size == 1)
+    println("  movsx %s, byte ptr %s", reg32[r], m);
+  else if (ty->size == 2)
+    println("  movsx %s, word ptr %s", reg32[r], m);
+  else if (ty->size == 4)
+    println("  movsxd %s, dword ptr %s", reg64[r], m);
+  else
+    println("  mov %s, qword ptr %s", reg64[r], m);
+}
+
+//
+// Strength reduction
+//
+// Multiplications by constants become shifts and lea. Divisions by
+// constants avoid idiv, which takes tens of cycles. Powers of two are
+// divided with shifts after biasing negative dividends so that the
+// quotient rounds toward zero. Other divisors multiply by a
+// fixed-point reciprocal and keep the high half of the product, as in
+// Granlund and Montgomery, "Division by Invariant Integers using
+// Multiplication" (the signed variant from Hacker's Delight, 10-1).
+//
+
+bool opt_strength_reduce = true;
+
+static uint64_t abs64(int64_t val)
+{
+  return (val < 0) ? -(uint64_t)val : val;
+}
+
+static bool is_pow2(uint64_t val)
+{
+  return val && !(val & (val - 1));
+}
+
+static int log2_of(uint64_t val)
+{
+  int n = 0;
+  while (val > 1)
+  {
+    val >>= 1;
+    n++;
+  }
+  return n;
+}
+
+// Splits `c` into f1 * f2 * 2^shift with f1 and f2 in {1, 3, 5, 9},
+// which lea and shl compute in at most two instructions.
+static bool split_mul(int64_t c, int *f1, int *f2, int *shift)
+{
+  static int factors[] = {1, 3, 5, 9};
+
+  if (c <= 0)
+    return false;
+
+  int s = 0;
+  for (; !(c & 1); c >>= 1)
+    s++;
+
+  for (int i = 0; i < 4; i++)
+  {
+    for (int j = i; j < 4; j++)
+    {
+      if (factors[i] * factors[j] != c || (i > 0) + (j > 0) + (s > 0) > 2)
+        continue;
+      *f1 = factors[i];
+      *f2 = factors[j];
+      *shift = s;
+      return true;
+    }
+  }
+  return false;
+}
+
+// r = r * c at the given width. Returns false if imul is cheaper.
+static bool gen_mul_imm(int r, int64_t c, int size)
+{
+  if (!opt_strength_reduce)
+    return false;
+
+  char *x = reg_sized(r, size);
+
+  // x * -2^s = -(x << s)
+  if (c < 0 && is_pow2(abs64(c)))
+  {
+    if (c != -1)
+      println("  shl %s, %d", x, log2_of(abs64(c)));
+    println("  neg %s", x);
+    return true;
+  }
+
+  int f1, f2, shift;
+  if (!split_mul(c, &f1, &f2, &shift))
+    return false;
+
+  int f[] = {f1, f2};
+  for (int i = 0; i < 2; i++)
+    if (f[i] > 1)
+      println("  lea %s, [%s + %s*%d]", x, reg64[r], reg64[r], f[i] - 1);
+  if (shift)
+    println("  shl %s, %d", x, shift);
+  return true;
+}
+
+// Computes the magic number and the shift for signed division by `d`
+// at `w` bits, so that n / d is the high half of n * magic shifted
+// right, plus one if that is negative. Arithmetic is done modulo 2^w.
+static void div_magic(int64_t d, int w, int64_t *magic, int *shift)
+{
+  uint64_t mask = (w == 64) ? ~(uint64_t)0 : ((uint64_t)1 << w) - 1;
+  uint64_t two_w1 = (uint64_t)1 << (w - 1);
+  uint64_t ad = abs64(d);
+  uint64_t t = two_w1 + (d < 0);
+  uint64_t anc = t - 1 - t % ad; // absolute value of nc
+  int p = w - 1;
+  uint64_t q1 = two_w1 / anc; // 2^p / anc
+  uint64_t r1 = two_w1 - q1 * anc;
+  uint64_t q2 = two_w1 / ad; // 2^p / ad
+  uint64_t r2 = two_w1 - q2 * ad;
+  uint64_t delta;
+
+  do
+  {
+    p++;
+    q1 = (q1 * 2) & mask;
+    r1 = (r1 * 2) & mask;
+    if (r1 >= anc)
+    {
+      q1 = (q1 + 1) & mask;
+      r1 -= anc;
+    }
+    q2 = (q2 * 2) & mask;
+    r2 = (r2 * 2) & mask;
+    if (r2 >= ad)
+    {
+      q2 = (q2 + 1) & mask;
+      r2 -= ad;
+    }
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+
+  uint64_t m = (q2 + 1) & mask;
+  if (d < 0)
+    m = -m & mask;
+  *magic = (w == 32) ? (int32_t)m : (int64_t)m;
+  *shift = p - w;
+}
+
+// r = r / d or r % d if d is plus or minus a power of two, using `t`
+// as a scratch register.
+static void gen_div_pow2(int r, int t, int64_t d, int size, bool is_mod)
+{
+  int w = size * 8;
+  uint64_t ad = abs64(d);
+  int s = log2_of(ad);
+  char *x = reg_sized(r, size);
+  char *tmp = reg_sized(t, size);
+
+  if (s == 0)
+  {
+    if (is_mod)
+      println("  mov %s, 0", x);
+    else if (d < 0)
+      println("  neg %s", x);
+    return;
+  }
+
+  // Negative dividends are biased by |d| - 1 so that the shift rounds
+  // toward zero.
+  if (ad - 1 <= INT32_MAX)
+  {
+    println("  lea %s, [%s + %lu]", tmp, reg64[r], ad - 1);
+    println("  test %s, %s", x, x);
+    println("  cmovns %s, %s", tmp, x);
+  }
+  else
+  {
+    println("  mov %s, %s", tmp, x);
+    println("  sar %s, %d", tmp, w - 1);
+    println("  shr %s, %d", tmp, w - s);
+    println("  add %s, %s", tmp, x);
+  }
+
+  if (is_mod)
+  {
+    // x % d = x - (biased x with the low s bits cleared)
+    if (s < 32)
+    {
+      println("  and %s, %ld", tmp, -(int64_t)ad);
+    }
+    else
+    {
+      println("  sar %s, %d", tmp, s);
+      println("  shl %s, %d", tmp, s);
+    }
+    println("  sub %s, %s", x, tmp);
+    return;
+  }
+
+  println("  sar %s, %d", tmp, s);
+  if (d < 0)
+    println("  neg %s", tmp);
+  println("  mov %s, %s", x, tmp);
+}
+
+// n / d or n % d for any other divisor. `n` must not be %rax or %rdx,
+// which are clobbered. Returns the register that holds the result.
+static int gen_div_magic(int n, int64_t d, int size, bool is_mod)
+{
+  int w = size * 8;
+  int64_t magic;
+  int shift;
+  div_magic(d, w, &magic, &shift);
+
+  char *ax = reg_sized(REG_RAX, size);
+  char *dx = reg_sized(REG_RDX, size);
+  char *x = reg_sized(n, size);
+
+  println("  mov %s, %ld", ax, magic);
+  println("  imul %s", x);
+  if (d > 0 && magic < 0)
+    println("  add %s, %s", dx, x);
+  else if (d < 0 && magic > 0)
+    println("  sub %s, %s", dx, x);
+  if (shift)
+    println("  sar %s, %d", dx, shift);
+
+  // Add one if the quotient is negative.
+  println("  mov %s, %s", ax, dx);
+  println("  shr %s, %d", ax, w - 1);
+  println("  add %s, %s", dx, ax);
+  if (!is_mod)
+    return REG_RDX;
+
+  // n % d = n - n / d * d
+  if (d == (int32_t)d)
+  {
+    println("  imul %s, %s, %ld", dx, dx, d);
+  }
+  else
+  {
+    println("  mov rax, %ld", d);
+    println("  imul rdx, rax");
+  }
+  println("  mov %s, %s", ax, x);
+  println("  sub %s, %s", ax, dx);
+  return REG_RAX;
+}
+
+// Returns true if division by `d` is done without idiv.
+static bool is_cheap_div(int64_t d)
+{
+  return opt_strength_reduce && d != 0;
+}
+
+// Returns the operand of a binary operator that can be an immediate.
+static Node *imm_operand(Node *node)
+{
+  int64_t val;
+
+  switch (node->kind)
+  {
+  case ND_ADD:
+  case ND_SUB:
+  case ND_MUL:
+  case ND_BITAND:
+  case ND_BITOR:
+  case ND_BITXOR:
+  case ND_EQ:
+  case ND_NE:
+  case ND_LT:
+  case ND_LE:
+    if (is_imm(node->rhs, &val))
+      return node->rhs;
+    if (is_imm(node->lhs, &val))
+      return node->lhs;
+    return NULL;
+  case ND_SHL:
+  case ND_SHR:
+    if (is_imm(node->rhs, &val))
+      return node->rhs;
+    return NULL;
+  case ND_DIV:
+  case ND_MOD:
+    if (is_imm(node->rhs, &val) && is_cheap_div(val))
+      return node->rhs;
+    return NULL;
+  }
+  return NULL;
+}
+
+// Number of registers needed by the patterns above, or 0 if no
+// pattern applies.
+static int isel_regs(Node *node)
+{
+  AddrMode am = {0};
+
+  switch (node->kind)
+  {
+  case ND_VAR:
+  case ND_MEMBER:
+  case ND_DEREF:
+    match_addr(node, &am);
+    return mode_regs(&am);
+  case ND_ADDR:
+    match_addr(node->lhs, &am);
+    return mode_regs(&am);
+  }
+
+  if (match_lea(node, &am))
+    return mode_regs(&am);
+
+  Node *imm = imm_operand(node);
+  if (!imm)
+    return 0;
+
+  int n = tree_regs_needed(imm == node->rhs ? node->lhs : node->rhs);
+  // Division by a constant needs a scratch register.
+  if (node->kind == ND_DIV || node->kind == ND_MOD)
+    return MAX(n, 2);
+  return n;
+}
+
+static char *setcc_insn(NodeKind kind, bool swapped);
+
+// x = x / d or x = x % d for a constant d. The dividend is copied to
+// tree_regs[k + 1], which is free, and %rax and %rdx are saved like in
+// gen_tree_div() if they hold other live values.
+static void gen_tree_div_imm(Node *node, int k, int64_t d)
+{
+  int x = tree_regs[k];
+  int size = is_wide(node->lhs->ty) ? 8 : 4;
+  bool is_mod = (node->kind == ND_MOD);
+
+  if (is_pow2(abs64(d)))
+  {
+    gen_div_pow2(x, tree_regs[k + 1], d, size, is_mod);
+    return;
+  }
+
+  int n = tree_regs[k + 1];
+  if (n == REG_RDX)
+    n = REG_R8;
+  println("  mov %s, %s", reg64[n], reg64[x]);
+
+  bool save_rax = (x != REG_RAX);
+  bool save_rdx = (k > 3);
+  if (save_rax)
+    push_reg(REG_RAX);
+  if (save_rdx)
+    push_reg(REG_RDX);
+
+  int result = gen_div_magic(n, d, size, is_mod);
+  if (x != result)
+    println("  mov %s, %s", reg64[x], reg64[result]);
+
+  if (save_rdx)
+    pop_reg(REG_RDX);
+  if (save_rax)
+    pop_reg(REG_RAX);
+}
+
+// x op imm, or imm op x if the immediate is the left-hand side.
+static void gen_tree_imm(Node *node, Node *imm, int k)
+{
+  bool swapped = (imm == node->lhs);
+  int r = tree_regs[k];
+  int64_t val;
+  is_imm(imm, &val);
+
+  gen_tree(swapped ? node->rhs : node->lhs, k);
+
+  bool wide = is_wide(node->lhs->ty);
+  char *ax = wide ? reg64[r] : reg32[r];
+
+  switch (node->kind)
+  {
+  case ND_ADD:
+    println("  add %s, %ld", ax, val);
+    return;
+  case ND_SUB:
+    // imm - x = -x + imm
+    if (swapped)
+    {
+      println("  neg %s", ax);
+      println("  add %s, %ld", ax, val);
+      return;
+    }
+    println("  sub %s, %ld", ax, val);
+    return;
+  case ND_MUL:
+    if (!gen_mul_imm(r, val, wide ? 8 : 4))
+      println("  imul %s, %s, %ld", ax, ax, val);
+    return;
+  case ND_DIV:
+  case ND_MOD:
+    gen_tree_div_imm(node, k, val);
+    return;
+  case ND_BITAND:
+    println("  and %s, %ld", reg64[r], val);
+    return;
+  case ND_BITOR:
+    println("  or %s, %ld", reg64[r], val);
+    return;
+  case ND_BITXOR:
+    println("  xor %s, %ld", reg64[r], val);
+    return;
+  case ND_EQ:
+  case ND_NE:
+  case ND_LT:
+  case ND_LE:
+    println("  cmp %s, %ld", ax, val);
+    println("  %s %s", setcc_insn(node->kind, swapped), reg8[r]);
+    println("  movzx %s, %s", reg32[r], reg8[r]);
+    return;
+  case ND_SHL:
+    println("  shl %s, %ld", ax, val & (wide ? 63 : 31));
+    return;
+  case ND_SHR:
+    println("  sar %s, %ld", ax, val & (wide ? 63 : 31));
+    return;
+  }
+  unreachable();
+}
+
+// Generates code for the patterns above. Returns false if no pattern
+// applies.
+static bool gen_isel(Node *node, int k)
+{
+  int r = tree_regs[k];
+  AddrMode am = {0};
+
+  switch (node->kind)
+  {
+  case ND_VAR:
+  case ND_MEMBER:
+  case ND_DEREF:
+    match_addr(node, &am);
+    load_mode(node->ty, r, gen_mode(&am, k));
+    return true;
+  case ND_ADDR:
+    match_addr(node->lhs, &am);
+    lea_mode(r, gen_mode(&am, k));
+    return true;
+  }
+
+  if (match_lea(node, &am))
+  {
+    char *m = gen_mode(&am, k);
+    println("  lea %s, %s", is_wide(node->ty) ? reg64[r] : reg32[r], m);
+    return true;
+  }
+
+  Node *imm = imm_operand(node);
+  if (imm)
+  {
+    gen_tree_imm(node, imm, k);
+    return true;
+  }
+  return false;
+}
+
+static char *setcc_insn(NodeKind kind, bool swapped)
+{
+  switch (kind)
+  {
+  case ND_EQ:
+    return "sete";
+  case ND_NE:
+    return "setne";
+  case ND_LT:
+    return swapped ? "setg" : "setl";
+  case ND_LE:
+    return swapped ? "setge" : "setle";
+  }
+  unreachable();
+}
+
+// x = x / y or x = x % y. %rax and %rdx are in the register stack,
+// so we save them if they hold other live values.
+static void gen_tree_div(Node *node, int k)
+{
+  int x = tree_regs[k];
+  int y = tree_regs[k + 1];
+  bool is_long = (node->lhs->ty->size == 8);
+
+  if (y == REG_RDX)
+  {
+    println("  mov r8, rdx");
+    y = REG_R8;
+  }
+
+  bool save_rax = (x != REG_RAX);
+  bool save_rdx = (k > 3);
+  if (save_rax)
+    push_reg(REG_RAX);
+  if (save_rdx)
+    push_reg(REG_RDX);
+
+  if (x != REG_RAX)
+    println("  mov rax, %s", reg64[x]);
+  println("  %s", is_long ? "cqo" : "cdq");
+  println("  idiv %s", is_long ? reg64[y] : reg32[y]);
+
+  int result = (node->kind == ND_DIV) ? REG_RAX : REG_RDX;
+  if (x != result)
+    println("  mov %s, %s", reg64[x], reg64[result]);
+
+  if (save_rdx)
+    pop_reg(REG_RDX);
+  if (save_rax)
+    pop_reg(REG_RAX);
+}
+
+// x = x << y or x = x >> y. The shift count has to be in %cl.
+static void gen_tree_shift(Node *node, int k, char *ax)
+{
+  int x = tree_regs[k];
+  int y = tree_regs[k + 1];
+  char *insn = (node->kind == ND_SHL) ? "shl" : "sar";
+  bool is_long = (node->lhs->ty->kind == TY_LONG || node->lhs->ty->base);
+
+  if (y == REG_RCX)
+  {
+    println("  %s %s, cl", insn, ax);
+    return;
+  }
+
+  if (x == REG_RCX)
+  {
+    println("  xchg rcx, %s", reg64[y]);
+    println("  %s %s, cl", insn, is_long ? reg64[y] : reg32[y]);
+    println("  mov rcx, %s", reg64[y]);
+    return;
+  }
+
+  bool save_rcx = (k > 4);
+  if (save_rcx)
+    push_reg(REG_RCX);
+  println("  mov rcx, %s", reg64[y]);
+  println("  %s %s, cl", insn, ax);
+  if (save_rcx)
+    pop_reg(REG_RCX);
+}
+
+// Evaluates the operands of a binary operator into tree_regs[k] and
+// tree_regs[k + 1]. Returns true if the right-hand side is in the
+// former and the left-hand side in the latter.
+static bool gen_tree_operands(Node *node, int k)
+{
+  int l = tree_regs_needed(node->lhs);
+  int r = tree_regs_needed(node->rhs);
+  int avail = NUM_TREE_REGS - 1 - k;
+  bool swapped = false;
+
+  if (tree_regs_needed(node) > avail)
+  {
+    // Not enough registers. Evaluate the right-hand side first as
+    // the stack machine does, and keep it on the stack meanwhile.
+    gen_tree(node->rhs, k);
+    push_reg(tree_regs[k]);
+    gen_tree(node->lhs, k);
+    pop_reg(tree_regs[k + 1]);
+  }
+  else if (l >= r)
+  {
+    gen_tree(node->lhs, k);
+    gen_tree(node->rhs, k + 1);
+  }
+  else
+  {
+    gen_tree(node->rhs, k);
+    gen_tree(node->lhs, k + 1);
+    swapped = true;
+  }
+  return swapped;
+}
+
+static void gen_tree_binary(Node *node, int k)
+{
+  bool swapped = gen_tree_operands(node, k);
+
+  // The left-hand side is in x and the right-hand side in y, unless
+  // they were swapped.
+  int x = tree_regs[swapped ? k + 1 : k];
+  int y = tree_regs[swapped ? k : k + 1];
+  int dst = tree_regs[k];
+
+  char *ax, *di;
+  if (node->lhs->ty->kind == TY_LONG || node->lhs->ty->base)
+  {
+    ax = reg64[dst];
+    di = reg64[tree_regs[k + 1]];
+  }
+  else
+  {
+    ax = reg32[dst];
+    di = reg32[tree_regs[k + 1]];
+  }
+
+  switch (node->kind)
+  {
+  case ND_ADD:
+    println("  add %s, %s", ax, di);
+    return;
+  case ND_MUL:
+    println("  imul %s, %s", ax, di);
+    return;
+  case ND_SUB:
+    println("  sub %s, %s", ax, di);
+    // y - x = -(x - y)
+    if (swapped)
+      println("  neg %s", ax);
+    return;
+  case ND_BITAND:
+    println("  and %s, %s", reg64[dst], reg64[tree_regs[k + 1]]);
+    return;
+  case ND_BITOR:
+    println("  or %s, %s", reg64[dst], reg64[tree_regs[k + 1]]);
+    return;
+  case ND_BITXOR:
+    println("  xor %s, %s", reg64[dst], reg64[tree_regs[k + 1]]);
+    return;
+  case ND_EQ:
+  case ND_NE:
+  case ND_LT:
+  case ND_LE:
+    println("  cmp %s, %s", ax, di);
+    println("  %s %s", setcc_insn(node->kind, swapped), reg8[dst]);
+    println("  movzx %s, %s", reg32[dst], reg8[dst]);
+    return;
+  }
+
+  // Division and shifts need the operands in order.
+  if (swapped)
+    println("  xchg %s, %s", reg64[x], reg64[y]);
+
+  if (node->kind == ND_DIV || node->kind == ND_MOD)
+    gen_tree_div(node, k);
+  else
+    gen_tree_shift(node, k, ax);
+}
+
+//
+// Extension elimination
+//
+// Loads and casts sign-extend sub-64-bit values, and many of those
+// extensions don't change anything: an int loaded with movsxd is
+// already sign-extended when it is converted to long, and a char
+// computed in 32 bits needs no movsx if it is only stored as a byte.
+// sext_size() tracks the bits that are known to be sign copies, and
+// gen_tree_assign() drops conversions whose bits are not stored.
+//
+
+bool opt_ext = true;
+
+// Returns the smallest size that fits `val` as a signed integer.
+static int fit_size(int64_t val)
+{
+  if (val == (int8_t)val)
+    return 1;
+  if (val == (int16_t)val)
+    return 2;
+  if (val == (int32_t)val)
+    return 4;
+  return 8;
+}
+
+static bool is_redundant_ext(Node *node);
+
+// Returns the smallest w such that the low 32 bits, or all 64 if
+// `wide` is true, of the register that gen_tree() or gen_expr()
+// computes `node` into are the sign extension of its low w bytes.
+static int sext_size(Node *node, bool wide)
+{
+  int max = wide ? 8 : 4;
+  Type *ty = node->ty;
+  int64_t val;
+
+  switch (node->kind)
+  {
+  case ND_NUM:
+    return MIN(fit_size(node->val), max);
+  case ND_VAR:
+  case ND_MEMBER:
+  case ND_DEREF:
+    // movsx to a 32-bit register clears the upper half.
+    if (!is_integer(ty) && ty->kind != TY_PTR)
+      return max;
+    if (ty->size == 4 || (ty->size < 4 && !wide))
+      return MIN(ty->size, max);
+    return max;
+  case ND_EQ:
+  case ND_NE:
+  case ND_LT:
+  case ND_LE:
+  case ND_NOT:
+    return 1;
+  case ND_BITAND:
+    // Masking with a non-negative constant clears the upper bits.
+    if ((is_imm(node->rhs, &val) || is_imm(node->lhs, &val)) && val >= 0)
+      return MIN(fit_size(val), max);
+    return max;
+  case ND_CAST:
+  {
+    if (ty->kind == TY_BOOL)
+      return 1;
+    char *insn = cast_table[getTypeId(node->lhs->ty)][getTypeId(ty)];
+    if (!insn || is_redundant_ext(node))
+      return sext_size(node->lhs, wide);
+    if (insn == i32i64)
+      return 4;
+    if (wide)
+      return 8;
+    return (insn == i32i8) ? 1 : 2;
+  }
+  }
+  return max;
+}
+
+// Returns true if a cast would sign-extend a value that already is.
+static bool is_redundant_ext(Node *node)
+{
+  if (!opt_ext || node->ty->kind == TY_BOOL || node->ty->kind == TY_VOID)
+    return false;
+
+  char *insn = cast_table[getTypeId(node->lhs->ty)][getTypeId(node->ty)];
+  if (insn == i32i64)
+    return sext_size(node->lhs, true) <= 4;
+  if (insn == i32i8)
+    return sext_size(node->lhs, false) <= 1;
+  if (insn == i32i16)
+    return sext_size(node->lhs, false) <= 2;
+  return false;
+}
+
+// Skips conversions that don't change the low `size` bytes of a value.
+// Sub-int values are kept sign-extended to 32 bits, so widening to
+// int or narrowing keeps the bytes a store of up to 4 bytes writes.
+static Node *skip_unstored(Node *node, int size)
+{
+  if (!opt_ext || size > 4)
+    return node;
+
+  while (node->kind == ND_CAST && is_integer(node->ty) &&
+         node->ty->kind != TY_BOOL && node->ty->size >= size &&
+         (is_integer(node->lhs->ty) || node->lhs->ty->kind == TY_PTR))
+    node = node->lhs;
+  return node;
+}
+
+static void gen_tree(Node *node, int k)
+{
+  int r = tree_regs[k];
+
+  if (opt_isel && gen_isel(node, k))
+    return;
+
+  switch (node->kind)
+  {
+  case ND_NUM:
+    println("  mov %s, %ld", reg64[r], node->val);
+    return;
+  case ND_VAR:
+  case ND_MEMBER:
+    gen_tree_addr(node, k);
+    load_reg(node->ty, r);
+    return;
+  case ND_DEREF:
+    gen_tree(node->lhs, k);
+    load_reg(node->ty, r);
+    return;
+  case ND_CAST:
+    gen_tree(node->lhs, k);
+    if (!is_redundant_ext(node))
+      cast_reg(node->lhs->ty, node->ty, r);
+    return;
+  case ND_NEG:
+    gen_tree(node->lhs, k);
+    println("  neg %s", reg64[r]);
+    return;
+  case ND_BITNOT:
+    gen_tree(node->lhs, k);
+    println("  not %s", reg64[r]);
+    return;
+  case ND_NOT:
+    gen_tree(node->lhs, k);
+    println("  cmp %s, 0", reg64[r]);
+    println("  sete %s", reg8[r]);
+    println("  movzx %s, %s", reg32[r], reg8[r]);
+    return;
+  }
+
+  if (is_tree_binary(node))
+  {
+    gen_tree_binary(node, k);
+    return;
+  }
+  gen_opaque(node, k, false);
+}
+
+// Skips conversions that keep the lower bits of a value.
+static Node *skip_ext(Node *node)
+{
+  while (node->kind == ND_CAST && node->ty->kind != TY_BOOL &&
+         (is_integer(node->lhs->ty) || node->lhs->ty->base) &&
+         node->lhs->ty->size <= node->ty->size)
+    node = node->lhs;
+  return node;
+}
+
+// Returns true if two lvalues refer to the same object and can be
+// evaluated without side effects.
+static bool same_lvalue(Node *a, Node *b)
+{
+  if (a->kind != b->kind)
+    return false;
+
+  switch (a->kind)
+  {
+  case ND_VAR:
+    return a->var == b->var;
+  case ND_DEREF:
+    return a->lhs->kind == ND_VAR && b->lhs->kind == ND_VAR &&
+           a->lhs->var == b->lhs->var;
+  case ND_MEMBER:
+    return a->member == b->member && same_lvalue(a->lhs, b->lhs);
+  }
+  return false;
+}
+
+// x = x op y, where the value is not used, becomes `op [x], y`.
+static bool gen_rmw(Node *node, AddrMode *am)
+{
+  Type *ty = node->lhs->ty;
+  Node *op = node->rhs;
+  if (op->kind == ND_CAST)
+    op = op->lhs;
+
+  char *insn;
+  switch (op->kind)
+  {
+  case ND_ADD:
+    insn = "add";
+    break;
+  case ND_SUB:
+    insn = "sub";
+    break;
+  case ND_BITAND:
+    insn = "and";
+    break;
+  case ND_BITOR:
+    insn = "or";
+    break;
+  case ND_BITXOR:
+    insn = "xor";
+    break;
+  default:
+    return false;
+  }
+
+  // The operation is at least as wide as x, so the lower bits of the
+  // result only depend on the lower bits of y.
+  Node *y;
+  if (same_lvalue(skip_ext(op->lhs), node->lhs))
+    y = op->rhs;
+  else if (op->kind != ND_SUB && same_lvalue(skip_ext(op->rhs), node->lhs))
+    y = op->lhs;
+  else
+    return false;
+
+  int64_t val;
+  if (is_imm(y, &val))
+  {
+    char *m = gen_mode(am, 0);
+    println("  %s %s ptr %s, %ld", insn, ptr_size(ty->size), m,
+            trunc_imm(val, ty->size));
+    return true;
+  }
+
+  gen_tree(y, 0);
+  char *m = gen_mode(am, 1);
+  println("  %s %s, %s", insn, m, reg_sized(tree_regs[0], ty->size));
+  return true;
+}
+
+// Assignment to a scalar. If `want_value` is true, the assigned value
+// is left in %rax. Returns false if the stack machine should do it.
+static bool gen_tree_assign(Node *node, bool want_value)
+{
+  Type *ty = node->lhs->ty;
+  if (!opt_tree_regs || !opt_isel || ty->kind == TY_STRUCT ||
+      ty->kind == TY_UNION || ty->kind == TY_ARRAY)
+    return false;
+
+  AddrMode am = {0};
+  match_addr(node->lhs, &am);
+
+  if (!want_value && ty->kind != TY_BOOL)
+  {
+    if (gen_rmw(node, &am))
+      return true;
+
+    // The conversion to the type of x truncates a constant.
+    int64_t val;
+    Node *y = node->rhs;
+    if (y->kind == ND_CAST)
+      y = y->lhs;
+    if (is_imm(y, &val))
+    {
+      char *m = gen_mode(&am, 0);
+      println("  mov %s ptr %s, %ld", ptr_size(ty->size), m,
+              trunc_imm(val, ty->size));
+      return true;
+    }
+  }
+
+  gen_tree(want_value ? node->rhs : skip_unstored(node->rhs, ty->size), 0);
+  char *m = gen_mode(&am, 1);
+  println("  mov %s, %s", m, reg_sized(tree_regs[0], ty->size));
+  return true;
+}
+
+// && and || whose value is used
+static void gen_logical(Node *node)
+{
+  int c = count();
+  gen_cond(node, NULL, format(".L.false.%d", c));
+  println("  mov rax, 1");
+  println("  jmp .L.end.%d", c);
+  println(".L.false.%d:", c);
+  println("  mov rax, 0");
+  println(".L.end.%d:", c);
+}
+
+//
+// Vector code
+//
+// The vectorizer's code (see vectorize.c) operates on %xmm0-15, or on
+// %ymm0-15 with -mavx2, which no other code uses. Vector registers are
+// numbered by vectorize.c and gen_ir(), so both code generators just
+// print them. With AVX2, all vector instructions are VEX-encoded, and
+// vzeroupper at the end of the vector code avoids the penalty for
+// mixing them with SSE code elsewhere.
+//
+
+bool opt_avx2;
+
+static char *vreg(int v)
+{
+  return format("%s%d", opt_avx2 ? "ymm" : "xmm", v);
+}
+
+static char *xreg(int v)
+{
+  return format("xmm%d", v);
+}
+
+// Prefix of VEX-encoded instructions
+static char *vex(void)
+{
+  return opt_avx2 ? "v" : "";
+}
+
+static char elem_suffix(int es)
+{
+  return (es == 1) ? 'b' : (es == 2) ? 'w' : (es == 4) ? 'd' : 'q';
+}
+
+static char *vec_insn(NodeKind op, int es)
+{
+  switch (op)
+  {
+  case ND_ADD:
+    return format("padd%c", elem_suffix(es));
+  case ND_SUB:
+    return format("psub%c", elem_suffix(es));
+  case ND_MUL:
+    return (es == 2) ? "pmullw" : "pmulld";
+  case ND_BITAND:
+    return "pand";
+  case ND_BITOR:
+    return "por";
+  case ND_BITXOR:
+    return "pxor";
+  }
+  unreachable();
+}
+
+static void vec_load(int d, char *base)
+{
+  println("  %smovdqu %s, [%s]", vex(), vreg(d), base);
+}
+
+static void vec_store(char *base, int v)
+{
+  println("  %smovdqu [%s], %s", vex(), base, vreg(v));
+}
+
+static void vec_mov(int d, int a)
+{
+  if (d != a)
+    println("  %smovdqa %s, %s", vex(), vreg(d), vreg(a));
+}
+
+// d = a op b. The vectorizer never makes d equal to b unless it is
+// also a.
+static void vec_op(NodeKind op, int es, int d, int a, int b)
+{
+  char *insn = vec_insn(op, es);
+  if (opt_avx2)
+  {
+    println("  v%s %s, %s, %s", insn, vreg(d), vreg(a), vreg(b));
+    return;
+  }
+  vec_mov(d, a);
+  println("  %s %s, %s", insn, vreg(d), vreg(b));
+}
+
+// Fills d with copies of the low `es` bytes of general-purpose
+// register r.
+static void vec_splat(int d, int es, int r)
+{
+  char *x = xreg(d);
+  if (es == 8)
+    println("  %smovq %s, %s", vex(), x, reg64[r]);
+  else
+    println("  %smovd %s, %s", vex(), x, reg32[r]);
+
+  if (opt_avx2)
+  {
+    println("  vpbroadcast%c %s, %s", elem_suffix(es), vreg(d), x);
+    return;
+  }
+  if (es == 1)
+    println("  punpcklbw %s, %s", x, x);
+  if (es <= 2)
+    println("  punpcklwd %s, %s", x, x);
+  if (es <= 4)
+    println("  pshufd %s, %s, 0", x, x);
+  else
+    println("  punpcklqdq %s, %s", x, x);
+}
+
+// Fills d with a constant without a general-purpose register if it
+// is 0 or -1. Returns false otherwise.
+static bool vec_const(int d, int64_t val)
+{
+  if (val != 0 && val != -1)
+    return false;
+  char *insn = val ? "pcmpeqd" : "pxor";
+  if (opt_avx2)
+    println("  v%s %s, %s, %s", insn, vreg(d), vreg(d), vreg(d));
+  else
+    println("  %s %s, %s", insn, vreg(d), vreg(d));
+  return true;
+}
+
+// Combines the lanes of v with `op` into general-purpose register r,
+// sign-extended like a loaded value. %xmm0 is used as a scratch
+// register, and v is clobbered.
+static void vec_reduce(NodeKind op, int es, int v, int r)
+{
+  char *insn = vec_insn(op, es);
+  char *x = xreg(v);
+
+  // Fold the upper half onto the lower half until one lane is left.
+  if (opt_avx2)
+  {
+    println("  vextracti128 xmm0, %s, 1", vreg(v));
+    println("  v%s %s, %s, xmm0", insn, x, x);
+  }
+  for (int w = 8; w >= es; w /= 2)
+  {
+    if (opt_avx2)
+    {
+      println("  vpsrldq xmm0, %s, %d", x, w);
+      println("  v%s %s, %s, xmm0", insn, x, x);
+    }
+    else
+    {
+      println("  movdqa xmm0, %s", x);
+      println("  psrldq xmm0, %d", w);
+      println("  %s %s, xmm0", insn, x);
+    }
+  }
+
+  if (es == 8)
+    println("  %smovq %s, %s", vex(), reg64[r], x);
+  else
+    println("  %smovd %s, %s", vex(), reg32[r], x);
+  if (es == 1)
+    println("  movsx %s, %s", reg32[r], reg8[r]);
+  else if (es == 2)
+    println("  movsx %s, %s", reg32[r], reg16[r]);
+}
+
+static void vec_end(void)
+{
+  if (opt_avx2)
+    println("  vzeroupper");
+}
+
+// Computes a vector expression into register k, or returns the
+// register that already holds it. Registers from k up are free.
+static int gen_vexpr(Node *node, int k)
+{
+  switch (node->kind)
+  {
+  case ND_VREG:
+    return node->vreg;
+  case ND_VLOAD:
+    gen_expr(node->lhs);
+    vec_load(k, "rax");
+    return k;
+  case ND_VSPLAT:
+    if (node->lhs->kind != ND_NUM || !vec_const(k, node->lhs->val))
+    {
+      gen_expr(node->lhs);
+      vec_splat(k, node->ty->size, REG_RAX);
+    }
+    return k;
+  case ND_VOP:
+  {
+    int a = gen_vexpr(node->lhs, k);
+    int b = gen_vexpr(node->rhs, k + 1);
+    vec_op(node->vop, node->ty->size, k, a, b);
+    return k;
+  }
+  }
+  unreachable();
+}
+
+static void gen_vset(Node *node)
+{
+  Node *val = node->lhs;
+  int v = node->vreg;
+
+  // v = v op x
+  if (val->kind == ND_VOP && val->lhs->kind == ND_VREG && val->lhs->vreg == v)
+  {
+    vec_op(val->vop, node->ty->size, v, v, gen_vexpr(val->rhs, 0));
+    return;
+  }
+  vec_mov(v, gen_vexpr(val, (val->kind == ND_VSPLAT) ? v : 0));
+}
+
+//
+// Block operations
+//
+// Loops that fill, copy or scan memory (see idiom.c) become the
+// operations below. Both code generators put the destination in %rdi,
+// the source in %rsi and the size in %rcx, unless the size is a known
+// constant, and may clobber %rax and %rdx too. Small blocks are moved
+// with a few wide moves, and larger ones with rep stosb and rep movsb,
+// which current CPUs run a cache line at a time. strlen uses %xmm0 and
+// %xmm1, which vector code never holds across it.
+//
+
+// Largest number of moves for a block of known size
+#define BLOCK_MOVES 8
+
+// Returns the largest power of two that is at most `n` and 8.
+static int move_size(int64_t n)
+{
+  return (n >= 8) ? 8 : (n >= 4) ? 4 : (n >= 2) ? 2 : 1;
+}
+
+// Fills a block of `len` bytes with `byte`, or of %rcx bytes if `len`
+// is negative.
+static void fill_block(int64_t len, int byte)
+{
+  if (len < 0 || len > 8 * BLOCK_MOVES)
+  {
+    if (len >= 0)
+      println("  mov rcx, %ld", len);
+    println("  mov al, %d", byte);
+    println("  rep stosb");
+    return;
+  }
+
+  println("  mov rax, %ld", (int64_t)((uint8_t)byte * 0x0101010101010101));
+  for (int64_t off = 0; off < len;)
+  {
+    int size = move_size(len - off);
+    println("  mov [rdi + %ld], %s", off, reg_sized(REG_RAX, size));
+    off += size;
+  }
+}
+
+// Copies a block of `len` bytes, or of %rcx bytes if `len` is
+// negative, moving at most `max` bytes at once.
+static void copy_block(int64_t len, int max)
+{
+  if (len < 0 || len > move_size(max) * BLOCK_MOVES)
+  {
+    if (len >= 0)
+      println("  mov rcx, %ld", len);
+    println("  rep movsb");
+    return;
+  }
+
+  for (int64_t off = 0; off < len;)
+  {
+    int size = move_size(MIN(len - off, max));
+    println("  mov %s, [rsi + %ld]", reg_sized(REG_RDX, size), off);
+    println("  mov [rdi + %ld], %s", off, reg_sized(REG_RDX, size));
+    off += size;
+  }
+}
+
+// Computes the length of the string at %rdi into %rax. The loop reads
+// aligned 16-byte blocks, which never cross a page boundary, so it
+// can't fault past the end of the string. Bytes before the start of
+// the string in the first block are shifted out of the mask of zero
+// bytes.
+static void scan_string(void)
+{
+  int c = count();
+  println("  mov rdx, rdi");
+  println("  and rdx, -16");
+  println("  mov ecx, edi");
+  println("  and ecx, 15");
+  println("  pxor xmm0, xmm0");
+  println("  movdqa xmm1, [rdx]");
+  println("  pcmpeqb xmm1, xmm0");
+  println("  pmovmskb eax, xmm1");
+  println("  shr eax, cl");
+  println("  test eax, eax");
+  println("  jnz .L.strlen.first.%d", c);
+  println(".L.strlen.loop.%d:", c);
+  println("  add rdx, 16");
+  println("  movdqa xmm1, [rdx]");
+  println("  pcmpeqb xmm1, xmm0");
+  println("  pmovmskb eax, xmm1");
+  println("  test eax, eax");
+  println("  jz .L.strlen.loop.%d", c);
+  println("  bsf eax, eax");
+  println("  add rax, rdx");
+  println("  sub rax, rdi");
+  println("  jmp .L.strlen.end.%d", c);
+  println(".L.strlen.first.%d:", c);
+  println("  bsf eax, eax");
+  println(".L.strlen.end.%d:", c);
+}
+
+//
+// Calls
+//
+// Arguments that contain calls are evaluated first, and all but the
+// last of them are saved on the stack until the others are done. The
+// rest (constants, variables and their addresses) are then loaded
+// straight into their registers, without going through %rax and the
+// stack. The 7th and later arguments are passed on the stack, pushed
+// last first, as in the System V ABI.
+//
+
+// Returns true if `node` can be evaluated into a register without
+// touching any other register.
+static bool is_simple_arg(Node *node)
+{
+  Type *ty = node->ty;
+  if (!is_integer(ty) && ty->kind != TY_PTR && ty->kind != TY_ARRAY)
+    return false;
+
+  switch (node->kind)
+  {
+  case ND_NUM:
+    return true;
+  case ND_VAR:
+    return true;
+  case ND_ADDR:
+    return node->lhs->kind == ND_VAR;
+  case ND_CAST:
+    return ty->kind != TY_ARRAY && is_simple_arg(node->lhs);
+  }
+  return false;
+}
+
+static char *var_mode(Obj *var)
+{
+  if (var->is_local)
+    return format("%d[rbp]", var->offset);
+  return format("[rip + %s]", var->name);
+}
+
+static void gen_simple_arg(Node *node, int r)
+{
+  switch (node->kind)
+  {
+  case ND_NUM:
+    println("  mov %s, %ld", reg64[r], node->val);
+    return;
+  case ND_VAR:
+    load_mode(node->ty, r, var_mode(node->var));
+    return;
+  case ND_ADDR:
+    lea_mode(r, var_mode(node->lhs->var));
+    return;
+  case ND_CAST:
+    gen_simple_arg(node->lhs, r);
+    cast_reg(node->lhs->ty, node->ty, r);
+    return;
+  }
+  unreachable();
+}
+
+// Evaluates the register arguments of a call into their registers.
+static void gen_reg_args(Node *node)
+{
+  Node *args[6];
+  int nargs = 0;
+  for (Node *arg = node->args; arg && nargs < 6; arg = arg->next)
+    args[nargs++] = arg;
+
+  int last = -1;
+  for (int i = 0; i < nargs; i++)
+    if (!is_simple_arg(args[i]))
+      last = i;
+
+  for (int i = 0; i < nargs; i++)
+  {
+    if (is_simple_arg(args[i]))
+      continue;
+    gen_expr(args[i]);
+    if (i < last)
+      push();
+  }
+  if (last != -1)
+    println("  mov %s, rax", argreg64[last]);
+  for (int i = last - 1; i >= 0; i--)
+    if (!is_simple_arg(args[i]))
+      pop(argreg64[i]);
+
+  for (int i = 0; i < nargs; i++)
+    if (is_simple_arg(args[i]))
+      gen_simple_arg(args[i], argreg[i]);
+}
+
+static void gen_funcall(Node *node)
+{
+  int nargs = 0;
+  for (Node *arg = node->args; arg; arg = arg->next)
+    nargs++;
+
+  Node **args = calloc(nargs, sizeof(Node *));
+  int i = 0;
+  for (Node *arg = node->args; arg; arg = arg->next)
+    args[i++] = arg;
+
+  // %rsp must be a multiple of 16 at the call, after the stack
+  // arguments have been pushed.
+  int nstack = MAX(nargs - 6, 0);
+  int pad = (depth + nstack) % 2;
+  if (pad)
+  {
+    println("  sub rsp, 8");
+    depth++;
+  }
+
+  for (i = nargs - 1; i >= 6; i--)
+  {
+    gen_expr(args[i]);
+    push();
+  }
+
+  gen_reg_args(node);
+  println("  mov rax, 0");
+  println("  call %s", node->funcname);
+
+  if (nstack + pad)
+  {
+    println("  add rsp, %d", (nstack + pad) * 8);
+    depth -= nstack + pad;
+  }
+}
+
+// Generate code for a given node.
+static void gen_expr(Node *node)
+{
+  println(" .loc 1 %d", node->tok->line_no);
+  switch (node->kind)
+  {
+  case ND_NULL_EXPR:
+    return;
+  case ND_NUM:
+    println("  mov rax, %ld", node->val);
+    return;
+  case ND_NEG:
+    gen_expr(node->lhs);
+    println("  neg rax");
+    return;
+  case ND_VAR:
+  case ND_MEMBER:
+    if (opt_tree_regs && opt_isel)
+      break;
+    gen_addr(node);
+    load(node->ty);
+    return;
+  case ND_DEREF:
+    if (opt_tree_regs && opt_isel)
+      break;
+    gen_expr(node->lhs);
+    load(node->ty);
+    return;
+  case ND_ADDR:
+    if (opt_tree_regs && opt_isel)
+      break;
+    gen_addr(node->lhs);
+    return;
+  case ND_ASSIGN:
+    if (gen_tree_assign(node, true))
+      return;
+    gen_addr(node->lhs);
+    push();
+    gen_expr(node->rhs);
+    store(node->ty);
+    return;
+  case ND_STMT_EXPR:
+    for (Node *n = node->body; n; n = n->next)
+    {
+      // The value of the last expression statement is the value of
+      // the statement expression.
+      if (!n->next && n->kind == ND_EXPR_STMT)
+      {
+        println(" .loc 1 %d", n->tok->line_no);
+        gen_expr(n->lhs);
+      }
+      else
+      {
+        gen_stmt(n);
+      }
+    }
+    return;
+  case ND_COMMA:
+    gen_expr(node->lhs);
+    gen_expr(node->rhs);
+    return;
+  case ND_CAST:
+    gen_expr(node->lhs);
+    if (!is_redundant_ext(node))
+      cast(node->lhs->ty, node->ty);
+    return;
+  case ND_MEMZERO:
+    // `rep stosb` is equivalent to `memset(%rdi, %al, %rcx)`.
+    println("  mov rcx, %d", node->var->ty->size);
+    println("  lea rdi, %d[rbp]", node->var->offset);
+    println("  mov al, 0");
+    println("  rep stosb");
+    return;
+  case ND_STRLEN:
+    gen_expr(node->lhs);
+    println("  mov rdi, rax");
+    scan_string();
+    return;
+  case ND_VREDUCE:
+    vec_reduce(node->vop, node->ty->size, node->vreg, REG_RAX);
+    return;
+  case ND_COND:
+  {
+    if (gen_select(node))
+      return;
+    int c = count();
+    gen_cond(node->cond, NULL, format(".L.else.%d", c));
+    gen_expr(node->then);
+    println("  jmp .L.end.%d", c);
+    println(".L.else.%d:", c);
+    gen_expr(node->els);
+    println(".L.end.%d:", c);
+    return;
+  }
+  case ND_NOT:
+    gen_expr(node->lhs);
+    println("  cmp rax, 0");
+    println("  sete al");
+    println("  movzx rax, al");
+    return;
+  case ND_BITNOT:
+    gen_expr(node->lhs);
+    println("  not rax");
+    return;
+
+  case ND_LOGAND:
+  {
+    if (opt_branch_fusion)
+    {
+      gen_logical(node);
+      return;
+    }
+    int c = count();
+    gen_expr(node->lhs);
+    println("  cmp rax, 0");
+    println("  je .L.false.%d", c);
+    gen_expr(node->rhs);
+    println("  cmp rax, 0");
+    println("  je .L.false.%d", c);
+    println("  mov rax, 1");
+    println("  jmp .L.end.%d", c);
+    println(".L.false.%d:", c);
+    println("  mov rax, 0");
+    println(".L.end.%d:", c);
+    return;
+  }
+  case ND_LOGOR:
+  {
+    if (opt_branch_fusion)
+    {
+      gen_logical(node);
+      return;
+    }
+    int c = count();
+    gen_expr(node->lhs);
+    println("  cmp rax, 0");
+    println("  jne .L.true.%d", c);
+    gen_expr(node->rhs);
+    println("  cmp rax, 0");
+    println("  jne .L.true.%d", c);
+    println("  mov rax, 0");
+    println("  jmp .L.end.%d", c);
+    println(".L.true.%d:", c);
+    println("  mov rax, 1");
+    println(".L.end.%d:", c);
+    return;
+  }
+
+  case ND_FUNCALL:
+  {
+    gen_funcall(node);
+
+    // It looks like the most significant 48 or 56 bits in RAX may
+    // contain garbage if a function return type is short or bool/char,
+    // respectively. We clear the upper bits here.
+    switch (node->ty->kind) {
+    case TY_BOOL:
+      println("  movzx eax, al");
+      return;
+    case TY_CHAR:
+      println("  movsx eax, al");
+      return;
+    case TY_SHORT:
+      println("  movsx eax, ax");
+      return;
+    }
+    return;
+  }
+  }
+
+  if (opt_tree_regs)
+  {
+    gen_tree(node, 0);
+    return;
+  }
+
+  gen_expr(node->rhs);
+  push();
+  gen_expr(node->lhs);
+  pop("rdi");
+
+  char *ax, *di;
+
+  if (node->lhs->ty->kind == TY_LONG || node->lhs->ty->base)
+  {
+    ax = "rax";
+    di = "rdi";
+  }
+  else
+  {
+    ax = "eax";
+    di = "edi";
+  }
+
+  switch (node->kind)
+  {
+  case ND_ADD:
+    println("  add %s, %s", ax, di);
+    return;
+  case ND_SUB:
+    println("  sub %s, %s", ax, di);
+    return;
+  case ND_MUL:
+    println("  imul %s, %s", ax, di);
+    return;
+  case ND_DIV:
+  case ND_MOD:
+    if (node->lhs->ty->size == 8)
+      println("  cqo");
+    else
+      println("  cdq");
+    println("  idiv %s", di);
+
+    if (node->kind == ND_MOD)
+      println("  mov rax, rdx");
+    return;
+  case ND_BITAND:
+    println("  and rax, rdi");
+    return;
+  case ND_BITOR:
+    println("  or rax, rdi");
+    return;
+  case ND_BITXOR:
+    println("  xor rax, rdi");
+    return;
+  case ND_EQ:
+    println("  cmp %s, %s", ax, di);
+    println("  sete al");
+    println("  movzb rax, al");
+    return;
+  case ND_NE:
+    println("  cmp %s, %s", ax, di);
+    println("  setne al");
+    println("  movzb rax, al");
+    return;
+  case ND_LT:
+    println("  cmp %s, %s", ax, di);
+    println("  setl al");
+    println("  movzb rax, al");
+    return;
+  case ND_LE:
+    println("  cmp %s, %s", ax, di);
+    println("  setle al");
+    println("  movzb rax, al");
+    return;
+  case ND_SHL:
+    println("  mov rcx, rdi");
+    println("  shl %s, cl", ax);
+    return;
+  case ND_SHR:
+    println("  mov rcx, rdi");
+    if (node->ty->size == 8)
+      println("  sar %s, cl", ax);
+    else
+      println("  sar %s, cl", ax);
+    return;
+  }
+  error_tok(node->tok, "invalid expression");
+}
+
+// Generate code for an expression whose value is not used.
+static void gen_void(Node *node)
+{
+  if (node->kind == ND_COMMA)
+  {
+    gen_void(node->lhs);
+    gen_void(node->rhs);
+    return;
+  }
+  if (node->kind == ND_ASSIGN && gen_tree_assign(node, false))
+    return;
+  gen_expr(node);
+}
+
+//
+// Conditional branches
+//
+// gen_cond() compiles a condition directly into jumps. A comparison
+// becomes cmp and a single jcc instead of materializing 0 or 1 and
+// testing it, ! swaps the targets, and && and || become chains of
+// jumps.
+//
+
+bool opt_branch_fusion = true;
+
+// Jump taken if `lhs kind rhs` holds, or if it doesn't when `negate`
+// is true. `swapped` means the operands of the cmp are reversed.
+static char *jcc_insn(NodeKind kind, bool swapped, bool negate)
+{
+  switch (kind)
+  {
+  case ND_EQ:
+    return negate ? "jne" : "je";
+  case ND_NE:
+    return negate ? "je" : "jne";
+  case ND_LT:
+    if (swapped)
+      return negate ? "jle" : "jg";
+    return negate ? "jge" : "jl";
+  case ND_LE:
+    if (swapped)
+      return negate ? "jl" : "jge";
+    return negate ? "jg" : "jle";
+  }
+  unreachable();
+}
+
+// Compares the operands of a comparison, using registers from
+// tree_regs[k]. Returns true if they are compared in reverse order.
+static bool gen_cmp(Node *node, int k)
+{
+  int sz = is_wide(node->lhs->ty) ? 8 : 4;
+
+  if (!opt_tree_regs)
+  {
+    gen_expr(node->rhs);
+    push();
+    gen_expr(node->lhs);
+    pop("rdi");
+    println("  cmp %s, %s", reg_sized(REG_RAX, sz), reg_sized(REG_RDI, sz));
+    return false;
+  }
+
+  Node *imm = opt_isel ? imm_operand(node) : NULL;
+  if (imm)
+  {
+    int64_t val;
+    is_imm(imm, &val);
+    bool swapped = (imm == node->lhs);
+    gen_tree(swapped ? node->rhs : node->lhs, k);
+    println("  cmp %s, %ld", reg_sized(tree_regs[k], sz), val);
+    return swapped;
+  }
+
+  bool swapped = gen_tree_operands(node, k);
+  println("  cmp %s, %s", reg_sized(tree_regs[k], sz), reg_sized(tree_regs[k + 1], sz));
+  return swapped;
+}
+
+// Emits `jt t` and `jf f`, where jt and jf are opposite jumps. A NULL
+// label falls through.
+static void branch(char *jt, char *jf, char *t, char *f)
+{
+  if (t)
+  {
+    println("  %s %s", jt, t);
+    if (f)
+      println("  jmp %s", f);
+  }
+  else if (f)
+  {
+    println("  %s %s", jf, f);
+  }
+}
+
+// Jumps to `t` if `node` is true and to `f` otherwise. One of the
+// labels may be NULL to fall through in that case.
+static void gen_cond(Node *node, char *t, char *f)
+{
+  if (!opt_branch_fusion)
+  {
+    gen_expr(node);
+    println("  cmp rax, 0");
+    branch("jne", "je", t, f);
+    return;
+  }
+
+  switch (node->kind)
+  {
+  case ND_NUM:
+    if (node->val ? t : f)
+      println("  jmp %s", node->val ? t : f);
+    return;
+  case ND_NOT:
+    gen_cond(node->lhs, f, t);
+    return;
+  case ND_LOGAND:
+    if (f)
+    {
+      gen_cond(node->lhs, NULL, f);
+      gen_cond(node->rhs, t, f);
+    }
+    else
+    {
+      char *end = format(".L.cond.%d", count());
+      gen_cond(node->lhs, NULL, end);
+      gen_cond(node->rhs, t, NULL);
+      println("%s:", end);
+    }
+    return;
+  case ND_LOGOR:
+    if (t)
+    {
+      gen_cond(node->lhs, t, NULL);
+      gen_cond(node->rhs, t, f);
+    }
+    else
+    {
+      char *end = format(".L.cond.%d", count());
+      gen_cond(node->lhs, end, NULL);
+      gen_cond(node->rhs, NULL, f);
+      println("%s:", end);
+    }
+    return;
+  case ND_COMMA:
+    gen_void(node->lhs);
+    gen_cond(node->rhs, t, f);
+    return;
+  case ND_EQ:
+  case ND_NE:
+  case ND_LT:
+  case ND_LE:
+  {
+    bool swapped = gen_cmp(node, 0);
+    branch(jcc_insn(node->kind, swapped, false),
+           jcc_insn(node->kind, swapped, true), t, f);
+    return;
+  }
+  }
+
+  gen_expr(node);
+  cmp_zero(node->ty);
+  branch("jne", "je", t, f);
+}
+
+//
+// Branchless conditional expressions
+//
+// A ?: whose arms are cheap and safe to evaluate unconditionally is
+// compiled without branches: both arms are computed and cmov picks
+// one, or setcc and arithmetic produce it if both are constants. This
+// avoids mispredictions when the condition depends on data, at the
+// cost of always executing both arms, so the arms must be small.
+//
+
+bool opt_branchless = true;
+
+// Maximum total cost of the two arms. A mispredicted branch costs
+// about 15-20 cycles, and it is mispredicted up to half the time.
+#define SELECT_BUDGET 6
+
+static bool is_scalar(Type *ty)
+{
+  return is_integer(ty) || ty->kind == TY_PTR;
+}
+
+// Returns the cost of evaluating an expression speculatively, or -1
+// if it may trap or has side effects. Memory is only read through
+// variables, which are always valid, and never through pointers.
+static int select_cost(Node *node)
+{
+  switch (node->kind)
+  {
+  case ND_NUM:
+    return 1;
+  case ND_VAR:
+    return is_scalar(node->ty) ? 1 : -1;
+  case ND_MEMBER:
+  {
+    Node *var = node->lhs;
+    while (var->kind == ND_MEMBER)
+      var = var->lhs;
+    return (var->kind == ND_VAR && is_scalar(node->ty)) ? 1 : -1;
+  }
+  case ND_CAST:
+    return is_scalar(node->ty) ? select_cost(node->lhs) : -1;
+  case ND_NEG:
+  case ND_BITNOT:
+  {
+    int c = select_cost(node->lhs);
+    return (c < 0) ? -1 : c + 1;
+  }
+  case ND_ADD:
+  case ND_SUB:
+  case ND_MUL:
+  case ND_BITAND:
+  case ND_BITOR:
+  case ND_BITXOR:
+  case ND_SHL:
+  case ND_SHR:
+  {
+    int l = select_cost(node->lhs);
+    int r = select_cost(node->rhs);
+    if (l < 0 || r < 0)
+      return -1;
+    return l + r + (node->kind == ND_MUL ? 3 : 1);
+  }
+  }
+  return -1;
+}
+
+// Returns true if a ?: should be compiled without branches. The arms
+// are computed before the condition, so it must not change them.
+bool is_branchless(Node *node)
+{
+  if (!opt_branchless || !is_scalar(node->ty) || has_side_effects(node->cond))
+    return false;
+
+  int t = select_cost(node->then);
+  int e = select_cost(node->els);
+  return t >= 0 && e >= 0 && t + e <= SELECT_BUDGET;
+}
+
+// Sets the flags from a condition and returns the condition code
+// that holds if the condition is true, e.g. "l" for cmovl and setl,
+// or if it is false when `negate` is true.
+static char *gen_flags(Node *cond, int k, bool negate)
+{
+  switch (cond->kind)
+  {
+  case ND_EQ:
+  case ND_NE:
+  case ND_LT:
+  case ND_LE:
+  {
+    bool swapped = gen_cmp(cond, k);
+    return jcc_insn(cond->kind, swapped, negate) + 1; // skip "j"
+  }
+  }
+
+  gen_tree(cond, k);
+  int sz = is_wide(cond->ty) ? 8 : 4;
+  println("  cmp %s, 0", reg_sized(tree_regs[k], sz));
+  return negate ? "e" : "ne";
+}
+
+static bool gen_select(Node *node)
+{
+  if (!opt_tree_regs || !is_branchless(node))
+    return false;
+
+  // !c ? a : b  =>  c ? b : a
+  Node *cond = node->cond;
+  Node *then = node->then;
+  Node *els = node->els;
+  while (cond->kind == ND_NOT)
+  {
+    cond = cond->lhs;
+    Node *tmp = then;
+    then = els;
+    els = tmp;
+  }
+
+  int sz = is_wide(node->ty) ? 8 : 4;
+  int64_t t, e;
+
+  // c ? t : e  =>  setcc; (-c & (t - e)) + e
+  if (is_imm(then, &t) && is_imm(els, &e) && t - e == (int32_t)(t - e))
+  {
+    // c ? e - 1 : e  =>  !c ? e : e - 1, which needs no neg and and
+    bool negate = (t - e == -1);
+    if (negate)
+    {
+      int64_t tmp = t;
+      t = e;
+      e = tmp;
+    }
+
+    char *cc = gen_flags(cond, 0, negate);
+    println("  set%s al", cc);
+    println("  movzx eax, al");
+    if (t - e != 1)
+    {
+      println("  neg %s", reg_sized(REG_RAX, sz));
+      println("  and %s, %ld", reg_sized(REG_RAX, sz), t - e);
+    }
+    if (e)
+      println("  add %s, %ld", reg_sized(REG_RAX, sz), e);
+    return true;
+  }
+
+  gen_tree(els, 0);
+  gen_tree(then, 1);
+  char *cc = gen_flags(cond, 2, false);
+  println("  cmov%s %s, %s", cc, reg_sized(tree_regs[0], sz), reg_sized(tree_regs[1], sz));
+  return true;
+}
+
+//
+// Loop rotation
+//
+// A loop with the condition at the top runs two branches per
+// iteration: the test that leaves the loop and the jump back to the
+// top. A rotated loop tests the condition once before entering the
+// loop and then at the bottom, so each iteration runs only one
+// backward conditional branch:
+//
+//   if (!cond) goto brk;   // guard
+//   body: ...
+//   cont: inc;
+//   if (cond) goto body;
+//   brk:
+//
+// The condition is emitted twice, so it has to be small and must not
+// contain a statement expression, whose labels can't be duplicated.
+//
+
+bool opt_loop_rotate = true;
+bool opt_align_loops = true;
+
+// Maximum number of nodes in a duplicated loop condition
+#define ROTATE_BUDGET 24
+
+static int cond_size(Node *node)
+{
+  if (!node)
+    return 0;
+  if (node->kind == ND_STMT_EXPR)
+    return -1;
+
+  int n = 1;
+  Node *kids[] = {node->lhs, node->rhs, node->cond, node->then, node->els};
+  for (int i = 0; i < sizeof(kids) / sizeof(*kids); i++)
+  {
+    int c = cond_size(kids[i]);
+    if (c < 0)
+      return -1;
+    n += c;
+  }
+  for (Node *arg = node->args; arg; arg = arg->next)
+  {
+    int c = cond_size(arg);
+    if (c < 0)
+      return -1;
+    n += c;
+  }
+  return n;
+}
+
+// Returns true if a "for" or "while" loop should be rotated.
+bool is_rotatable(Node *node)
+{
+  if (!opt_loop_rotate || !node->cond)
+    return false;
+  int n = cond_size(node->cond);
+  return 0 < n && n <= ROTATE_BUDGET;
+}
+
+// Pads the start of a loop to a 16-byte boundary, so that the loop
+// body is fetched and decoded in as few blocks as possible. The
+// padding is skipped if it would take more than 10 bytes.
+static void align_loop(void)
+{
+  if (opt_align_loops)
+    println("  .p2align 4,,10");
+}
+
+// Calls a function in tail position. The frame is torn down before
+// jumping to the callee, which then returns directly to our caller.
+// Stack arguments replace our own stack parameters, which the other
+// arguments may read, so they are stored last.
+static void gen_tail_call(Node *node)
+{
+  int nargs = 0;
+  for (Node *arg = node->args; arg; arg = arg->next)
+    nargs++;
+
+  Node **args = calloc(nargs, sizeof(Node *));
+  int i = 0;
+  for (Node *arg = node->args; arg; arg = arg->next)
+    args[i++] = arg;
+
+  for (i = nargs - 1; i >= 6; i--)
+  {
+    gen_expr(args[i]);
+    push();
+  }
+
+  gen_reg_args(node);
+  for (i = 6; i < nargs; i++)
+  {
+    pop("rax");
+    println("  mov %d[rbp], rax", 16 + (i - 6) * 8);
+  }
+  println("  mov rsp, rbp");
+  println("  pop rbp");
+  println("  mov rax, 0");
+  println("  jmp %s", node->funcname);
+}
+
+static void gen_stmt(Node *node)
+{
+  println(" .loc 1 %d", node->tok->line_no);
+  switch (node->kind)
+  {
+  case ND_IF:
+  {
+    int c = count();
+    gen_cond(node->cond, NULL, format(".L.else%d", c));
+    gen_stmt(node->then);
+    println("  jmp .L.end%d", c);
+    println(".L.else%d:", c);
+    if (node->els)
+    {
+      gen_stmt(node->els);
+    }
+    println(".L.end%d:", c);
+    return;
+  }
+  case ND_FOR:
+  {
+    int c = count();
+    if (node->init)
+      gen_stmt(node->init);
+
+    if (is_rotatable(node))
+    {
+      gen_cond(node->cond, NULL, node->brk_label);
+      align_loop();
+      println(".L.begin%d:", c);
+      gen_stmt(node->then);
+      println("%s:", node->cont_label);
+      if (node->inc)
+        gen_void(node->inc);
+      gen_cond(node->cond, format(".L.begin%d", c), NULL);
+      println("%s:", node->brk_label);
+      return;
+    }
+
+    align_loop();
+    println(".L.begin%d:", c);
+    if (node->cond)
+      gen_cond(node->cond, NULL, node->brk_label);
+    gen_stmt(node->then);
+    println("%s:", node->cont_label);
+    if (node->inc)
+      gen_void(node->inc);
+    println("  jmp .L.begin%d", c);
+    println("%s:", node->brk_label);
+    return;
+  }
+  case ND_DO: {
+    int c = count();
+    align_loop();
     println(".L.begin.%d:", c);
     gen_stmt(node->then);
     println("%s:", node->cont_label);
-    gen_expr(node->cond);
-    println("  cmp rax, 0");
-    println("  jne .L.begin.%d", c);
+    // The optimizer leaves `do ... while (0)` with a constant condition.
+    if (node->cond->kind == ND_NUM)
+    {
+      if (node->cond->val)
+        println("  jmp .L.begin.%d", c);
+    }
+    else
+    {
+      gen_cond(node->cond, format(".L.begin.%d", c), NULL);
+    }
     println("%s:", node->brk_label);
     return;
   }
@@ -526,18 +2984,730 @@ static void gen_stmt(Node *node)
     gen_stmt(node->lhs);
     return;
   case ND_RETURN:
+    if (node->tail_call && node->lhs->kind == ND_FUNCALL)
+    {
+      gen_tail_call(node->lhs);
+      return;
+    }
     if (node->lhs)
       gen_expr(node->lhs);
     println("  jmp .L.return.%s", current_fn->name);
     return;
   case ND_EXPR_STMT:
+    gen_void(node->lhs);
+    return;
+  case ND_VSET:
+    gen_vset(node);
+    return;
+  case ND_VSTORE:
+  {
+    int v = gen_vexpr(node->rhs, 0);
+    gen_expr(node->lhs);
+    vec_store("rax", v);
+    return;
+  }
+  case ND_VEND:
+    vec_end();
+    return;
+  case ND_MEMSET:
+  case ND_MEMCPY:
+  {
+    int64_t len = (node->cond->kind == ND_NUM) ? node->cond->val : -1;
+    if (len < 0)
+    {
+      gen_expr(node->cond);
+      push();
+    }
+    if (node->rhs)
+    {
+      gen_expr(node->rhs);
+      push();
+    }
     gen_expr(node->lhs);
+    println("  mov rdi, rax");
+    if (node->rhs)
+      pop("rsi");
+    if (len < 0)
+      pop("rcx");
+
+    if (node->kind == ND_MEMSET)
+      fill_block(len, node->val);
+    else
+      copy_block(len, node->val);
     return;
   }
+  }
 
   error_tok(node->tok, "invalid statement");
 }
 
+//
+// Code generator for the IR
+//
+// Every virtual register has been assigned a physical register by
+// alloc_regs(), so an instruction usually becomes one or two x86
+// instructions operating on those registers.
+//
+
+static char *reg(Reg *r, int size)
+{
+  switch (size)
+  {
+  case 1:
+    return reg8[r->rn];
+  case 2:
+    return reg16[r->rn];
+  case 4:
+    return reg32[r->rn];
+  }
+  return reg64[r->rn];
+}
+
+static void mov(Reg *dst, Reg *src)
+{
+  if (dst->rn != src->rn)
+    println("  mov %s, %s", reg64[dst->rn], reg64[src->rn]);
+}
+
+static char *setcc(IROp op)
+{
+  switch (op)
+  {
+  case IR_EQ:
+    return "sete";
+  case IR_NE:
+    return "setne";
+  case IR_LT:
+    return "setl";
+  case IR_LE:
+    return "setle";
+  }
+  unreachable();
+}
+
+static char *jcc(IROp op, bool negate)
+{
+  switch (op)
+  {
+  case IR_EQ:
+    return negate ? "jne" : "je";
+  case IR_NE:
+    return negate ? "je" : "jne";
+  case IR_LT:
+    return negate ? "jge" : "jl";
+  case IR_LE:
+    return negate ? "jg" : "jle";
+  }
+  unreachable();
+}
+
+// Restores the callee-saved registers the register allocator used.
+static void restore_regs(Obj *fn)
+{
+  if (fn->ir)
+    for (int r = 0; r < NUM_REGS; r++)
+      if (fn->ir->save_slot[r])
+        println("  mov %s, %d[rbp]", reg64[r], fn->ir->save_slot[r]->offset);
+}
+
+// A call in tail position becomes a jump if the rest of its block only
+// moves its value to the return register.
+static bool is_tail_jump(IR *ir)
+{
+  if (ir->op != IR_CALL || !ir->tail)
+    return false;
+
+  // Restoring our registers must not overwrite the arguments.
+  IRFunc *callee = private_callee(ir);
+  for (int i = 0; callee && i < ir->nargs; i++)
+    if (callee->param_reg[i] >= REG_RBX)
+      return false;
+
+  for (IR *ir2 = ir->next; ir2; ir2 = ir2->next)
+    if (ir2->op != IR_COPY && ir2->op != IR_SPILL && ir2->op != IR_RELOAD &&
+        ir2->op != IR_RET)
+      return false;
+  return true;
+}
+
+// Number of uses of each virtual register in the current function,
+// not counting constants that are used as immediates
+static int *use_count;
+
+// Comparison whose flags the next branch tests directly
+static IR *fused_cmp;
+
+// A comparison can skip setcc if its only use is the branch or select
+// that follows it and nothing in between touches the flags.
+static bool is_fusible(IR *ir)
+{
+  if (!opt_branch_fusion || use_count[ir->dst->vn] != 1)
+    return false;
+
+  for (IR *ir2 = ir->next; ir2; ir2 = ir2->next)
+  {
+    if (ir2->op == IR_BR || ir2->op == IR_SELECT)
+      return ir2->a == ir->dst;
+    if (ir2->op != IR_COPY && ir2->op != IR_RELOAD && ir2->op != IR_SPILL)
+      return false;
+  }
+  return false;
+}
+
+static void load_part(int dst, int base, int offset, int size)
+{
+  static char *ptr[] = {[1] = "byte", [2] = "word", [4] = "dword", [8] = "qword"};
+  char *r = (size == 8) ? reg64[dst] : reg32[dst];
+  char *op = (size == 8 || size == 4) ? "mov" : "movzx";
+  println("  %s %s, %s ptr %d[%s]", op, r, ptr[size], offset, reg64[base]);
+}
+
+// Loads the struct whose address is in `rn` into %rax and %rdx.
+static void load_struct_ret(int rn, int size)
+{
+  int lo = MIN(size, 8);
+  int hi = size - lo;
+
+  // Don't overwrite the address before the second load.
+  if (rn == REG_RAX && hi)
+  {
+    load_part(REG_RDX, rn, 8, hi);
+    load_part(REG_RAX, rn, 0, lo);
+    return;
+  }
+  load_part(REG_RAX, rn, 0, lo);
+  if (hi)
+    load_part(REG_RDX, rn, 8, hi);
+}
+
+// Move call arguments to the argument registers, or for a function
+// with the private convention, to the registers its parameters were
+// given. The moves happen in parallel: an argument may currently be in
+// the register another one has to go to, so we order the moves and
+// break cycles with xchg.
+static void move_args(IR *ir)
+{
+  IRFunc *callee = private_callee(ir);
+  int nargs = ir->nargs;
+  int dest[6];
+  int src[6];
+  bool done[6];
+  for (int i = 0; i < nargs; i++)
+  {
+    dest[i] = callee ? callee->param_reg[i] : argreg[i];
+    src[i] = ir->args[i]->rn;
+    done[i] = (dest[i] == -1 || src[i] == dest[i]);
+  }
+
+  for (;;)
+  {
+    int pending = -1;
+    bool progress = false;
+
+    for (int i = 0; i < nargs; i++)
+    {
+      if (done[i])
+        continue;
+      pending = i;
+
+      // The destination may still be read by another pending move.
+      bool busy = false;
+      for (int j = 0; j < nargs; j++)
+        if (!done[j] && j != i && src[j] == dest[i])
+          busy = true;
+      if (busy)
+        continue;
+
+      println("  mov %s, %s", reg64[dest[i]], reg64[src[i]]);
+      done[i] = true;
+      progress = true;
+    }
+
+    if (pending == -1)
+      return;
+    if (progress)
+      continue;
+
+    // Every pending move is part of a cycle. Swap one pair and update
+    // the sources of the remaining moves.
+    int d = dest[pending];
+    int s = src[pending];
+    println("  xchg %s, %s", reg64[d], reg64[s]);
+    done[pending] = true;
+    for (int j = 0; j < nargs; j++)
+    {
+      if (done[j])
+        continue;
+      if (src[j] == d)
+        src[j] = s;
+      else if (src[j] == s)
+        src[j] = d;
+      if (src[j] == dest[j])
+        done[j] = true;
+    }
+  }
+}
+
+// Returns true if `r` holds a constant.
+static bool is_const(Reg *r, int64_t *val)
+{
+  if (!r || !r->def || r->def->op != IR_IMM)
+    return false;
+  *val = r->def->imm;
+  return true;
+}
+
+// Returns the operand of a multiplication or division that is
+// compiled as an immediate, or NULL.
+static Reg *const_operand(IR *ir, int64_t *val)
+{
+  if (ir->a == ir->b)
+    return NULL;
+
+  switch (ir->op)
+  {
+  case IR_MUL:
+    if (is_const(ir->b, val) && *val == (int32_t)*val)
+      return ir->b;
+    if (is_const(ir->a, val) && *val == (int32_t)*val)
+      return ir->a;
+    return NULL;
+  case IR_DIV:
+  case IR_MOD:
+    if (is_const(ir->b, val) && is_cheap_div(*val))
+      return ir->b;
+    return NULL;
+  }
+  return NULL;
+}
+
+static void gen_inst(IR *ir, BB *next)
+{
+  Reg *dst = ir->dst;
+  Reg *a = ir->a;
+  Reg *b = ir->b;
+  int64_t val;
+
+  Reg *c = const_operand(ir, &val);
+  if (c)
+  {
+    Reg *x = (c == b) ? a : b;
+    if (ir->op == IR_MUL)
+    {
+      mov(dst, x);
+      if (!gen_mul_imm(dst->rn, val, ir->size))
+        println("  imul %s, %s, %ld", reg(dst, ir->size), reg(dst, ir->size), val);
+      return;
+    }
+
+    // The allocator keeps operands and the result out of %rax and
+    // %rdx, so they are free to use.
+    if (is_pow2(abs64(val)))
+    {
+      mov(dst, x);
+      gen_div_pow2(dst->rn, REG_RDX, val, ir->size, ir->op == IR_MOD);
+      return;
+    }
+    int result = gen_div_magic(x->rn, val, ir->size, ir->op == IR_MOD);
+    println("  mov %s, %s", reg64[dst->rn], reg64[result]);
+    return;
+  }
+
+  switch (ir->op)
+  {
+  case IR_IMM:
+    // Constants that are only used as immediates need no register.
+    if (use_count[dst->vn])
+      println("  mov %s, %ld", reg64[dst->rn], ir->imm);
+    return;
+  case IR_COPY:
+    mov(dst, a);
+    return;
+  case IR_ADD:
+  case IR_MUL:
+  case IR_AND:
+  case IR_OR:
+  case IR_XOR:
+  {
+    char *insn[] = {
+        [IR_ADD] = "add", [IR_MUL] = "imul", [IR_AND] = "and",
+        [IR_OR] = "or",   [IR_XOR] = "xor",
+    };
+    // These are commutative, so if dst is b, compute dst = b op a.
+    if (dst->rn == b->rn)
+    {
+      b = a;
+      a = dst;
+    }
+    mov(dst, a);
+    println("  %s %s, %s", insn[ir->op], reg(dst, ir->size), reg(b, ir->size));
+    return;
+  }
+  case IR_SUB:
+    if (dst->rn == b->rn)
+    {
+      // a - b = -(b - a)
+      println("  sub %s, %s", reg(dst, ir->size), reg(a, ir->size));
+      println("  neg %s", reg(dst, ir->size));
+      return;
+    }
+    mov(dst, a);
+    println("  sub %s, %s", reg(dst, ir->size), reg(b, ir->size));
+    return;
+  case IR_DIV:
+  case IR_MOD:
+    // The allocator keeps operands and the result out of %rax and %rdx.
+    println("  mov rax, %s", reg64[a->rn]);
+    if (ir->size == 8)
+      println("  cqo");
+    else
+      println("  cdq");
+    println("  idiv %s", reg(b, ir->size));
+    println("  mov %s, %s", reg64[dst->rn], (ir->op == IR_DIV) ? "rax" : "rdx");
+    return;
+  case IR_SHL:
+  case IR_SAR:
+    println("  mov rcx, %s", reg64[b->rn]);
+    mov(dst, a);
+    println("  %s %s, cl", (ir->op == IR_SHL) ? "shl" : "sar", reg(dst, ir->size));
+    return;
+  case IR_EQ:
+  case IR_NE:
+  case IR_LT:
+  case IR_LE:
+    println("  cmp %s, %s", reg(a, ir->size), reg(b, ir->size));
+    if (is_fusible(ir))
+    {
+      fused_cmp = ir;
+      return;
+    }
+    println("  %s %s", setcc(ir->op), reg8[dst->rn]);
+    println("  movzx %s, %s", reg32[dst->rn], reg8[dst->rn]);
+    return;
+  case IR_NEG:
+  case IR_NOT:
+    mov(dst, a);
+    println("  %s %s", (ir->op == IR_NEG) ? "neg" : "not", reg(dst, ir->size));
+    return;
+  case IR_SEXT:
+    if (ir->size == 4)
+      println("  movsxd %s, %s", reg64[dst->rn], reg32[a->rn]);
+    else
+      println("  movsx %s, %s", reg32[dst->rn], reg(a, ir->size));
+    return;
+  case IR_LVAR:
+    println("  lea %s, %d[rbp]", reg64[dst->rn], ir->var->offset);
+    return;
+  case IR_GVAR:
+    println("  lea %s, [rip + %s]", reg64[dst->rn], ir->var->name);
+    return;
+  case IR_LOAD:
+    if (ir->size == 1)
+      println("  movsx %s, byte ptr [%s]", reg32[dst->rn], reg64[a->rn]);
+    else if (ir->size == 2)
+      println("  movsx %s, word ptr [%s]", reg32[dst->rn], reg64[a->rn]);
+    else if (ir->size == 4)
+      println("  movsxd %s, dword ptr [%s]", reg64[dst->rn], reg64[a->rn]);
+    else
+      println("  mov %s, [%s]", reg64[dst->rn], reg64[a->rn]);
+    return;
+  case IR_STORE:
+    println("  mov [%s], %s", reg64[a->rn], reg(b, ir->size));
+    return;
+  case IR_MEMCPY:
+    // Copy in the widest pieces that fit, so that a struct that was
+    // just stored from registers can be forwarded from the store.
+    for (int i = 0; i < ir->size;)
+    {
+      int sz = 8;
+      while (i + sz > ir->size)
+        sz /= 2;
+      char *r = (sz == 8) ? "rcx" : (sz == 4) ? "ecx" : (sz == 2) ? "cx" : "cl";
+      println("  mov %s, %d[%s]", r, i, reg64[b->rn]);
+      println("  mov %d[%s], %s", i, reg64[a->rn], r);
+      i += sz;
+    }
+    return;
+  case IR_MEMZERO:
+    // `rep stosb` is equivalent to `memset(%rdi, %al, %rcx)`.
+    println("  mov rdi, %s", reg64[a->rn]);
+    println("  mov rcx, %d", ir->size);
+    println("  mov al, 0");
+    println("  rep stosb");
+    return;
+  case IR_MEMSET:
+    println("  mov rdi, %s", reg64[a->rn]);
+    if (!is_const(b, &val) || val < 0)
+    {
+      println("  mov rcx, %s", reg64[b->rn]);
+      val = -1;
+    }
+    fill_block(val, ir->imm);
+    return;
+  case IR_MEMCOPY:
+    println("  mov rdi, %s", reg64[a->rn]);
+    println("  mov rsi, %s", reg64[b->rn]);
+    if (!is_const(ir->args[0], &val) || val < 0)
+    {
+      println("  mov rcx, %s", reg64[ir->args[0]->rn]);
+      val = -1;
+    }
+    copy_block(val, ir->imm);
+    return;
+  case IR_STRLEN:
+    println("  mov rdi, %s", reg64[a->rn]);
+    scan_string();
+    if (dst->rn != REG_RAX)
+      println("  mov %s, rax", reg64[dst->rn]);
+    return;
+  case IR_PREFETCH:
+    println("  %s %ld[%s]", ir->size ? "prefetcht0" : "prefetchnta", ir->imm, reg64[a->rn]);
+    return;
+  case IR_PARAM:
+    // With the private convention, the caller has put it there already.
+    if (current_fn->ir->is_private)
+      return;
+    if (ir->imm >= 6)
+      println("  mov %s, %ld[rbp]", reg64[dst->rn], 16 + (ir->imm - 6) * 8);
+    else if (dst->rn != argreg[ir->imm])
+      println("  mov %s, %s", reg64[dst->rn], reg64[argreg[ir->imm]]);
+    return;
+  case IR_RELOAD:
+    println("  mov %s, %d[rbp]", reg64[dst->rn], ir->var->offset);
+    return;
+  case IR_SPILL:
+    println("  mov %d[rbp], %s", ir->var->offset, reg64[a->rn]);
+    return;
+  case IR_CALL:
+  {
+    // Registers live across the call are not changed by the callee,
+    // so we can use the others freely here.
+    IRFunc *callee = private_callee(ir);
+
+    // Arguments after the sixth are pushed from the array gen_ir()
+    // stored them to, last first. %rsp must be a multiple of 16 at the
+    // call. A tail call copies them over our own stack parameters
+    // instead (see tailcall.c).
+    bool tail = is_tail_jump(ir);
+    Obj *area = ir->stack_args;
+    int nstack = area ? area->ty->array_len : 0;
+    int pad = tail ? 0 : nstack % 2;
+    if (pad)
+      println("  sub rsp, 8");
+    for (int i = nstack - 1; i >= 0; i--)
+    {
+      println("  push qword ptr %d[rbp]", area->offset + i * 8);
+      if (tail)
+        println("  pop qword ptr %d[rbp]", 16 + i * 8);
+    }
+
+    move_args(ir);
+    if (tail)
+    {
+      restore_regs(current_fn);
+      println("  mov rsp, rbp");
+      println("  pop rbp");
+      if (!callee)
+        println("  mov rax, 0");
+      println("  jmp %s", ir->name);
+      return;
+    }
+    // %al only matters to variadic functions.
+    if (!callee)
+      println("  mov rax, 0");
+    println("  call %s", ir->name);
+    if (nstack + pad)
+      println("  add rsp, %d", (nstack + pad) * 8);
+
+    if (callee && ret_in_regs(callee))
+    {
+      println("  mov %d[rbp], rax", ir->var->offset);
+      println("  mov %d[rbp], rdx", ir->var->offset + 8);
+      println("  lea %s, %d[rbp]", reg64[dst->rn], ir->var->offset);
+      return;
+    }
+
+    // See the comment in gen_expr() about the upper bits of RAX.
+    switch (ir->ty->kind)
+    {
+    case TY_BOOL:
+      println("  movzx eax, al");
+      break;
+    case TY_CHAR:
+      println("  movsx eax, al");
+      break;
+    case TY_SHORT:
+      println("  movsx eax, ax");
+      break;
+    }
+    if (dst->rn != REG_RAX)
+      println("  mov %s, rax", reg64[dst->rn]);
+    return;
+  }
+  case IR_SELECT:
+  {
+    // cc holds if the condition is true, ncc if it is false.
+    char *cc = "ne";
+    char *ncc = "e";
+    if (fused_cmp && fused_cmp->dst == a)
+    {
+      cc = jcc(fused_cmp->op, false) + 1;
+      ncc = jcc(fused_cmp->op, true) + 1;
+    }
+    else
+    {
+      println("  cmp %s, 0", reg(a, ir->size));
+    }
+    fused_cmp = NULL;
+
+    Reg *t = ir->args[0];
+    Reg *e = ir->args[1];
+    if (dst->rn == t->rn)
+    {
+      println("  cmov%s %s, %s", ncc, reg64[dst->rn], reg64[e->rn]);
+      return;
+    }
+    mov(dst, e);
+    println("  cmov%s %s, %s", cc, reg64[dst->rn], reg64[t->rn]);
+    return;
+  }
+  case IR_BR:
+  {
+    char *jt = "jne";
+    char *jf = "je";
+    if (fused_cmp && fused_cmp->dst == a)
+    {
+      jt = jcc(fused_cmp->op, false);
+      jf = jcc(fused_cmp->op, true);
+    }
+    else
+    {
+      println("  cmp %s, 0", reg(a, ir->size));
+    }
+    fused_cmp = NULL;
+
+    if (ir->then == next)
+    {
+      println("  %s .L.bb%d", jf, ir->els->label);
+      return;
+    }
+    println("  %s .L.bb%d", jt, ir->then->label);
+    if (ir->els != next)
+      println("  jmp .L.bb%d", ir->els->label);
+    return;
+  }
+  case IR_JMP:
+    if (ir->then != next)
+      println("  jmp .L.bb%d", ir->then->label);
+    return;
+  case IR_RET:
+    if (a && ret_in_regs(current_fn->ir))
+      load_struct_ret(a->rn, current_fn->ty->return_ty->size);
+    else if (a && a->rn != REG_RAX)
+      println("  mov rax, %s", reg64[a->rn]);
+    println("  jmp .L.return.%s", current_fn->name);
+    return;
+  case IR_VLOAD:
+    vec_load(ir->vd, reg64[a->rn]);
+    return;
+  case IR_VSTORE:
+    vec_store(reg64[a->rn], ir->va);
+    return;
+  case IR_VSPLAT:
+    if (!is_const(a, &val) || !vec_const(ir->vd, val))
+      vec_splat(ir->vd, ir->size, a->rn);
+    return;
+  case IR_VMOV:
+    vec_mov(ir->vd, ir->va);
+    return;
+  case IR_VOP:
+    vec_op(ir->imm, ir->size, ir->vd, ir->va, ir->vb);
+    return;
+  case IR_VREDUCE:
+    vec_reduce(ir->imm, ir->size, ir->va, dst->rn);
+    return;
+  case IR_VEND:
+    vec_end();
+    return;
+  }
+  unreachable();
+}
+
+static void count_uses(IRFunc *fn)
+{
+  use_count = calloc(fn->nregs, sizeof(int));
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      int64_t val;
+      Reg *c = const_operand(ir, &val);
+      if (ir->a && ir->a != c)
+        use_count[ir->a->vn]++;
+      if (ir->b && ir->b != c)
+        use_count[ir->b->vn]++;
+      for (int i = 0; i < ir->nargs; i++)
+        use_count[ir->args[i]->vn]++;
+    }
+  }
+}
+
+// Finds the blocks that are jumped to from themselves or from a later
+// block, which are the loop headers in the final layout.
+static bool *find_loop_heads(IRFunc *fn, int *base)
+{
+  int lo = INT_MAX, hi = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    lo = MIN(lo, bb->label);
+    hi = MAX(hi, bb->label);
+  }
+
+  bool *seen = calloc(hi - lo + 1, sizeof(bool));
+  bool *head = calloc(hi - lo + 1, sizeof(bool));
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    seen[bb->label - lo] = true;
+    BB *succs[2];
+    int n = get_succs(bb, succs);
+    for (int i = 0; i < n; i++)
+      if (seen[succs[i]->label - lo])
+        head[succs[i]->label - lo] = true;
+  }
+  free(seen);
+  *base = lo;
+  return head;
+}
+
+static void gen_ir_func(IRFunc *fn)
+{
+  int line = 0;
+  count_uses(fn);
+
+  int base;
+  bool *loop_head = find_loop_heads(fn, &base);
+
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    if (loop_head[bb->label - base] && bb != fn->bbs)
+      align_loop();
+    println(".L.bb%d:", bb->label);
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      if (ir->tok && ir->tok->line_no != line)
+      {
+        line = ir->tok->line_no;
+        println(" .loc 1 %d", line);
+      }
+      gen_inst(ir, bb->next);
+
+      // The rest of the block only returns the value of the call.
+      if (is_tail_jump(ir))
+        break;
+    }
+  }
+}
+
 static void assign_lvar_offsets(Obj *prog)
 {
   for (Obj *fn = prog; fn; fn = fn->next)
@@ -547,9 +3717,20 @@ static void assign_lvar_offsets(Obj *prog)
       continue;
     }
 
+    // Parameters after the sixth are in the caller's frame, above the
+    // return address. Parameters are the last locals.
+    Obj *stack_params = fn->params;
+    for (int i = 0; i < 6 && stack_params; i++)
+      stack_params = stack_params->next;
+    int arg_offset = 16;
+    for (Obj *var = stack_params; var; var = var->next, arg_offset += 8)
+      var->offset = arg_offset;
+
     int offset = 0;
-    for (Obj *var = fn->locals; var; var = var->next)
+    for (Obj *var = fn->locals; var != stack_params; var = var->next)
     {
+      if (var->is_promoted)
+        continue;
       offset += var->ty->size;
       offset = align_to(offset, var->align);
       var->offset = -offset;
@@ -615,6 +3796,7 @@ static void emit_text(Obj *prog)
     println(".text");
     println("%s:", fn->name);
     current_fn = fn;
+    buffering = true;
 
     // prologue
     println("  push rbp");
@@ -629,8 +3811,10 @@ static void emit_text(Obj *prog)
       int off = fn->va_area->offset;
 
       // va_elem
-      println("  mov dword ptr %d[rbp], %d", off, gp * 8);
+      println("  mov dword ptr %d[rbp], %d", off, MIN(gp, 6) * 8);
       println("  mov dword ptr %d[rbp], 0", off + 4);
+      println("  movq %d[rbp], rbp", off + 8);
+      println("  addq %d[rbp], %d", off + 8, 16 + MAX(gp - 6, 0) * 8);
       println("  movq %d[rbp], rbp", off + 16);
       println("  addq %d[rbp], %d", off + 16, off + 24);
 
@@ -651,25 +3835,39 @@ static void emit_text(Obj *prog)
       println("  movsd %d[rbp], xmm7", off + 128);
     }
 
-    // Save passed-by-register arguments to the stack
+    // Save passed-by-register arguments to the stack. The IR does
+    // this itself with IR_PARAM.
     int i = 0;
-    for (Obj *var = fn->params; var; var = var->next)
-      store_gp(i++, var->offset, var->ty->size);
+    if (!fn->ir)
+      for (Obj *var = fn->params; var && i < 6; var = var->next)
+        store_gp(i++, var->offset, var->ty->size);
 
-    gen_stmt(fn->body);
+    // Save callee-saved registers the register allocator used
+    if (fn->ir)
+      for (int r = 0; r < NUM_REGS; r++)
+        if (fn->ir->save_slot[r])
+          println("  mov %d[rbp], %s", fn->ir->save_slot[r]->offset, reg64[r]);
+
+    if (fn->ir)
+      gen_ir_func(fn->ir);
+    else
+      gen_stmt(fn->body);
     assert(depth == 0);
 
     println(".L.return.%s:", fn->name);
+    restore_regs(fn);
     println("  mov rsp, rbp");
     println("  pop rbp");
     println("  ret");
+
+    buffering = false;
+    peephole_flush(prog, output_file);
   }
 }
 
 void codegen(Obj *prog, FILE *out)
 {
   output_file = out;
-
   assign_lvar_offsets(prog);
   emit_data(prog);
   emit_text(prog);
@@ -0,0 +1,752 @@
+#include "9cc.h"
+#include <setjmp.h>
+
+//
+// Compile-time evaluation of function calls
+//
+// A call of a function that computes its value from its arguments
+// alone, such as
+//
+//   static int table_size(int bits) { int n = 1; while (bits--) n *= 2; return n + 1; }
+//
+// can be evaluated by the compiler when the arguments are constants.
+// This file is an interpreter for the AST of such functions. It runs
+// loops, switches, gotos, local variables, arrays, structs, pointers
+// to locals and calls of other functions defined in the file,
+// including recursive ones.
+//
+// The interpreter gives up as soon as the function does something it
+// cannot do at compile time: calling a function that is only
+// declared, writing to a global variable, reading one that could have
+// changed, or dividing by zero. It also gives up after
+// -fconsteval-steps=<n> evaluated nodes, after MAX_MEMORY bytes of
+// local variables or MAX_DEPTH nested calls, so a function that loops
+// forever or recurses without end only costs compile time.
+//
+// It is used in two places. The parser accepts calls in initializers
+// of global variables, where they are evaluated with the initial values
+// of other global variables as in
+//
+//   static const int size = table_size(12);
+//
+// and the consteval pass replaces calls of static functions with
+// constant arguments in function bodies by their values.
+//
+// Memory is a set of blocks, one for each local variable of each active
+// call and one for each global variable that is read. A pointer is the
+// number of the block in the upper 32 bits and an offset in the lower,
+// which lets every access be checked against the bounds of its block.
+// Global blocks are read-only copies of the initial values.
+//
+
+#define MAX_MEMORY (1 << 20)
+#define MAX_DEPTH 200
+#define GLOBAL_BIT (1 << 30)
+
+int opt_consteval_steps = 1000000;
+
+typedef struct
+{
+  Obj *var;
+  char *buf;
+  int size;
+} Block;
+
+typedef struct
+{
+  Obj *fn;
+  int base; // block of the first local variable
+} Frame;
+
+typedef enum
+{
+  FLOW_NEXT,
+  FLOW_RETURN,
+  FLOW_JUMP,
+} Flow;
+
+static Obj *prog;
+static bool in_gvar_init;
+
+static Block *locals;
+static int nlocals;
+static int locals_cap;
+static Block *gvars;
+static int ngvars;
+static int gvars_cap;
+static long memory;
+
+static Frame *frame;
+static int depth;
+static long steps;
+
+static char *target;  // label of FLOW_JUMP
+static char *seek;    // label the statements are entered for, if not NULL
+static int64_t retval;
+
+static jmp_buf fail_buf;
+static char *reason;
+
+static int nfolded;
+
+static void fail(char *msg)
+{
+  reason = msg;
+  longjmp(fail_buf, 1);
+}
+
+static void step(void)
+{
+  if (--steps < 0)
+    fail(format("takes more than %d steps", opt_consteval_steps));
+}
+
+static int64_t convert(Type *ty, int64_t val)
+{
+  if (ty->kind == TY_BOOL)
+    return val != 0;
+  switch (ty->size)
+  {
+  case 1:
+    return (int8_t)val;
+  case 2:
+    return (int16_t)val;
+  case 4:
+    return (int32_t)val;
+  }
+  return val;
+}
+
+//
+// Memory
+//
+
+static int64_t new_local(Obj *var)
+{
+  int size = var->ty->size;
+  if (size < 0)
+    fail(format("has variable '%s' of an incomplete type", var->name));
+  memory += size;
+  if (memory > MAX_MEMORY)
+    fail(format("needs more than %d bytes of local variables", MAX_MEMORY));
+
+  if (nlocals == locals_cap)
+  {
+    locals_cap = locals_cap ? locals_cap * 2 : 64;
+    locals = realloc(locals, sizeof(Block) * locals_cap);
+  }
+  locals[nlocals] = (Block){var, calloc(1, size ? size : 1), size};
+  return (int64_t)++nlocals << 32;
+}
+
+static void free_locals(int base)
+{
+  while (nlocals > base)
+  {
+    Block *b = &locals[--nlocals];
+    memory -= b->size;
+    free(b->buf);
+  }
+}
+
+static bool is_string_literal(Obj *var)
+{
+  return !strncmp(var->name, ".L..", 4) && var->ty->kind == TY_ARRAY &&
+         var->ty->base->kind == TY_CHAR;
+}
+
+// Returns a pointer to a read-only copy of the initial value of a
+// global variable. In a function body, other functions may have
+// changed the variable by the time of the call, so only string
+// literals can be read there.
+static int64_t gvar_addr(Obj *var)
+{
+  if (var->is_function)
+    fail(format("takes the address of function '%s'", var->name));
+
+  for (int i = 0; i < ngvars; i++)
+    if (gvars[i].var == var)
+      return (int64_t)((i + 1) | GLOBAL_BIT) << 32;
+
+  char *buf = NULL;
+  if ((in_gvar_init || is_string_literal(var)) && !var->rel)
+    buf = var->init_data;
+
+  if (ngvars == gvars_cap)
+  {
+    gvars_cap = gvars_cap ? gvars_cap * 2 : 16;
+    gvars = realloc(gvars, sizeof(Block) * gvars_cap);
+  }
+  gvars[ngvars] = (Block){var, buf, var->ty->size};
+  return (int64_t)(++ngvars | GLOBAL_BIT) << 32;
+}
+
+// Returns the host address of `size` bytes at `addr`.
+static char *access(int64_t addr, int size, bool write)
+{
+  uint64_t id = (uint64_t)addr >> 32;
+  uint32_t offset = addr;
+
+  Block *b = NULL;
+  if (id & GLOBAL_BIT)
+  {
+    id &= ~GLOBAL_BIT;
+    if (id >= 1 && id <= ngvars)
+      b = &gvars[id - 1];
+    if (b && write)
+      fail(format("writes global variable '%s'", b->var->name));
+    if (b && !b->buf)
+      fail(format("reads global variable '%s'", b->var->name));
+  }
+  else if (id >= 1 && id <= nlocals)
+  {
+    b = &locals[id - 1];
+  }
+
+  if (!b || (uint64_t)offset + size > b->size)
+    fail("accesses memory out of bounds");
+  return b->buf + offset;
+}
+
+// Values of arrays, structs and unions are their addresses, as in
+// codegen().
+static int64_t load(Type *ty, int64_t addr)
+{
+  if (ty->kind == TY_ARRAY || ty->kind == TY_STRUCT || ty->kind == TY_UNION)
+    return addr;
+  if (ty->kind == TY_FUNC)
+    fail("uses a function pointer");
+
+  char *p = access(addr, ty->size, false);
+  switch (ty->size)
+  {
+  case 1:
+    return ty->kind == TY_BOOL ? *(uint8_t *)p : *(int8_t *)p;
+  case 2:
+    return *(int16_t *)p;
+  case 4:
+    return *(int32_t *)p;
+  }
+  return *(int64_t *)p;
+}
+
+static void store(Type *ty, int64_t addr, int64_t val)
+{
+  if (ty->kind == TY_STRUCT || ty->kind == TY_UNION)
+  {
+    char *src = access(val, ty->size, false);
+    memmove(access(addr, ty->size, true), src, ty->size);
+    return;
+  }
+
+  char *p = access(addr, ty->size, true);
+  switch (ty->size)
+  {
+  case 1:
+    *(int8_t *)p = val;
+    return;
+  case 2:
+    *(int16_t *)p = val;
+    return;
+  case 4:
+    *(int32_t *)p = val;
+    return;
+  }
+  *(int64_t *)p = val;
+}
+
+//
+// Expressions
+//
+
+static int64_t eval(Node *node);
+static Flow exec(Node *node);
+static int64_t call(Obj *fn, int64_t *args);
+
+static Obj *find_func(char *name)
+{
+  for (Obj *obj = prog; obj; obj = obj->next)
+    if (obj->is_function && obj->is_definition && obj->body && !strcmp(obj->name, name))
+      return obj;
+  return NULL;
+}
+
+static int64_t var_addr(Obj *var)
+{
+  if (!var->is_local)
+    return gvar_addr(var);
+  if (!frame)
+    fail(format("uses '%s', which is not a constant", var->name));
+
+  int i = frame->base;
+  for (Obj *v = frame->fn->locals; v; v = v->next, i++)
+    if (v == var)
+      return (int64_t)(i + 1) << 32;
+  unreachable();
+}
+
+static int64_t addr_of(Node *node)
+{
+  step();
+
+  switch (node->kind)
+  {
+  case ND_VAR:
+    return var_addr(node->var);
+  case ND_DEREF:
+    return eval(node->lhs);
+  case ND_MEMBER:
+    return addr_of(node->lhs) + node->member->offset;
+  case ND_COMMA:
+    eval(node->lhs);
+    return addr_of(node->rhs);
+  }
+  fail("takes the address of an unsupported expression");
+}
+
+static int64_t eval_stmt_expr(Node *node)
+{
+  for (Node *n = node->body; n; n = n->next)
+  {
+    if (!n->next && n->kind == ND_EXPR_STMT)
+      return eval(n->lhs);
+    if (exec(n) != FLOW_NEXT)
+      fail("jumps out of a statement expression");
+  }
+  return 0;
+}
+
+static int64_t eval_call(Node *node)
+{
+  Obj *fn = find_func(node->funcname);
+  if (!fn)
+    fail(format("calls '%s', which is not defined", node->funcname));
+
+  int nargs = 0;
+  for (Node *arg = node->args; arg; arg = arg->next)
+    nargs++;
+
+  int64_t *args = calloc(nargs, sizeof(int64_t));
+  int i = 0;
+  for (Node *arg = node->args; arg; arg = arg->next)
+    args[i++] = eval(arg);
+
+  int64_t val = call(fn, args);
+  free(args);
+  return val;
+}
+
+static int64_t eval_binary(Node *node)
+{
+  switch (node->kind)
+  {
+  case ND_ADD:
+  case ND_SUB:
+  case ND_MUL:
+  case ND_DIV:
+  case ND_MOD:
+  case ND_BITAND:
+  case ND_BITOR:
+  case ND_BITXOR:
+  case ND_SHL:
+  case ND_SHR:
+  case ND_EQ:
+  case ND_NE:
+  case ND_LT:
+  case ND_LE:
+    break;
+  default:
+    fail("uses an unsupported expression");
+  }
+
+  uint64_t a = eval(node->lhs);
+  uint64_t b = eval(node->rhs);
+  int bits = (node->lhs->ty->size == 8) ? 64 : 32;
+
+  switch (node->kind)
+  {
+  case ND_ADD:
+    return convert(node->ty, a + b);
+  case ND_SUB:
+    return convert(node->ty, a - b);
+  case ND_MUL:
+    return convert(node->ty, a * b);
+  case ND_DIV:
+  case ND_MOD:
+    if (b == 0)
+      fail("divides by zero");
+    if ((int64_t)b == -1)
+      return convert(node->ty, (node->kind == ND_DIV) ? -a : 0);
+    if (node->kind == ND_DIV)
+      return convert(node->ty, (int64_t)a / (int64_t)b);
+    return convert(node->ty, (int64_t)a % (int64_t)b);
+  case ND_BITAND:
+    return convert(node->ty, a & b);
+  case ND_BITOR:
+    return convert(node->ty, a | b);
+  case ND_BITXOR:
+    return convert(node->ty, a ^ b);
+  case ND_SHL:
+    return convert(node->ty, a << (b & (bits - 1)));
+  case ND_SHR:
+    return convert(node->ty, (int64_t)a >> (b & (bits - 1)));
+  case ND_EQ:
+    return a == b;
+  case ND_NE:
+    return a != b;
+  case ND_LT:
+    return (int64_t)a < (int64_t)b;
+  }
+  return (int64_t)a <= (int64_t)b;
+}
+
+static int64_t eval(Node *node)
+{
+  step();
+
+  switch (node->kind)
+  {
+  case ND_NULL_EXPR:
+    return 0;
+  case ND_NUM:
+    return node->val;
+  case ND_VAR:
+  case ND_MEMBER:
+    return load(node->ty, addr_of(node));
+  case ND_DEREF:
+    return load(node->ty, eval(node->lhs));
+  case ND_ADDR:
+    return addr_of(node->lhs);
+  case ND_ASSIGN:
+  {
+    int64_t addr = addr_of(node->lhs);
+    int64_t val = eval(node->rhs);
+    store(node->ty, addr, val);
+    return val;
+  }
+  case ND_MEMZERO:
+  {
+    int64_t addr = var_addr(node->var);
+    memset(access(addr, node->var->ty->size, true), 0, node->var->ty->size);
+    return 0;
+  }
+  case ND_COMMA:
+    eval(node->lhs);
+    return eval(node->rhs);
+  case ND_CAST:
+  {
+    int64_t val = eval(node->lhs);
+    if (is_integer(node->ty))
+      return convert(node->ty, val);
+    return val;
+  }
+  case ND_COND:
+    return eval(node->cond) ? eval(node->then) : eval(node->els);
+  case ND_NOT:
+    return !eval(node->lhs);
+  case ND_LOGAND:
+    return eval(node->lhs) && eval(node->rhs);
+  case ND_LOGOR:
+    return eval(node->lhs) || eval(node->rhs);
+  case ND_NEG:
+    return convert(node->ty, -(uint64_t)eval(node->lhs));
+  case ND_BITNOT:
+    return convert(node->ty, ~eval(node->lhs));
+  case ND_FUNCALL:
+    return eval_call(node);
+  case ND_STMT_EXPR:
+    return eval_stmt_expr(node);
+  }
+  return eval_binary(node);
+}
+
+//
+// Statements
+//
+// A jump, including break and continue, returns FLOW_JUMP with the
+// label in `target` up to the statement list or loop that contains
+// the label. The list then executes its statements again with `seek`
+// set, which skips everything up to the label.
+//
+
+static bool is_label(Node *node, void *label)
+{
+  return (node->kind == ND_LABEL && !strcmp(node->unique_label, label)) ||
+         (node->kind == ND_CASE && !strcmp(node->label, label));
+}
+
+static bool has_label(Node *node, char *label)
+{
+  return node && any_node(node, is_label, label);
+}
+
+static bool is_target(char *label)
+{
+  return label && !strcmp(target, label);
+}
+
+static Flow exec_list(Node *body)
+{
+  Node *n = body;
+  while (n)
+  {
+    if (seek && !has_label(n, seek))
+    {
+      n = n->next;
+      continue;
+    }
+
+    Flow flow = exec(n);
+    if (flow == FLOW_JUMP)
+    {
+      bool found = false;
+      for (Node *m = body; m; m = m->next)
+        if (has_label(m, target))
+          found = true;
+      if (found)
+      {
+        seek = target;
+        n = body;
+        continue;
+      }
+    }
+    if (flow != FLOW_NEXT)
+      return flow;
+    n = n->next;
+  }
+  return FLOW_NEXT;
+}
+
+// Runs the body of a loop once. Returns true if the loop goes on.
+static bool exec_body(Node *node, Flow *flow)
+{
+  *flow = exec(node->then);
+  if (*flow == FLOW_JUMP && is_target(node->brk_label))
+  {
+    *flow = FLOW_NEXT;
+    return false;
+  }
+  if (*flow == FLOW_JUMP && is_target(node->cont_label))
+    *flow = FLOW_NEXT;
+  return *flow == FLOW_NEXT;
+}
+
+static Flow exec(Node *node)
+{
+  step();
+
+  switch (node->kind)
+  {
+  case ND_BLOCK:
+    return exec_list(node->body);
+  case ND_EXPR_STMT:
+    if (seek)
+      fail("jumps into an expression");
+    eval(node->lhs);
+    return FLOW_NEXT;
+  case ND_RETURN:
+    if (seek)
+      fail("jumps into an expression");
+    retval = node->lhs ? eval(node->lhs) : 0;
+    return FLOW_RETURN;
+  case ND_GOTO:
+    target = node->unique_label;
+    return FLOW_JUMP;
+  case ND_LABEL:
+    if (seek && !strcmp(seek, node->unique_label))
+      seek = NULL;
+    return exec(node->lhs);
+  case ND_CASE:
+    if (seek && !strcmp(seek, node->label))
+      seek = NULL;
+    return exec(node->lhs);
+  case ND_IF:
+    if (seek)
+      return exec(has_label(node->then, seek) ? node->then : node->els);
+    if (eval(node->cond))
+      return exec(node->then);
+    return node->els ? exec(node->els) : FLOW_NEXT;
+  case ND_FOR:
+  {
+    if (seek && !has_label(node->then, seek))
+      fail("jumps into a loop header");
+    if (!seek && node->init)
+      exec(node->init);
+
+    Flow flow = FLOW_NEXT;
+    for (;;)
+    {
+      if (!seek && node->cond && !eval(node->cond))
+        break;
+      if (!exec_body(node, &flow))
+        break;
+      if (node->inc)
+        eval(node->inc);
+    }
+    return flow;
+  }
+  case ND_DO:
+  {
+    Flow flow;
+    while (exec_body(node, &flow) && eval(node->cond))
+      ;
+    return flow;
+  }
+  case ND_SWITCH:
+  {
+    if (seek)
+      fail("jumps into a switch");
+    int64_t val = eval(node->cond);
+
+    Node *c = node->default_case;
+    for (Node *n = node->case_next; n; n = n->case_next)
+      if (convert(node->cond->ty, n->val) == val)
+        c = n;
+    if (!c)
+      return FLOW_NEXT;
+
+    seek = c->label;
+    Flow flow = exec(node->then);
+    if (flow == FLOW_JUMP && is_target(node->brk_label))
+      return FLOW_NEXT;
+    return flow;
+  }
+  }
+  fail("uses an unsupported statement");
+}
+
+static int64_t call(Obj *fn, int64_t *args)
+{
+  if (fn->ty->is_variadic)
+    fail(format("calls variadic function '%s'", fn->name));
+  if (depth == MAX_DEPTH)
+    fail(format("makes more than %d nested calls", MAX_DEPTH));
+
+  Frame f = {fn, nlocals};
+  for (Obj *var = fn->locals; var; var = var->next)
+    new_local(var);
+
+  Frame *saved = frame;
+  frame = &f;
+  depth++;
+
+  int i = 0;
+  for (Obj *var = fn->params; var; var = var->next, i++)
+    store(var->ty, var_addr(var), convert(var->ty, args[i]));
+
+  Flow flow = exec(fn->body);
+  if (flow == FLOW_JUMP)
+    fail("jumps to a label it cannot find");
+  int64_t val = (flow == FLOW_RETURN) ? retval : 0;
+
+  depth--;
+  frame = saved;
+  free_locals(f.base);
+
+  Type *ty = fn->ty->return_ty;
+  if (ty->kind == TY_STRUCT || ty->kind == TY_UNION)
+    fail("returns a struct");
+  return is_integer(ty) ? convert(ty, val) : val;
+}
+
+// Evaluates a call at compile time. Returns true and sets `val` if it
+// could be evaluated, or returns false and sets `why` to the reason.
+// `gvar_init` is true in an initializer of a global variable, where
+// the initial values of other global variables may be read.
+bool eval_funcall(Node *node, Obj *p, bool gvar_init, int64_t *val, char **why)
+{
+  prog = p;
+  in_gvar_init = gvar_init;
+  frame = NULL;
+  depth = 0;
+  memory = 0;
+  steps = opt_consteval_steps;
+  seek = NULL;
+
+  bool ok = false;
+  if (!setjmp(fail_buf))
+  {
+    if (!is_integer(node->ty))
+      fail("does not return an integer");
+    *val = eval_call(node);
+    ok = true;
+  }
+
+  free_locals(0);
+  ngvars = 0;
+  if (why)
+    *why = reason;
+  return ok;
+}
+
+//
+// The consteval pass
+//
+
+// Returns true if an argument may not be a constant, so that calls
+// with variable arguments are not tried and do not show up in remarks.
+static bool is_variable(Node *node, void *arg)
+{
+  if (node->kind == ND_VAR)
+    return node->var->is_local || !is_string_literal(node->var);
+  return node->kind == ND_FUNCALL || node->kind == ND_ASSIGN || node->kind == ND_STMT_EXPR;
+}
+
+static void fold_call(Node *node)
+{
+  Obj *fn = find_func(node->funcname);
+  if (!fn || !fn->is_static)
+    return;
+  for (Node *arg = node->args; arg; arg = arg->next)
+    if (any_node(arg, is_variable, NULL))
+      return;
+
+  int64_t val;
+  char *why;
+  if (!eval_funcall(node, prog, false, &val, &why))
+  {
+    remark_missed("consteval", node->tok, "call to '%s' not evaluated: it %s", fn->name, why);
+    return;
+  }
+
+  remark("consteval", node->tok, "call to '%s' evaluated to %ld", fn->name, val);
+  Type *ty = node->ty;
+  Token *tok = node->tok;
+  Node *next = node->next;
+  memset(node, 0, sizeof(Node));
+  node->kind = ND_NUM;
+  node->ty = ty;
+  node->tok = tok;
+  node->val = val;
+  node->next = next;
+  nfolded++;
+}
+
+// Folds the calls in the arguments of a call before the call itself.
+static void fold_calls(Node *node)
+{
+  if (!node)
+    return;
+
+  Node *kids[] = {node->lhs, node->rhs, node->cond, node->then,
+                  node->els, node->init, node->inc};
+  for (int i = 0; i < sizeof(kids) / sizeof(*kids); i++)
+    fold_calls(kids[i]);
+  for (Node *n = node->body; n; n = n->next)
+    fold_calls(n);
+  for (Node *n = node->args; n; n = n->next)
+    fold_calls(n);
+
+  if (node->kind == ND_FUNCALL)
+    fold_call(node);
+}
+
+void fold_const_calls(Obj *p)
+{
+  prog = p;
+  nfolded = 0;
+  for (Obj *fn = prog; fn; fn = fn->next)
+    if (fn->is_function && fn->is_definition)
+      fold_calls(fn->body);
+  count_stat("consteval-calls", "calls", nfolded);
+}
@@ -0,0 +1,916 @@
+#include "9cc.h"
+
+//
+// AST to IR lowering
+//
+// This file converts a function body into a control flow graph of
+// basic blocks. Expressions are evaluated into fresh virtual registers,
+// so the result is in SSA form from the start: the only values that
+// merge at join points are the results of ?:, && and ||, and those get
+// an IR_PHI in the join block.
+//
+
+// Maps a "goto" label, a case label or a break/continue label to
+// the basic block it starts.
+typedef struct LabelMap LabelMap;
+struct LabelMap
+{
+  LabelMap *next;
+  char *name;
+  BB *bb;
+};
+
+static IRFunc *fn;
+static LabelMap *label_map;
+
+// The block instructions are currently appended to.
+static BB *out;
+static BB *last_bb;
+
+static Reg *gen_expr(Node *node);
+static void gen_stmt(Node *node);
+
+BB *new_bb(void)
+{
+  static int label = 1;
+  BB *bb = calloc(1, sizeof(BB));
+  bb->label = label++;
+  return bb;
+}
+
+Reg *new_reg(IRFunc *fn)
+{
+  Reg *r = calloc(1, sizeof(Reg));
+  r->vn = fn->nregs++;
+  fn->regs = realloc(fn->regs, sizeof(Reg *) * fn->nregs);
+  fn->regs[r->vn] = r;
+  return r;
+}
+
+IR *new_ir(IROp op, Token *tok)
+{
+  IR *ir = calloc(1, sizeof(IR));
+  ir->op = op;
+  ir->tok = tok;
+  return ir;
+}
+
+void insert_before(IR *pos, IR *ir)
+{
+  ir->bb = pos->bb;
+  ir->next = pos;
+  ir->prev = pos->prev;
+  if (pos->prev)
+    pos->prev->next = ir;
+  else
+    pos->bb->first = ir;
+  pos->prev = ir;
+}
+
+void remove_ir(IR *ir)
+{
+  if (ir->prev)
+    ir->prev->next = ir->next;
+  else
+    ir->bb->first = ir->next;
+  if (ir->next)
+    ir->next->prev = ir->prev;
+  else
+    ir->bb->last = ir->prev;
+}
+
+bool is_terminator(IR *ir)
+{
+  return ir->op == IR_BR || ir->op == IR_JMP || ir->op == IR_RET;
+}
+
+// Returns true if an instruction has an effect other than defining
+// its destination register.
+bool has_side_effect(IR *ir)
+{
+  switch (ir->op)
+  {
+  case IR_STORE:
+  case IR_MEMCPY:
+  case IR_MEMZERO:
+  case IR_MEMSET:
+  case IR_MEMCOPY:
+  case IR_PREFETCH:
+  case IR_CALL:
+  case IR_BR:
+  case IR_JMP:
+  case IR_RET:
+  case IR_SPILL:
+    return true;
+  case IR_VLOAD:
+  case IR_VSTORE:
+  case IR_VSPLAT:
+  case IR_VMOV:
+  case IR_VOP:
+  case IR_VREDUCE:
+  case IR_VEND:
+    // Vector registers are not virtual registers, so vector code must
+    // stay where it is.
+    return true;
+  }
+  return false;
+}
+
+static bool is_terminated(BB *bb)
+{
+  return bb->last && is_terminator(bb->last);
+}
+
+static void start_bb(BB *bb)
+{
+  if (last_bb)
+    last_bb->next = bb;
+  else
+    fn->bbs = bb;
+  last_bb = bb;
+  out = bb;
+}
+
+// Append an instruction to the current block. Code that follows
+// a jump is unreachable, but it still needs a block to live in.
+static IR *emit(IROp op, Token *tok)
+{
+  if (is_terminated(out))
+    start_bb(new_bb());
+
+  IR *ir = new_ir(op, tok);
+  ir->bb = out;
+  ir->prev = out->last;
+  if (out->last)
+    out->last->next = ir;
+  else
+    out->first = ir;
+  out->last = ir;
+  return ir;
+}
+
+static Reg *new_dst(IR *ir)
+{
+  ir->dst = new_reg(fn);
+  ir->dst->def = ir;
+  return ir->dst;
+}
+
+static IR *jmp(BB *bb, Token *tok)
+{
+  IR *ir = emit(IR_JMP, tok);
+  ir->then = bb;
+  return ir;
+}
+
+static IR *br(Reg *r, int size, BB *then, BB *els, Token *tok)
+{
+  IR *ir = emit(IR_BR, tok);
+  ir->a = r;
+  ir->size = size;
+  ir->then = then;
+  ir->els = els;
+  return ir;
+}
+
+// Start a new block, falling through from the current one.
+static void enter(BB *bb, Token *tok)
+{
+  if (!is_terminated(out))
+    jmp(bb, tok);
+  start_bb(bb);
+}
+
+static BB *label_bb(char *name)
+{
+  for (LabelMap *m = label_map; m; m = m->next)
+    if (!strcmp(m->name, name))
+      return m->bb;
+
+  LabelMap *m = calloc(1, sizeof(LabelMap));
+  m->name = name;
+  m->bb = new_bb();
+  m->next = label_map;
+  label_map = m;
+  return m->bb;
+}
+
+static Reg *imm(int64_t val, Token *tok)
+{
+  IR *ir = emit(IR_IMM, tok);
+  ir->imm = val;
+  return new_dst(ir);
+}
+
+static Reg *binop(IROp op, Reg *a, Reg *b, int size, Token *tok)
+{
+  IR *ir = emit(op, tok);
+  ir->a = a;
+  ir->b = b;
+  ir->size = size;
+  return new_dst(ir);
+}
+
+static Reg *unop(IROp op, Reg *a, int size, Token *tok)
+{
+  IR *ir = emit(op, tok);
+  ir->a = a;
+  ir->size = size;
+  return new_dst(ir);
+}
+
+static Reg *phi(Reg *a, BB *from_a, Reg *b, BB *from_b, Token *tok)
+{
+  IR *ir = emit(IR_PHI, tok);
+  ir->nargs = 2;
+  ir->args = calloc(2, sizeof(Reg *));
+  ir->from = calloc(2, sizeof(BB *));
+  ir->args[0] = a;
+  ir->from[0] = from_a;
+  ir->args[1] = b;
+  ir->from[1] = from_b;
+  return new_dst(ir);
+}
+
+// Width of an arithmetic operation on a value of a given type.
+// Values of types smaller than long only use the lower 32 bits of
+// a register, just like the eax/edi forms in codegen.c.
+static int width(Type *ty)
+{
+  return (ty->kind == TY_LONG || ty->base) ? 8 : 4;
+}
+
+// Width of a comparison against zero.
+static int cmp_size(Type *ty)
+{
+  return (is_integer(ty) && ty->size <= 4) ? 4 : 8;
+}
+
+static Reg *gen_addr(Node *node)
+{
+  switch (node->kind)
+  {
+  case ND_VAR:
+  {
+    IR *ir = emit(node->var->is_local ? IR_LVAR : IR_GVAR, node->tok);
+    ir->var = node->var;
+    return new_dst(ir);
+  }
+  case ND_DEREF:
+    return gen_expr(node->lhs);
+  case ND_COMMA:
+    gen_expr(node->lhs);
+    return gen_addr(node->rhs);
+  case ND_MEMBER:
+  {
+    Reg *base = gen_addr(node->lhs);
+    return binop(IR_ADD, base, imm(node->member->offset, node->tok), 8, node->tok);
+  }
+  }
+
+  error_tok(node->tok, "not an lvalue");
+}
+
+// Arrays, structs and unions are represented by their addresses,
+// as in codegen.c's load().
+static Reg *load(Type *ty, Reg *addr, Token *tok)
+{
+  if (ty->kind == TY_ARRAY || ty->kind == TY_STRUCT || ty->kind == TY_UNION)
+    return addr;
+
+  IR *ir = emit(IR_LOAD, tok);
+  ir->a = addr;
+  ir->size = ty->size;
+  return new_dst(ir);
+}
+
+static void store(Type *ty, Reg *addr, Reg *val, Token *tok)
+{
+  IR *ir = emit((ty->kind == TY_STRUCT || ty->kind == TY_UNION) ? IR_MEMCPY : IR_STORE, tok);
+  ir->a = addr;
+  ir->b = val;
+  ir->size = ty->size;
+}
+
+enum
+{
+  I8,
+  I16,
+  I32,
+  I64
+};
+
+static int getTypeId(Type *ty)
+{
+  switch (ty->kind)
+  {
+  case TY_CHAR:
+    return I8;
+  case TY_SHORT:
+    return I16;
+  case TY_INT:
+    return I32;
+  }
+  return I64;
+}
+
+// Sign extensions needed for type casts, mirroring the cast table in
+// codegen.c. Zero means the value can be used as it is.
+static int sext_table[][4] = {
+    {0, 0, 0, 4}, // i8
+    {1, 0, 0, 4}, // i16
+    {1, 2, 0, 4}, // i32
+    {1, 2, 0, 0}, // i64
+};
+
+static Reg *cast(Reg *r, Type *from, Type *to, Token *tok)
+{
+  if (to->kind == TY_VOID)
+    return r;
+
+  if (to->kind == TY_BOOL)
+    return binop(IR_NE, r, imm(0, tok), cmp_size(from), tok);
+
+  int sz = sext_table[getTypeId(from)][getTypeId(to)];
+  if (sz)
+    return unop(IR_SEXT, r, sz, tok);
+  return r;
+}
+
+// Branch to `then` if the expression is true, to `els` otherwise.
+// With branch fusion, && and || become chains of branches and ! swaps
+// the targets, so that each comparison ends up right before the branch
+// that tests it.
+static void gen_branch(Node *node, BB *then, BB *els)
+{
+  if (node->kind == ND_NUM)
+  {
+    jmp(node->val ? then : els, node->tok);
+    return;
+  }
+
+  if (opt_branch_fusion)
+  {
+    switch (node->kind)
+    {
+    case ND_NOT:
+      gen_branch(node->lhs, els, then);
+      return;
+    case ND_LOGAND:
+    {
+      BB *rhs_bb = new_bb();
+      gen_branch(node->lhs, rhs_bb, els);
+      start_bb(rhs_bb);
+      gen_branch(node->rhs, then, els);
+      return;
+    }
+    case ND_LOGOR:
+    {
+      BB *rhs_bb = new_bb();
+      gen_branch(node->lhs, then, rhs_bb);
+      start_bb(rhs_bb);
+      gen_branch(node->rhs, then, els);
+      return;
+    }
+    case ND_COMMA:
+      gen_expr(node->lhs);
+      gen_branch(node->rhs, then, els);
+      return;
+    }
+  }
+
+  br(gen_expr(node), cmp_size(node->ty), then, els, node->tok);
+}
+
+static Reg *gen_logical(Node *node)
+{
+  if (opt_branch_fusion)
+  {
+    BB *then = new_bb();
+    BB *els = new_bb();
+    BB *join = new_bb();
+
+    gen_branch(node, then, els);
+    start_bb(then);
+    Reg *t = imm(1, node->tok);
+    jmp(join, node->tok);
+    start_bb(els);
+    Reg *f = imm(0, node->tok);
+    jmp(join, node->tok);
+
+    start_bb(join);
+    return phi(t, then, f, els, node->tok);
+  }
+
+  // For "&&", a false left-hand side decides the result and skips
+  // the right-hand side; for "||" a true one does.
+  bool is_and = (node->kind == ND_LOGAND);
+  BB *rhs_bb = new_bb();
+  BB *join = new_bb();
+
+  Reg *l = gen_expr(node->lhs);
+  Reg *short_val = imm(is_and ? 0 : 1, node->tok);
+  IR *ir;
+  if (is_and)
+    ir = br(l, cmp_size(node->lhs->ty), rhs_bb, join, node->tok);
+  else
+    ir = br(l, cmp_size(node->lhs->ty), join, rhs_bb, node->tok);
+  BB *lhs_end = ir->bb;
+
+  start_bb(rhs_bb);
+  Reg *r = gen_expr(node->rhs);
+  r = binop(IR_NE, r, imm(0, node->tok), cmp_size(node->rhs->ty), node->tok);
+  BB *rhs_end = jmp(join, node->tok)->bb;
+
+  start_bb(join);
+  return phi(short_val, lhs_end, r, rhs_end, node->tok);
+}
+
+// Arguments after the sixth are stored to an array in our frame, which
+// the call pushes from. As operands of the call, they would all need a
+// register at once.
+static Reg *gen_funcall(Node *node)
+{
+  Token *tok = node->tok;
+  int nargs = 0;
+  for (Node *arg = node->args; arg; arg = arg->next)
+    nargs++;
+
+  Reg **args = calloc(nargs, sizeof(Reg *));
+  int i = 0;
+  for (Node *arg = node->args; arg; arg = arg->next)
+    args[i++] = gen_expr(arg);
+
+  // Another call among the arguments may use an array of its own, so
+  // this one is filled after all of them are evaluated.
+  Obj *stack_args = NULL;
+  if (nargs > 6)
+  {
+    stack_args = calloc(1, sizeof(Obj));
+    stack_args->name = "";
+    stack_args->ty = array_of(ty_long, nargs - 6);
+    stack_args->align = 8;
+    stack_args->is_local = true;
+    stack_args->next = fn->obj->locals;
+    fn->obj->locals = stack_args;
+
+    for (i = 6; i < nargs; i++)
+    {
+      IR *addr = emit(IR_LVAR, tok);
+      addr->var = stack_args;
+      Reg *r = binop(IR_ADD, new_dst(addr), imm((i - 6) * 8, tok), 8, tok);
+      store(ty_long, r, args[i], tok);
+    }
+  }
+
+  IR *ir = emit(IR_CALL, tok);
+  ir->name = node->funcname;
+  ir->ty = node->ty;
+  ir->args = args;
+  ir->nargs = MIN(nargs, 6);
+  ir->stack_args = stack_args;
+  return new_dst(ir);
+}
+
+//
+// Vector code
+//
+// Vector registers are numbered the same way as by codegen.c's
+// gen_vexpr(), which also describes the instructions.
+//
+
+static IR *emit_vec(IROp op, Node *node)
+{
+  IR *ir = emit(op, node->tok);
+  ir->size = node->ty->size;
+  return ir;
+}
+
+static int gen_vexpr(Node *node, int k)
+{
+  IR *ir;
+
+  switch (node->kind)
+  {
+  case ND_VREG:
+    return node->vreg;
+  case ND_VLOAD:
+  {
+    Reg *addr = gen_expr(node->lhs);
+    ir = emit_vec(IR_VLOAD, node);
+    ir->a = addr;
+    ir->vd = k;
+    return k;
+  }
+  case ND_VSPLAT:
+  {
+    Reg *val = gen_expr(node->lhs);
+    ir = emit_vec(IR_VSPLAT, node);
+    ir->a = val;
+    ir->vd = k;
+    return k;
+  }
+  case ND_VOP:
+  {
+    int a = gen_vexpr(node->lhs, k);
+    int b = gen_vexpr(node->rhs, k + 1);
+    ir = emit_vec(IR_VOP, node);
+    ir->imm = node->vop;
+    ir->vd = k;
+    ir->va = a;
+    ir->vb = b;
+    return k;
+  }
+  }
+  unreachable();
+}
+
+static void gen_vset(Node *node)
+{
+  Node *val = node->lhs;
+  int v = node->vreg;
+
+  // v = v op x
+  if (val->kind == ND_VOP && val->lhs->kind == ND_VREG && val->lhs->vreg == v)
+  {
+    int b = gen_vexpr(val->rhs, 0);
+    IR *ir = emit_vec(IR_VOP, val);
+    ir->imm = val->vop;
+    ir->vd = ir->va = v;
+    ir->vb = b;
+    return;
+  }
+
+  int a = gen_vexpr(val, (val->kind == ND_VSPLAT) ? v : 0);
+  if (a != v)
+  {
+    IR *ir = emit_vec(IR_VMOV, node);
+    ir->vd = v;
+    ir->va = a;
+  }
+}
+
+static Reg *gen_expr(Node *node)
+{
+  Token *tok = node->tok;
+
+  switch (node->kind)
+  {
+  case ND_NULL_EXPR:
+    return NULL;
+  case ND_NUM:
+    return imm(node->val, tok);
+  case ND_NEG:
+    return unop(IR_NEG, gen_expr(node->lhs), width(node->ty), tok);
+  case ND_VAR:
+  case ND_MEMBER:
+    return load(node->ty, gen_addr(node), tok);
+  case ND_DEREF:
+    return load(node->ty, gen_expr(node->lhs), tok);
+  case ND_ADDR:
+    return gen_addr(node->lhs);
+  case ND_ASSIGN:
+  {
+    Reg *addr = gen_addr(node->lhs);
+    Reg *val = gen_expr(node->rhs);
+    store(node->ty, addr, val, tok);
+    return val;
+  }
+  case ND_STMT_EXPR:
+  {
+    Reg *r = NULL;
+    for (Node *n = node->body; n; n = n->next)
+    {
+      if (!n->next && n->kind == ND_EXPR_STMT)
+        r = gen_expr(n->lhs);
+      else
+        gen_stmt(n);
+    }
+    return r;
+  }
+  case ND_COMMA:
+    gen_expr(node->lhs);
+    return gen_expr(node->rhs);
+  case ND_CAST:
+    return cast(gen_expr(node->lhs), node->lhs->ty, node->ty, tok);
+  case ND_VREDUCE:
+  {
+    IR *ir = emit_vec(IR_VREDUCE, node);
+    ir->imm = node->vop;
+    ir->va = node->vreg;
+    return new_dst(ir);
+  }
+  case ND_MEMZERO:
+  {
+    IR *addr = emit(IR_LVAR, tok);
+    addr->var = node->var;
+    IR *ir = emit(IR_MEMZERO, tok);
+    ir->a = new_dst(addr);
+    ir->size = node->var->ty->size;
+    return NULL;
+  }
+  case ND_STRLEN:
+  {
+    Reg *s = gen_expr(node->lhs);
+    IR *ir = emit(IR_STRLEN, tok);
+    ir->a = s;
+    return new_dst(ir);
+  }
+  case ND_COND:
+  {
+    if (is_branchless(node))
+    {
+      // Both arms are cheap and safe to evaluate, so compute them
+      // both and let the backend pick one with cmov.
+      // !c ? a : b  =>  c ? b : a
+      Node *cond = node->cond;
+      bool swap = false;
+      for (; cond->kind == ND_NOT; cond = cond->lhs)
+        swap = !swap;
+
+      Reg *t = gen_expr(swap ? node->els : node->then);
+      Reg *e = gen_expr(swap ? node->then : node->els);
+      Reg *c = gen_expr(cond);
+      IR *ir = emit(IR_SELECT, tok);
+      ir->a = c;
+      ir->size = cmp_size(cond->ty);
+      ir->nargs = 2;
+      ir->args = calloc(2, sizeof(Reg *));
+      ir->args[0] = t;
+      ir->args[1] = e;
+      return new_dst(ir);
+    }
+
+    BB *then = new_bb();
+    BB *els = new_bb();
+    BB *join = new_bb();
+
+    gen_branch(node->cond, then, els);
+
+    start_bb(then);
+    Reg *t = gen_expr(node->then);
+    BB *then_end = jmp(join, tok)->bb;
+
+    start_bb(els);
+    Reg *e = gen_expr(node->els);
+    BB *els_end = jmp(join, tok)->bb;
+
+    start_bb(join);
+    if (node->ty->kind == TY_VOID || !t || !e)
+      return NULL;
+    return phi(t, then_end, e, els_end, tok);
+  }
+  case ND_NOT:
+  {
+    Reg *r = gen_expr(node->lhs);
+    return binop(IR_EQ, r, imm(0, tok), cmp_size(node->lhs->ty), tok);
+  }
+  case ND_BITNOT:
+    return unop(IR_NOT, gen_expr(node->lhs), width(node->ty), tok);
+  case ND_LOGAND:
+  case ND_LOGOR:
+    return gen_logical(node);
+  case ND_FUNCALL:
+    return gen_funcall(node);
+  }
+
+  // Like codegen.c, evaluate the right-hand side first.
+  Reg *b = gen_expr(node->rhs);
+  Reg *a = gen_expr(node->lhs);
+  int sz = width(node->lhs->ty);
+
+  switch (node->kind)
+  {
+  case ND_ADD:
+    return binop(IR_ADD, a, b, sz, tok);
+  case ND_SUB:
+    return binop(IR_SUB, a, b, sz, tok);
+  case ND_MUL:
+    return binop(IR_MUL, a, b, sz, tok);
+  case ND_DIV:
+    return binop(IR_DIV, a, b, sz, tok);
+  case ND_MOD:
+    return binop(IR_MOD, a, b, sz, tok);
+  case ND_BITAND:
+    return binop(IR_AND, a, b, sz, tok);
+  case ND_BITOR:
+    return binop(IR_OR, a, b, sz, tok);
+  case ND_BITXOR:
+    return binop(IR_XOR, a, b, sz, tok);
+  case ND_EQ:
+    return binop(IR_EQ, a, b, sz, tok);
+  case ND_NE:
+    return binop(IR_NE, a, b, sz, tok);
+  case ND_LT:
+    return binop(IR_LT, a, b, sz, tok);
+  case ND_LE:
+    return binop(IR_LE, a, b, sz, tok);
+  case ND_SHL:
+    return binop(IR_SHL, a, b, sz, tok);
+  case ND_SHR:
+    return binop(IR_SAR, a, b, sz, tok);
+  }
+  error_tok(tok, "invalid expression");
+}
+
+static void gen_stmt(Node *node)
+{
+  Token *tok = node->tok;
+
+  switch (node->kind)
+  {
+  case ND_IF:
+  {
+    BB *then = new_bb();
+    BB *els = new_bb();
+    BB *end = new_bb();
+
+    gen_branch(node->cond, then, els);
+    start_bb(then);
+    gen_stmt(node->then);
+    jmp(end, tok);
+    start_bb(els);
+    if (node->els)
+      gen_stmt(node->els);
+    enter(end, tok);
+    return;
+  }
+  case ND_FOR:
+  {
+    BB *begin = new_bb();
+    BB *body = new_bb();
+    BB *cont = label_bb(node->cont_label);
+    BB *brk = label_bb(node->brk_label);
+
+    if (node->init)
+      gen_stmt(node->init);
+
+    // See "Loop rotation" in codegen.c.
+    if (is_rotatable(node))
+    {
+      gen_branch(node->cond, body, brk);
+      start_bb(body);
+      gen_stmt(node->then);
+      enter(cont, tok);
+      if (node->inc)
+        gen_expr(node->inc);
+      gen_branch(node->cond, body, brk);
+      start_bb(brk);
+      return;
+    }
+
+    enter(begin, tok);
+    if (node->cond)
+      gen_branch(node->cond, body, brk);
+    enter(body, tok);
+    gen_stmt(node->then);
+    enter(cont, tok);
+    if (node->inc)
+      gen_expr(node->inc);
+    jmp(begin, tok);
+    start_bb(brk);
+    return;
+  }
+  case ND_DO:
+  {
+    BB *body = new_bb();
+    BB *cont = label_bb(node->cont_label);
+    BB *brk = label_bb(node->brk_label);
+
+    enter(body, tok);
+    gen_stmt(node->then);
+    enter(cont, tok);
+    gen_branch(node->cond, body, brk);
+    start_bb(brk);
+    return;
+  }
+  case ND_SWITCH:
+  {
+    Reg *r = gen_expr(node->cond);
+    int sz = (node->cond->ty->size == 8) ? 8 : 4;
+
+    for (Node *n = node->case_next; n; n = n->case_next)
+    {
+      BB *next = new_bb();
+      Reg *c = binop(IR_EQ, r, imm(n->val, n->tok), sz, n->tok);
+      br(c, 4, label_bb(n->label), next, n->tok);
+      start_bb(next);
+    }
+
+    if (node->default_case)
+      jmp(label_bb(node->default_case->label), tok);
+    else
+      jmp(label_bb(node->brk_label), tok);
+
+    gen_stmt(node->then);
+    enter(label_bb(node->brk_label), tok);
+    return;
+  }
+  case ND_CASE:
+    enter(label_bb(node->label), tok);
+    gen_stmt(node->lhs);
+    return;
+  case ND_BLOCK:
+    for (Node *n = node->body; n; n = n->next)
+      gen_stmt(n);
+    return;
+  case ND_GOTO:
+    jmp(label_bb(node->unique_label), tok);
+    return;
+  case ND_LABEL:
+    enter(label_bb(node->unique_label), tok);
+    gen_stmt(node->lhs);
+    return;
+  case ND_RETURN:
+  {
+    Reg *r = node->lhs ? gen_expr(node->lhs) : NULL;
+    if (node->tail_call && node->lhs->kind == ND_FUNCALL)
+      r->def->tail = true;
+    IR *ir = emit(IR_RET, tok);
+    ir->a = r;
+    return;
+  }
+  case ND_EXPR_STMT:
+    gen_expr(node->lhs);
+    return;
+  case ND_VSET:
+    gen_vset(node);
+    return;
+  case ND_VSTORE:
+  {
+    int v = gen_vexpr(node->rhs, 0);
+    Reg *addr = gen_expr(node->lhs);
+    IR *ir = emit_vec(IR_VSTORE, node);
+    ir->a = addr;
+    ir->va = v;
+    return;
+  }
+  case ND_VEND:
+    emit_vec(IR_VEND, node);
+    return;
+  case ND_MEMSET:
+  {
+    Reg *dst = gen_expr(node->lhs);
+    Reg *n = gen_expr(node->cond);
+    IR *ir = emit(IR_MEMSET, tok);
+    ir->a = dst;
+    ir->b = n;
+    ir->imm = node->val;
+    return;
+  }
+  case ND_MEMCPY:
+  {
+    Reg *dst = gen_expr(node->lhs);
+    Reg *src = gen_expr(node->rhs);
+    Reg *n = gen_expr(node->cond);
+    IR *ir = emit(IR_MEMCOPY, tok);
+    ir->a = dst;
+    ir->b = src;
+    ir->imm = node->val;
+    ir->nargs = 1;
+    ir->args = calloc(1, sizeof(Reg *));
+    ir->args[0] = n;
+    return;
+  }
+  }
+
+  error_tok(tok, "invalid statement");
+}
+
+IRFunc *gen_ir(Obj *obj)
+{
+  fn = calloc(1, sizeof(IRFunc));
+  fn->obj = obj;
+  label_map = NULL;
+  last_bb = NULL;
+
+  // The entry block has no predecessors even if the function body
+  // starts with a loop.
+  start_bb(new_bb());
+
+  // Store parameters to their variables. If a parameter's address is
+  // not taken, mem2reg() removes the store and it stays in a register.
+  int i = 0;
+  for (Obj *var = obj->params; var; var = var->next, i++)
+  {
+    IR *ir = emit(IR_PARAM, obj->body->tok);
+    ir->imm = i;
+    Reg *val = new_dst(ir);
+    if (var->ty->size < 4)
+      val = unop(IR_SEXT, val, var->ty->size, obj->body->tok);
+
+    IR *addr = emit(IR_LVAR, obj->body->tok);
+    addr->var = var;
+    store(var->ty, new_dst(addr), val, obj->body->tok);
+  }
+
+  enter(new_bb(), obj->body->tok);
+
+  gen_stmt(obj->body);
+  if (!is_terminated(out))
+    emit(IR_RET, obj->body->tok);
+
+  build_cfg(fn);
+  build_dom_tree(fn);
+  return fn;
+}
@@ -0,0 +1,485 @@
+#include "9cc.h"
+
+//
+// Loop idiom recognition
+//
+// This AST pass replaces loops that fill, copy or scan memory one
+// element at a time by a single operation on the whole block:
+//
+//   for (i = s; i < n; i++) p[i] = c;      fill (n - s) elements
+//   for (i = s; i < n; i++) p[i] = q[i];   copy (n - s) elements
+//   while (*p) p++;                        p += strlen(p)
+//   for (i = s; p[i]; i++);                i += strlen(&p[i])
+//
+// The first two are counted loops (see unroll.c) with a step of 1.
+// p and q are arrays or local pointers that the loop doesn't change,
+// c is a constant whose bytes are all equal, like 0 or -1, and the
+// elements may be of any type, including structs. A counted loop
+// becomes
+//
+//   init;
+//   if (i < n) { fill(&p[i], c, (n - i) * sizeof(*p)); i = n; }
+//
+// The code generator fills and copies with rep stosb and rep movsb,
+// or with a few wide moves if the size is a small constant, and scans
+// a string 16 bytes at a time. rep movsb copies one byte after another
+// in increasing address order, so that if p and q overlap, the result
+// is the same as that of the loop. Moves wider than an element could
+// read bytes before the loop would have written them, so they are
+// allowed only if p and q are different arrays or p isn't ahead of q.
+//
+
+static int nfill;
+static int ncopy;
+static int nstrlen;
+
+// Frame walks like `*(&x+1)` may change any local (see unroll.c).
+static bool frame_walk;
+
+static Node *new_node(NodeKind kind, Token *tok)
+{
+  Node *node = calloc(1, sizeof(Node));
+  node->kind = kind;
+  node->tok = tok;
+  return node;
+}
+
+static Node *new_binary(NodeKind kind, Node *lhs, Node *rhs, Token *tok)
+{
+  Node *node = new_node(kind, tok);
+  node->lhs = lhs;
+  node->rhs = rhs;
+  return node;
+}
+
+static Node *new_num(int64_t val, Token *tok)
+{
+  Node *node = new_node(ND_NUM, tok);
+  node->val = val;
+  node->ty = ty_long;
+  return node;
+}
+
+static Node *new_var(Obj *var, Token *tok)
+{
+  Node *node = new_node(ND_VAR, tok);
+  node->var = var;
+  node->ty = var->ty;
+  return node;
+}
+
+static Node *expr_stmt(Node *expr)
+{
+  add_type(expr);
+  return new_binary(ND_EXPR_STMT, expr, NULL, expr->tok);
+}
+
+static bool is_scalar_addr(Node *node, void *arg)
+{
+  return node->kind == ND_ADDR && node->lhs->kind == ND_VAR &&
+         node->lhs->var->is_local && node->lhs->var->ty->kind != TY_ARRAY &&
+         node->lhs->var->ty->kind != TY_STRUCT && node->lhs->var->ty->kind != TY_UNION;
+}
+
+static Node *skip_casts(Node *node)
+{
+  while (node->kind == ND_CAST && node->ty->size >= node->lhs->ty->size &&
+         is_integer(node->lhs->ty))
+    node = node->lhs;
+  return node;
+}
+
+// Returns the only statement of a loop body, or NULL.
+static Node *single_stmt(Node *body)
+{
+  if (body->kind != ND_BLOCK)
+    return body;
+  if (!body->body || body->body->next)
+    return NULL;
+  return single_stmt(body->body);
+}
+
+static bool is_empty(Node *body)
+{
+  return body->kind == ND_BLOCK && (!body->body || (is_empty(body->body) && !body->body->next));
+}
+
+//
+// Addresses
+//
+
+// Matches an integer expression `var * coef + off`.
+static bool linear(Node *node, Obj *var, int64_t *coef, int64_t *off)
+{
+  int64_t c1, o1, c2, o2;
+
+  switch (node->kind)
+  {
+  case ND_NUM:
+    *coef = 0;
+    *off = node->val;
+    return true;
+  case ND_VAR:
+    *coef = 1;
+    *off = 0;
+    return node->var == var;
+  case ND_CAST:
+    return node->ty->size >= node->lhs->ty->size && is_integer(node->lhs->ty) &&
+           linear(node->lhs, var, coef, off);
+  case ND_ADD:
+  case ND_SUB:
+    if (!linear(node->lhs, var, &c1, &o1) || !linear(node->rhs, var, &c2, &o2))
+      return false;
+    if (node->kind == ND_SUB)
+    {
+      c2 = -c2;
+      o2 = -o2;
+    }
+    *coef = c1 + c2;
+    *off = o1 + o2;
+    return true;
+  case ND_MUL:
+    if (!linear(node->lhs, var, &c1, &o1) || !linear(node->rhs, var, &c2, &o2) ||
+        (c1 && c2))
+      return false;
+    *coef = c1 * o2 + c2 * o1;
+    *off = o1 * o2;
+    return true;
+  }
+  return false;
+}
+
+// Splits an address into `base + var * coef + off`, where base is a
+// variable. Pointer arithmetic has already scaled the index.
+static bool split_addr(Node *node, Obj *var, Obj **base, int64_t *coef, int64_t *off)
+{
+  switch (node->kind)
+  {
+  case ND_VAR:
+    *base = node->var;
+    *coef = *off = 0;
+    return true;
+  case ND_CAST:
+    return node->lhs->ty->base && split_addr(node->lhs, var, base, coef, off);
+  case ND_ADD:
+  case ND_SUB:
+  {
+    int64_t c, o;
+    if (!node->ty->base || !linear(node->rhs, var, &c, &o) ||
+        !split_addr(node->lhs, var, base, coef, off))
+      return false;
+    if (node->kind == ND_SUB)
+    {
+      c = -c;
+      o = -o;
+    }
+    *coef += c;
+    *off += o;
+    return true;
+  }
+  }
+  return false;
+}
+
+// Matches the address of element `var` of an array or of a local
+// pointer. The loop assigns nothing but `var`, so the base doesn't
+// change.
+static bool elem_addr(Node *node, Obj *var, int size, Obj **base, int64_t *off)
+{
+  int64_t coef;
+  if (!split_addr(node, var, base, &coef, off) || coef != size || *base == var)
+    return false;
+  return (*base)->ty->kind == TY_ARRAY || (*base)->is_local;
+}
+
+//
+// Fills and copies
+//
+
+// Skips conversions between types of the same representation.
+static Node *skip_same_casts(Node *node)
+{
+  while (node->kind == ND_CAST && node->ty->size == node->lhs->ty->size &&
+         (node->ty->kind != TY_BOOL || node->lhs->ty->kind == TY_BOOL))
+    node = node->lhs;
+  return node;
+}
+
+// Returns the byte that every byte of a `size`-byte constant equals,
+// or -1.
+static int fill_byte(int64_t val, int size)
+{
+  uint64_t mask = (size == 8) ? -1 : ((uint64_t)1 << (size * 8)) - 1;
+  uint8_t byte = val;
+  if (((val ^ (byte * 0x0101010101010101)) & mask) != 0)
+    return -1;
+  return byte;
+}
+
+// Builds fill(&p[i], c, (n - i) * size) or copy(&p[i], &q[i], ...).
+static Node *block_op(CountedLoop *c, Node *store, Node *src, int byte, int chunk)
+{
+  Token *tok = c->loop->tok;
+  int size = store->ty->size;
+
+  Node *count;
+  Node *limit = skip_casts(c->limit);
+  if (c->has_start && limit->kind == ND_NUM)
+  {
+    count = new_num((limit->val + c->inclusive - c->start) * size, tok);
+  }
+  else
+  {
+    Node *n = new_cast(copy_node(c->limit), ty_long);
+    if (c->inclusive)
+      n = new_binary(ND_ADD, n, new_num(1, tok), tok);
+    Node *i = new_cast(new_var(c->var, tok), ty_long);
+    count = new_binary(ND_MUL, new_binary(ND_SUB, n, i, tok), new_num(size, tok), tok);
+    add_type(count);
+  }
+
+  Node *node = new_node(src ? ND_MEMCPY : ND_MEMSET, tok);
+  node->lhs = copy_node(store->lhs);
+  node->rhs = src ? copy_node(src->lhs) : NULL;
+  node->cond = count;
+  node->val = src ? chunk : byte;
+  return node;
+}
+
+// Replaces a loop that stores to p[i] in every iteration.
+static Node *replace_counted(Node *node)
+{
+  CountedLoop c;
+  if (frame_walk || !match_counted_loop(node, &c) || c.step != 1)
+    return NULL;
+
+  Node *stmt = single_stmt(node->then);
+  if (!stmt || stmt->kind != ND_EXPR_STMT || stmt->lhs->kind != ND_ASSIGN)
+    return NULL;
+  Node *store = stmt->lhs->lhs;
+  if (store->kind != ND_DEREF)
+    return NULL;
+
+  int size = store->ty->size;
+  Obj *dst, *src;
+  int64_t doff, soff;
+  if (!elem_addr(store->lhs, c.var, size, &dst, &doff))
+    return NULL;
+
+  Node *val = skip_same_casts(stmt->lhs->rhs);
+  Node *op;
+  char *name;
+  if (val->kind == ND_DEREF && val->ty->size == size &&
+      elem_addr(val->lhs, c.var, size, &src, &soff))
+  {
+    // A move wider than an element could read what an earlier move
+    // should have written if p is ahead of q.
+    bool apart = (dst != src) ? dst->ty->kind == TY_ARRAY && src->ty->kind == TY_ARRAY
+                              : doff <= soff;
+    op = block_op(&c, store, val, 0, apart ? 8 : MIN(size, 8));
+    name = "memcpy";
+  }
+  else
+  {
+    val = skip_casts(val);
+    int byte = (val->kind == ND_NUM && store->ty->kind != TY_STRUCT &&
+                store->ty->kind != TY_UNION)
+                   ? fill_byte(val->val, size)
+                   : -1;
+    if (byte < 0)
+      return NULL;
+    op = block_op(&c, store, NULL, byte, 0);
+    name = "memset";
+  }
+
+  // A loop that never runs is left alone.
+  if (op->cond->kind == ND_NUM && op->cond->val <= 0)
+    return NULL;
+
+  Token *tok = node->tok;
+  Node *limit = copy_node(c.limit);
+  if (c.inclusive)
+    limit = new_binary(ND_ADD, limit, new_num(1, tok), tok);
+  op->next = expr_stmt(new_binary(ND_ASSIGN, new_var(c.var, tok), limit, tok));
+
+  Node *body = new_node(ND_BLOCK, tok);
+  body->body = op;
+  if (op->cond->kind != ND_NUM)
+  {
+    Node *guard = new_node(ND_IF, tok);
+    guard->cond = node->cond;
+    guard->then = body;
+    body = guard;
+  }
+
+  remark("loop-idiom", tok, "loop replaced by %s", name);
+  if (op->kind == ND_MEMSET)
+    nfill++;
+  else
+    ncopy++;
+  Node *block = new_node(ND_BLOCK, tok);
+  if (node->init)
+  {
+    block->body = node->init;
+    node->init->next = body;
+  }
+  else
+  {
+    block->body = body;
+  }
+  return block;
+}
+
+//
+// String scans
+//
+
+// Matches `v = v + 1`, the form of v++ and ++v after parsing, possibly
+// as the value of `(v = v + 1) - 1`, for an integer or a char pointer.
+static Obj *match_step(Node *node)
+{
+  node = skip_same_casts(skip_casts(node));
+  if (node->kind == ND_ADD && node->rhs->kind == ND_NUM)
+    node = skip_same_casts(skip_casts(node->lhs));
+  if (node->kind != ND_ASSIGN || node->lhs->kind != ND_VAR)
+    return NULL;
+
+  Obj *var = node->lhs->var;
+  Node *add = skip_same_casts(skip_casts(node->rhs));
+  if (add->kind != ND_ADD || skip_casts(add->rhs)->kind != ND_NUM ||
+      skip_casts(add->rhs)->val != 1)
+    return NULL;
+  Node *lhs = skip_same_casts(skip_casts(add->lhs));
+  if (lhs->kind != ND_VAR || lhs->var != var || !var->is_local)
+    return NULL;
+
+  if (var->ty->kind == TY_INT || var->ty->kind == TY_LONG)
+    return var;
+  if (var->ty->kind == TY_PTR && var->ty->base->size == 1)
+    return var;
+  return NULL;
+}
+
+// Replaces a loop that steps over the characters of a string.
+static Node *replace_strlen(Node *node)
+{
+  if (!node->cond)
+    return NULL;
+
+  Node *step = node->inc;
+  if (!step)
+  {
+    Node *stmt = single_stmt(node->then);
+    if (!stmt || stmt->kind != ND_EXPR_STMT)
+      return NULL;
+    step = stmt->lhs;
+  }
+  else if (!is_empty(node->then))
+  {
+    return NULL;
+  }
+
+  Obj *var = match_step(step);
+  if (!var)
+    return NULL;
+
+  // *p or *p != 0
+  Node *cond = skip_casts(node->cond);
+  if (cond->kind == ND_NE && skip_casts(cond->rhs)->kind == ND_NUM &&
+      skip_casts(cond->rhs)->val == 0)
+    cond = skip_casts(cond->lhs);
+  if (cond->kind != ND_DEREF || !is_integer(cond->ty) || cond->ty->size != 1)
+    return NULL;
+
+  Obj *base;
+  int64_t coef, off;
+  if (var->ty->kind == TY_PTR)
+  {
+    if (!split_addr(cond->lhs, var, &base, &coef, &off) || base != var)
+      return NULL;
+  }
+  else if (!elem_addr(cond->lhs, var, 1, &base, &off))
+  {
+    return NULL;
+  }
+
+  Token *tok = node->tok;
+  Node *len = new_node(ND_STRLEN, tok);
+  len->lhs = copy_node(cond->lhs);
+  len->ty = ty_long;
+  Node *sum = new_binary(ND_ADD, new_var(var, tok), len, tok);
+  if (var->ty->kind == TY_PTR)
+    sum->ty = var->ty;
+
+  remark("loop-idiom", tok, "loop replaced by strlen");
+  nstrlen++;
+  Node *block = new_node(ND_BLOCK, tok);
+  Node *stmt = expr_stmt(new_binary(ND_ASSIGN, new_var(var, tok), sum, tok));
+  if (node->init)
+  {
+    block->body = node->init;
+    node->init->next = stmt;
+  }
+  else
+  {
+    block->body = stmt;
+  }
+  return block;
+}
+
+static Node *replace_loop(Node *node)
+{
+  Node *res = replace_counted(node);
+  if (!res)
+    res = replace_strlen(node);
+  return res ? res : node;
+}
+
+static Node *replace_stmt(Node *node)
+{
+  if (!node)
+    return NULL;
+
+  switch (node->kind)
+  {
+  case ND_BLOCK:
+    for (Node **p = &node->body; *p; p = &(*p)->next)
+    {
+      Node *next = (*p)->next;
+      *p = replace_stmt(*p);
+      (*p)->next = next;
+    }
+    return node;
+  case ND_IF:
+    node->then = replace_stmt(node->then);
+    node->els = replace_stmt(node->els);
+    return node;
+  case ND_FOR:
+    node->then = replace_stmt(node->then);
+    return replace_loop(node);
+  case ND_DO:
+  case ND_SWITCH:
+    node->then = replace_stmt(node->then);
+    return node;
+  case ND_CASE:
+  case ND_LABEL:
+    node->lhs = replace_stmt(node->lhs);
+    return node;
+  }
+  return node;
+}
+
+void replace_idioms(Obj *prog)
+{
+  nfill = ncopy = nstrlen = 0;
+  for (Obj *fn = prog; fn; fn = fn->next)
+  {
+    if (!fn->is_function || !fn->is_definition)
+      continue;
+    frame_walk = any_node(fn->body, is_scalar_addr, NULL);
+    fn->body = replace_stmt(fn->body);
+  }
+  count_stat("idiom-memset", "loops", nfill);
+  count_stat("idiom-memcpy", "loops", ncopy);
+  count_stat("idiom-strlen", "loops", nstrlen);
+}
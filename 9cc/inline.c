@@ -0,0 +1,601 @@
+#include "9cc.h"
+
+//
+// Function inlining
+//
+// A call to a small function, or to the only call site of a static
+// function, is replaced by a copy of the callee's body:
+//
+//   x = f(a, b);
+//
+// becomes
+//
+//   x = ({ p = a; q = b; <body>; L: ret; });
+//
+// where p and q are copies of the parameters, added to the caller's
+// locals together with copies of all the other locals of f. In the
+// body, `return e;` becomes `ret = e; goto L;`, or just `ret = e;` if
+// it is the last statement. A call whose value is unused becomes a
+// block rather than a statement expression.
+//
+// Functions are visited callees first, so that a copied body already
+// has its own calls inlined. Recursive calls are never inlined.
+//
+// A call is inlined if the size of the callee in nodes is within a
+// threshold. The threshold grows with the cost of the call itself
+// (moving each argument) and with constant arguments, which fold away
+// in the copy. "inline" raises it, and __attribute__((always_inline))
+// and __attribute__((noinline)) override it. Static functions whose
+// calls have all been inlined and whose address is not taken are not
+// emitted any more.
+//
+
+#define INLINE_THRESHOLD 20
+#define INLINE_HINT_THRESHOLD 80
+#define ONLY_CALL_THRESHOLD 400
+#define ARG_BONUS 4
+#define CONST_ARG_BONUS 10
+
+// Callers stop growing by inlining at this size.
+#define MAX_CALLER_SIZE 4000
+
+typedef enum
+{
+  UNVISITED,
+  VISITING,
+  VISITED,
+} State;
+
+typedef struct
+{
+  Obj *fn; // the definition
+  State state;
+  int size;
+  int ncalls;      // calls left in the program
+  bool addr_taken; // used other than by a direct call
+  bool is_inline;
+  bool always_inline;
+  bool noinline;
+} Func;
+
+static Func *funcs;
+static int nfuncs;
+
+static Func *caller;
+
+static int ninlined;
+static int nremoved;
+
+// Copies made for the body being inlined
+static Obj **var_from;
+static Obj **var_to;
+static int nvars;
+
+static char **label_from;
+static char **label_to;
+static int nlabels;
+
+static Node **case_from;
+static Node **case_to;
+static int ncases;
+
+static Obj *ret_var;    // the return value, or NULL if it is unused
+static char *join;      // label after the body
+static bool join_used;  // whether anything jumps to `join`
+static Node *last_ret;  // return statement at the end of the body
+
+static Node *new_node(NodeKind kind, Token *tok)
+{
+  Node *node = calloc(1, sizeof(Node));
+  node->kind = kind;
+  node->tok = tok;
+  return node;
+}
+
+static Node *new_var(Obj *var, Token *tok)
+{
+  Node *node = new_node(ND_VAR, tok);
+  node->var = var;
+  node->ty = var->ty;
+  return node;
+}
+
+static Node *expr_stmt(Node *expr, Token *tok)
+{
+  Node *node = new_node(ND_EXPR_STMT, tok);
+  node->lhs = expr;
+  return node;
+}
+
+static Node *assign_stmt(Obj *var, Node *val, Token *tok)
+{
+  Node *node = new_node(ND_ASSIGN, tok);
+  node->lhs = new_var(var, tok);
+  node->rhs = val;
+  node->ty = var->ty;
+  return expr_stmt(node, tok);
+}
+
+static Node *new_goto(char *label, Token *tok)
+{
+  Node *node = new_node(ND_GOTO, tok);
+  node->unique_label = label;
+  return node;
+}
+
+static Node *new_label(char *label, Token *tok)
+{
+  Node *node = new_node(ND_LABEL, tok);
+  node->label = label;
+  node->unique_label = label;
+  node->lhs = new_node(ND_BLOCK, tok);
+  return node;
+}
+
+static bool count_node(Node *node, void *arg)
+{
+  (*(int *)arg)++;
+  return false;
+}
+
+static int size_of(Node *node)
+{
+  int n = 0;
+  any_node(node, count_node, &n);
+  return n;
+}
+
+static Func *find_func(char *name)
+{
+  for (int i = 0; i < nfuncs; i++)
+    if (!strcmp(funcs[i].fn->name, name))
+      return &funcs[i];
+  return NULL;
+}
+
+//
+// Analysis
+//
+
+static bool count_refs(Node *node, void *arg)
+{
+  Func *f;
+  if (node->kind == ND_FUNCALL && (f = find_func(node->funcname)))
+    f->ncalls++;
+  if (node->kind == ND_VAR && node->var->is_function && (f = find_func(node->var->name)))
+    f->addr_taken = true;
+  return false;
+}
+
+static void find_funcs(Obj *prog)
+{
+  nfuncs = 0;
+  for (Obj *obj = prog; obj; obj = obj->next)
+    if (obj->is_function && obj->is_definition)
+      nfuncs++;
+
+  funcs = calloc(nfuncs, sizeof(Func));
+  int i = 0;
+  for (Obj *obj = prog; obj; obj = obj->next)
+    if (obj->is_function && obj->is_definition)
+      funcs[i++].fn = obj;
+
+  // Hints may be given on any declaration of a function.
+  for (Obj *obj = prog; obj; obj = obj->next)
+  {
+    Func *f = obj->is_function ? find_func(obj->name) : NULL;
+    if (!f)
+      continue;
+    f->is_inline |= obj->is_inline;
+    f->always_inline |= obj->always_inline;
+    f->noinline |= obj->noinline;
+  }
+
+  for (i = 0; i < nfuncs; i++)
+    any_node(funcs[i].fn->body, count_refs, NULL);
+
+  // Functions referenced by global initializers
+  for (Obj *obj = prog; obj; obj = obj->next)
+  {
+    for (Relocation *rel = obj->rel; rel; rel = rel->next)
+    {
+      Func *f = find_func(rel->label);
+      if (f)
+        f->addr_taken = true;
+    }
+  }
+}
+
+static bool is_const_arg(Node *node)
+{
+  while (node->kind == ND_CAST)
+    node = node->lhs;
+  return node->kind == ND_NUM || (node->kind == ND_ADDR && node->lhs->kind == ND_VAR);
+}
+
+// Returns the size up to which the callee is inlined into a call.
+static int threshold(Func *callee, Node *call)
+{
+  int limit = callee->is_inline ? INLINE_HINT_THRESHOLD : INLINE_THRESHOLD;
+  if (callee->fn->is_static && callee->ncalls == 1 && !callee->addr_taken)
+    limit = ONLY_CALL_THRESHOLD;
+
+  for (Node *arg = call->args; arg; arg = arg->next)
+  {
+    limit += ARG_BONUS;
+    if (is_const_arg(arg))
+      limit += CONST_ARG_BONUS;
+  }
+  return limit;
+}
+
+//
+// Copying the callee
+//
+
+static char *map_label(char *label)
+{
+  for (int i = 0; i < nlabels; i++)
+    if (label_from[i] == label)
+      return label_to[i];
+  return label;
+}
+
+static void add_label(char *label)
+{
+  if (!label || map_label(label) != label)
+    return;
+  label_from = realloc(label_from, sizeof(char *) * (nlabels + 1));
+  label_to = realloc(label_to, sizeof(char *) * (nlabels + 1));
+  label_from[nlabels] = label;
+  label_to[nlabels] = new_unique_name();
+  nlabels++;
+}
+
+// Gives every jump target in the callee a new name in the copy.
+static bool rename_labels(Node *node, void *arg)
+{
+  add_label(node->brk_label);
+  add_label(node->cont_label);
+  if (node->kind == ND_LABEL)
+    add_label(node->unique_label);
+  if (node->kind == ND_CASE)
+    add_label(node->label);
+  return false;
+}
+
+static Obj *map_var(Obj *var)
+{
+  for (int i = 0; i < nvars; i++)
+    if (var_from[i] == var)
+      return var_to[i];
+  return var;
+}
+
+static Node *map_case(Node *node)
+{
+  for (int i = 0; i < ncases; i++)
+    if (case_from[i] == node)
+      return case_to[i];
+  return NULL;
+}
+
+static Node *copy(Node *node);
+
+static Node *copy_list(Node *node)
+{
+  Node head = {};
+  Node *cur = &head;
+  for (Node *n = node; n; n = n->next)
+    cur = cur->next = copy(n);
+  return head.next;
+}
+
+static Node *copy_return(Node *node)
+{
+  Node *stmt = NULL;
+  if (node->lhs && ret_var)
+    stmt = assign_stmt(ret_var, copy(node->lhs), node->tok);
+  else if (node->lhs)
+    stmt = expr_stmt(copy(node->lhs), node->tok);
+
+  if (node == last_ret)
+    return stmt ? stmt : new_node(ND_BLOCK, node->tok);
+
+  join_used = true;
+  Node *block = new_node(ND_BLOCK, node->tok);
+  block->body = new_goto(join, node->tok);
+  if (stmt)
+  {
+    stmt->next = block->body;
+    block->body = stmt;
+  }
+  return block;
+}
+
+static Node *copy(Node *node)
+{
+  if (!node)
+    return NULL;
+  if (node->kind == ND_RETURN && join)
+    return copy_return(node);
+
+  Node *n = calloc(1, sizeof(Node));
+  *n = *node;
+  n->next = NULL;
+  n->var = node->var ? map_var(node->var) : NULL;
+  n->brk_label = map_label(node->brk_label);
+  n->cont_label = map_label(node->cont_label);
+  n->unique_label = map_label(node->unique_label);
+  if (node->kind == ND_CASE)
+    n->label = map_label(node->label);
+
+  n->lhs = copy(node->lhs);
+  n->rhs = copy(node->rhs);
+  n->cond = copy(node->cond);
+  n->then = copy(node->then);
+  n->els = copy(node->els);
+  n->init = copy(node->init);
+  n->inc = copy(node->inc);
+  n->body = copy_list(node->body);
+  n->args = copy_list(node->args);
+
+  if (node->kind == ND_CASE)
+  {
+    case_from = realloc(case_from, sizeof(Node *) * (ncases + 1));
+    case_to = realloc(case_to, sizeof(Node *) * (ncases + 1));
+    case_from[ncases] = node;
+    case_to[ncases] = n;
+    ncases++;
+  }
+
+  // The cases of a switch are in its body, which has been copied by
+  // now.
+  if (node->kind == ND_SWITCH)
+  {
+    n->case_next = map_case(node->case_next);
+    n->default_case = map_case(node->default_case);
+    for (Node *c = node->case_next; c; c = c->case_next)
+      map_case(c)->case_next = map_case(c->case_next);
+  }
+  return n;
+}
+
+static void add_var(Obj *from, Obj *to)
+{
+  var_from = realloc(var_from, sizeof(Obj *) * (nvars + 1));
+  var_to = realloc(var_to, sizeof(Obj *) * (nvars + 1));
+  var_from[nvars] = from;
+  var_to[nvars] = to;
+  nvars++;
+}
+
+static Obj *new_local(Obj *var)
+{
+  Obj *v = calloc(1, sizeof(Obj));
+  *v = *var;
+  v->next = caller->fn->locals;
+  caller->fn->locals = v;
+  return v;
+}
+
+// Returns the inlined body of a call to `callee`, as a statement if
+// `is_stmt` or as a statement expression otherwise.
+static Node *inline_call(Func *callee, Node *call, bool is_stmt)
+{
+  Obj *fn = callee->fn;
+  Token *tok = call->tok;
+
+  nvars = nlabels = ncases = 0;
+  for (Obj *var = fn->locals; var; var = var->next)
+    add_var(var, new_local(var));
+  any_node(fn->body, rename_labels, NULL);
+
+  ret_var = NULL;
+  if (!is_stmt)
+    ret_var = new_local(&(Obj){.name = "", .ty = fn->ty->return_ty, .is_local = true,
+                               .align = fn->ty->return_ty->align});
+  join = new_unique_name();
+  join_used = false;
+
+  last_ret = NULL;
+  for (Node *n = fn->body->body; n; n = n->next)
+    if (!n->next && n->kind == ND_RETURN)
+      last_ret = n;
+
+  Node head = {};
+  Node *cur = &head;
+  Obj *param = fn->params;
+  for (Node *arg = call->args; arg; arg = arg->next, param = param->next)
+    cur = cur->next = assign_stmt(map_var(param), arg, tok);
+
+  cur = cur->next = copy(fn->body);
+  if (join_used)
+    cur = cur->next = new_label(join, tok);
+  if (ret_var)
+    cur = cur->next = expr_stmt(new_var(ret_var, tok), tok);
+
+  Node *node = new_node(is_stmt ? ND_BLOCK : ND_STMT_EXPR, tok);
+  node->body = head.next;
+  node->ty = is_stmt ? NULL : call->ty;
+  return node;
+}
+
+// Returns a copy of the definition of `fn` under a new name, with its
+// own locals and labels. Returns stay returns.
+Obj *clone_function(Obj *fn, char *name)
+{
+  Obj *clone = calloc(1, sizeof(Obj));
+  *clone = *fn;
+  clone->name = name;
+  clone->next = NULL;
+
+  nvars = nlabels = ncases = 0;
+  Obj head = {};
+  Obj *cur = &head;
+  for (Obj *var = fn->locals; var; var = var->next)
+  {
+    cur = cur->next = calloc(1, sizeof(Obj));
+    *cur = *var;
+    cur->next = NULL;
+    add_var(var, cur);
+  }
+  clone->locals = head.next;
+  clone->params = fn->params ? map_var(fn->params) : NULL;
+  clone->va_area = fn->va_area ? map_var(fn->va_area) : NULL;
+  any_node(fn->body, rename_labels, NULL);
+
+  join = NULL;
+  clone->body = copy(fn->body);
+  return clone;
+}
+
+//
+// Decisions
+//
+
+static void visit(Func *f);
+
+// Returns true if `call` should be replaced by the body of `callee`.
+static bool should_inline(Func *callee, Node *call, bool is_stmt)
+{
+  char *name = callee->fn->name;
+  char *into = caller->fn->name;
+  Type *ret_ty = callee->fn->ty->return_ty;
+
+  if (callee->noinline)
+  {
+    remark_missed("inline", call->tok, "'%s' not inlined into '%s': noinline attribute",
+                  name, into);
+    return false;
+  }
+  if (callee == caller || callee->state == VISITING)
+  {
+    remark_missed("inline", call->tok, "'%s' not inlined into '%s': recursive call",
+                  name, into);
+    return false;
+  }
+  if (callee->fn->ty->is_variadic)
+  {
+    remark_missed("inline", call->tok, "'%s' not inlined into '%s': variadic function",
+                  name, into);
+    return false;
+  }
+  if (ret_ty->kind == TY_STRUCT || ret_ty->kind == TY_UNION ||
+      (ret_ty->kind == TY_VOID && !is_stmt))
+  {
+    remark_missed("inline", call->tok, "'%s' not inlined into '%s': unsupported return type",
+                  name, into);
+    return false;
+  }
+  if (callee->always_inline)
+    return true;
+
+  if (caller->size > MAX_CALLER_SIZE)
+  {
+    remark_missed("inline", call->tok, "'%s' not inlined into '%s': caller is too large",
+                  name, into);
+    return false;
+  }
+
+  int limit = threshold(callee, call);
+  if (callee->size > limit)
+  {
+    remark_missed("inline", call->tok,
+                  "'%s' not inlined into '%s': too large (cost=%d, threshold=%d)", name,
+                  into, callee->size, limit);
+    return false;
+  }
+  return true;
+}
+
+// Replaces `node` in place by `with`.
+static void replace(Node *node, Node *with)
+{
+  Node *next = node->next;
+  *node = *with;
+  node->next = next;
+}
+
+static void inline_calls(Node *node)
+{
+  if (!node)
+    return;
+
+  bool is_stmt = (node->kind == ND_EXPR_STMT && node->lhs->kind == ND_FUNCALL);
+  Node *call = is_stmt ? node->lhs : node;
+  if (call->kind != ND_FUNCALL)
+  {
+    Node *kids[] = {node->lhs, node->rhs, node->cond, node->then,
+                    node->els, node->init, node->inc};
+    for (int i = 0; i < sizeof(kids) / sizeof(*kids); i++)
+      inline_calls(kids[i]);
+    for (Node *n = node->body; n; n = n->next)
+    {
+      // The last statement of a statement expression is its value.
+      if (node->kind == ND_STMT_EXPR && !n->next && n->kind == ND_EXPR_STMT)
+        inline_calls(n->lhs);
+      else
+        inline_calls(n);
+    }
+    return;
+  }
+
+  for (Node *n = call->args; n; n = n->next)
+    inline_calls(n);
+
+  Func *callee = find_func(call->funcname);
+  if (!callee)
+    return;
+  visit(callee);
+  if (!should_inline(callee, call, is_stmt))
+    return;
+
+  remark("inline", call->tok, "'%s' inlined into '%s' (cost=%d)", callee->fn->name,
+         caller->fn->name, callee->size);
+  replace(node, inline_call(callee, call, is_stmt));
+  caller->size += callee->size;
+  callee->ncalls--;
+  ninlined++;
+
+  // The copy calls what the callee calls.
+  any_node(node, count_refs, NULL);
+}
+
+static void visit(Func *f)
+{
+  if (f->state != UNVISITED)
+    return;
+  f->state = VISITING;
+
+  Func *saved = caller;
+  caller = f;
+  f->size = size_of(f->fn->body);
+  inline_calls(f->fn->body);
+  f->size = size_of(f->fn->body);
+  caller = saved;
+
+  f->state = VISITED;
+}
+
+void inline_functions(Obj *prog)
+{
+  find_funcs(prog);
+  ninlined = nremoved = 0;
+
+  for (int i = 0; i < nfuncs; i++)
+    visit(&funcs[i]);
+
+  for (int i = 0; i < nfuncs; i++)
+  {
+    Func *f = &funcs[i];
+    if (f->fn->is_static && f->ncalls == 0 && !f->addr_taken)
+    {
+      f->fn->is_definition = false;
+      nremoved++;
+    }
+  }
+
+  count_stat("inlined", "calls", ninlined);
+  count_stat("inline-removed", "funcs", nremoved);
+}
@@ -0,0 +1,171 @@
+#include "9cc.h"
+
+//
+// Textual IR dump for --emit-ir
+//
+
+static FILE *output_file;
+
+static char *opnames[] = {
+    [IR_IMM] = "imm",       [IR_COPY] = "copy",     [IR_ADD] = "add",
+    [IR_SUB] = "sub",       [IR_MUL] = "mul",       [IR_DIV] = "div",
+    [IR_MOD] = "mod",       [IR_AND] = "and",       [IR_OR] = "or",
+    [IR_XOR] = "xor",       [IR_SHL] = "shl",       [IR_SAR] = "sar",
+    [IR_EQ] = "eq",         [IR_NE] = "ne",         [IR_LT] = "lt",
+    [IR_LE] = "le",         [IR_NEG] = "neg",       [IR_NOT] = "not",
+    [IR_SEXT] = "sext",     [IR_LVAR] = "lvar",     [IR_GVAR] = "gvar",
+    [IR_LOAD] = "load",     [IR_STORE] = "store",   [IR_MEMCPY] = "memcpy",
+    [IR_MEMZERO] = "memzero", [IR_MEMSET] = "memset", [IR_MEMCOPY] = "memcopy",
+    [IR_STRLEN] = "strlen", [IR_CALL] = "call",     [IR_PHI] = "phi",
+    [IR_PARAM] = "param",   [IR_SELECT] = "select", [IR_PREFETCH] = "prefetch",
+    [IR_BR] = "br",         [IR_JMP] = "jmp",       [IR_RET] = "ret",
+    [IR_RELOAD] = "reload", [IR_SPILL] = "spill",   [IR_VLOAD] = "vload",
+    [IR_VSTORE] = "vstore", [IR_VSPLAT] = "vsplat", [IR_VMOV] = "vmov",
+    [IR_VOP] = "vop",       [IR_VREDUCE] = "vreduce", [IR_VEND] = "vend",
+};
+
+// Lane operations of vector instructions
+static char *vopnames[] = {
+    [ND_ADD] = "add",    [ND_SUB] = "sub",   [ND_MUL] = "mul",
+    [ND_BITAND] = "and", [ND_BITOR] = "or",  [ND_BITXOR] = "xor",
+};
+
+static void print(char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(output_file, fmt, ap);
+  va_end(ap);
+}
+
+static void print_reg(Reg *r)
+{
+  if (r)
+    print(" v%d", r->vn);
+}
+
+static void print_ir(IR *ir)
+{
+  print("  ");
+  if (ir->dst)
+    print("v%d = ", ir->dst->vn);
+  print("%s", opnames[ir->op]);
+  if (ir->size)
+    print("%d", ir->size);
+
+  switch (ir->op)
+  {
+  case IR_IMM:
+  case IR_PARAM:
+    print(" %ld", ir->imm);
+    break;
+  case IR_LVAR:
+  case IR_GVAR:
+    print(" %s", *ir->var->name ? ir->var->name : "<anon>");
+    break;
+  case IR_CALL:
+    print(" %s(", ir->name);
+    for (int i = 0; i < ir->nargs; i++)
+      print("%sv%d", i ? ", " : "", ir->args[i]->vn);
+    print(")");
+    break;
+  case IR_PHI:
+    for (int i = 0; i < ir->nargs; i++)
+      print("%s [v%d, .L%d]", i ? "," : "", ir->args[i]->vn, ir->from[i]->label);
+    break;
+  case IR_SELECT:
+    print(" v%d ? v%d : v%d", ir->a->vn, ir->args[0]->vn, ir->args[1]->vn);
+    break;
+  case IR_BR:
+    print_reg(ir->a);
+    print(", .L%d, .L%d", ir->then->label, ir->els->label);
+    break;
+  case IR_JMP:
+    print(" .L%d", ir->then->label);
+    break;
+  case IR_VLOAD:
+  case IR_VSPLAT:
+    print(" x%d,", ir->vd);
+    print_reg(ir->a);
+    break;
+  case IR_VSTORE:
+    print_reg(ir->a);
+    print(", x%d", ir->va);
+    break;
+  case IR_VMOV:
+    print(" x%d, x%d", ir->vd, ir->va);
+    break;
+  case IR_VOP:
+    print(" %s x%d, x%d, x%d", vopnames[ir->imm], ir->vd, ir->va, ir->vb);
+    break;
+  case IR_VREDUCE:
+    print(" %s x%d", vopnames[ir->imm], ir->va);
+    break;
+  case IR_VEND:
+    break;
+  case IR_MEMSET:
+    print_reg(ir->a);
+    print(", %ld,", ir->imm);
+    print_reg(ir->b);
+    break;
+  case IR_PREFETCH:
+    print_reg(ir->a);
+    print(", %ld", ir->imm);
+    break;
+  case IR_MEMCOPY:
+    print_reg(ir->a);
+    print(",");
+    print_reg(ir->b);
+    print(",");
+    print_reg(ir->args[0]);
+    break;
+  default:
+    print_reg(ir->a);
+    if (ir->b)
+      print(",");
+    print_reg(ir->b);
+  }
+  print("\n");
+}
+
+static void print_set(char *name, uint64_t *set, int n)
+{
+  print(" %s:", name);
+  for (int i = 0; i < n; i++)
+    if (bs_test(set, i))
+      print(" v%d", i);
+}
+
+static void print_bb(IRFunc *fn, BB *bb)
+{
+  print(".L%d:", bb->label);
+
+  print("  ; preds:");
+  for (int i = 0; i < bb->npreds; i++)
+    print(" .L%d", bb->preds[i]->label);
+  if (bb->idom != bb)
+    print(" idom: .L%d", bb->idom->label);
+  print_set("live-in", bb->live_in, fn->nregs);
+  print("\n");
+
+  for (IR *ir = bb->first; ir; ir = ir->next)
+    print_ir(ir);
+}
+
+void dump_ir(Obj *prog, FILE *out)
+{
+  output_file = out;
+
+  for (Obj *obj = prog; obj; obj = obj->next)
+  {
+    IRFunc *fn = obj->ir;
+    if (!fn)
+      continue;
+
+    compute_liveness(fn);
+    print("%s:\n", obj->name);
+    for (BB *bb = fn->bbs; bb; bb = bb->next)
+      print_bb(fn, bb);
+    print("\n");
+  }
+}
@@ -0,0 +1,543 @@
+#include "9cc.h"
+
+//
+// IR optimization passes
+//
+
+// Rewrite every use of a register through `map`, which maps virtual
+// register numbers to their replacements (or NULL).
+static Reg *resolve(Reg **map, Reg *r)
+{
+  while (r && map[r->vn])
+    r = map[r->vn];
+  return r;
+}
+
+static void replace_uses(IRFunc *fn, Reg **map)
+{
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      ir->a = resolve(map, ir->a);
+      ir->b = resolve(map, ir->b);
+      for (int i = 0; i < ir->nargs; i++)
+        ir->args[i] = resolve(map, ir->args[i]);
+    }
+  }
+}
+
+// If all operands of a phi are the same register (ignoring the phi
+// itself), the phi is just a copy of it.
+static Reg *trivial_phi(IR *ir, Reg **map)
+{
+  Reg *val = NULL;
+  for (int i = 0; i < ir->nargs; i++)
+  {
+    Reg *r = resolve(map, ir->args[i]);
+    if (r == ir->dst || r == val)
+      continue;
+    if (val)
+      return NULL;
+    val = r;
+  }
+  return val;
+}
+
+// Copy propagation. In SSA form, `x = copy y` means x and y hold the
+// same value everywhere x is used, so uses of x can read y directly.
+static bool propagate_copies(IRFunc *fn)
+{
+  Reg **map = calloc(fn->nregs, sizeof(Reg *));
+  bool changed = false;
+
+  for (bool again = true; again;)
+  {
+    again = false;
+    for (BB *bb = fn->bbs; bb; bb = bb->next)
+    {
+      for (IR *ir = bb->first; ir; ir = ir->next)
+      {
+        if (!ir->dst || map[ir->dst->vn])
+          continue;
+
+        Reg *val = NULL;
+        if (ir->op == IR_COPY)
+          val = resolve(map, ir->a);
+        else if (ir->op == IR_PHI)
+          val = trivial_phi(ir, map);
+
+        if (val && val != ir->dst)
+        {
+          map[ir->dst->vn] = val;
+          again = true;
+        }
+      }
+    }
+    changed |= again;
+  }
+
+  if (!changed)
+  {
+    free(map);
+    return false;
+  }
+
+  replace_uses(fn, map);
+
+  // The copies are dead now.
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    for (IR *ir = bb->first; ir; ir = ir->next)
+      if (ir->dst && map[ir->dst->vn])
+        remove_ir(ir);
+  free(map);
+  return true;
+}
+
+static bool is_commutative(IROp op)
+{
+  switch (op)
+  {
+  case IR_ADD:
+  case IR_MUL:
+  case IR_AND:
+  case IR_OR:
+  case IR_XOR:
+  case IR_EQ:
+  case IR_NE:
+    return true;
+  }
+  return false;
+}
+
+// Returns true if an instruction computes a value only from its
+// operands, so that two of them with the same operands are equal.
+static bool is_pure(IR *ir)
+{
+  switch (ir->op)
+  {
+  case IR_IMM:
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_DIV:
+  case IR_MOD:
+  case IR_AND:
+  case IR_OR:
+  case IR_XOR:
+  case IR_SHL:
+  case IR_SAR:
+  case IR_EQ:
+  case IR_NE:
+  case IR_LT:
+  case IR_LE:
+  case IR_NEG:
+  case IR_NOT:
+  case IR_SEXT:
+  case IR_LVAR:
+  case IR_GVAR:
+  case IR_LOAD:
+    return true;
+  }
+  return false;
+}
+
+static bool same_value(IR *x, IR *y)
+{
+  if (x->op != y->op || x->size != y->size || x->imm != y->imm || x->var != y->var)
+    return false;
+  if (x->a == y->a && x->b == y->b)
+    return true;
+  return is_commutative(x->op) && x->a == y->b && x->b == y->a;
+}
+
+// Writes to memory through a pointer may change any loaded value.
+static bool clobbers_memory(IR *ir)
+{
+  return ir->op == IR_STORE || ir->op == IR_MEMCPY || ir->op == IR_MEMZERO ||
+         ir->op == IR_MEMSET || ir->op == IR_MEMCOPY || ir->op == IR_CALL ||
+         ir->op == IR_VSTORE;
+}
+
+// Local common subexpression elimination. Within a basic block, an
+// instruction that recomputes an available value is replaced by the
+// register that already holds it. Loads are available until the next
+// instruction that may write memory.
+static bool eliminate_common_subexprs(IRFunc *fn)
+{
+  Reg **map = calloc(fn->nregs, sizeof(Reg *));
+  IR **avail = NULL;
+  int cap = 0;
+  bool changed = false;
+
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    int navail = 0;
+
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      ir->a = resolve(map, ir->a);
+      ir->b = resolve(map, ir->b);
+      for (int i = 0; i < ir->nargs; i++)
+        ir->args[i] = resolve(map, ir->args[i]);
+
+      if (clobbers_memory(ir))
+      {
+        int j = 0;
+        for (int i = 0; i < navail; i++)
+          if (avail[i]->op != IR_LOAD)
+            avail[j++] = avail[i];
+        navail = j;
+        continue;
+      }
+
+      if (!is_pure(ir))
+        continue;
+
+      IR *prev = NULL;
+      for (int i = 0; i < navail && !prev; i++)
+        if (same_value(avail[i], ir))
+          prev = avail[i];
+
+      if (prev)
+      {
+        map[ir->dst->vn] = prev->dst;
+        remove_ir(ir);
+        changed = true;
+        continue;
+      }
+
+      if (navail == cap)
+      {
+        cap = cap ? cap * 2 : 64;
+        avail = realloc(avail, sizeof(IR *) * cap);
+      }
+      avail[navail++] = ir;
+    }
+  }
+
+  // Values computed in one block may be used in blocks it dominates.
+  if (changed)
+    replace_uses(fn, map);
+  free(map);
+  free(avail);
+  return changed;
+}
+
+// Dead code elimination. Instructions with side effects are live,
+// and so are the definitions of the registers they use, transitively.
+// Everything else is removed.
+bool remove_dead_code(IRFunc *fn)
+{
+  bool *live = calloc(fn->nregs, sizeof(bool));
+  IR **worklist = NULL;
+  int n = 0;
+  int cap = 0;
+
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      if (!has_side_effect(ir))
+        continue;
+      if (n == cap)
+      {
+        cap = cap ? cap * 2 : 64;
+        worklist = realloc(worklist, sizeof(IR *) * cap);
+      }
+      worklist[n++] = ir;
+    }
+  }
+
+  while (n > 0)
+  {
+    IR *ir = worklist[--n];
+    Reg *uses[2] = {ir->a, ir->b};
+    for (int j = 0; j < 2 + ir->nargs; j++)
+    {
+      Reg *r = (j < 2) ? uses[j] : ir->args[j - 2];
+      if (!r || live[r->vn])
+        continue;
+      live[r->vn] = true;
+      if (n == cap)
+      {
+        cap = cap ? cap * 2 : 64;
+        worklist = realloc(worklist, sizeof(IR *) * cap);
+      }
+      worklist[n++] = r->def;
+    }
+  }
+  free(worklist);
+
+  bool changed = false;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      if (has_side_effect(ir) || (ir->dst && live[ir->dst->vn]))
+        continue;
+      remove_ir(ir);
+      changed = true;
+    }
+  }
+  free(live);
+  return changed;
+}
+
+void optimize_ir(IRFunc *fn)
+{
+  for (bool changed = true; changed;)
+  {
+    changed = propagate_copies(fn);
+    changed |= eliminate_common_subexprs(fn);
+    changed |= remove_dead_code(fn);
+  }
+}
+
+//
+// Sign extension elimination
+//
+// Loads and IR_SEXT sign-extend values, and many extensions are
+// redundant. The operand may already be sign-extended, e.g. an int
+// loaded with movsxd and then converted to long. Or the users may read
+// no more bytes than the extension preserves, e.g. a char computed in
+// 32 bits and only stored as a byte.
+//
+// For each register we track the smallest w such that its low 32 bits
+// (ext32) and all its 64 bits (ext64) are the sign extension of its
+// low w bytes, and the number of bytes its users read (demand).
+//
+
+// Returns the smallest size that fits `val` as a signed integer.
+static int fit_size(int64_t val)
+{
+  if (val == (int8_t)val)
+    return 1;
+  if (val == (int16_t)val)
+    return 2;
+  if (val == (int32_t)val)
+    return 4;
+  return 8;
+}
+
+static int *ext32;
+static int *ext64;
+
+// Facts about registers that haven't been visited yet, e.g. loop
+// values read by a phi, are unknown.
+static int get_ext32(Reg *r)
+{
+  return ext32[r->vn] ? ext32[r->vn] : 4;
+}
+
+static int get_ext64(Reg *r)
+{
+  return ext64[r->vn] ? ext64[r->vn] : 8;
+}
+
+// Computes ext32 and ext64 of the register that `ir` defines, after
+// the register allocator assigns it and codegen emits it.
+static void known_ext(IR *ir)
+{
+  int e32 = 4;
+  int e64 = 8;
+
+  switch (ir->op)
+  {
+  case IR_IMM:
+    e32 = MIN(fit_size((int32_t)ir->imm), 4);
+    e64 = fit_size(ir->imm);
+    break;
+  case IR_COPY:
+    e32 = get_ext32(ir->a);
+    e64 = get_ext64(ir->a);
+    break;
+  case IR_PHI:
+  case IR_SELECT:
+    e32 = e64 = 1;
+    for (int i = 0; i < ir->nargs; i++)
+    {
+      e32 = MAX(e32, get_ext32(ir->args[i]));
+      e64 = MAX(e64, get_ext64(ir->args[i]));
+    }
+    break;
+  case IR_EQ:
+  case IR_NE:
+  case IR_LT:
+  case IR_LE:
+    e32 = e64 = 1;
+    break;
+  case IR_AND:
+    // Masking with a non-negative constant clears the upper bits.
+    if (ir->b->def && ir->b->def->op == IR_IMM && ir->b->def->imm >= 0)
+    {
+      e64 = fit_size(ir->b->def->imm);
+      e32 = MIN(e64, 4);
+    }
+    break;
+  case IR_LOAD:
+    // movsx to a 32-bit register clears the upper half.
+    if (ir->size < 4)
+      e32 = ir->size;
+    else if (ir->size == 4)
+      e64 = 4;
+    break;
+  case IR_SEXT:
+    e32 = MIN(ir->size, get_ext32(ir->a));
+    if (ir->size == 4)
+      e64 = e32;
+    break;
+  case IR_CALL:
+    if (ir->ty->kind == TY_BOOL || ir->ty->kind == TY_CHAR)
+      e32 = 1;
+    else if (ir->ty->kind == TY_SHORT)
+      e32 = 2;
+    break;
+  }
+
+  ext32[ir->dst->vn] = e32;
+  ext64[ir->dst->vn] = e64;
+}
+
+// Returns the number of low bytes of `r` that `ir` reads.
+static int demand(IR *ir, Reg *r)
+{
+  switch (ir->op)
+  {
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_DIV:
+  case IR_MOD:
+  case IR_AND:
+  case IR_OR:
+  case IR_XOR:
+  case IR_EQ:
+  case IR_NE:
+  case IR_LT:
+  case IR_LE:
+  case IR_NEG:
+  case IR_NOT:
+  case IR_BR:
+    return ir->size;
+  case IR_SHL:
+  case IR_SAR:
+    // The shift count is taken from %cl.
+    return (r == ir->a) ? ir->size : 1;
+  case IR_SEXT:
+    return ir->size;
+  case IR_STORE:
+    return (r == ir->b) ? ir->size : 8;
+  case IR_SELECT:
+    if (r == ir->a && r != ir->args[0] && r != ir->args[1])
+      return ir->size;
+    return 8;
+  }
+  return 8;
+}
+
+static void use_demand(int *dem, IR *ir)
+{
+  Reg *uses[2] = {ir->a, ir->b};
+  for (int j = 0; j < 2 + ir->nargs; j++)
+  {
+    Reg *r = (j < 2) ? uses[j] : ir->args[j - 2];
+    if (r)
+      dem[r->vn] = MAX(dem[r->vn], demand(ir, r));
+  }
+}
+
+// Replaces the extensions marked in `map` with their operands.
+static bool remove_exts(IRFunc *fn, Reg **map)
+{
+  bool changed = false;
+  for (int i = 0; i < fn->nregs; i++)
+    changed |= (map[i] != NULL);
+  if (!changed)
+    return false;
+
+  replace_uses(fn, map);
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    for (IR *ir = bb->first; ir; ir = ir->next)
+      if (ir->dst && map[ir->dst->vn])
+        remove_ir(ir);
+  return true;
+}
+
+void eliminate_exts(IRFunc *fn)
+{
+  ext32 = calloc(fn->nregs, sizeof(int));
+  ext64 = calloc(fn->nregs, sizeof(int));
+  Reg **map = calloc(fn->nregs, sizeof(Reg *));
+
+  // Extensions of values that are already sign-extended. A removed
+  // extension's register takes the facts of its operand.
+  for (int i = 0; i < fn->nbbs; i++)
+  {
+    for (IR *ir = fn->rpo[i]->first; ir; ir = ir->next)
+    {
+      if (!ir->dst)
+        continue;
+      if (ir->op == IR_SEXT)
+      {
+        int have = (ir->size == 4) ? get_ext64(ir->a) : get_ext32(ir->a);
+        if (have <= ir->size)
+        {
+          map[ir->dst->vn] = ir->a;
+          ir->op = IR_COPY;
+        }
+      }
+      known_ext(ir);
+    }
+  }
+  remove_exts(fn, map);
+
+  // Extensions whose users don't read the bits they change
+  int *dem = calloc(fn->nregs, sizeof(int));
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    for (IR *ir = bb->first; ir; ir = ir->next)
+      use_demand(dem, ir);
+
+  memset(map, 0, sizeof(Reg *) * fn->nregs);
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    for (IR *ir = bb->first; ir; ir = ir->next)
+      if (ir->op == IR_SEXT && dem[ir->dst->vn] <= ir->size)
+        map[ir->dst->vn] = ir->a;
+  remove_exts(fn, map);
+
+  free(ext32);
+  free(ext64);
+  free(dem);
+  free(map);
+}
+
+// Convert the function out of SSA form by replacing each phi with
+// copies. A phi `x = phi(a from A, b from B)` becomes `t = a` at the
+// end of A, `t = b` at the end of B, and `x = t` at the phi. Going
+// through a fresh register `t` keeps the copies correct even if a
+// predecessor has several successors or another phi of the same
+// block reads x.
+void leave_ssa(IRFunc *fn)
+{
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir && ir->op == IR_PHI; ir = ir->next)
+    {
+      Reg *tmp = new_reg(fn);
+
+      for (int i = 0; i < ir->nargs; i++)
+      {
+        IR *copy = new_ir(IR_COPY, ir->tok);
+        copy->dst = tmp;
+        copy->a = ir->args[i];
+        insert_before(ir->from[i]->last, copy);
+      }
+
+      ir->op = IR_COPY;
+      ir->a = tmp;
+      ir->nargs = 0;
+      ir->args = NULL;
+      ir->from = NULL;
+    }
+  }
+}
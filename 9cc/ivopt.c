@@ -0,0 +1,641 @@
+#include "9cc.h"
+
+//
+// Induction variable optimization
+//
+// A basic induction variable is a phi in a loop header that starts at
+// some value and grows by a constant in every iteration:
+//
+//   i = phi [i0, preheader], [i', latch]
+//   i' = add i, c
+//
+// Array indexing computes an address like a + sext(i) * 8 + 16 from it
+// in every iteration. If `a` is loop-invariant, we give the address a
+// pointer induction variable of its own,
+//
+//   p = phi [a + i0 * 8 + 16, preheader], [p', latch]
+//   p' = add p, c * 8
+//
+// and the multiply and the adds disappear (strength reduction).
+// Addresses that differ only in the offset, like a[i] and a[i-1],
+// share one pointer and add the difference.
+//
+// If i is then used only by the exit test, the test is rewritten to
+// compare a pointer against its final value instead (linear function
+// test replacement), and i is removed.
+//
+// Signed overflow is undefined and there are no unsigned types, so
+// we assume that an int induction variable doesn't wrap when it is
+// sign-extended.
+//
+
+// Maximum number of pointer induction variables added to a loop
+#define MAX_PTRS 6
+
+// The value of a register as base + scale * iv + off, where iv is a
+// basic induction variable and base is NULL or a loop-invariant
+// register. Values with a base are always 8 bytes wide.
+typedef struct
+{
+  IR *iv;
+  Reg *base;
+  int64_t scale;
+  int64_t off;
+  int size;
+} Affine;
+
+// A basic induction variable
+typedef struct
+{
+  IR *phi;
+  IR *inc; // i' = add i, step, possibly through other adds
+  int64_t step;
+  int size;
+} IV;
+
+// A pointer induction variable added for the addresses with the same
+// iv, base and scale
+typedef struct
+{
+  Affine aff; // the value of `phi`
+  IR *phi;
+  Reg *next;
+  bool is_addr; // used as the address of a load or store
+} Ptr;
+
+static IRFunc *fn;
+static Loop *loop;
+static BB *pre;
+static BB *latch;
+
+static IV ivs[16];
+static int nivs;
+static Affine **affs; // indexed by virtual register number
+static int naffs;
+
+static int nreduced;
+static int nremoved;
+
+static bool is_imm(Reg *r)
+{
+  return r && r->def && r->def->op == IR_IMM;
+}
+
+static bool is_invariant(Reg *r)
+{
+  return !in_loop(loop, r->def->bb);
+}
+
+// LICM leaves variable addresses in the loop, but they are invariant
+// too and can be recomputed in the preheader.
+static bool is_var_addr(Reg *r)
+{
+  return r->def->op == IR_LVAR || r->def->op == IR_GVAR;
+}
+
+static bool same_base(Reg *x, Reg *y)
+{
+  if (x == y)
+    return true;
+  return x && y && is_var_addr(x) && is_var_addr(y) && x->def->op == y->def->op &&
+         x->def->var == y->def->var;
+}
+
+static bool fits(int64_t val)
+{
+  return val == (int32_t)val;
+}
+
+static IR *add_ir(IR *pos, IROp op, Reg *a, Reg *b, int size)
+{
+  IR *ir = new_ir(op, pos->tok);
+  ir->a = a;
+  ir->b = b;
+  ir->size = size;
+  ir->dst = new_reg(fn);
+  ir->dst->def = ir;
+  insert_before(pos, ir);
+  return ir;
+}
+
+static Reg *add_imm(IR *pos, int64_t val)
+{
+  IR *ir = add_ir(pos, IR_IMM, NULL, NULL, 0);
+  ir->imm = val;
+  return ir->dst;
+}
+
+// Returns `a + b` computed before `pos`. Either may be NULL for 0.
+static Reg *add_reg(IR *pos, Reg *a, Reg *b)
+{
+  if (!a || !b)
+    return a ? a : b;
+  return add_ir(pos, IR_ADD, a, b, 8)->dst;
+}
+
+//
+// Analysis
+//
+
+// Matches a header phi that is a basic induction variable.
+static bool match_iv(IR *phi, IV *iv)
+{
+  if (phi->nargs != 2)
+    return false;
+
+  if ((phi->from[0] != latch || phi->from[1] != pre) &&
+      (phi->from[0] != pre || phi->from[1] != latch))
+    return false;
+
+  Reg *next = (phi->from[0] == latch) ? phi->args[0] : phi->args[1];
+  IR *inc = next->def;
+  if (!inc || !in_loop(loop, inc->bb) || (inc->size != 4 && inc->size != 8))
+    return false;
+
+  // An unrolled loop adds the step in several instructions, one for
+  // each copy of the body.
+  iv->step = 0;
+  for (Reg *r = next; r != phi->dst;)
+  {
+    IR *ir = r->def;
+    if (!ir || !in_loop(loop, ir->bb) || ir->size != inc->size)
+      return false;
+
+    if (ir->op == IR_ADD && is_imm(ir->b))
+    {
+      iv->step += ir->b->def->imm;
+      r = ir->a;
+    }
+    else if (ir->op == IR_ADD && is_imm(ir->a))
+    {
+      iv->step += ir->a->def->imm;
+      r = ir->b;
+    }
+    else if (ir->op == IR_SUB && is_imm(ir->b))
+    {
+      iv->step -= ir->b->def->imm;
+      r = ir->a;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  iv->phi = phi;
+  iv->inc = inc;
+  iv->size = inc->size;
+  return iv->step != 0 && fits(iv->step);
+}
+
+// Registers added by this pass have no affine form.
+static Affine *aff_of(Reg *r)
+{
+  return (r && r->vn < naffs) ? affs[r->vn] : NULL;
+}
+
+static Affine *new_affine(Affine *x)
+{
+  if (!fits(x->scale) || !fits(x->off) || x->scale == 0)
+    return NULL;
+  Affine *aff = calloc(1, sizeof(Affine));
+  *aff = *x;
+  return aff;
+}
+
+// Computes the affine form of the value an instruction defines, if it
+// has one, from the forms of its operands.
+static Affine *analyze(IR *ir)
+{
+  Affine *x = aff_of(ir->a);
+  Affine *y = aff_of(ir->b);
+  Reg *b = ir->b;
+
+  // Put the affine operand first.
+  if (!x && y && ir->op != IR_SUB && ir->op != IR_SHL)
+  {
+    x = y;
+    y = NULL;
+    b = ir->a;
+  }
+  if (!x || y)
+    return NULL;
+
+  Affine v = *x;
+  switch (ir->op)
+  {
+  case IR_COPY:
+    return new_affine(&v);
+  case IR_SEXT:
+    if (ir->size != 4 || x->size != 4)
+      return NULL;
+    v.size = 8;
+    return new_affine(&v);
+  }
+
+  if (ir->size != x->size || !b)
+    return NULL;
+
+  switch (ir->op)
+  {
+  case IR_ADD:
+    if (is_imm(b))
+    {
+      v.off += b->def->imm;
+      return new_affine(&v);
+    }
+    if ((is_invariant(b) || is_var_addr(b)) && !v.base && ir->size == 8)
+    {
+      v.base = b;
+      return new_affine(&v);
+    }
+    return NULL;
+  case IR_SUB:
+    if (!is_imm(b))
+      return NULL;
+    v.off -= b->def->imm;
+    return new_affine(&v);
+  case IR_MUL:
+  case IR_SHL:
+  {
+    if (!is_imm(b) || v.base)
+      return NULL;
+    int64_t k = b->def->imm;
+    if (ir->op == IR_SHL)
+    {
+      if (k < 0 || k > 30)
+        return NULL;
+      k = 1L << k;
+    }
+    if (!fits(k))
+      return NULL;
+    v.scale *= k;
+    v.off *= k;
+    return new_affine(&v);
+  }
+  }
+  return NULL;
+}
+
+static void analyze_loop(void)
+{
+  nivs = 0;
+  for (IR *ir = loop->head->first; ir && ir->op == IR_PHI; ir = ir->next)
+  {
+    if (nivs == sizeof(ivs) / sizeof(*ivs) || !match_iv(ir, &ivs[nivs]))
+      continue;
+    affs[ir->dst->vn] = new_affine(&(Affine){ir, NULL, 1, 0, ivs[nivs].size});
+    nivs++;
+  }
+
+  // Blocks are in reverse postorder, so operands come before uses,
+  // except for phis.
+  for (int i = 0; i < loop->nbbs; i++)
+    for (IR *ir = loop->bbs[i]->first; ir; ir = ir->next)
+      if (ir->dst && ir->op != IR_PHI)
+        affs[ir->dst->vn] = analyze(ir);
+}
+
+static IV *iv_of(IR *phi)
+{
+  for (int i = 0; i < nivs; i++)
+    if (ivs[i].phi == phi)
+      return &ivs[i];
+  return NULL;
+}
+
+//
+// Strength reduction
+//
+
+static bool is_addr(Affine *aff)
+{
+  return aff && aff->base;
+}
+
+// Returns true if an address is used by anything but the computation
+// of another address, i.e. if it is worth a pointer of its own.
+// `is_mem` is set if it is the address of a load or a store.
+static bool is_root(Reg *r, bool *is_mem)
+{
+  bool root = false;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      bool uses = (ir->a == r || ir->b == r);
+      for (int i = 0; i < ir->nargs; i++)
+        uses |= (ir->args[i] == r);
+      if (!uses)
+        continue;
+      if ((ir->op == IR_LOAD || ir->op == IR_STORE || ir->op == IR_VLOAD ||
+           ir->op == IR_VSTORE) && ir->a == r)
+        *is_mem = true;
+      if (!ir->dst || !in_loop(loop, bb) || !is_addr(aff_of(ir->dst)))
+        root = true;
+    }
+  }
+  return root;
+}
+
+static void replace_uses(Reg *from, Reg *to)
+{
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      if (ir->a == from)
+        ir->a = to;
+      if (ir->b == from)
+        ir->b = to;
+      for (int i = 0; i < ir->nargs; i++)
+        if (ir->args[i] == from)
+          ir->args[i] = to;
+    }
+  }
+}
+
+// Computes base + scale * val + off before `pos`. `val` is the value of
+// an induction variable of width `size`, or NULL for 0.
+static Reg *gen_affine(IR *pos, Affine *aff, Reg *val, int size)
+{
+  int64_t off = aff->off;
+  Reg *r = NULL;
+
+  if (val && is_imm(val))
+  {
+    int64_t v = (size == 4) ? (int32_t)val->def->imm : val->def->imm;
+    off += aff->scale * v;
+  }
+  else if (val)
+  {
+    r = val;
+    if (size == 4)
+      r = add_ir(pos, IR_SEXT, r, NULL, 4)->dst;
+    if (aff->scale != 1)
+      r = add_ir(pos, IR_MUL, r, add_imm(pos, aff->scale), 8)->dst;
+  }
+
+  Reg *base = aff->base;
+  if (base && in_loop(loop, base->def->bb))
+  {
+    IR *ir = add_ir(pos, base->def->op, NULL, NULL, 0);
+    ir->var = base->def->var;
+    base = ir->dst;
+  }
+  r = add_reg(pos, base, r);
+  if (off)
+    r = add_reg(pos, r, add_imm(pos, off));
+  return r;
+}
+
+static Ptr *new_ptr(Affine *aff)
+{
+  IV *iv = iv_of(aff->iv);
+  Reg *init = (aff->iv->from[0] == pre) ? aff->iv->args[0] : aff->iv->args[1];
+
+  Ptr *p = calloc(1, sizeof(Ptr));
+  p->aff = *aff;
+
+  IR *phi = new_ir(IR_PHI, aff->iv->tok);
+  phi->dst = new_reg(fn);
+  phi->dst->def = phi;
+  phi->nargs = 2;
+  phi->args = calloc(2, sizeof(Reg *));
+  phi->from = calloc(2, sizeof(BB *));
+  phi->from[0] = pre;
+  phi->from[1] = latch;
+  insert_before(loop->head->first, phi);
+  p->phi = phi;
+
+  phi->args[0] = gen_affine(pre->last, aff, init, iv->size);
+  IR *pos = iv->inc->next;
+  p->next = add_ir(pos, IR_ADD, phi->dst, add_imm(pos, aff->scale * iv->step), 8)->dst;
+  phi->args[1] = p->next;
+  return p;
+}
+
+static Ptr *find_ptr(Ptr **ptrs, int nptrs, Affine *aff)
+{
+  for (int i = 0; i < nptrs; i++)
+    if (ptrs[i]->aff.iv == aff->iv && same_base(ptrs[i]->aff.base, aff->base) &&
+        ptrs[i]->aff.scale == aff->scale)
+      return ptrs[i];
+  return NULL;
+}
+
+static int reduce(Ptr **ptrs)
+{
+  int nptrs = 0;
+  for (int i = 0; i < loop->nbbs; i++)
+  {
+    for (IR *ir = loop->bbs[i]->first; ir; ir = ir->next)
+    {
+      Affine *aff = aff_of(ir->dst);
+      bool is_mem = false;
+      if (!is_addr(aff) || !is_root(ir->dst, &is_mem))
+        continue;
+
+      Ptr *p = find_ptr(ptrs, nptrs, aff);
+      if (!p)
+      {
+        if (nptrs == MAX_PTRS)
+          continue;
+        p = ptrs[nptrs++] = new_ptr(aff);
+      }
+      p->is_addr |= is_mem;
+
+      // The instruction now adds the difference in offsets to the
+      // pointer, or is replaced by it.
+      if (aff->off == p->aff.off)
+      {
+        replace_uses(ir->dst, p->phi->dst);
+      }
+      else
+      {
+        Reg *diff = add_imm(ir, aff->off - p->aff.off);
+        ir->op = IR_ADD;
+        ir->a = p->phi->dst;
+        ir->b = diff;
+        ir->size = 8;
+        ir->nargs = 0;
+      }
+      affs[ir->dst->vn] = NULL;
+      nreduced++;
+    }
+  }
+  return nptrs;
+}
+
+//
+// Linear function test replacement
+//
+
+static int count_uses(Reg *r, IR **user)
+{
+  int n = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      bool uses = (ir->a == r || ir->b == r);
+      for (int i = 0; i < ir->nargs; i++)
+        uses |= (ir->args[i] == r);
+      if (uses)
+      {
+        n++;
+        if (user)
+          *user = ir;
+      }
+    }
+  }
+  return n;
+}
+
+// Finds the only use of `r` other than `other`.
+static IR *other_use(Reg *r, IR *other, int *n)
+{
+  IR *found = NULL;
+  *n = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      if (ir == other)
+        continue;
+      bool uses = (ir->a == r || ir->b == r);
+      for (int i = 0; i < ir->nargs; i++)
+        uses |= (ir->args[i] == r);
+      if (uses)
+      {
+        (*n)++;
+        found = ir;
+      }
+    }
+  }
+  return found;
+}
+
+// Rewrites the exit test of `iv` as a comparison of `p`, and removes
+// the induction variable if nothing else uses it.
+static void replace_test(IV *iv, Ptr *p)
+{
+  IR *phi = iv->phi;
+  IR *inc = iv->inc;
+  int nphi, ninc;
+  IR *u1 = other_use(phi->dst, inc, &nphi);
+  IR *u2 = other_use(inc->dst, phi, &ninc);
+  if (nphi + ninc != 1)
+    return;
+
+  IR *cmp = u1 ? u1 : u2;
+  Reg *var = u1 ? phi->dst : inc->dst;
+  Reg *ptr = u1 ? p->phi->dst : p->next;
+  IR *user;
+
+  if (cmp->op != IR_LT && cmp->op != IR_LE && cmp->op != IR_EQ && cmp->op != IR_NE)
+    return;
+  if (!in_loop(loop, cmp->bb) || cmp->size != iv->size)
+    return;
+  if (count_uses(cmp->dst, &user) != 1 || user->op != IR_BR)
+    return;
+
+  Reg **lhs = (cmp->a == var) ? &cmp->a : &cmp->b;
+  Reg **rhs = (cmp->a == var) ? &cmp->b : &cmp->a;
+  if (*rhs == var || !(is_invariant(*rhs) || is_imm(*rhs)))
+    return;
+
+  Reg *limit = *rhs;
+  if (is_imm(limit) && in_loop(loop, limit->def->bb))
+    limit = add_imm(pre->last, limit->def->imm);
+
+  *rhs = gen_affine(pre->last, &p->aff, limit, iv->size);
+  *lhs = ptr;
+  cmp->size = 8;
+
+  remove_ir(inc);
+  remove_ir(phi);
+  nremoved++;
+}
+
+static void optimize_loop(void)
+{
+  latch = NULL;
+  for (int i = 0; i < loop->head->npreds; i++)
+  {
+    BB *bb = loop->head->preds[i];
+    if (bb == pre)
+      continue;
+    if (latch)
+      return;
+    latch = bb;
+  }
+  if (!latch || loop->head->npreds != 2)
+    return;
+
+  analyze_loop();
+
+  Ptr *ptrs[MAX_PTRS];
+  int nptrs = reduce(ptrs);
+  if (nptrs == 0)
+    return;
+
+  // Remove the arithmetic that computed the addresses, so that only
+  // the exit test may be left using each induction variable.
+  remove_dead_code(fn);
+
+  for (int i = 0; i < nivs; i++)
+  {
+    for (int j = 0; j < nptrs; j++)
+    {
+      Ptr *p = ptrs[j];
+      if (p->aff.iv == ivs[i].phi && p->is_addr && p->aff.scale > 0)
+      {
+        replace_test(&ivs[i], p);
+        break;
+      }
+    }
+  }
+}
+
+void optimize_ivs(IRFunc *f)
+{
+  fn = f;
+  nreduced = nremoved = 0;
+
+  int nloops;
+  Loop **loops = find_loops(fn, &nloops);
+  if (nloops == 0)
+    return;
+
+  bool changed = false;
+  for (int i = 0; i < nloops; i++)
+    if (!preheader_of(loops[i]) && add_preheader(fn, loops[i]))
+      changed = true;
+
+  if (changed)
+  {
+    build_cfg(fn);
+    build_dom_tree(fn);
+    loops = find_loops(fn, &nloops);
+  }
+
+  // Inner loops come first, so that the start values of their pointers,
+  // computed in their preheaders, may be reduced in the outer loops.
+  for (int i = 0; i < nloops; i++)
+  {
+    loop = loops[i];
+    pre = preheader_of(loop);
+    if (!pre)
+      continue;
+    naffs = fn->nregs;
+    affs = calloc(naffs, sizeof(Affine *));
+    optimize_loop();
+    free(affs);
+  }
+
+  if (nreduced)
+    remove_dead_code(fn);
+  count_stat("iv-reduced", "addrs", nreduced);
+  count_stat("iv-removed", "ivs", nremoved);
+}
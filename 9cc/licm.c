@@ -0,0 +1,553 @@
+#include "9cc.h"
+
+//
+// Loop-invariant code motion
+//
+// An instruction in a loop is invariant if its operands are defined
+// outside the loop or by other invariant instructions. Such an
+// instruction computes the same value in every iteration, so it can be
+// computed once in the loop's preheader, a block that runs right
+// before the loop and jumps only to its header.
+//
+// Arithmetic can be hoisted from anywhere in the loop, but loads and
+// divisions may trap, so they are hoisted only from blocks that run in
+// every iteration, and only from loops without calls, which might not
+// return. A load is invariant only if no store in the loop may write
+// the memory it reads, which we decide with the rules in may_alias().
+//
+// Every hoisted value that the loop still uses keeps a register busy
+// for the whole loop, so we don't hoist what is as cheap to recompute
+// as to keep: immediates and variable addresses are copied into the
+// preheader for the instructions that use them, but stay in the loop.
+// Unrolled loops compute the same value in several copies of the body,
+// so a hoisted instruction that repeats one already in the preheader
+// is replaced by it. At most MAX_LIVE hoisted values are left live
+// across a loop.
+//
+
+// Maximum number of hoisted values used in or after a loop
+#define MAX_LIVE 6
+
+static IRFunc *fn;
+
+// Local variables whose address may be known outside the function or
+// used to reach other variables
+static Obj **escaped;
+static int nescaped;
+
+// True if the address of a scalar local is used for more than a direct
+// access, e.g. `*(&x+1)`, which existing code uses to reach a
+// neighbouring variable in the stack frame. Then any local may alias
+// any other (see mem2reg.c).
+static bool frame_walk;
+
+static int nhoisted;
+
+// The memory an address points to: `off` bytes from the start of
+// variable `var`, or from the value of `base` if var is NULL. The
+// offset is unknown if `known` is false.
+typedef struct
+{
+  Obj *var;
+  Reg *base;
+  int64_t off;
+  bool known;
+} Addr;
+
+static bool is_imm(Reg *r)
+{
+  return r->def && r->def->op == IR_IMM;
+}
+
+// Returns true if `r` is an immediate or a variable address, which
+// take a single instruction to compute.
+static bool is_cheap(Reg *r)
+{
+  IROp op = r->def->op;
+  return op == IR_IMM || op == IR_LVAR || op == IR_GVAR;
+}
+
+// Returns the variable an address is derived from by adding offsets,
+// or NULL.
+static Obj *var_of(Reg *r)
+{
+  IR *def = r->def;
+  switch (def->op)
+  {
+  case IR_LVAR:
+  case IR_GVAR:
+    return def->var;
+  case IR_COPY:
+    return var_of(def->a);
+  case IR_ADD:
+  {
+    Obj *x = var_of(def->a);
+    Obj *y = var_of(def->b);
+    return (x && y) ? NULL : x ? x : y;
+  }
+  case IR_SUB:
+    return var_of(def->b) ? NULL : var_of(def->a);
+  }
+  return NULL;
+}
+
+static Addr decompose(Reg *r)
+{
+  Addr addr = {.known = true};
+  for (;;)
+  {
+    IR *def = r->def;
+    if (def && (def->op == IR_LVAR || def->op == IR_GVAR))
+    {
+      if (def->var->is_local && frame_walk)
+        break;
+      addr.var = def->var;
+      return addr;
+    }
+    if (def && def->op == IR_COPY)
+    {
+      r = def->a;
+      continue;
+    }
+    if (def && def->op == IR_ADD && is_imm(def->b))
+    {
+      addr.off += def->b->def->imm;
+      r = def->a;
+      continue;
+    }
+    if (def && def->op == IR_ADD && is_imm(def->a))
+    {
+      addr.off += def->a->def->imm;
+      r = def->b;
+      continue;
+    }
+    if (def && def->op == IR_SUB && is_imm(def->b))
+    {
+      addr.off -= def->b->def->imm;
+      r = def->a;
+      continue;
+    }
+
+    // An array element at a variable index is somewhere in the array.
+    Obj *var = var_of(r);
+    if (var && !(var->is_local && frame_walk))
+    {
+      addr.var = var;
+      addr.known = false;
+      return addr;
+    }
+    break;
+  }
+  addr.base = r;
+  return addr;
+}
+
+static bool is_escaped(Obj *var)
+{
+  for (int i = 0; i < nescaped; i++)
+    if (escaped[i] == var)
+      return true;
+  return false;
+}
+
+static bool overlaps(Addr *x, int xsize, Addr *y, int ysize)
+{
+  if (!x->known || !y->known)
+    return true;
+  return x->off < y->off + ysize && y->off < x->off + xsize;
+}
+
+// Returns true if `ir`, which writes memory, may change the value that
+// `load` reads.
+static bool may_alias(IR *load, IR *ir)
+{
+  // Vector stores and block operations write more than `size` bytes.
+  if (ir->op == IR_VSTORE || ir->op == IR_MEMSET || ir->op == IR_MEMCOPY)
+    return true;
+
+  Addr x = decompose(load->a);
+  Addr y = decompose(ir->a);
+
+  // Distinct variables don't overlap.
+  if (x.var && y.var)
+    return x.var == y.var && overlaps(&x, load->size, &y, ir->size);
+
+  // A pointer can't point to a local whose address is never taken.
+  if (x.var && x.var->is_local && !is_escaped(x.var))
+    return false;
+  if (y.var && y.var->is_local && !is_escaped(y.var))
+    return false;
+
+  if (!x.var && !y.var && x.base == y.base)
+    return overlaps(&x, load->size, &y, ir->size);
+
+  // C only allows an object to be accessed through its own type or a
+  // character type (C11 6.5p7), and types of different sizes are
+  // different. Block copies and clears may write any type.
+  if (ir->op == IR_STORE && load->size != ir->size && load->size != 1 && ir->size != 1)
+    return false;
+  return true;
+}
+
+static bool is_scalar_lvar(Reg *r)
+{
+  if (!r || r->def->op != IR_LVAR)
+    return false;
+  TypeKind kind = r->def->var->ty->kind;
+  return kind != TY_ARRAY && kind != TY_STRUCT && kind != TY_UNION;
+}
+
+static void escape(Obj **base, Reg *r)
+{
+  if (!r || !base[r->vn] || !base[r->vn]->is_local || is_escaped(base[r->vn]))
+    return;
+  escaped = realloc(escaped, sizeof(Obj *) * (nescaped + 1));
+  escaped[nescaped++] = base[r->vn];
+}
+
+// Finds the local variables whose address flows anywhere but into
+// address arithmetic and the address operands of memory accesses.
+// Address arithmetic on a scalar is a walk through the stack frame.
+static void find_escaped(void)
+{
+  Obj **base = calloc(fn->nregs, sizeof(Obj *));
+  nescaped = 0;
+  frame_walk = false;
+
+  for (int i = 0; i < fn->nbbs; i++)
+  {
+    for (IR *ir = fn->rpo[i]->first; ir; ir = ir->next)
+    {
+      switch (ir->op)
+      {
+      case IR_LVAR:
+        base[ir->dst->vn] = ir->var;
+        continue;
+      case IR_COPY:
+        base[ir->dst->vn] = base[ir->a->vn];
+        continue;
+      case IR_SUB:
+        base[ir->dst->vn] = base[ir->a->vn];
+        escape(base, ir->b);
+        frame_walk |= is_scalar_lvar(ir->a);
+        continue;
+      case IR_ADD:
+        base[ir->dst->vn] = base[ir->a->vn] ? base[ir->a->vn] : base[ir->b->vn];
+        frame_walk |= is_scalar_lvar(ir->a) || is_scalar_lvar(ir->b);
+        continue;
+      case IR_LOAD:
+      case IR_MEMZERO:
+        continue;
+      case IR_STORE:
+        escape(base, ir->b);
+        continue;
+      case IR_MEMCPY:
+        continue;
+      }
+      escape(base, ir->a);
+      escape(base, ir->b);
+      for (int j = 0; j < ir->nargs; j++)
+        escape(base, ir->args[j]);
+    }
+  }
+  free(base);
+}
+
+// Returns true if a block runs in every iteration of the loop that
+// doesn't leave it early, i.e. it dominates every block that can leave
+// the loop or go back to the header.
+static bool runs_always(Loop *loop, BB *bb)
+{
+  for (int i = 0; i < loop->nbbs; i++)
+  {
+    BB *b = loop->bbs[i];
+    BB *succs[2];
+    int n = get_succs(b, succs);
+    bool leaves = (b->last->op == IR_RET);
+    for (int j = 0; j < n; j++)
+      if (!in_loop(loop, succs[j]) || succs[j] == loop->head)
+        leaves = true;
+    if (leaves && !dominates(bb, b))
+      return false;
+  }
+  return true;
+}
+
+static bool is_invariant(Loop *loop, bool *inv, Reg *r)
+{
+  return !r || !in_loop(loop, r->def->bb) || inv[r->vn] || is_cheap(r);
+}
+
+static bool can_hoist(Loop *loop, IR *ir, IR **stores, int nstores, bool has_call)
+{
+  switch (ir->op)
+  {
+  case IR_COPY:
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_AND:
+  case IR_OR:
+  case IR_XOR:
+  case IR_SHL:
+  case IR_SAR:
+  case IR_EQ:
+  case IR_NE:
+  case IR_LT:
+  case IR_LE:
+  case IR_NEG:
+  case IR_NOT:
+  case IR_SEXT:
+  case IR_SELECT:
+    return true;
+  case IR_DIV:
+  case IR_MOD:
+    if (is_imm(ir->b) && ir->b->def->imm != 0 && ir->b->def->imm != -1)
+      return true;
+    return !has_call && runs_always(loop, ir->bb);
+  case IR_LOAD:
+    if (has_call || !runs_always(loop, ir->bb))
+      return false;
+    for (int i = 0; i < nstores; i++)
+      if (may_alias(ir, stores[i]))
+        return false;
+    return true;
+  }
+  return false;
+}
+
+// Instructions moved or copied into the preheader of the current loop
+static IR **moved;
+static int nmoved;
+
+// Registers of hoisted instructions that were replaced by an equal one
+static Reg **map;
+static int nmap;
+
+static Reg *resolve(Reg *r)
+{
+  while (r && r->vn < nmap && map[r->vn])
+    r = map[r->vn];
+  return r;
+}
+
+// Returns true if two registers hold the same value. A cheap value
+// in the loop equals its copy in the preheader.
+static bool same_reg(Reg *x, Reg *y)
+{
+  if (x == y)
+    return true;
+  if (!x || !y || !is_cheap(x) || !is_cheap(y))
+    return false;
+  IR *a = x->def;
+  IR *b = y->def;
+  return a->op == b->op && a->imm == b->imm && a->var == b->var;
+}
+
+// Returns an instruction already in the preheader that computes the
+// same value as `ir`, or NULL. Loads are equal too, since nothing in
+// the loop writes the memory they read.
+static IR *find_moved(IR *ir)
+{
+  if (ir->nargs)
+    return NULL;
+  for (int i = 0; i < nmoved; i++)
+  {
+    IR *x = moved[i];
+    if (x->op == ir->op && x->size == ir->size && x->imm == ir->imm &&
+        x->var == ir->var && same_reg(x->a, resolve(ir->a)) &&
+        same_reg(x->b, resolve(ir->b)))
+      return x;
+  }
+  return NULL;
+}
+
+static void add_moved(IR *ir)
+{
+  moved = realloc(moved, sizeof(IR *) * (nmoved + 1));
+  moved[nmoved++] = ir;
+}
+
+// Makes a copy of an immediate or an address in the preheader for a
+// hoisted instruction, since the original is defined inside the loop.
+static Reg *copy_cheap(Loop *loop, BB *pre, Reg *r)
+{
+  if (!r || !is_cheap(r) || !in_loop(loop, r->def->bb))
+    return r;
+  IR *ir = new_ir(r->def->op, r->def->tok);
+  ir->imm = r->def->imm;
+  ir->var = r->def->var;
+  ir->size = r->def->size;
+
+  IR *prev = find_moved(ir);
+  if (prev)
+    return prev->dst;
+
+  ir->dst = new_reg(fn);
+  ir->dst->def = ir;
+  insert_before(pre->last, ir);
+  add_moved(ir);
+  return ir->dst;
+}
+
+// Counts the uses of each register.
+static int *count_uses(void)
+{
+  int *uses = calloc(fn->nregs, sizeof(int));
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      if (ir->a)
+        uses[ir->a->vn]++;
+      if (ir->b)
+        uses[ir->b->vn]++;
+      for (int i = 0; i < ir->nargs; i++)
+        uses[ir->args[i]->vn]++;
+    }
+  }
+  return uses;
+}
+
+static void replace_uses(void)
+{
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      ir->a = resolve(ir->a);
+      ir->b = resolve(ir->b);
+      for (int i = 0; i < ir->nargs; i++)
+        ir->args[i] = resolve(ir->args[i]);
+    }
+  }
+}
+
+static void hoist(Loop *loop, BB *pre)
+{
+  IR **stores = NULL;
+  int nstores = 0;
+  bool has_call = false;
+
+  for (int i = 0; i < loop->nbbs; i++)
+  {
+    for (IR *ir = loop->bbs[i]->first; ir; ir = ir->next)
+    {
+      if (ir->op == IR_CALL)
+        has_call = true;
+      if (ir->op == IR_STORE || ir->op == IR_MEMCPY || ir->op == IR_MEMZERO ||
+          ir->op == IR_MEMSET || ir->op == IR_MEMCOPY || ir->op == IR_VSTORE)
+      {
+        stores = realloc(stores, sizeof(IR *) * (nstores + 1));
+        stores[nstores++] = ir;
+      }
+    }
+  }
+
+  // A hoisted value is live across the loop as long as an instruction
+  // that isn't hoisted uses it. `uses` counts those uses.
+  int *uses = count_uses();
+  int live = 0;
+  nmap = fn->nregs;
+  map = calloc(nmap, sizeof(Reg *));
+  nmoved = 0;
+
+  // Blocks are in reverse postorder, so operands are visited before
+  // their uses and hoisted instructions stay in a valid order.
+  bool *inv = calloc(fn->nregs, sizeof(bool));
+  for (int i = 0; i < loop->nbbs; i++)
+  {
+    IR *next;
+    for (IR *ir = loop->bbs[i]->first; ir; ir = next)
+    {
+      next = ir->next;
+      if (!can_hoist(loop, ir, stores, nstores, has_call))
+        continue;
+
+      bool ok = is_invariant(loop, inv, ir->a) && is_invariant(loop, inv, ir->b);
+      for (int j = 0; j < ir->nargs; j++)
+        ok = ok && is_invariant(loop, inv, ir->args[j]);
+      if (!ok)
+        continue;
+
+      // Operands only this instruction uses die in the preheader, and
+      // an instruction equal to one there adds no value.
+      Reg *a = resolve(ir->a);
+      Reg *b = resolve(ir->b);
+      IR *prev = find_moved(ir);
+      int n = live;
+      if (a && inv[a->vn] && uses[a->vn] == (a == b ? 2 : 1))
+        n--;
+      if (b && b != a && inv[b->vn] && uses[b->vn] == 1)
+        n--;
+      if (uses[ir->dst->vn] && !(prev && uses[prev->dst->vn]))
+        n++;
+      if (n > MAX_LIVE)
+        continue;
+      live = n;
+
+      if (a)
+        uses[a->vn]--;
+      if (b)
+        uses[b->vn]--;
+      remove_ir(ir);
+      inv[ir->dst->vn] = true;
+      nhoisted++;
+
+      if (prev)
+      {
+        map[ir->dst->vn] = prev->dst;
+        uses[prev->dst->vn] += uses[ir->dst->vn];
+        continue;
+      }
+
+      ir->a = copy_cheap(loop, pre, a);
+      ir->b = copy_cheap(loop, pre, b);
+      for (int j = 0; j < ir->nargs; j++)
+        ir->args[j] = copy_cheap(loop, pre, resolve(ir->args[j]));
+      insert_before(pre->last, ir);
+      add_moved(ir);
+    }
+  }
+  replace_uses();
+  free(map);
+  free(inv);
+  free(uses);
+  free(stores);
+}
+
+void hoist_invariants(IRFunc *f)
+{
+  fn = f;
+  nhoisted = 0;
+
+  int nloops;
+  Loop **loops = find_loops(fn, &nloops);
+  if (nloops == 0)
+    return;
+
+  bool changed = false;
+  for (int i = 0; i < nloops; i++)
+    if (!preheader_of(loops[i]) && add_preheader(fn, loops[i]))
+      changed = true;
+
+  if (changed)
+  {
+    build_cfg(fn);
+    build_dom_tree(fn);
+    loops = find_loops(fn, &nloops);
+  }
+
+  find_escaped();
+
+  // Inner loops come first, so an instruction hoisted into the
+  // preheader of an inner loop may be hoisted again from the outer.
+  for (int i = 0; i < nloops; i++)
+  {
+    BB *pre = preheader_of(loops[i]);
+    if (pre)
+      hoist(loops[i], pre);
+  }
+
+  count_stat("licm-hoisted", "exprs", nhoisted);
+}
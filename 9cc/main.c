@@ -1,12 +1,20 @@
 #include "9cc.h"
 
 static char *opt_o;
+static bool opt_emit_ir;
+static bool opt_pass_stats;
+static bool opt_peephole_stats;
 
 static char *input_path;
 
 static void usage(int status)
 {
-  fprintf(stderr, "9cc [ -o <path> ] <file>\n");
+  fprintf(stderr, "9cc [ -o <path> ] [ -O<level> ] [ -f<pass> ] [ -fno-<pass> ]\n"
+                  "    [ -fpeephole-window=<n> ] [ -fprefetch-distance=<n> ]\n"
+                  "    [ -fspecialize-budget=<n> ] [ -fconsteval-steps=<n> ] [ -mavx2 ]\n"
+                  "    [ -Rpass=<passes> ] [ -Rpass-missed=<passes> ] [ --pass-stats ]\n"
+                  "    [ --peephole-stats ] [ --emit-ir ] <file>\n");
+  print_passes(stderr);
   exit(status);
 }
 
@@ -25,6 +33,71 @@ static void parse_args(int argc, char **argv)
       continue;
     }
 
+    // -O is -O1, and levels above 3 are the same as -O3.
+    if (!strncmp(argv[i], "-O", 2))
+    {
+      char *end;
+      opt_level = argv[i][2] ? strtol(argv[i] + 2, &end, 10) : 1;
+      if (argv[i][2] && (*end || opt_level < 0))
+        error("invalid optimization level: %s", argv[i]);
+      opt_level = MIN(opt_level, 3);
+      continue;
+    }
+
+    if (!strncmp(argv[i], "-fpeephole-window=", 18))
+    {
+      opt_peephole_window = atoi(argv[i] + 18);
+      continue;
+    }
+
+    if (!strncmp(argv[i], "-fprefetch-distance=", 20))
+    {
+      opt_prefetch_distance = atoi(argv[i] + 20);
+      continue;
+    }
+
+    if (!strncmp(argv[i], "-fconsteval-steps=", 18))
+    {
+      opt_consteval_steps = atoi(argv[i] + 18);
+      continue;
+    }
+
+    if (!strncmp(argv[i], "-fspecialize-budget=", 20))
+    {
+      opt_specialize_budget = atoi(argv[i] + 20);
+      continue;
+    }
+
+    if (!strncmp(argv[i], "-f", 2) && set_pass_option(argv[i] + 2))
+      continue;
+
+    if (!strncmp(argv[i], "-R", 2) && set_remark_option(argv[i] + 2))
+      continue;
+
+    if (!strcmp(argv[i], "-mavx2"))
+    {
+      opt_avx2 = true;
+      continue;
+    }
+
+    if (!strcmp(argv[i], "--pass-stats"))
+    {
+      opt_pass_stats = true;
+      continue;
+    }
+
+    if (!strcmp(argv[i], "--peephole-stats"))
+    {
+      opt_peephole_stats = true;
+      continue;
+    }
+
+    if (!strcmp(argv[i], "--emit-ir"))
+    {
+      opt_emit_ir = true;
+      continue;
+    }
+
     if (!strncmp(argv[i], "-o", 2))
     {
       opt_o = argv[i] + 2;
@@ -58,8 +131,21 @@ int main(int argc, char **argv)
 
   Token *tok = tokenize_file(input_path);
   Obj *prog = parse(tok);
+  run_passes(prog, opt_emit_ir);
+
   FILE *out = open_file(opt_o);
+  if (opt_emit_ir)
+  {
+    dump_ir(prog, out);
+    return 0;
+  }
+
   fprintf(out, ".file 1 \"%s\"\n", input_path);
-  codegen(prog, out);
+  run_codegen(prog, out);
+
+  if (opt_pass_stats)
+    print_pass_stats(stderr);
+  if (opt_peephole_stats)
+    print_peephole_stats(stderr);
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,400 @@
+#include "9cc.h"
+
+//
+// Promotion of local variables to registers
+//
+// gen_ir() keeps every local variable in memory: a variable is read
+// with `load (lvar x)` and written with `store (lvar x), v`. Most
+// locals are scalars whose address never escapes, so those loads and
+// stores can be replaced with registers in SSA form.
+//
+// A variable is promotable if the address computed by its IR_LVAR is
+// only used directly as the address of loads, stores and zero-clears
+// of the whole variable. Taking the address with `&` or array decay makes the
+// address flow somewhere else, and such variables stay in memory.
+//
+// Existing code walks from the address of one scalar to its
+// neighbours in the stack frame (e.g. `*(&x+1)` to read y), so if the
+// address of any scalar goes through pointer arithmetic, directly or
+// after being stored to a pointer variable, we don't promote anything
+// in the function. An address that only escapes, e.g. to a function
+// that stores through it, keeps just its own variable in memory.
+//
+// We then construct SSA as in Cytron et al., "Efficiently Computing
+// Static Single Assignment Form and the Control Dependence Graph":
+// phis are placed at the iterated dominance frontier of the blocks
+// that store to a variable, and loads are renamed to the reaching
+// stored value by walking the dominator tree.
+//
+
+static IRFunc *fn;
+static Obj **vars;  // promotable variables
+static int nvars;
+static Reg ***stack; // reaching definitions per variable
+static int *depth;
+static BB ***children; // dominator tree, indexed by rpo number
+static int *nchildren;
+static Reg *zero;
+
+static int var_index(Obj *var)
+{
+  for (int i = 0; i < nvars; i++)
+    if (vars[i] == var)
+      return i;
+  return -1;
+}
+
+static bool is_scalar(Type *ty)
+{
+  return ty->kind != TY_ARRAY && ty->kind != TY_STRUCT && ty->kind != TY_UNION;
+}
+
+static void add_var(Obj *var)
+{
+  if (var_index(var) != -1)
+    return;
+  vars = realloc(vars, sizeof(Obj *) * (nvars + 1));
+  vars[nvars++] = var;
+}
+
+static void remove_var(Obj *var)
+{
+  int i = var_index(var);
+  if (i != -1)
+    vars[i] = vars[--nvars];
+}
+
+// Returns the variable whose address is held in `r`, if any.
+static Obj *lvar_of(Reg *r)
+{
+  if (r && r->def && r->def->op == IR_LVAR)
+    return r->def->var;
+  return NULL;
+}
+
+static bool is_access(IR *ir)
+{
+  return ir->op == IR_LOAD || ir->op == IR_STORE || ir->op == IR_MEMZERO;
+}
+
+// Returns true if pointer arithmetic is done on the address of a
+// scalar local. The address may first be stored to a variable and
+// loaded from it, so we track which registers and variables hold
+// such an address until nothing changes.
+static bool walks_frame(void)
+{
+  bool *addr = calloc(fn->nregs, sizeof(bool));
+  Obj **holders = NULL;
+  int nholders = 0;
+  bool walk = false;
+
+  for (bool changed = true; changed && !walk;)
+  {
+    changed = false;
+    for (BB *bb = fn->bbs; bb; bb = bb->next)
+    {
+      for (IR *ir = bb->first; ir; ir = ir->next)
+      {
+        bool a = ir->a && addr[ir->a->vn];
+        bool b = ir->b && addr[ir->b->vn];
+        Obj *var = lvar_of(ir->a);
+        bool val = false;
+
+        switch (ir->op)
+        {
+        case IR_LVAR:
+          val = is_scalar(ir->var->ty);
+          break;
+        case IR_COPY:
+          val = a;
+          break;
+        case IR_ADD:
+        case IR_SUB:
+          walk |= a || b;
+          break;
+        case IR_LOAD:
+          for (int i = 0; var && i < nholders; i++)
+            val |= (holders[i] == var);
+          break;
+        case IR_STORE:
+          if (!b)
+            break;
+          // Through any other pointer, the address may be anywhere.
+          if (!var)
+          {
+            walk = true;
+            break;
+          }
+          bool found = false;
+          for (int i = 0; i < nholders; i++)
+            found |= (holders[i] == var);
+          if (!found)
+          {
+            holders = realloc(holders, sizeof(Obj *) * (nholders + 1));
+            holders[nholders++] = var;
+            changed = true;
+          }
+          break;
+        }
+
+        if (ir->dst && val && !addr[ir->dst->vn])
+        {
+          addr[ir->dst->vn] = true;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  free(addr);
+  free(holders);
+  return walk;
+}
+
+static void find_promotable(void)
+{
+  nvars = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    for (IR *ir = bb->first; ir; ir = ir->next)
+      if (ir->op == IR_LVAR && is_scalar(ir->var->ty))
+        add_var(ir->var);
+
+  if (walks_frame())
+  {
+    nvars = 0;
+    return;
+  }
+
+  // Any use other than the address of a full-width load or store
+  // lets the address escape.
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      Obj *var = lvar_of(ir->a);
+      if (var && !(is_access(ir) && ir->size == var->ty->size))
+        remove_var(var);
+
+      remove_var(lvar_of(ir->b));
+      for (int i = 0; i < ir->nargs; i++)
+        remove_var(lvar_of(ir->args[i]));
+    }
+  }
+}
+
+static void insert_phis(void)
+{
+  BB **worklist = calloc(fn->nbbs, sizeof(BB *));
+  int *has_phi = calloc(fn->nbbs, sizeof(int));
+  int *queued = calloc(fn->nbbs, sizeof(int));
+
+  for (int v = 0; v < nvars; v++)
+  {
+    // Blocks are marked with v + 1 so that the arrays need not be
+    // cleared for each variable.
+    int n = 0;
+    for (BB *bb = fn->bbs; bb; bb = bb->next)
+    {
+      for (IR *ir = bb->first; ir; ir = ir->next)
+      {
+        if ((ir->op == IR_STORE || ir->op == IR_MEMZERO) &&
+            lvar_of(ir->a) == vars[v] && queued[bb->rpo] != v + 1)
+        {
+          queued[bb->rpo] = v + 1;
+          worklist[n++] = bb;
+        }
+      }
+    }
+
+    while (n > 0)
+    {
+      BB *bb = worklist[--n];
+      for (int i = 0; i < bb->ndf; i++)
+      {
+        BB *df = bb->df[i];
+        if (has_phi[df->rpo] == v + 1)
+          continue;
+        has_phi[df->rpo] = v + 1;
+
+        IR *ir = new_ir(IR_PHI, df->first->tok);
+        ir->var = vars[v];
+        ir->nargs = df->npreds;
+        ir->args = calloc(df->npreds, sizeof(Reg *));
+        ir->from = calloc(df->npreds, sizeof(BB *));
+        memcpy(ir->from, df->preds, sizeof(BB *) * df->npreds);
+        ir->dst = new_reg(fn);
+        ir->dst->def = ir;
+        insert_before(df->first, ir);
+
+        if (queued[df->rpo] != v + 1)
+        {
+          queued[df->rpo] = v + 1;
+          worklist[n++] = df;
+        }
+      }
+    }
+  }
+
+  free(worklist);
+  free(has_phi);
+  free(queued);
+}
+
+static void push(int v, Reg *r)
+{
+  stack[v] = realloc(stack[v], sizeof(Reg *) * (depth[v] + 1));
+  stack[v][depth[v]++] = r;
+}
+
+static Reg *top(int v)
+{
+  // A variable read before it is written may have any value.
+  if (depth[v] == 0)
+    return zero;
+  return stack[v][depth[v] - 1];
+}
+
+static Reg *resolve(Reg **map, Reg *r)
+{
+  while (r && map[r->vn])
+    r = map[r->vn];
+  return r;
+}
+
+// Returns the value a store leaves in its variable. A load of a char
+// or short variable sign-extends what was stored, so the stored value
+// is extended the same way. Like parameters in gen_ir(), ints need no
+// extension: the upper half of an int register is never used, and a
+// conversion to long is an explicit IR_SEXT.
+static Reg *truncate(IR *store)
+{
+  if (store->size >= 4)
+    return store->b;
+
+  IR *ir = new_ir(IR_SEXT, store->tok);
+  ir->a = store->b;
+  ir->size = store->size;
+  ir->dst = new_reg(fn);
+  ir->dst->def = ir;
+  insert_before(store, ir);
+  return ir->dst;
+}
+
+static void rename_vars(BB *bb, Reg **map)
+{
+  int *saved = calloc(nvars, sizeof(int));
+  memcpy(saved, depth, sizeof(int) * nvars);
+
+  for (IR *ir = bb->first; ir; ir = ir->next)
+  {
+    if (ir->op == IR_PHI)
+    {
+      int v = var_index(ir->var);
+      if (v != -1)
+        push(v, ir->dst);
+      continue;
+    }
+
+    ir->a = resolve(map, ir->a);
+    ir->b = resolve(map, ir->b);
+    for (int i = 0; i < ir->nargs; i++)
+      ir->args[i] = resolve(map, ir->args[i]);
+
+    int v = var_index(lvar_of(ir->a));
+    if (v == -1)
+      continue;
+
+    if (ir->op == IR_LOAD)
+    {
+      map[ir->dst->vn] = top(v);
+      remove_ir(ir);
+    }
+    else if (ir->op == IR_STORE)
+    {
+      push(v, truncate(ir));
+      remove_ir(ir);
+    }
+    else if (ir->op == IR_MEMZERO)
+    {
+      push(v, zero);
+      remove_ir(ir);
+    }
+  }
+
+  BB *succs[2];
+  int nsuccs = get_succs(bb, succs);
+  for (int i = 0; i < nsuccs; i++)
+  {
+    for (IR *ir = succs[i]->first; ir && ir->op == IR_PHI; ir = ir->next)
+    {
+      // Phis built by gen_ir() may use loads in this block that were
+      // just replaced.
+      int v = var_index(ir->var);
+      for (int j = 0; j < ir->nargs; j++)
+        if (ir->from[j] == bb)
+          ir->args[j] = (v == -1) ? resolve(map, ir->args[j]) : top(v);
+    }
+  }
+
+  for (int i = 0; i < nchildren[bb->rpo]; i++)
+    rename_vars(children[bb->rpo][i], map);
+
+  memcpy(depth, saved, sizeof(int) * nvars);
+  free(saved);
+}
+
+void mem2reg(IRFunc *f)
+{
+  fn = f;
+  find_promotable();
+  if (nvars == 0)
+    return;
+
+  insert_phis();
+
+  // This is removed as dead code if unused.
+  IR *ir = new_ir(IR_IMM, fn->bbs->last->tok);
+  zero = ir->dst = new_reg(fn);
+  zero->def = ir;
+  insert_before(fn->bbs->last, ir);
+
+  children = calloc(fn->nbbs, sizeof(BB **));
+  nchildren = calloc(fn->nbbs, sizeof(int));
+  for (int i = 1; i < fn->nbbs; i++)
+  {
+    BB *bb = fn->rpo[i];
+    int p = bb->idom->rpo;
+    children[p] = realloc(children[p], sizeof(BB *) * (nchildren[p] + 1));
+    children[p][nchildren[p]++] = bb;
+  }
+
+  stack = calloc(nvars, sizeof(Reg **));
+  depth = calloc(nvars, sizeof(int));
+  // Stores to chars and shorts add a register each.
+  int nstores = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    for (IR *ir = bb->first; ir; ir = ir->next)
+      if (ir->op == IR_STORE)
+        nstores++;
+  Reg **map = calloc(fn->nregs + nstores, sizeof(Reg *));
+  rename_vars(fn->rpo[0], map);
+
+  // The addresses of promoted variables are no longer used.
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    for (IR *ir = bb->first; ir; ir = ir->next)
+      if (ir->op == IR_LVAR && var_index(ir->var) != -1)
+        remove_ir(ir);
+
+  for (int i = 0; i < nvars; i++)
+  {
+    vars[i]->is_promoted = true;
+    free(stack[i]);
+  }
+  for (int i = 0; i < fn->nbbs; i++)
+    free(children[i]);
+  free(children);
+  free(nchildren);
+  free(stack);
+  free(depth);
+  free(map);
+}
@@ -0,0 +1,481 @@
+#include "9cc.h"
+
+//
+// AST-level optimizer
+//
+// This pass runs between the parser and the code generator. It folds
+// constant subtrees of ordinary code (the parser only evaluates
+// constant expressions where the language requires them), applies
+// simple algebraic identities and removes branches that can never be
+// taken.
+//
+
+static Node *fold_expr(Node *node);
+
+static Node *new_num(int64_t val, Node *orig)
+{
+  Node *node = calloc(1, sizeof(Node));
+  node->kind = ND_NUM;
+  node->tok = orig->tok;
+  node->ty = orig->ty;
+  node->val = val;
+  return node;
+}
+
+static Node *new_block(Token *tok)
+{
+  Node *node = calloc(1, sizeof(Node));
+  node->kind = ND_BLOCK;
+  node->tok = tok;
+  return node;
+}
+
+static bool is_num(Node *node, int64_t val)
+{
+  return node->kind == ND_NUM && node->val == val;
+}
+
+// Returns true if a value of this type can be represented by ND_NUM.
+static bool is_scalar(Type *ty)
+{
+  return is_integer(ty) || ty->kind == TY_PTR;
+}
+
+// Returns true if evaluating the node may modify memory or call
+// a function.
+bool has_side_effects(Node *node)
+{
+  if (!node)
+    return false;
+
+  switch (node->kind)
+  {
+  case ND_ASSIGN:
+  case ND_FUNCALL:
+  case ND_STMT_EXPR:
+  case ND_MEMZERO:
+  case ND_MEMSET:
+  case ND_MEMCPY:
+    return true;
+  }
+
+  return has_side_effects(node->lhs) || has_side_effects(node->rhs) ||
+         has_side_effects(node->cond) || has_side_effects(node->then) ||
+         has_side_effects(node->els);
+}
+
+// Returns true if a node contains a jump target. Such code cannot be
+// removed even if it is unreachable by fall-through.
+static bool has_label(Node *node)
+{
+  if (!node)
+    return false;
+
+  if (node->kind == ND_LABEL || node->kind == ND_CASE)
+    return true;
+
+  if (has_label(node->lhs) || has_label(node->rhs) || has_label(node->cond) ||
+      has_label(node->then) || has_label(node->els) || has_label(node->init) ||
+      has_label(node->inc))
+    return true;
+
+  for (Node *n = node->body; n; n = n->next)
+    if (has_label(n))
+      return true;
+  for (Node *n = node->args; n; n = n->next)
+    if (has_label(n))
+      return true;
+  return false;
+}
+
+// Arithmetic is done in 32 or 64 bits depending on the operand type.
+// An int-sized result is kept sign-extended so that it compares the
+// same way as the value the generated code would have in %eax.
+static int64_t wrap(Type *ty, int64_t val)
+{
+  if (ty->size == 8)
+    return val;
+  return (int32_t)val;
+}
+
+// Convert a value the same way the `cast()` in codegen does.
+static int64_t cast_val(Type *ty, int64_t val)
+{
+  if (ty->kind == TY_BOOL)
+    return val != 0;
+
+  switch (ty->size)
+  {
+  case 1:
+    return (int8_t)val;
+  case 2:
+    return (int16_t)val;
+  case 4:
+    return (int32_t)val;
+  }
+  return val;
+}
+
+static bool is_64bit(Type *ty)
+{
+  return ty->kind == TY_LONG || ty->base;
+}
+
+// Evaluate a binary operator whose operands are both numbers.
+// Returns false if the operation must be left to run time.
+static bool eval_binary(Node *node, int64_t *res)
+{
+  int64_t l = node->lhs->val;
+  int64_t r = node->rhs->val;
+  bool w = is_64bit(node->lhs->ty);
+
+  switch (node->kind)
+  {
+  case ND_ADD:
+    *res = (uint64_t)l + (uint64_t)r;
+    return true;
+  case ND_SUB:
+    *res = (uint64_t)l - (uint64_t)r;
+    return true;
+  case ND_MUL:
+    *res = (uint64_t)l * (uint64_t)r;
+    return true;
+  case ND_DIV:
+  case ND_MOD:
+    // Division by zero and INT_MIN / -1 trap at run time.
+    if (r == 0 || (r == -1 && l == (w ? INT64_MIN : INT32_MIN)))
+      return false;
+    *res = (node->kind == ND_DIV) ? l / r : l % r;
+    return true;
+  case ND_BITAND:
+    *res = l & r;
+    return true;
+  case ND_BITOR:
+    *res = l | r;
+    return true;
+  case ND_BITXOR:
+    *res = l ^ r;
+    return true;
+  case ND_SHL:
+    // x86 masks the shift count to the operand width.
+    if (w)
+      *res = (uint64_t)l << (r & 63);
+    else
+      *res = (int32_t)((uint32_t)l << (r & 31));
+    return true;
+  case ND_SHR:
+    if (w)
+      *res = l >> (r & 63);
+    else
+      *res = (int32_t)l >> (r & 31);
+    return true;
+  case ND_EQ:
+    *res = l == r;
+    return true;
+  case ND_NE:
+    *res = l != r;
+    return true;
+  case ND_LT:
+    *res = l < r;
+    return true;
+  case ND_LE:
+    *res = l <= r;
+    return true;
+  }
+  return false;
+}
+
+// `x op 0`, `x * 1` and the like. Only identities that leave the
+// type of the expression unchanged are applied.
+static Node *simplify(Node *node)
+{
+  Node *lhs = node->lhs;
+  Node *rhs = node->rhs;
+
+  switch (node->kind)
+  {
+  case ND_ADD:
+  case ND_BITOR:
+  case ND_BITXOR:
+    if (is_num(rhs, 0))
+      return lhs;
+    if (is_num(lhs, 0))
+      return rhs;
+    break;
+  case ND_SUB:
+  case ND_SHL:
+  case ND_SHR:
+    if (is_num(rhs, 0))
+      return lhs;
+    break;
+  case ND_MUL:
+    if (is_num(rhs, 1))
+      return lhs;
+    if (is_num(lhs, 1))
+      return rhs;
+    if ((is_num(rhs, 0) && !has_side_effects(lhs)) ||
+        (is_num(lhs, 0) && !has_side_effects(rhs)))
+      return new_num(0, node);
+    break;
+  case ND_DIV:
+    if (is_num(rhs, 1))
+      return lhs;
+    break;
+  case ND_BITAND:
+    if ((is_num(rhs, 0) && !has_side_effects(lhs)) ||
+        (is_num(lhs, 0) && !has_side_effects(rhs)))
+      return new_num(0, node);
+    break;
+  }
+  return node;
+}
+
+static bool same_repr(Type *t1, Type *t2)
+{
+  return t1->size == t2->size && is_scalar(t1) && is_scalar(t2);
+}
+
+// Convert a value to 0 or 1 like `!!x`.
+static Node *to_bool(Node *expr, Node *orig)
+{
+  Node *node = calloc(1, sizeof(Node));
+  node->kind = ND_NE;
+  node->tok = orig->tok;
+  node->lhs = expr;
+  node->rhs = new_num(0, orig);
+  node->rhs->ty = ty_int;
+  add_type(node);
+  return node;
+}
+
+static Node *fold_logical(Node *node)
+{
+  Node *lhs = node->lhs;
+  Node *rhs = node->rhs;
+
+  // For "&&", a zero operand decides the result; for "||" a non-zero
+  // operand does.
+  bool is_and = (node->kind == ND_LOGAND);
+
+  if (lhs->kind == ND_NUM)
+  {
+    if ((lhs->val == 0) == is_and)
+    {
+      if (has_label(rhs))
+        return node;
+      return new_num(!is_and, node);
+    }
+    if (rhs->kind == ND_NUM)
+      return new_num(rhs->val != 0, node);
+    return to_bool(rhs, node);
+  }
+
+  if (rhs->kind == ND_NUM && !has_side_effects(lhs))
+  {
+    if ((rhs->val == 0) == is_and)
+      return new_num(!is_and, node);
+  }
+  return node;
+}
+
+static void fold_list(Node **head, Node *(*fn)(Node *))
+{
+  for (Node **p = head; *p; p = &(*p)->next)
+  {
+    Node *next = (*p)->next;
+    *p = fn(*p);
+    (*p)->next = next;
+  }
+}
+
+static Node *fold_expr(Node *node)
+{
+  if (!node)
+    return NULL;
+
+  switch (node->kind)
+  {
+  case ND_NUM:
+  case ND_VAR:
+  case ND_NULL_EXPR:
+  case ND_MEMZERO:
+    return node;
+  case ND_STMT_EXPR:
+    fold_list(&node->body, fold_stmt);
+    return node;
+  case ND_FUNCALL:
+    fold_list(&node->args, fold_expr);
+    return node;
+  case ND_COND:
+  {
+    node->cond = fold_expr(node->cond);
+    node->then = fold_expr(node->then);
+    node->els = fold_expr(node->els);
+    if (node->cond->kind != ND_NUM)
+      return node;
+
+    Node *live = node->cond->val ? node->then : node->els;
+    Node *dead = node->cond->val ? node->els : node->then;
+    if (has_label(dead))
+      return node;
+    return live;
+  }
+  case ND_LOGAND:
+  case ND_LOGOR:
+    node->lhs = fold_expr(node->lhs);
+    node->rhs = fold_expr(node->rhs);
+    return fold_logical(node);
+  case ND_COMMA:
+    node->lhs = fold_expr(node->lhs);
+    node->rhs = fold_expr(node->rhs);
+    if (!has_side_effects(node->lhs) && !has_label(node->lhs))
+      return node->rhs;
+    return node;
+  }
+
+  node->lhs = fold_expr(node->lhs);
+  node->rhs = fold_expr(node->rhs);
+
+  if (!node->ty || !is_scalar(node->ty))
+    return node;
+
+  Node *lhs = node->lhs;
+  Node *rhs = node->rhs;
+
+  switch (node->kind)
+  {
+  case ND_NEG:
+    if (lhs->kind == ND_NUM)
+      return new_num(wrap(node->ty, -(uint64_t)lhs->val), node);
+    return node;
+  case ND_BITNOT:
+    if (lhs->kind == ND_NUM)
+      return new_num(wrap(node->ty, ~lhs->val), node);
+    return node;
+  case ND_NOT:
+    if (lhs->kind == ND_NUM)
+      return new_num(!lhs->val, node);
+    return node;
+  case ND_CAST:
+    if (lhs->kind == ND_NUM)
+      return new_num(cast_val(node->ty, lhs->val), node);
+    return node;
+  case ND_ADD:
+  case ND_SUB:
+  case ND_MUL:
+  case ND_DIV:
+  case ND_MOD:
+  case ND_BITAND:
+  case ND_BITOR:
+  case ND_BITXOR:
+  case ND_SHL:
+  case ND_SHR:
+  case ND_EQ:
+  case ND_NE:
+  case ND_LT:
+  case ND_LE:
+  {
+    int64_t val;
+    if (lhs->kind == ND_NUM && rhs->kind == ND_NUM && eval_binary(node, &val))
+      return new_num(wrap(node->ty, val), node);
+
+    Node *res = simplify(node);
+    if (res != node && !same_repr(res->ty, node->ty))
+      return node;
+    return res;
+  }
+  }
+  return node;
+}
+
+// Returns true if control never falls through the end of a statement.
+static bool is_jump(Node *node)
+{
+  return node->kind == ND_RETURN || node->kind == ND_GOTO;
+}
+
+static Node *fold_block(Node *node)
+{
+  fold_list(&node->body, fold_stmt);
+
+  // Statements that follow an unconditional jump are dead unless
+  // something jumps into them.
+  for (Node *n = node->body; n; n = n->next)
+  {
+    if (!is_jump(n))
+      continue;
+    while (n->next && !has_label(n->next))
+      n->next = n->next->next;
+  }
+  return node;
+}
+
+Node *fold_stmt(Node *node)
+{
+  switch (node->kind)
+  {
+  case ND_IF:
+  {
+    node->cond = fold_expr(node->cond);
+    node->then = fold_stmt(node->then);
+    if (node->els)
+      node->els = fold_stmt(node->els);
+    if (node->cond->kind != ND_NUM)
+      return node;
+
+    Node *live = node->cond->val ? node->then : node->els;
+    Node *dead = node->cond->val ? node->els : node->then;
+    if (has_label(dead))
+      return node;
+    return live ? live : new_block(node->tok);
+  }
+  case ND_FOR:
+    if (node->init)
+      node->init = fold_stmt(node->init);
+    node->cond = fold_expr(node->cond);
+    node->inc = fold_expr(node->inc);
+    node->then = fold_stmt(node->then);
+    if (node->cond && node->cond->kind == ND_NUM)
+    {
+      if (node->cond->val)
+        node->cond = NULL;
+      else if (!has_label(node->then))
+        return node->init ? node->init : new_block(node->tok);
+    }
+    return node;
+  case ND_DO:
+    node->then = fold_stmt(node->then);
+    node->cond = fold_expr(node->cond);
+    return node;
+  case ND_SWITCH:
+    node->cond = fold_expr(node->cond);
+    node->then = fold_stmt(node->then);
+    return node;
+  case ND_CASE:
+  case ND_LABEL:
+    // These nodes are referenced from the switch and goto lists,
+    // so they are updated in place.
+    node->lhs = fold_stmt(node->lhs);
+    return node;
+  case ND_BLOCK:
+    return fold_block(node);
+  case ND_RETURN:
+  case ND_EXPR_STMT:
+    node->lhs = fold_expr(node->lhs);
+    return node;
+  case ND_MEMSET:
+  case ND_MEMCPY:
+    node->lhs = fold_expr(node->lhs);
+    node->rhs = fold_expr(node->rhs);
+    node->cond = fold_expr(node->cond);
+    return node;
+  }
+  return node;
+}
+
+void optimize(Obj *prog)
+{
+  for (Obj *fn = prog; fn; fn = fn->next)
+    if (fn->is_function && fn->is_definition)
+      fn->body = fold_stmt(fn->body);
+}
@@ -44,6 +44,9 @@ typedef struct
   bool is_typedef;
   bool is_static;
   bool is_extern;
+  bool is_inline;
+  bool always_inline;
+  bool noinline;
   int align;
 } VarAttr;
 
@@ -98,8 +101,13 @@ static char *cont_label;
 // a switch statement. Otherwise, NULL.
 static Node *current_switch;
 
+// True while the initializer of a global variable is evaluated, where
+// function calls are allowed.
+static bool in_gvar_init;
+
 static bool is_typename(Token *tok);
 static Type *declspec(Token **rest, Token *tok, VarAttr *attr);
+static Token *attribute_list(Token *tok, VarAttr *attr);
 static Type *type_suffix(Token **rest, Token *tok, Type *ty);
 static Type *declarator(Token **rest, Token *tok, Type *ty);
 static Type *typename(Token **rest, Token *tok);
@@ -830,13 +838,18 @@ write_gvar_data(Relocation *cur, Initializer *init, Type *ty, char *buf, int off
 // embedded to .data section. This function serializes Initializer
 // objects to a flat byte array. It is a compile error if an
 // initializer list contains a non-constant expression.
+//
+// Calls of functions defined earlier in the file are evaluated by the
+// interpreter in consteval.c.
 static void gvar_initializer(Token **rest, Token *tok, Obj *var)
 {
   Initializer *init = initializer(rest, tok, var->ty, &var->ty);
 
   Relocation head = {};
   char *buf = calloc(1, var->ty->size);
+  in_gvar_init = true;
   write_gvar_data(&head, init, var->ty, buf, 0);
+  in_gvar_init = false;
   var->init_data = buf;
   var->rel = head.next;
 }
@@ -859,6 +872,9 @@ static bool is_typename(Token *tok)
       "extern",
       "_Alignas",
       "signed",
+      "inline",
+      "const",
+      "__attribute__",
   };
 
   for (int i = 0; i < sizeof(kw) / sizeof(*kw); i++)
@@ -872,7 +888,7 @@ static bool is_typename(Token *tok)
   ;
 }
 
-static char *new_unique_name(void)
+char *new_unique_name(void)
 {
   static int id = 0;
   return format(".L..%d", id++);
@@ -1541,6 +1557,18 @@ static Node *to_assign(Node *binary)
   add_type(binary->rhs);
   Token *tok = binary->tok;
 
+  // `x op= y` to `x = x op y` if x is a variable, which is evaluated
+  // twice without side effects. This keeps the address of x from
+  // being taken.
+  if (binary->lhs->kind == ND_VAR)
+  {
+    Obj *var = binary->lhs->var;
+    return new_binary(ND_ASSIGN, binary->lhs,
+                      new_binary(binary->kind, new_var_node(var, tok),
+                                 binary->rhs, tok),
+                      tok);
+  }
+
   Obj *var = new_lvar("", pointer_to(binary->lhs->ty));
 
   Node *expr1 = new_binary(ND_ASSIGN, new_var_node(var, tok),
@@ -1788,11 +1816,11 @@ static int64_t eval2(Node *node, char **label)
       switch (node->ty->size)
       {
       case 1:
-        return (uint8_t)val;
+        return (int8_t)val;
       case 2:
-        return (uint16_t)val;
+        return (int16_t)val;
       case 4:
-        return (uint32_t)val;
+        return (int32_t)val;
       }
     }
     return val;
@@ -1814,6 +1842,17 @@ static int64_t eval2(Node *node, char **label)
     return 0;
   case ND_NUM:
     return node->val;
+  case ND_FUNCALL:
+  {
+    if (!in_gvar_init)
+      break;
+    int64_t val;
+    char *why;
+    if (!eval_funcall(node, globals, true, &val, &why))
+      error_tok(node->tok, "call to '%s' cannot be evaluated at compile time: it %s",
+                node->funcname, why);
+    return val;
+  }
   }
 
   error_tok(node->tok, "not a compile-time constant");
@@ -1843,6 +1882,39 @@ static int64_t const_expr(Token **rest, Token *tok)
   return eval(node);
 }
 
+// Returns the unroll hint of a "#pragma unroll" before a loop:
+//
+//   #pragma unroll          fully unroll (-1)
+//   #pragma unroll N        unroll N times; also unroll(N) and
+//   #pragma GCC unroll N    GCC's spelling
+//   #pragma nounroll        don't unroll (1)
+static int loop_pragma(Token *tok)
+{
+  char *p = tok->pragma;
+  if (!p)
+    return 0;
+
+  while (isspace(*p))
+    p++;
+  if (!strncmp(p, "GCC", 3) && isspace(p[3]))
+    p += 4;
+  while (isspace(*p))
+    p++;
+
+  if (!strncmp(p, "nounroll", 8))
+    return 1;
+  if (strncmp(p, "unroll", 6) || isalnum(p[6]) || p[6] == '_')
+    return 0;
+
+  p += 6;
+  while (isspace(*p) || *p == '(')
+    p++;
+  if (!isdigit(*p))
+    return -1;
+  int n = strtol(p, &p, 10);
+  return MAX(n, 1);
+}
+
 // stmt = "return" expr? ";"
 //      | "if" "(" expr ")" stmt ("else" stmt)?
 //      | "switch" "(" expr ")" stmt
@@ -1939,6 +2011,7 @@ static Node *stmt(Token **rest, Token *tok)
   if (equal(tok, "for"))
   {
     Node *node = new_node(ND_FOR, tok);
+    node->unroll = loop_pragma(tok);
     tok = skip(tok->next, "(");
 
     enter_scope();
@@ -1975,6 +2048,7 @@ static Node *stmt(Token **rest, Token *tok)
   if (equal(tok, "while"))
   {
     Node *node = new_node(ND_FOR, tok);
+    node->unroll = loop_pragma(tok);
     tok = skip(tok->next, "(");
     node->cond = expr(&tok, tok);
     tok = skip(tok, ")");
@@ -1991,6 +2065,7 @@ static Node *stmt(Token **rest, Token *tok)
 
   if (equal(tok, "do")) {
     Node *node = new_node(ND_DO, tok);
+    node->unroll = loop_pragma(tok);
 
     char *brk = brk_label;
     char *cont = cont_label;
@@ -2111,7 +2186,55 @@ static Type *enum_specifier(Token **rest, Token *tok)
   return ty;
 }
 
-// declspec = ("void" | "_Bool" | "char" | "short" | "int" | "long" | struct-decl | union-decl | typedef | "static" | "extern" | typedef-name | enum-specifier | "signed")+
+// attribute-list = ("__attribute__" "(" "(" (attribute ("," attribute)*)? ")" ")")*
+// attribute = ident ("(" ... ")")?
+//
+// always_inline and noinline are recorded in `attr`. Other attributes
+// are ignored.
+
+static Token *attribute_list(Token *tok, VarAttr *attr)
+{
+  while (consume(&tok, tok, "__attribute__"))
+  {
+    tok = skip(tok, "(");
+    tok = skip(tok, "(");
+
+    bool first = true;
+    while (!consume(&tok, tok, ")"))
+    {
+      if (!first)
+        tok = skip(tok, ",");
+      first = false;
+
+      if (tok->kind != TK_IDENT && tok->kind != TK_KEYWORD)
+        error_tok(tok, "expected an attribute name");
+      if (attr && (equal(tok, "always_inline") || equal(tok, "__always_inline__")))
+        attr->always_inline = true;
+      if (attr && (equal(tok, "noinline") || equal(tok, "__noinline__")))
+        attr->noinline = true;
+      tok = tok->next;
+
+      if (equal(tok, "("))
+      {
+        int depth = 0;
+        do
+        {
+          if (tok->kind == TK_EOF)
+            error_tok(tok, "unterminated attribute");
+          if (equal(tok, "("))
+            depth++;
+          else if (equal(tok, ")"))
+            depth--;
+          tok = tok->next;
+        } while (depth > 0);
+      }
+    }
+    tok = skip(tok, ")");
+  }
+  return tok;
+}
+
+// declspec = ("void" | "_Bool" | "char" | "short" | "int" | "long" | struct-decl | union-decl | typedef | "static" | "extern" | "inline" | attribute-list | typedef-name | enum-specifier | "signed" | "const")+
 //
 // The order of typenames in a type-specifier doesn't matter. For
 // example, `int long static` means the same as `static long int`.
@@ -2169,6 +2292,28 @@ static Type *declspec(Token **rest, Token *tok, VarAttr *attr)
       continue;
     }
 
+    if (equal(tok, "inline"))
+    {
+      if (!attr)
+        error_tok(tok, "inline is not allowed in this context");
+      attr->is_inline = true;
+      tok = tok->next;
+      continue;
+    }
+
+    if (equal(tok, "__attribute__"))
+    {
+      tok = attribute_list(tok, attr);
+      continue;
+    }
+
+    // The "const" qualifier is accepted and ignored.
+    if (equal(tok, "const"))
+    {
+      tok = tok->next;
+      continue;
+    }
+
     if (equal(tok, "_Alignas"))
     {
       if (!attr)
@@ -2358,12 +2503,16 @@ static Type *type_suffix(Token **rest, Token *tok, Type *ty)
 }
 
 // declarator = "*"* ident type-suffix
-// declarator = "*"* ("(" ident ")" | "(" declarator ")" | ident) type-suffix
+// declarator = ("*" "const"*)* ("(" ident ")" | "(" declarator ")" | ident) type-suffix
 
 static Type *declarator(Token **rest, Token *tok, Type *ty)
 {
   while (consume(&tok, tok, "*"))
+  {
     ty = pointer_to(ty);
+    while (consume(&tok, tok, "const"))
+      ;
+  }
 
   if (equal(tok, "("))
   {
@@ -2382,7 +2531,7 @@ static Type *declarator(Token **rest, Token *tok, Type *ty)
   return ty;
 }
 
-// abstract-declarator = "*"* ("(" abstract-declarator ")")? type-suffix
+// abstract-declarator = ("*" "const"*)* ("(" abstract-declarator ")")? type-suffix
 
 static Type *abstract_declarator(Token **rest, Token *tok, Type *ty)
 {
@@ -2390,6 +2539,8 @@ static Type *abstract_declarator(Token **rest, Token *tok, Type *ty)
   {
     ty = pointer_to(ty);
     tok = tok->next;
+    while (consume(&tok, tok, "const"))
+      ;
   }
 
   if (equal(tok, "("))
@@ -2521,10 +2672,14 @@ static void create_param_lvars(Type *param)
 static Token *function(Token *tok, Type *basety, VarAttr *attr)
 {
   Type *ty = declarator(&tok, tok, basety);
+  tok = attribute_list(tok, attr);
   Obj *fn = new_gvar(get_ident(ty->name), ty);
   fn->is_function = true;
   fn->is_definition = !consume(&tok, tok, ";");
   fn->is_static = attr->is_static;
+  fn->is_inline = attr->is_inline;
+  fn->always_inline = attr->always_inline;
+  fn->noinline = attr->noinline;
   if (!fn->is_definition)
     return tok;
 
@@ -0,0 +1,356 @@
+#include "9cc.h"
+#include <time.h>
+
+//
+// Pass manager
+//
+// Optimization passes are registered in the table below with the
+// lowest -O level that enables them. -f<name> and -fno-<name> turn a
+// single pass on or off regardless of the level, which is also how
+// to find the pass that miscompiles a program.
+//
+// AST passes run over the whole program and IR passes over each
+// function. Codegen passes change how codegen() emits code, so they
+// are flags rather than functions. A pass may have both, when the
+// same optimization is done in the IR and in codegen().
+//
+
+int opt_level = 1;
+
+// Whether functions are compiled through the IR
+static bool opt_ir;
+
+typedef enum
+{
+  PASS_AST,
+  PASS_IR,
+  PASS_CODEGEN,
+} PassKind;
+
+typedef struct
+{
+  char *name;
+  PassKind kind;
+  int level; // lowest -O level that enables the pass
+  void (*run_ast)(Obj *prog);
+  void (*run_ir)(IRFunc *fn);
+  bool *flag;
+  int force; // 1 for -f<name>, -1 for -fno-<name>
+} Pass;
+
+static Pass passes[] = {
+    {"consteval", PASS_AST, 1, .run_ast = fold_const_calls},
+    {"inline", PASS_AST, 1, .run_ast = inline_functions},
+    {"specialize", PASS_AST, 2, .run_ast = specialize_functions},
+    {"tail-calls", PASS_AST, 1, .run_ast = eliminate_tail_calls},
+    {"fold", PASS_AST, 1, .run_ast = optimize},
+    {"loop-idiom", PASS_AST, 1, .run_ast = replace_idioms},
+    {"vectorize", PASS_AST, 2, .run_ast = vectorize},
+    {"unroll", PASS_AST, 1, .run_ast = unroll_loops},
+    {"ir", PASS_CODEGEN, 2, .flag = &opt_ir},
+    {"mem2reg", PASS_IR, 1, .run_ir = mem2reg},
+    {"iropt", PASS_IR, 1, .run_ir = optimize_ir},
+    {"licm", PASS_IR, 1, .run_ir = hoist_invariants},
+    {"ivopts", PASS_IR, 1, .run_ir = optimize_ivs},
+    {"prefetch-loop-arrays", PASS_IR, 3, .run_ir = insert_prefetches},
+    {"ext", PASS_IR, 1, .run_ir = eliminate_exts, .flag = &opt_ext},
+    {"ipa-ra", PASS_CODEGEN, 2, .flag = &opt_ipa_ra},
+    {"tree-regs", PASS_CODEGEN, 1, .flag = &opt_tree_regs},
+    {"isel", PASS_CODEGEN, 1, .flag = &opt_isel},
+    {"strength-reduce", PASS_CODEGEN, 1, .flag = &opt_strength_reduce},
+    {"branch-fusion", PASS_CODEGEN, 1, .flag = &opt_branch_fusion},
+    {"branchless", PASS_CODEGEN, 1, .flag = &opt_branchless},
+    {"loop-rotate", PASS_CODEGEN, 1, .flag = &opt_loop_rotate},
+    {"align-loops", PASS_CODEGEN, 2, .flag = &opt_align_loops},
+    {"peephole", PASS_CODEGEN, 1, .flag = &opt_peephole},
+};
+
+#define NUM_PASSES (sizeof(passes) / sizeof(*passes))
+
+static bool is_enabled(Pass *pass)
+{
+  if (pass->force)
+    return pass->force > 0;
+  return opt_level >= pass->level;
+}
+
+// Handles -f<name> and -fno-<name>. `arg` is the part after "-f".
+bool set_pass_option(char *arg)
+{
+  bool on = strncmp(arg, "no-", 3);
+  if (!on)
+    arg += 3;
+
+  for (int i = 0; i < NUM_PASSES; i++)
+  {
+    if (!strcmp(passes[i].name, arg))
+    {
+      passes[i].force = on ? 1 : -1;
+      return true;
+    }
+  }
+  return false;
+}
+
+void print_passes(FILE *out)
+{
+  fprintf(out, "passes:");
+  for (int i = 0; i < NUM_PASSES; i++)
+    fprintf(out, " %s (-O%d)", passes[i].name, passes[i].level);
+  fprintf(out, "\n");
+}
+
+//
+// Optimization remarks
+//
+// -Rpass=<names> reports what the named passes did, and
+// -Rpass-missed=<names> what they tried to do but didn't and why,
+// like the clang options of the same names. <names> is a
+// comma-separated list of pass names, or "all".
+//
+
+static char *remark_passes;
+static char *missed_passes;
+
+// Handles -Rpass= and -Rpass-missed=. `arg` is the part after "-R".
+bool set_remark_option(char *arg)
+{
+  if (!strncmp(arg, "pass=", 5))
+  {
+    remark_passes = arg + 5;
+    return true;
+  }
+  if (!strncmp(arg, "pass-missed=", 12))
+  {
+    missed_passes = arg + 12;
+    return true;
+  }
+  return false;
+}
+
+static bool in_list(char *list, char *name)
+{
+  if (!list)
+    return false;
+  if (!strcmp(list, "all"))
+    return true;
+
+  int len = strlen(name);
+  for (char *p = list; p; p = strchr(p, ','))
+  {
+    if (*p == ',')
+      p++;
+    if (!strncmp(p, name, len) && (p[len] == ',' || p[len] == '\0'))
+      return true;
+  }
+  return false;
+}
+
+static void vremark(char *list, char *option, char *pass, Token *tok, char *fmt,
+                    va_list ap)
+{
+  if (!in_list(list, pass))
+    return;
+  char *msg;
+  size_t len;
+  FILE *out = open_memstream(&msg, &len);
+  vfprintf(out, fmt, ap);
+  fclose(out);
+  note_tok(tok, "remark", "%s [-R%s=%s]", msg, option, pass);
+  free(msg);
+}
+
+void remark(char *pass, Token *tok, char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vremark(remark_passes, "pass", pass, tok, fmt, ap);
+  va_end(ap);
+}
+
+void remark_missed(char *pass, Token *tok, char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vremark(missed_passes, "pass-missed", pass, tok, fmt, ap);
+  va_end(ap);
+}
+
+//
+// Statistics
+//
+
+typedef struct
+{
+  char *name;
+  char *unit;
+  double time;
+  long before;
+  long after;
+} Stat;
+
+static Stat *stats;
+static int nstats;
+
+double get_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Adds to the statistics of a pass. IR passes run once per function,
+// so their numbers are summed.
+static void record(char *name, char *unit, double time, long before, long after)
+{
+  Stat *st = NULL;
+  for (int i = 0; i < nstats; i++)
+    if (!strcmp(stats[i].name, name))
+      st = &stats[i];
+
+  if (!st)
+  {
+    stats = realloc(stats, sizeof(Stat) * (nstats + 1));
+    st = &stats[nstats++];
+    *st = (Stat){name, unit};
+  }
+  st->time += time;
+  st->before += before;
+  st->after += after;
+}
+
+// Adds `n` to a number that a pass reports in the statistics, such as
+// the number of instructions it moved.
+void count_stat(char *name, char *unit, long n)
+{
+  record(name, unit, 0, -1, n);
+}
+
+static long count_nodes(Node *node)
+{
+  if (!node)
+    return 0;
+
+  long n = 1;
+  n += count_nodes(node->lhs) + count_nodes(node->rhs);
+  n += count_nodes(node->cond) + count_nodes(node->then) + count_nodes(node->els);
+  n += count_nodes(node->init) + count_nodes(node->inc);
+  for (Node *n2 = node->body; n2; n2 = n2->next)
+    n += count_nodes(n2);
+  for (Node *arg = node->args; arg; arg = arg->next)
+    n += count_nodes(arg);
+  return n;
+}
+
+static long count_ast(Obj *prog)
+{
+  long n = 0;
+  for (Obj *fn = prog; fn; fn = fn->next)
+    if (fn->is_function && fn->is_definition)
+      n += count_nodes(fn->body);
+  return n;
+}
+
+static long count_ir(IRFunc *fn)
+{
+  long n = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    for (IR *ir = bb->first; ir; ir = ir->next)
+      n++;
+  return n;
+}
+
+static void run_ir_pass(char *name, void (*run)(IRFunc *fn), IRFunc *fn)
+{
+  long before = count_ir(fn);
+  double start = get_time();
+  run(fn);
+  record(name, "ir", get_time() - start, before, count_ir(fn));
+}
+
+void print_pass_stats(FILE *out)
+{
+  double total = 0;
+  fprintf(out, "%-12s %10s %10s %10s  %s\n", "pass", "time(ms)", "before", "after", "unit");
+  for (int i = 0; i < nstats; i++)
+  {
+    Stat *st = &stats[i];
+    fprintf(out, "%-12s %10.3f ", st->name, st->time * 1000);
+    if (st->before < 0)
+      fprintf(out, "%10s", "-");
+    else
+      fprintf(out, "%10ld", st->before);
+    fprintf(out, " %10ld  %s\n", st->after, st->unit);
+    total += st->time;
+  }
+  fprintf(out, "%-12s %10.3f\n", "total", total * 1000);
+}
+
+//
+// Pipeline
+//
+
+// Runs the AST passes, and lowers functions to the IR and optimizes
+// them if the IR is enabled or `need_ir` is true.
+void run_passes(Obj *prog, bool need_ir)
+{
+  for (int i = 0; i < NUM_PASSES; i++)
+  {
+    Pass *pass = &passes[i];
+    if (pass->flag)
+      *pass->flag = is_enabled(pass);
+  }
+
+  for (int i = 0; i < NUM_PASSES; i++)
+  {
+    Pass *pass = &passes[i];
+    if (pass->kind != PASS_AST || !is_enabled(pass))
+      continue;
+    long before = count_ast(prog);
+    double start = get_time();
+    pass->run_ast(prog);
+    record(pass->name, "nodes", get_time() - start, before, count_ast(prog));
+  }
+
+  if (!opt_ir && !need_ir)
+    return;
+
+  for (Obj *fn = prog; fn; fn = fn->next)
+  {
+    if (!fn->is_function || !fn->is_definition)
+      continue;
+
+    double start = get_time();
+    fn->ir = gen_ir(fn);
+    record("gen-ir", "ir", get_time() - start, -1, count_ir(fn->ir));
+
+    for (int i = 0; i < NUM_PASSES; i++)
+      if (passes[i].kind == PASS_IR && is_enabled(&passes[i]))
+        run_ir_pass(passes[i].name, passes[i].run_ir, fn->ir);
+  }
+}
+
+// Takes functions out of SSA, allocates registers and emits assembly.
+void run_codegen(Obj *prog, FILE *out)
+{
+  for (Obj *fn = prog; fn; fn = fn->next)
+    if (fn->ir)
+      run_ir_pass("leave-ssa", leave_ssa, fn->ir);
+
+  // Callees are allocated before their callers.
+  int n;
+  IRFunc **funcs = regalloc_order(prog, &n);
+  for (int i = 0; i < n; i++)
+    run_ir_pass("regalloc", alloc_regs, funcs[i]);
+
+  double start = get_time();
+  codegen(prog, out);
+  double time = get_time() - start;
+
+  double peephole_time;
+  long insns_in, insns_out;
+  get_peephole_stats(&peephole_time, &insns_in, &insns_out);
+  record("codegen", "insns", time - peephole_time, -1, insns_in);
+  if (opt_peephole)
+    record("peephole", "insns", peephole_time, insns_in, insns_out);
+}
@@ -0,0 +1,592 @@
+#include "9cc.h"
+
+//
+// Peephole optimizer
+//
+// codegen.c prints assembly one line at a time. While a function is
+// being generated, the lines are parsed into instructions and kept
+// here instead. At the end of the function, we slide a window of a few
+// instructions over the buffer, rewrite wasteful patterns and then
+// print the result.
+//
+
+bool opt_peephole = true;
+int opt_peephole_window = 4;
+
+typedef enum
+{
+  OPD_REG,
+  OPD_IMM,
+  OPD_MEM,
+  OPD_SYM,
+} OperandKind;
+
+typedef struct
+{
+  OperandKind kind;
+  int reg;  // REG_*, or one of the two below
+  int size; // register size
+  int64_t imm;
+  char *text;
+} Operand;
+
+#define REG_RSP NUM_REGS
+#define REG_RBP (NUM_REGS + 1)
+
+typedef enum
+{
+  INST_INSN,
+  INST_LABEL,
+  INST_DIRECTIVE,
+} InstKind;
+
+typedef struct
+{
+  InstKind kind;
+  char *op;
+  Operand opds[3];
+  int nopds;
+  char *text; // the original line, or NULL if rewritten
+  bool deleted;
+} Inst;
+
+static Inst *insts;
+static int ninsts;
+static int capacity;
+
+// Statistics for --pass-stats
+static double total_time;
+static long insns_in;
+static long insns_out;
+
+static char *regnames[][NUM_REGS + 2] = {
+    {"al", "cl", "dl", "sil", "dil", "r8b", "r9b", "r10b",
+     "r11b", "bl", "r12b", "r13b", "r14b", "r15b", "spl", "bpl"},
+    {"ax", "cx", "dx", "si", "di", "r8w", "r9w", "r10w",
+     "r11w", "bx", "r12w", "r13w", "r14w", "r15w", "sp", "bp"},
+    {"eax", "ecx", "edx", "esi", "edi", "r8d", "r9d", "r10d",
+     "r11d", "ebx", "r12d", "r13d", "r14d", "r15d", "esp", "ebp"},
+    {"rax", "rcx", "rdx", "rsi", "rdi", "r8", "r9", "r10",
+     "r11", "rbx", "r12", "r13", "r14", "r15", "rsp", "rbp"},
+};
+
+//
+// Parser
+//
+
+static bool parse_reg(char *s, int len, int *reg, int *size)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    for (int j = 0; j < NUM_REGS + 2; j++)
+    {
+      if (strlen(regnames[i][j]) == len && !strncmp(regnames[i][j], s, len))
+      {
+        *reg = j;
+        *size = 1 << i;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static void parse_operand(Operand *opd, char *s)
+{
+  opd->text = s;
+
+  if (strchr(s, '['))
+  {
+    opd->kind = OPD_MEM;
+    return;
+  }
+
+  if (parse_reg(s, strlen(s), &opd->reg, &opd->size))
+  {
+    opd->kind = OPD_REG;
+    return;
+  }
+
+  char *end;
+  int64_t val = strtoll(s, &end, 10);
+  if (*s && !*end)
+  {
+    opd->kind = OPD_IMM;
+    opd->imm = val;
+    return;
+  }
+
+  opd->kind = OPD_SYM;
+}
+
+static char *trim(char *s)
+{
+  while (*s == ' ')
+    s++;
+  char *end = s + strlen(s);
+  while (end > s && end[-1] == ' ')
+    *--end = '\0';
+  return s;
+}
+
+static void parse_line(Inst *inst, char *line)
+{
+  memset(inst, 0, sizeof(Inst));
+  inst->text = line;
+
+  char *s = trim(strdup(line));
+  if (*s == '.' && !strchr(s, ':'))
+  {
+    inst->kind = INST_DIRECTIVE;
+    return;
+  }
+  if (s[strlen(s) - 1] == ':')
+  {
+    inst->kind = INST_LABEL;
+    inst->op = strndup(s, strlen(s) - 1);
+    return;
+  }
+
+  inst->kind = INST_INSN;
+  char *p = strchr(s, ' ');
+  if (!p)
+  {
+    inst->op = s;
+    return;
+  }
+  *p = '\0';
+  inst->op = s;
+
+  // Operands are separated by commas. There are no commas inside
+  // memory operands in our output.
+  for (char *opd = strtok(p + 1, ","); opd && inst->nopds < 3; opd = strtok(NULL, ","))
+    parse_operand(&inst->opds[inst->nopds++], trim(opd));
+}
+
+//
+// Helpers for rules
+//
+
+static bool is_insn(Inst *inst, char *op)
+{
+  return inst->kind == INST_INSN && !strcmp(inst->op, op);
+}
+
+static bool is_reg(Operand *opd, int reg)
+{
+  return opd->kind == OPD_REG && opd->reg == reg;
+}
+
+static bool is_jcc(Inst *inst)
+{
+  return inst->kind == INST_INSN && inst->op[0] == 'j' && strcmp(inst->op, "jmp");
+}
+
+static bool is_branch(Inst *inst)
+{
+  return inst->kind == INST_INSN && (inst->op[0] == 'j' || !strcmp(inst->op, "ret"));
+}
+
+// Returns the index of the n'th instruction after i, skipping deleted
+// ones and directives, or -1 if it is beyond the window or the end of
+// the function.
+static int next(int i, int n)
+{
+  int seen = 0;
+  for (int j = i + 1; j < ninsts; j++)
+  {
+    if (insts[j].deleted || insts[j].kind == INST_DIRECTIVE)
+      continue;
+    if (++seen > opt_peephole_window)
+      return -1;
+    if (seen == n)
+      return j;
+  }
+  return -1;
+}
+
+// Instructions that read or write registers that don't appear in
+// their operands
+static bool has_implicit_regs(Inst *inst)
+{
+  static char *ops[] = {"call", "idiv", "div", "mul", "cqo", "cdq", "rep",
+                        "ret",  "leave", "push", "pop"};
+  for (int i = 0; i < sizeof(ops) / sizeof(*ops); i++)
+    if (!strcmp(inst->op, ops[i]))
+      return true;
+
+  // One-operand imul multiplies by %rax into %rdx:%rax.
+  return !strcmp(inst->op, "imul") && inst->nopds == 1;
+}
+
+// Returns true if the instruction may read or write any part of `reg`.
+static bool mentions(Inst *inst, int reg)
+{
+  if (inst->kind != INST_INSN || has_implicit_regs(inst))
+    return true;
+
+  for (int i = 0; i < inst->nopds; i++)
+  {
+    Operand *opd = &inst->opds[i];
+    if (is_reg(opd, reg))
+      return true;
+    if (opd->kind != OPD_MEM)
+      continue;
+
+    for (char *p = opd->text; *p;)
+    {
+      if (!isalnum(*p))
+      {
+        p++;
+        continue;
+      }
+      char *q = p;
+      while (isalnum(*q))
+        q++;
+      int r, size;
+      if (parse_reg(p, q - p, &r, &size) && r == reg)
+        return true;
+      p = q;
+    }
+  }
+  return false;
+}
+
+static void set_reg(Operand *opd, int reg, int size)
+{
+  opd->kind = OPD_REG;
+  opd->reg = reg;
+  opd->size = size;
+  opd->text = regnames[size == 8 ? 3 : size == 4 ? 2 : size == 2 ? 1 : 0][reg];
+}
+
+static void rewrite(Inst *inst, char *op)
+{
+  inst->op = op;
+  inst->text = NULL;
+}
+
+static bool is_zero_to(Inst *inst, int reg)
+{
+  if (is_insn(inst, "mov") && is_reg(&inst->opds[0], reg) &&
+      inst->opds[1].kind == OPD_IMM && inst->opds[1].imm == 0)
+    return true;
+  return is_insn(inst, "xor") && is_reg(&inst->opds[0], reg) &&
+         is_reg(&inst->opds[1], reg);
+}
+
+//
+// Rules
+//
+// Each rule looks at the instruction at index i and those following
+// it in the window. It returns true if it changed something.
+//
+
+static Obj *program;
+
+// push %a; ...; pop %b  =>  mov %b, %a; ...
+//
+// The instructions in between must not touch %b or the stack.
+static bool push_pop(int i)
+{
+  Inst *push = &insts[i];
+  if (!is_insn(push, "push") || push->opds[0].kind != OPD_REG)
+    return false;
+
+  int j;
+  for (int n = 1;; n++)
+  {
+    j = next(i, n);
+    if (j == -1 || insts[j].kind != INST_INSN)
+      return false;
+    if (is_insn(&insts[j], "pop"))
+      break;
+    if (is_branch(&insts[j]) || mentions(&insts[j], REG_RSP))
+      return false;
+  }
+
+  Inst *pop = &insts[j];
+  if (pop->opds[0].kind != OPD_REG)
+    return false;
+  int a = push->opds[0].reg;
+  int b = pop->opds[0].reg;
+
+  for (int k = i + 1; k < j; k++)
+    if (!insts[k].deleted && insts[k].kind != INST_DIRECTIVE && mentions(&insts[k], b))
+      return false;
+
+  pop->deleted = true;
+  if (a == b)
+  {
+    push->deleted = true;
+    return true;
+  }
+  rewrite(push, "mov");
+  push->nopds = 2;
+  set_reg(&push->opds[0], b, 8);
+  set_reg(&push->opds[1], a, 8);
+  return true;
+}
+
+static bool is_variadic(char *name)
+{
+  for (Obj *fn = program; fn; fn = fn->next)
+    if (fn->is_function && !strcmp(fn->name, name))
+      return fn->ty->is_variadic;
+  return true;
+}
+
+// %al tells a variadic function how many vector registers are used
+// to pass arguments. Other functions don't need it, whether they are
+// called or jumped to by a tail call.
+static bool zero_al(int i)
+{
+  if (!is_zero_to(&insts[i], REG_RAX))
+    return false;
+
+  for (int n = 1;; n++)
+  {
+    int j = next(i, n);
+    if (j == -1 || insts[j].kind != INST_INSN)
+      return false;
+    if (is_insn(&insts[j], "call") || is_insn(&insts[j], "jmp"))
+    {
+      Operand *callee = &insts[j].opds[0];
+      if (callee->kind != OPD_SYM || is_variadic(callee->text))
+        return false;
+      insts[i].deleted = true;
+      return true;
+    }
+    if (mentions(&insts[j], REG_RAX) || is_branch(&insts[j]))
+      return false;
+  }
+}
+
+static char *invert_cond(char *cc)
+{
+  static char *pairs[][2] = {
+      {"e", "ne"}, {"l", "ge"}, {"le", "g"}, {"b", "ae"}, {"be", "a"},
+  };
+  for (int i = 0; i < sizeof(pairs) / sizeof(*pairs); i++)
+  {
+    if (!strcmp(cc, pairs[i][0]))
+      return pairs[i][1];
+    if (!strcmp(cc, pairs[i][1]))
+      return pairs[i][0];
+  }
+  return NULL;
+}
+
+// setCC %r; movzx %r, %r; cmp %r, 0; je L  =>  setCC %r; movzx %r, %r; jNCC L
+//
+// setcc and movzx don't change the flags, so the branch can use the
+// ones the setcc consumed.
+static bool setcc_branch(int i)
+{
+  Inst *set = &insts[i];
+  if (set->kind != INST_INSN || strncmp(set->op, "set", 3) || set->opds[0].kind != OPD_REG)
+    return false;
+  int reg = set->opds[0].reg;
+
+  int j = next(i, 1);
+  int k = next(i, 2);
+  int l = next(i, 3);
+  if (j == -1 || k == -1 || l == -1)
+    return false;
+
+  Inst *ext = &insts[j];
+  Inst *cmp = &insts[k];
+  Inst *br = &insts[l];
+  if (!(is_insn(ext, "movzx") || is_insn(ext, "movzb")) ||
+      !is_reg(&ext->opds[0], reg) || !is_reg(&ext->opds[1], reg))
+    return false;
+  if (!is_insn(cmp, "cmp") || !is_reg(&cmp->opds[0], reg) ||
+      cmp->opds[1].kind != OPD_IMM || cmp->opds[1].imm != 0)
+    return false;
+  if (!is_insn(br, "je") && !is_insn(br, "jne"))
+    return false;
+
+  char *cc = set->op + 3;
+  if (is_insn(br, "je"))
+    cc = invert_cond(cc);
+  if (!cc)
+    return false;
+
+  cmp->deleted = true;
+  rewrite(br, format("j%s", cc));
+  return true;
+}
+
+// jmp L; L:  =>  L:
+static bool jump_to_next(int i)
+{
+  Inst *jmp = &insts[i];
+  if (!(is_insn(jmp, "jmp") || is_jcc(jmp)) || jmp->opds[0].kind != OPD_SYM)
+    return false;
+
+  for (int j = i + 1; j < ninsts; j++)
+  {
+    Inst *inst = &insts[j];
+    if (inst->deleted || inst->kind == INST_DIRECTIVE)
+      continue;
+    if (inst->kind != INST_LABEL)
+      return false;
+    if (!strcmp(inst->op, jmp->opds[0].text))
+    {
+      jmp->deleted = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if the flags are overwritten before they are read.
+static bool flags_dead(int i)
+{
+  static char *writers[] = {"cmp", "test", "add", "sub", "and", "or", "xor",
+                            "neg", "imul", "idiv", "call"};
+
+  for (int n = 1;; n++)
+  {
+    int j = next(i, n);
+    if (j == -1)
+      return false;
+    Inst *inst = &insts[j];
+    if (inst->kind != INST_INSN || is_branch(inst))
+      return false;
+    if (!strncmp(inst->op, "set", 3) || !strncmp(inst->op, "cmov", 4) ||
+        !strcmp(inst->op, "adc") || !strcmp(inst->op, "sbb"))
+      return false;
+    for (int k = 0; k < sizeof(writers) / sizeof(*writers); k++)
+      if (!strcmp(inst->op, writers[k]))
+        return true;
+  }
+}
+
+// mov %r64, imm  =>  mov %r32, imm     if 0 <= imm < 2^32
+// mov %r, 0      =>  xor %r32, %r32    if the flags are dead
+//
+// Writing a 32-bit register clears the upper half, and the 32-bit
+// forms are shorter.
+static bool short_imm(int i)
+{
+  Inst *mov = &insts[i];
+  if (!is_insn(mov, "mov") || mov->opds[0].kind != OPD_REG ||
+      mov->opds[1].kind != OPD_IMM)
+    return false;
+
+  Operand *dst = &mov->opds[0];
+  int64_t val = mov->opds[1].imm;
+
+  if (val == 0 && dst->size >= 4 && flags_dead(i))
+  {
+    rewrite(mov, "xor");
+    set_reg(&mov->opds[0], dst->reg, 4);
+    set_reg(&mov->opds[1], dst->reg, 4);
+    return true;
+  }
+
+  if (dst->size == 8 && 0 <= val && val <= UINT32_MAX)
+  {
+    mov->text = NULL;
+    set_reg(dst, dst->reg, 4);
+    return true;
+  }
+  return false;
+}
+
+typedef struct
+{
+  char *name;
+  bool (*fn)(int i);
+  int count;
+} Rule;
+
+static Rule rules[] = {
+    {"push-pop", push_pop},
+    {"zero-al", zero_al},
+    {"setcc-branch", setcc_branch},
+    {"jump-to-next", jump_to_next},
+    {"short-imm", short_imm},
+};
+
+#define NUM_RULES (sizeof(rules) / sizeof(*rules))
+
+//
+// Interface to codegen.c
+//
+
+void peephole_add(char *line)
+{
+  if (ninsts == capacity)
+  {
+    capacity = capacity ? capacity * 2 : 256;
+    insts = realloc(insts, sizeof(Inst) * capacity);
+  }
+  parse_line(&insts[ninsts++], line);
+}
+
+static void print_inst(Inst *inst, FILE *out)
+{
+  if (inst->text)
+  {
+    fprintf(out, "%s\n", inst->text);
+    return;
+  }
+
+  fprintf(out, "  %s", inst->op);
+  for (int i = 0; i < inst->nopds; i++)
+    fprintf(out, "%s%s", i ? ", " : " ", inst->opds[i].text);
+  fprintf(out, "\n");
+}
+
+// Optimize the buffered instructions and print them.
+void peephole_flush(Obj *prog, FILE *out)
+{
+  double start = get_time();
+  program = prog;
+
+  for (int i = 0; i < ninsts; i++)
+    if (insts[i].kind == INST_INSN)
+      insns_in++;
+
+  for (bool changed = opt_peephole; changed && opt_peephole_window > 0;)
+  {
+    changed = false;
+    for (int i = 0; i < ninsts; i++)
+    {
+      for (int r = 0; r < NUM_RULES && !insts[i].deleted; r++)
+      {
+        if (rules[r].fn(i))
+        {
+          rules[r].count++;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < ninsts; i++)
+  {
+    if (insts[i].deleted)
+      continue;
+    if (insts[i].kind == INST_INSN)
+      insns_out++;
+    print_inst(&insts[i], out);
+  }
+  ninsts = 0;
+  total_time += get_time() - start;
+}
+
+void get_peephole_stats(double *time, long *before, long *after)
+{
+  *time = total_time;
+  *before = insns_in;
+  *after = insns_out;
+}
+
+void print_peephole_stats(FILE *out)
+{
+  for (int i = 0; i < NUM_RULES; i++)
+    fprintf(out, "peephole: %-14s %d\n", rules[i].name, rules[i].count);
+}
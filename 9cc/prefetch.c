@@ -0,0 +1,237 @@
+#include "9cc.h"
+
+//
+// Software prefetching
+//
+// A loop that walks a large array with a stride of a cache line or
+// more misses the cache on every iteration, and out-of-order execution
+// can only overlap a few of the misses with the work of the loop. If
+// the walk goes through a pointer induction variable
+//
+//   p = phi [p0, preheader], [p', latch]
+//   ... = load p + off
+//   p' = add p, step
+//
+// (array indexing becomes one in ivopts), we know where the loop will
+// be n iterations later, and prefetch that line:
+//
+//   prefetch p + off + n * step
+//
+// n is chosen so that the prefetch is issued about
+// -fprefetch-distance=<n> IR instructions before the load, which
+// should cover the memory latency.
+//
+// Strides smaller than a cache line are left to the hardware
+// prefetcher, which follows sequential streams well and would only be
+// slowed down by a prefetch in every iteration. Streams that are only
+// read and jump at least a page per iteration use prefetchnta, since
+// their lines are not going to be needed again; others use
+// prefetcht0.
+//
+// Since prefetches never fault, this is safe even when the loop ends
+// long before the prefetched address.
+//
+
+#define CACHE_LINE 64
+#define PAGE_SIZE 4096
+
+// Maximum number of prefetches added to a loop
+#define MAX_PREFETCHES 8
+
+int opt_prefetch_distance = 800;
+
+// A pointer induction variable that addresses memory in the loop
+typedef struct
+{
+  IR *phi;
+  IR *inc; // p' = add p, step
+  int64_t step;
+  int64_t offs[MAX_PREFETCHES]; // offsets of the lines to prefetch
+  int noffs;
+  bool has_store;
+  Token *tok; // the first access, for remarks
+} Stream;
+
+static IRFunc *fn;
+static Loop *loop;
+static BB *pre;
+
+static int nprefetches;
+
+static bool is_imm(Reg *r)
+{
+  return r && r->def && r->def->op == IR_IMM;
+}
+
+static bool fits(int64_t val)
+{
+  return val == (int32_t)val;
+}
+
+static bool is_innermost(Loop **loops, int nloops)
+{
+  for (int i = 0; i < nloops; i++)
+    if (loops[i] != loop && in_loop(loop, loops[i]->head))
+      return false;
+  return true;
+}
+
+static bool match_stream(IR *phi, Stream *s)
+{
+  if (phi->nargs != 2 || (phi->from[0] != pre && phi->from[1] != pre))
+    return false;
+
+  Reg *next = (phi->from[0] == pre) ? phi->args[1] : phi->args[0];
+  IR *inc = next->def;
+  if (!inc || !in_loop(loop, inc->bb) || inc->size != 8)
+    return false;
+
+  if (inc->op == IR_ADD && inc->a == phi->dst && is_imm(inc->b))
+    s->step = inc->b->def->imm;
+  else if (inc->op == IR_ADD && inc->b == phi->dst && is_imm(inc->a))
+    s->step = inc->a->def->imm;
+  else if (inc->op == IR_SUB && inc->a == phi->dst && is_imm(inc->b))
+    s->step = -inc->b->def->imm;
+  else
+    return false;
+
+  s->phi = phi;
+  s->inc = inc;
+  s->noffs = 0;
+  s->has_store = false;
+  s->tok = NULL;
+  return s->step != 0;
+}
+
+// Returns true if `r` is p + off for a stream pointer p.
+static bool match_addr(Stream *s, Reg *r, int64_t *off)
+{
+  if (r == s->phi->dst)
+  {
+    *off = 0;
+    return true;
+  }
+  if (r == s->inc->dst)
+  {
+    *off = s->step;
+    return true;
+  }
+
+  IR *ir = r->def;
+  if (!ir || ir->op != IR_ADD || ir->size != 8)
+    return false;
+  if (ir->a == s->phi->dst && is_imm(ir->b))
+    *off = ir->b->def->imm;
+  else if (ir->b == s->phi->dst && is_imm(ir->a))
+    *off = ir->a->def->imm;
+  else
+    return false;
+  return true;
+}
+
+// Records an access at `off` from the stream pointer, unless a line
+// that is already prefetched covers it.
+static void add_access(Stream *s, IR *ir, int64_t off)
+{
+  if (!s->tok)
+    s->tok = ir->tok;
+  if (ir->op == IR_STORE || ir->op == IR_VSTORE)
+    s->has_store = true;
+
+  for (int i = 0; i < s->noffs; i++)
+    if (s->offs[i] - CACHE_LINE < off && off < s->offs[i] + CACHE_LINE)
+      return;
+  if (s->noffs < MAX_PREFETCHES)
+    s->offs[s->noffs++] = off;
+}
+
+static void find_accesses(Stream *s)
+{
+  for (int i = 0; i < loop->nbbs; i++)
+  {
+    for (IR *ir = loop->bbs[i]->first; ir; ir = ir->next)
+    {
+      int64_t off;
+      if ((ir->op == IR_LOAD || ir->op == IR_STORE || ir->op == IR_VLOAD ||
+           ir->op == IR_VSTORE) && match_addr(s, ir->a, &off))
+        add_access(s, ir, off);
+    }
+  }
+}
+
+static int loop_size(void)
+{
+  int n = 0;
+  for (int i = 0; i < loop->nbbs; i++)
+    for (IR *ir = loop->bbs[i]->first; ir; ir = ir->next)
+      n++;
+  return n;
+}
+
+static void prefetch_stream(Stream *s, int iters)
+{
+  int64_t step = s->step < 0 ? -s->step : s->step;
+  if (step < CACHE_LINE)
+  {
+    remark_missed("prefetch-loop-arrays", s->tok,
+                  "stride of %ld bytes is left to the hardware prefetcher", step);
+    return;
+  }
+
+  int64_t ahead = s->step * iters;
+  int locality = (!s->has_store && step >= PAGE_SIZE) ? 0 : 3;
+
+  for (int i = 0; i < s->noffs && nprefetches < MAX_PREFETCHES; i++)
+  {
+    if (!fits(s->offs[i] + ahead))
+      continue;
+
+    // The increment runs in every iteration that goes back to the
+    // header.
+    IR *ir = new_ir(IR_PREFETCH, s->tok);
+    ir->a = s->phi->dst;
+    ir->imm = s->offs[i] + ahead;
+    ir->size = locality;
+    insert_before(s->inc, ir);
+    nprefetches++;
+  }
+
+  remark("prefetch-loop-arrays", s->tok, "prefetching %d iterations (%ld bytes) ahead",
+         iters, ahead < 0 ? -ahead : ahead);
+}
+
+static void prefetch_loop(void)
+{
+  int iters = MAX(1, (opt_prefetch_distance + loop_size() - 1) / loop_size());
+  nprefetches = 0;
+
+  for (IR *ir = loop->head->first; ir && ir->op == IR_PHI; ir = ir->next)
+  {
+    Stream s;
+    if (!match_stream(ir, &s))
+      continue;
+    find_accesses(&s);
+    if (s.noffs > 0)
+      prefetch_stream(&s, iters);
+  }
+}
+
+void insert_prefetches(IRFunc *f)
+{
+  fn = f;
+
+  int nloops;
+  Loop **loops = find_loops(fn, &nloops);
+  long total = 0;
+
+  for (int i = 0; i < nloops; i++)
+  {
+    loop = loops[i];
+    pre = preheader_of(loop);
+    if (!pre || !is_innermost(loops, nloops))
+      continue;
+    prefetch_loop();
+    total += nprefetches;
+  }
+  count_stat("prefetches", "insns", total);
+}
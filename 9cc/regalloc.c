@@ -0,0 +1,629 @@
+#include "9cc.h"
+
+//
+// Linear scan register allocator
+//
+// This file maps the virtual registers of a function, which has been
+// converted out of SSA form, to the 14 general-purpose registers of
+// x86-64 (every register but %rsp and %rbp). We use the algorithm from
+// Poletto and Sarkar, "Linear Scan Register Allocation".
+//
+// Instructions are numbered in the order they are emitted. Instruction
+// i reads its operands at position 2i and writes its result at 2i+1,
+// so that a register whose last use is at i can be reused for the
+// result of i. The live interval of a virtual register is the range
+// from its first definition to its last use, widened to cover whole
+// blocks it is live into or out of.
+//
+// Some instructions need specific physical registers (e.g. idiv uses
+// %rax and %rdx, and a call destroys every caller-saved register).
+// Intervals that overlap such an instruction are not allowed to use
+// those registers, so the code generator is free to clobber them.
+//
+// If we run out of registers, the interval that ends last is spilled
+// to a stack slot. Every use of a spilled register is then rewritten
+// to read a fresh short-lived register reloaded from the slot, and
+// every definition to write one that is stored to the slot, after
+// which allocation starts over. Since the new registers live across
+// only one instruction, this terminates quickly.
+//
+
+#define CALLER_SAVED ((1 << REG_RBX) - 1)
+
+typedef struct
+{
+  Reg *reg;
+  int start;
+  int end;
+  int forbidden; // bitmask of registers the interval cannot use
+  int prefer;    // preferred physical register, or -1
+
+  // If the register is computed from `hint` and the two intervals
+  // don't overlap, we try to give them the same physical register.
+  Reg *hint;
+} Interval;
+
+// Registers an instruction needs for itself. Intervals overlapping
+// positions lo..hi cannot use them, or, if `across` is true, only
+// intervals that contain that range.
+typedef struct
+{
+  int lo;
+  int hi;
+  int regs;
+  bool across;
+} Clobber;
+
+// Registers in the order we try them. Caller-saved registers don't
+// need to be saved in the prologue, so they come first. %rax, %rcx
+// and %rdx are tried late because idiv and shifts need them.
+static int order[] = {
+    REG_R10, REG_R11, REG_R9, REG_R8, REG_RSI, REG_RDI, REG_RDX,
+    REG_RCX, REG_RAX, REG_RBX, REG_R12, REG_R13, REG_R14, REG_R15,
+};
+
+static Obj *new_slot(IRFunc *fn)
+{
+  Obj *var = calloc(1, sizeof(Obj));
+  var->name = "";
+  var->ty = ty_long;
+  var->align = 8;
+  var->is_local = true;
+  var->next = fn->obj->locals;
+  fn->obj->locals = var;
+  return var;
+}
+
+static bool is_use(IR *ir, Reg *r)
+{
+  if (ir->a == r || ir->b == r)
+    return true;
+  for (int i = 0; i < ir->nargs; i++)
+    if (ir->args[i] == r)
+      return true;
+  return false;
+}
+
+static int argreg[] = {REG_RDI, REG_RSI, REG_RDX, REG_RCX, REG_R8, REG_R9};
+
+static void get_clobber(IR *ir, int pos, Clobber *c)
+{
+  c->lo = pos * 2;
+  c->hi = pos * 2 + 1;
+  c->regs = 0;
+  c->across = false;
+
+  switch (ir->op)
+  {
+  case IR_DIV:
+  case IR_MOD:
+    c->regs = (1 << REG_RAX) | (1 << REG_RDX);
+    return;
+  case IR_SHL:
+  case IR_SAR:
+  case IR_MEMCPY:
+    c->regs = 1 << REG_RCX;
+    return;
+  case IR_MEMZERO:
+    c->regs = (1 << REG_RAX) | (1 << REG_RCX) | (1 << REG_RDI);
+    return;
+  case IR_MEMSET:
+  case IR_MEMCOPY:
+  case IR_STRLEN:
+    // See "Block operations" in codegen.c.
+    c->regs = (1 << REG_RAX) | (1 << REG_RCX) | (1 << REG_RDX) | (1 << REG_RSI) |
+              (1 << REG_RDI);
+    return;
+  case IR_CALL:
+    // Arguments are moved to the argument registers and the result
+    // is moved from %rax by the call sequence itself.
+    c->regs = call_clobbers(ir);
+    c->across = true;
+    return;
+  case IR_PARAM:
+    // The parameter stays in its argument register until this point.
+    c->lo = 0;
+    c->hi = pos * 2 - 1;
+    c->regs = (ir->imm < 6) ? 1 << argreg[ir->imm] : 0;
+    return;
+  }
+}
+
+static int func_clobbers(IRFunc *fn);
+
+static void extend(Interval *iv, int pos)
+{
+  if (!iv->reg)
+    return;
+  iv->start = MIN(iv->start, pos);
+  iv->end = MAX(iv->end, pos);
+}
+
+static int cmp_start(const void *x, const void *y)
+{
+  Interval *a = *(Interval **)x;
+  Interval *b = *(Interval **)y;
+  if (a->start != b->start)
+    return a->start - b->start;
+  return a->reg->vn - b->reg->vn;
+}
+
+static int pick_reg(Interval *iv, Interval *ivs, int used)
+{
+  int avail = ~(used | iv->forbidden) & ((1 << NUM_REGS) - 1);
+
+  Reg *h = iv->hint;
+  if (h && h->rn >= 0 && ivs[h->vn].end <= iv->start && (avail & (1 << h->rn)))
+    return h->rn;
+  if (iv->prefer >= 0 && (avail & (1 << iv->prefer)))
+    return iv->prefer;
+
+  for (int i = 0; i < NUM_REGS; i++)
+    if (avail & (1 << order[i]))
+      return order[i];
+  return -1;
+}
+
+// Run linear scan once. Returns the number of registers spilled and
+// stores them to `spills`.
+static int scan(IRFunc *fn, Reg **spills)
+{
+  compute_liveness(fn);
+
+  int nregs = fn->nregs;
+  Interval *ivs = calloc(nregs, sizeof(Interval));
+  for (int i = 0; i < nregs; i++)
+  {
+    ivs[i].start = INT_MAX;
+    ivs[i].end = -1;
+    ivs[i].prefer = -1;
+  }
+
+  int ninsts = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+    for (IR *ir = bb->first; ir; ir = ir->next)
+      ninsts++;
+  Clobber *clobbers = calloc(ninsts, sizeof(Clobber));
+  int nclobbers = 0;
+
+  // Build live intervals.
+  int pos = 0;
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    int first = pos;
+    for (IR *ir = bb->first; ir; ir = ir->next, pos++)
+    {
+      Reg *uses[2] = {ir->a, ir->b};
+      for (int j = 0; j < 2 + ir->nargs; j++)
+      {
+        Reg *r = (j < 2) ? uses[j] : ir->args[j - 2];
+        if (!r)
+          continue;
+        ivs[r->vn].reg = r;
+        extend(&ivs[r->vn], pos * 2);
+      }
+      if (ir->dst)
+      {
+        ivs[ir->dst->vn].reg = ir->dst;
+        extend(&ivs[ir->dst->vn], pos * 2 + 1);
+      }
+
+      // Parameters of a function with the private convention arrive
+      // in the registers we assign them here, so they are live from
+      // the entry on.
+      if (ir->op == IR_PARAM && fn->is_private)
+      {
+        extend(&ivs[ir->dst->vn], 0);
+        continue;
+      }
+
+      Clobber *c = &clobbers[nclobbers];
+      get_clobber(ir, pos, c);
+      if (c->regs)
+        nclobbers++;
+    }
+
+    for (int i = 0; i < nregs; i++)
+    {
+      if (bs_test(bb->live_in, i))
+        extend(&ivs[i], first * 2);
+      if (bs_test(bb->live_out, i))
+        extend(&ivs[i], pos * 2 - 1);
+    }
+  }
+
+  // Apply register constraints.
+  for (int i = 0; i < nregs; i++)
+  {
+    Interval *iv = &ivs[i];
+    if (!iv->reg)
+      continue;
+
+    for (int j = 0; j < nclobbers; j++)
+    {
+      Clobber *c = &clobbers[j];
+      if (c->across ? (iv->start < c->lo && c->hi < iv->end)
+                    : (iv->start <= c->hi && c->lo <= iv->end))
+        iv->forbidden |= c->regs;
+    }
+  }
+
+  // Prefer the register of the source operand for copies and
+  // two-address instructions, so that no move is needed. Likewise
+  // for values that arrive in fixed registers.
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      if (!ir->dst)
+        continue;
+      if (ir->op == IR_PARAM && ir->imm < 6)
+        ivs[ir->dst->vn].prefer = argreg[ir->imm];
+      else if (ir->op == IR_CALL)
+        ivs[ir->dst->vn].prefer = REG_RAX;
+      else if (ir->a && ir->op != IR_LOAD)
+        ivs[ir->dst->vn].hint = ir->a;
+    }
+  }
+
+  Interval **sorted = calloc(nregs, sizeof(Interval *));
+  int n = 0;
+  for (int i = 0; i < nregs; i++)
+    if (ivs[i].reg)
+      sorted[n++] = &ivs[i];
+  qsort(sorted, n, sizeof(Interval *), cmp_start);
+
+  Interval *active[NUM_REGS];
+  int nactive = 0;
+  int nspills = 0;
+
+  for (int i = 0; i < n; i++)
+  {
+    Interval *cur = sorted[i];
+
+    // Expire intervals that ended before this one starts.
+    int j = 0;
+    for (int k = 0; k < nactive; k++)
+      if (active[k]->end >= cur->start)
+        active[j++] = active[k];
+    nactive = j;
+
+    int used = 0;
+    for (int k = 0; k < nactive; k++)
+      used |= 1 << active[k]->reg->rn;
+
+    int rn = pick_reg(cur, ivs, used);
+    if (rn >= 0)
+    {
+      cur->reg->rn = rn;
+      active[nactive++] = cur;
+      continue;
+    }
+
+    // No register is free. Spill whichever of the current interval
+    // and the active ones it could take a register from ends last.
+    Interval *victim = NULL;
+    int vk = -1;
+    for (int k = 0; k < nactive; k++)
+    {
+      Interval *iv = active[k];
+      if (iv->reg->unspillable || (cur->forbidden & (1 << iv->reg->rn)))
+        continue;
+      if (!victim || victim->end < iv->end)
+      {
+        victim = iv;
+        vk = k;
+      }
+    }
+
+    if (victim && (cur->reg->unspillable || victim->end > cur->end))
+    {
+      cur->reg->rn = victim->reg->rn;
+      victim->reg->rn = -1;
+      active[vk] = cur;
+      spills[nspills++] = victim->reg;
+      continue;
+    }
+
+    if (cur->reg->unspillable)
+      unreachable();
+    spills[nspills++] = cur->reg;
+  }
+
+  free(ivs);
+  free(clobbers);
+  free(sorted);
+  return nspills;
+}
+
+// Rewrite every use and definition of a spilled register to go
+// through its stack slot.
+static void spill(IRFunc *fn, Reg *r)
+{
+  Obj *slot = new_slot(fn);
+
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      if (is_use(ir, r))
+      {
+        Reg *tmp = new_reg(fn);
+        tmp->unspillable = true;
+
+        IR *reload = new_ir(IR_RELOAD, ir->tok);
+        reload->dst = tmp;
+        reload->var = slot;
+        tmp->def = reload;
+        insert_before(ir, reload);
+
+        if (ir->a == r)
+          ir->a = tmp;
+        if (ir->b == r)
+          ir->b = tmp;
+        for (int i = 0; i < ir->nargs; i++)
+          if (ir->args[i] == r)
+            ir->args[i] = tmp;
+      }
+
+      if (ir->dst == r)
+      {
+        Reg *tmp = new_reg(fn);
+        tmp->unspillable = true;
+        tmp->def = ir;
+        ir->dst = tmp;
+
+        IR *save = new_ir(IR_SPILL, ir->tok);
+        save->a = tmp;
+        save->var = slot;
+        insert_before(ir->next, save);
+        ir = save;
+      }
+    }
+  }
+}
+
+void alloc_regs(IRFunc *fn)
+{
+  for (;;)
+  {
+    for (int i = 0; i < fn->nregs; i++)
+      fn->regs[i]->rn = -1;
+
+    Reg **spills = calloc(fn->nregs, sizeof(Reg *));
+    int nspills = scan(fn, spills);
+    for (int i = 0; i < nspills; i++)
+      spill(fn, spills[i]);
+    free(spills);
+    if (nspills == 0)
+      break;
+  }
+
+  // Give each callee-saved register we use a slot to save it in. That
+  // includes those we pass arguments of private functions in.
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      int regs = ir->dst ? 1 << ir->dst->rn : 0;
+      if (ir->op == IR_CALL)
+        regs |= call_clobbers(ir);
+
+      for (int rn = REG_RBX; rn < NUM_REGS; rn++)
+        if ((regs & (1 << rn)) && !fn->save_slot[rn])
+          fn->save_slot[rn] = new_slot(fn);
+
+      // A struct that comes back in registers is stored to a slot.
+      IRFunc *callee = (ir->op == IR_CALL) ? private_callee(ir) : NULL;
+      if (callee && ret_in_regs(callee))
+      {
+        ir->var = new_slot(fn);
+        ir->var->ty = array_of(ty_long, 2);
+      }
+    }
+  }
+
+  if (fn->is_private)
+  {
+    for (int i = 0; i < 6; i++)
+      fn->param_reg[i] = -1;
+    for (IR *ir = fn->bbs->first; ir; ir = ir->next)
+      if (ir->op == IR_PARAM)
+        fn->param_reg[ir->imm] = ir->dst->rn;
+  }
+
+  if (opt_ipa_ra && fn->obj->is_static)
+  {
+    fn->clobbers = func_clobbers(fn);
+    fn->has_clobbers = true;
+  }
+}
+
+//
+// Interprocedural register allocation
+//
+// Without knowing what a callee does, a call has to be assumed to
+// change every caller-saved register, so values that live across it
+// must be in callee-saved registers, which cost a save and a restore,
+// or on the stack. With -fipa-ra, functions are allocated callees
+// first, and a call of a static function only clobbers the registers
+// it and its own callees actually write. The caller can keep values in
+// the others.
+//
+// A static function whose address is never taken is only called
+// directly from this file, so it uses a private calling convention as
+// well: each parameter arrives in the register the allocator picked
+// for it in the callee, so it never has to move, and an unused
+// parameter is not passed at all. Small structs are returned in %rax
+// and %rdx instead of by address. Functions in a recursive cycle are
+// called before they are allocated, so the ones that are called that
+// way keep the standard convention.
+//
+
+bool opt_ipa_ra = true;
+
+static IRFunc **funcs;
+static int nfuncs;
+
+static IRFunc **postorder;
+static int npostorder;
+static char *state; // 0: not visited, 1: being visited, 2: done
+
+static int find_func(char *name)
+{
+  for (int i = 0; i < nfuncs; i++)
+    if (!strcmp(funcs[i]->obj->name, name))
+      return i;
+  return -1;
+}
+
+static int num_params(Obj *fn)
+{
+  int n = 0;
+  for (Obj *var = fn->params; var; var = var->next)
+    n++;
+  return n;
+}
+
+// Returns true if the function may be called other than directly by
+// name, because its address is used somewhere.
+static bool is_addr_taken(Obj *prog, char *name)
+{
+  for (Obj *obj = prog; obj; obj = obj->next)
+    for (Relocation *rel = obj->rel; rel; rel = rel->next)
+      if (!strcmp(rel->label, name))
+        return true;
+
+  for (int i = 0; i < nfuncs; i++)
+    for (BB *bb = funcs[i]->bbs; bb; bb = bb->next)
+      for (IR *ir = bb->first; ir; ir = ir->next)
+        if (ir->op == IR_GVAR && !strcmp(ir->var->name, name))
+          return true;
+  return false;
+}
+
+// Caller-saved registers a function changes, including those its
+// callees change.
+static int func_clobbers(IRFunc *fn)
+{
+  int regs = 1 << REG_RAX;
+  if (ret_in_regs(fn))
+    regs |= 1 << REG_RDX;
+
+  for (BB *bb = fn->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      if (ir->dst)
+        regs |= 1 << ir->dst->rn;
+      if (ir->op == IR_PARAM)
+        continue;
+      Clobber c;
+      get_clobber(ir, 0, &c);
+      regs |= c.regs;
+    }
+  }
+  return regs & CALLER_SAVED;
+}
+
+static void visit(int i)
+{
+  state[i] = 1;
+  for (BB *bb = funcs[i]->bbs; bb; bb = bb->next)
+  {
+    for (IR *ir = bb->first; ir; ir = ir->next)
+    {
+      int j = (ir->op == IR_CALL) ? find_func(ir->name) : -1;
+      if (j < 0)
+        continue;
+      if (state[j] == 1)
+        funcs[j]->is_private = false;
+      else if (state[j] == 0)
+        visit(j);
+    }
+  }
+  state[i] = 2;
+  postorder[npostorder++] = funcs[i];
+}
+
+// Returns the functions of the program in the order their registers
+// should be allocated.
+IRFunc **regalloc_order(Obj *prog, int *n)
+{
+  nfuncs = 0;
+  for (Obj *obj = prog; obj; obj = obj->next)
+    if (obj->ir)
+      nfuncs++;
+
+  funcs = calloc(nfuncs, sizeof(IRFunc *));
+  int i = 0;
+  for (Obj *obj = prog; obj; obj = obj->next)
+    if (obj->ir)
+      funcs[i++] = obj->ir;
+
+  *n = nfuncs;
+  if (!opt_ipa_ra)
+    return funcs;
+
+  for (i = 0; i < nfuncs; i++)
+  {
+    Obj *obj = funcs[i]->obj;
+    funcs[i]->is_private = obj->is_static && !obj->ty->is_variadic &&
+                           num_params(obj) <= 6 && !is_addr_taken(prog, obj->name);
+  }
+
+  postorder = calloc(nfuncs, sizeof(IRFunc *));
+  state = calloc(nfuncs, 1);
+  npostorder = 0;
+  for (i = 0; i < nfuncs; i++)
+    if (!state[i])
+      visit(i);
+
+  int nprivate = 0;
+  for (i = 0; i < nfuncs; i++)
+    if (funcs[i]->is_private)
+      nprivate++;
+  count_stat("private-convention", "functions", nprivate);
+  return postorder;
+}
+
+// Returns the registers a call may change: every caller-saved
+// register, unless the callee has been allocated already.
+int call_clobbers(IR *call)
+{
+  int i = opt_ipa_ra ? find_func(call->name) : -1;
+  if (i < 0 || !funcs[i]->has_clobbers)
+    return CALLER_SAVED;
+
+  IRFunc *callee = funcs[i];
+  int regs = callee->clobbers;
+  for (int j = 0; j < call->nargs; j++)
+  {
+    int r = callee->is_private ? callee->param_reg[j] : argreg[j];
+    if (r >= 0)
+      regs |= 1 << r;
+  }
+  return regs;
+}
+
+// Returns the callee if the call uses the private convention.
+IRFunc *private_callee(IR *call)
+{
+  int i = opt_ipa_ra ? find_func(call->name) : -1;
+  if (i < 0 || !funcs[i]->is_private || !funcs[i]->has_clobbers)
+    return NULL;
+  return funcs[i];
+}
+
+// Returns true if the function returns a struct in %rax and %rdx.
+// Each half is loaded with a single move, so the size must allow that.
+bool ret_in_regs(IRFunc *fn)
+{
+  Type *ty = fn->obj->ty->return_ty;
+  if (!fn->is_private || (ty->kind != TY_STRUCT && ty->kind != TY_UNION))
+    return false;
+  int lo = MIN(ty->size, 8);
+  int hi = ty->size - lo;
+  return (lo == 1 || lo == 2 || lo == 4 || lo == 8) &&
+         (hi == 0 || hi == 1 || hi == 2 || hi == 4 || hi == 8);
+}
@@ -0,0 +1,503 @@
+#include "9cc.h"
+
+//
+// Function specialization
+//
+// A static function that is called with a constant argument, such as
+// a mode flag or an element size,
+//
+//   copy_elems(dst, src, n, 4);
+//
+// branches on that argument at run time in every call. We give it a
+// clone for the constant instead, where the parameter is replaced by
+// the value and is no longer passed,
+//
+//   copy_elems.constprop.0(dst, src, n);
+//
+// and the fold pass that runs next removes the branches the constant
+// decides. Calls with the same constants share a clone, including
+// recursive calls in the clone itself.
+//
+// A constant argument is only worth a clone if the parameter decides
+// something in the callee: it appears in a condition, or it is an
+// operand of a multiplication, division or shift, which become cheaper
+// with a constant. Parameters that the callee assigns to or takes the
+// address of are not replaced, and neither are those that a recursive
+// call passes a different value for.
+//
+// Clones make the program larger, so a function gets at most
+// MAX_CLONES of them, and all clones together may add at most
+// -fspecialize-budget=<n> nodes to the program. Static functions that
+// nobody calls any more are not emitted.
+//
+
+#define MAX_CLONES 4
+#define MAX_PARAMS 6
+
+int opt_specialize_budget = 2000;
+
+typedef struct
+{
+  Obj *fn;
+  bool known[MAX_PARAMS];
+  int64_t vals[MAX_PARAMS];
+  Obj *clone;
+} Spec;
+
+static Spec *specs;
+static int nspecs;
+
+static Obj *prog;
+static int budget;
+static int nclones;
+static int nredirected;
+
+static bool count_node(Node *node, void *arg)
+{
+  (*(int *)arg)++;
+  return false;
+}
+
+static int size_of(Node *node)
+{
+  int n = 0;
+  any_node(node, count_node, &n);
+  return n;
+}
+
+static int num_params(Obj *fn)
+{
+  int n = 0;
+  for (Obj *var = fn->params; var; var = var->next)
+    n++;
+  return n;
+}
+
+static Obj *find_func(char *name)
+{
+  for (Obj *obj = prog; obj; obj = obj->next)
+    if (obj->is_function && obj->is_definition && !strcmp(obj->name, name))
+      return obj;
+  return NULL;
+}
+
+// Returns the value of the type `ty` that `val` converts to.
+static int64_t convert(Type *ty, int64_t val)
+{
+  if (ty->kind == TY_BOOL)
+    return val != 0;
+  switch (ty->size)
+  {
+  case 1:
+    return (int8_t)val;
+  case 2:
+    return (int16_t)val;
+  case 4:
+    return (int32_t)val;
+  }
+  return val;
+}
+
+// Evaluates an argument at compile time, like eval() in the parser,
+// but fails rather than reporting an error if it is not a constant.
+static bool eval_const(Node *node, int64_t *val)
+{
+  int64_t a, b;
+
+  switch (node->kind)
+  {
+  case ND_NUM:
+    *val = node->val;
+    return true;
+  case ND_CAST:
+    if (!eval_const(node->lhs, &a) || !(is_integer(node->ty) || node->ty->kind == TY_PTR))
+      return false;
+    *val = convert(node->ty, a);
+    return true;
+  case ND_NEG:
+    if (!eval_const(node->lhs, &a))
+      return false;
+    *val = convert(node->ty, -(uint64_t)a);
+    return true;
+  case ND_BITNOT:
+    if (!eval_const(node->lhs, &a))
+      return false;
+    *val = convert(node->ty, ~a);
+    return true;
+  case ND_ADD:
+  case ND_SUB:
+  case ND_MUL:
+  case ND_BITAND:
+  case ND_BITOR:
+  case ND_BITXOR:
+  case ND_SHL:
+    if (!is_integer(node->ty) || !eval_const(node->lhs, &a) || !eval_const(node->rhs, &b))
+      return false;
+    break;
+  default:
+    return false;
+  }
+
+  switch (node->kind)
+  {
+  case ND_ADD:
+    *val = (uint64_t)a + b;
+    break;
+  case ND_SUB:
+    *val = (uint64_t)a - b;
+    break;
+  case ND_MUL:
+    *val = (uint64_t)a * b;
+    break;
+  case ND_BITAND:
+    *val = a & b;
+    break;
+  case ND_BITOR:
+    *val = a | b;
+    break;
+  case ND_BITXOR:
+    *val = a ^ b;
+    break;
+  case ND_SHL:
+    if (b < 0 || b >= 64)
+      return false;
+    *val = (uint64_t)a << b;
+    break;
+  }
+  *val = convert(node->ty, *val);
+  return true;
+}
+
+//
+// Which parameters are worth a clone
+//
+
+static Obj *param_var;
+
+static bool uses_param(Node *node, void *arg)
+{
+  return node->kind == ND_VAR && node->var == param_var;
+}
+
+static bool is_param(Node *node)
+{
+  while (node->kind == ND_CAST)
+    node = node->lhs;
+  return node->kind == ND_VAR && node->var == param_var;
+}
+
+static bool modifies_param(Node *node, void *arg)
+{
+  return (node->kind == ND_ASSIGN || node->kind == ND_ADDR) && node->lhs->kind == ND_VAR &&
+         node->lhs->var == param_var;
+}
+
+static bool decides(Node *node, void *arg)
+{
+  switch (node->kind)
+  {
+  case ND_IF:
+  case ND_FOR:
+  case ND_DO:
+  case ND_SWITCH:
+  case ND_COND:
+    return node->cond && any_node(node->cond, uses_param, NULL);
+  case ND_LOGAND:
+  case ND_LOGOR:
+  case ND_MUL:
+  case ND_DIV:
+  case ND_MOD:
+  case ND_SHL:
+  case ND_SHR:
+    return is_param(node->lhs) || is_param(node->rhs);
+  }
+  return false;
+}
+
+// A recursive call that passes another value for the parameter would
+// only lead to a chain of clones, one per value.
+static bool changes_in_recursion(Node *node, void *fn)
+{
+  if (node->kind != ND_FUNCALL || strcmp(node->funcname, ((Obj *)fn)->name))
+    return false;
+
+  Obj *param = ((Obj *)fn)->params;
+  for (Node *arg = node->args; arg; arg = arg->next, param = param->next)
+    if (param == param_var)
+      return !is_param(arg);
+  return false;
+}
+
+static bool is_worth_it(Obj *fn, Obj *param)
+{
+  param_var = param;
+  return !any_node(fn->body, modifies_param, NULL) &&
+         !any_node(fn->body, changes_in_recursion, fn) && any_node(fn->body, decides, NULL);
+}
+
+//
+// Cloning
+//
+
+static Spec *find_spec(Obj *fn, bool *known, int64_t *vals)
+{
+  for (int i = 0; i < nspecs; i++)
+  {
+    Spec *s = &specs[i];
+    if (s->fn != fn)
+      continue;
+    bool match = true;
+    for (int j = 0; j < MAX_PARAMS; j++)
+      if (s->known[j] != known[j] || (known[j] && s->vals[j] != vals[j]))
+        match = false;
+    if (match)
+      return s;
+  }
+  return NULL;
+}
+
+static int count_clones(Obj *fn)
+{
+  int n = 0;
+  for (int i = 0; i < nspecs; i++)
+    if (specs[i].fn == fn)
+      n++;
+  return n;
+}
+
+static void replace_param(Node *node, Obj *var, int64_t val)
+{
+  if (!node)
+    return;
+  if (node->kind == ND_VAR && node->var == var)
+  {
+    node->kind = ND_NUM;
+    node->var = NULL;
+    node->val = val;
+    return;
+  }
+
+  Node *kids[] = {node->lhs, node->rhs, node->cond, node->then,
+                  node->els, node->init, node->inc};
+  for (int i = 0; i < sizeof(kids) / sizeof(*kids); i++)
+    replace_param(kids[i], var, val);
+  for (Node *n = node->body; n; n = n->next)
+    replace_param(n, var, val);
+  for (Node *n = node->args; n; n = n->next)
+    replace_param(n, var, val);
+}
+
+// Removes the known parameters from a clone. They stay as locals,
+// which nothing uses any more. Parameters are the last locals, so the
+// removed ones are moved in front of them.
+static void drop_params(Obj *clone, bool *known)
+{
+  Obj *kept[MAX_PARAMS];
+  Obj *dropped[MAX_PARAMS];
+  int nkept = 0, ndropped = 0;
+  int i = 0;
+  for (Obj *var = clone->params; var; var = var->next, i++)
+  {
+    if (known[i])
+      dropped[ndropped++] = var;
+    else
+      kept[nkept++] = var;
+  }
+
+  Obj head = {};
+  Obj *cur = &head;
+  for (Obj *var = clone->locals; var != clone->params; var = var->next)
+    cur = cur->next = var;
+  for (i = 0; i < ndropped; i++)
+    cur = cur->next = dropped[i];
+  for (i = 0; i < nkept; i++)
+    cur = cur->next = kept[i];
+  cur->next = NULL;
+  clone->locals = head.next;
+  clone->params = nkept ? kept[0] : NULL;
+
+  Type *ty = copy_type(clone->ty);
+  Type params = {};
+  Type *last = &params;
+  i = 0;
+  for (Type *t = clone->ty->params; t; t = t->next, i++)
+  {
+    if (known[i])
+      continue;
+    last = last->next = copy_type(t);
+    last->next = NULL;
+  }
+  ty->params = params.next;
+  clone->ty = ty;
+}
+
+static Obj *new_clone(Obj *fn, bool *known, int64_t *vals)
+{
+  char *name = format("%s.constprop.%d", fn->name, count_clones(fn));
+  Obj *clone = clone_function(fn, name);
+
+  int i = 0;
+  for (Obj *var = clone->params; var; var = var->next, i++)
+    if (known[i])
+      replace_param(clone->body, var, vals[i]);
+  drop_params(clone, known);
+
+  Obj *last = prog;
+  while (last->next)
+    last = last->next;
+  last->next = clone;
+
+  specs = realloc(specs, sizeof(Spec) * (nspecs + 1));
+  Spec *s = &specs[nspecs++];
+  s->fn = fn;
+  memcpy(s->known, known, sizeof(s->known));
+  memcpy(s->vals, vals, sizeof(s->vals));
+  s->clone = clone;
+  nclones++;
+  return clone;
+}
+
+// Describes the constants of a clone for remarks, like "n=4, mode=1".
+static char *describe(Obj *fn, bool *known, int64_t *vals)
+{
+  char *buf;
+  size_t len;
+  FILE *out = open_memstream(&buf, &len);
+  int i = 0;
+  for (Obj *var = fn->params; var; var = var->next, i++)
+    if (known[i])
+      fprintf(out, "%s%s=%ld", ftell(out) ? ", " : "", var->name, vals[i]);
+  fclose(out);
+  return buf;
+}
+
+static bool specialize_call(Node *node, void *arg)
+{
+  if (node->kind != ND_FUNCALL)
+    return false;
+  Obj *fn = find_func(node->funcname);
+  if (!fn || !fn->is_static || fn->ty->is_variadic || num_params(fn) > MAX_PARAMS)
+    return false;
+
+  // The original of a clone is specialized, not the clone.
+  for (int i = 0; i < nspecs; i++)
+    if (specs[i].clone == fn)
+      return false;
+
+  bool known[MAX_PARAMS] = {};
+  int64_t vals[MAX_PARAMS] = {};
+  bool has_const = false;
+  bool worth = false;
+
+  int i = 0;
+  Obj *param = fn->params;
+  for (Node *arg = node->args; arg; arg = arg->next, param = param->next, i++)
+  {
+    if (!eval_const(arg, &vals[i]))
+      continue;
+    has_const = true;
+    if (is_worth_it(fn, param))
+      known[i] = worth = true;
+  }
+  if (!has_const)
+    return false;
+
+  if (!worth)
+  {
+    remark_missed("specialize", node->tok,
+                  "'%s' not specialized: the constant arguments decide nothing", fn->name);
+    return false;
+  }
+
+  Spec *s = find_spec(fn, known, vals);
+  Obj *clone = s ? s->clone : NULL;
+  if (!clone)
+  {
+    int size = size_of(fn->body);
+    if (count_clones(fn) == MAX_CLONES)
+    {
+      remark_missed("specialize", node->tok, "'%s' not specialized: too many clones",
+                    fn->name);
+      return false;
+    }
+    if (size > budget)
+    {
+      remark_missed("specialize", node->tok,
+                    "'%s' not specialized: clone budget exhausted (cost=%d, left=%d)",
+                    fn->name, size, budget);
+      return false;
+    }
+    budget -= size;
+    clone = new_clone(fn, known, vals);
+  }
+
+  remark("specialize", node->tok, "call to '%s' redirected to '%s' (%s)", fn->name,
+         clone->name, describe(fn, known, vals));
+
+  Node head = {};
+  Node *cur = &head;
+  i = 0;
+  for (Node *arg = node->args; arg; arg = arg->next, i++)
+    if (!known[i])
+      cur = cur->next = arg;
+  cur->next = NULL;
+  node->args = head.next;
+  node->funcname = clone->name;
+  node->func_ty = clone->ty;
+  nredirected++;
+  return false;
+}
+
+//
+// Removing unused originals
+//
+
+static Obj *ref_fn;
+
+static bool refers_to(Node *node, void *arg)
+{
+  if (node->kind == ND_FUNCALL && !strcmp(node->funcname, ref_fn->name))
+    return true;
+  return node->kind == ND_VAR && node->var->is_function && !strcmp(node->var->name, ref_fn->name);
+}
+
+static bool is_used(Obj *fn)
+{
+  ref_fn = fn;
+  for (Obj *obj = prog; obj; obj = obj->next)
+  {
+    if (obj->is_function && obj->is_definition && obj != fn &&
+        any_node(obj->body, refers_to, NULL))
+      return true;
+    for (Relocation *rel = obj->rel; rel; rel = rel->next)
+      if (!strcmp(rel->label, fn->name))
+        return true;
+  }
+  return false;
+}
+
+void specialize_functions(Obj *p)
+{
+  prog = p;
+  budget = opt_specialize_budget;
+  nspecs = nclones = nredirected = 0;
+
+  for (Obj *fn = prog; fn; fn = fn->next)
+    if (fn->is_function && fn->is_definition)
+      any_node(fn->body, specialize_call, NULL);
+
+  int nremoved = 0;
+  for (int i = 0; i < nspecs; i++)
+  {
+    Obj *fn = specs[i].fn;
+    if (fn->is_definition && !is_used(fn))
+    {
+      fn->is_definition = false;
+      nremoved++;
+    }
+  }
+
+  count_stat("specialized", "calls", nredirected);
+  count_stat("clones", "funcs", nclones);
+  count_stat("specialize-removed", "funcs", nremoved);
+}
@@ -0,0 +1,312 @@
+#include "9cc.h"
+
+//
+// Tail calls
+//
+// A call whose value is returned right away is a tail call: the
+// caller has nothing left to do after it. Recursive descent code and
+// state machines that call the function for the next state are full
+// of them, and each one grows the stack and costs a call and a return.
+//
+// A tail call of the function itself becomes a jump back to the start
+// of the body, after the arguments have been assigned to the
+// parameters:
+//
+//   int f(int n, int acc) { if (n == 0) return acc; return f(n - 1, acc * n); }
+//
+// becomes
+//
+//   int f(int n, int acc) { L: if (n == 0) return acc; t = n - 1; acc = acc * n; n = t; goto L; }
+//
+// An argument goes through a temporary only if a later argument reads
+// the parameter it is assigned to. The passes that run after this one
+// see an ordinary loop.
+//
+// Other tail calls are marked, and codegen() emits them as a jump to
+// the callee after it has torn down the frame, so that the callee
+// returns directly to our caller. Arguments that go on the stack are
+// stored over our own stack parameters, so the callee may not have
+// more of them than we do.
+//
+// Neither is done if a local variable has its address taken, since
+// the callee could still use the variable after the frame is gone, or
+// the next iteration overwrite it. The value of the callee must also
+// be returned as it is: nobody is left to sign-extend it.
+//
+// In a void function, a call statement is a tail call too if "return;"
+// follows it or it is the last thing the function does.
+//
+
+static Obj *fn;
+static char *entry; // label at the start of the body, or NULL if not used yet
+static bool addr_taken;
+
+static int nloops;
+static int njumps;
+
+static Node *new_node(NodeKind kind, Token *tok)
+{
+  Node *node = calloc(1, sizeof(Node));
+  node->kind = kind;
+  node->tok = tok;
+  return node;
+}
+
+static Node *new_var(Obj *var, Token *tok)
+{
+  Node *node = new_node(ND_VAR, tok);
+  node->var = var;
+  node->ty = var->ty;
+  return node;
+}
+
+static Node *assign_stmt(Obj *var, Node *val, Token *tok)
+{
+  Node *node = new_node(ND_ASSIGN, tok);
+  node->lhs = new_var(var, tok);
+  node->rhs = val;
+  node->ty = var->ty;
+
+  Node *stmt = new_node(ND_EXPR_STMT, tok);
+  stmt->lhs = node;
+  return stmt;
+}
+
+static Obj *new_temp(Type *ty)
+{
+  Obj *var = calloc(1, sizeof(Obj));
+  var->name = "";
+  var->ty = ty;
+  var->is_local = true;
+  var->align = ty->align;
+  var->next = fn->locals;
+  fn->locals = var;
+  return var;
+}
+
+// Returns the local variable that `node` is part of, or NULL.
+static Obj *local_of(Node *node)
+{
+  while (node->kind == ND_MEMBER)
+    node = node->lhs;
+  if (node->kind == ND_VAR && node->var->is_local)
+    return node->var;
+  return NULL;
+}
+
+static bool takes_addr(Node *node, void *arg)
+{
+  if (node->kind == ND_ADDR && local_of(node->lhs))
+    return true;
+
+  // An array decays to a pointer to its first element.
+  return (node->kind == ND_VAR || node->kind == ND_MEMBER) && node->ty &&
+         node->ty->kind == TY_ARRAY && local_of(node);
+}
+
+static bool uses_var(Node *node, void *var)
+{
+  return node->kind == ND_VAR && node->var == var;
+}
+
+// Returns the operand of the conversion that the parser adds to a
+// return value or an argument.
+static Node *strip_cast(Node *node)
+{
+  return node->kind == ND_CAST ? node->lhs : node;
+}
+
+// Returns true if returning a value of type `from` as `to` needs no
+// code. The caller only looks at as many bits of a return value as its
+// type has.
+static bool is_free_cast(Type *from, Type *to)
+{
+  if (to->kind == TY_VOID)
+    return true;
+  if (to->kind == TY_BOOL)
+    return from->kind == TY_BOOL;
+  return (is_integer(from) || from->kind == TY_PTR) &&
+         (is_integer(to) || to->kind == TY_PTR) && from->size >= to->size;
+}
+
+// Replaces a self-recursive tail call by assignments to the parameters
+// and a jump to the start of the body.
+static void make_loop(Node *node, Node *call)
+{
+  Token *tok = node->tok;
+  Node head = {};
+  Node *cur = &head;
+  Node moves = {};
+  Node *last = &moves;
+
+  Obj *param = fn->params;
+  for (Node *arg = call->args; arg; arg = arg->next, param = param->next)
+  {
+    Node *val = strip_cast(arg);
+    if (val->kind == ND_VAR && val->var == param)
+      continue;
+
+    bool read_later = false;
+    for (Node *a = arg->next; a; a = a->next)
+      if (any_node(a, uses_var, param))
+        read_later = true;
+
+    if (!read_later)
+    {
+      cur = cur->next = assign_stmt(param, arg, tok);
+      continue;
+    }
+    Obj *tmp = new_temp(param->ty);
+    cur = cur->next = assign_stmt(tmp, arg, tok);
+    last = last->next = assign_stmt(param, new_var(tmp, tok), tok);
+  }
+  cur->next = moves.next;
+  while (cur->next)
+    cur = cur->next;
+
+  if (!entry)
+    entry = new_unique_name();
+  cur = cur->next = new_node(ND_GOTO, tok);
+  cur->unique_label = entry;
+
+  Node *next = node->next;
+  memset(node, 0, sizeof(Node));
+  node->kind = ND_BLOCK;
+  node->tok = tok;
+  node->body = head.next;
+  node->next = next;
+}
+
+static void tail_return(Node *node)
+{
+  if (!node->lhs)
+    return;
+  Node *call = strip_cast(node->lhs);
+  if (call->kind != ND_FUNCALL)
+    return;
+
+  char *name = call->funcname;
+  if (addr_taken)
+  {
+    remark_missed("tail-calls", call->tok,
+                  "'%s' is not tail called: the address of a local variable is taken", name);
+    return;
+  }
+  if (!is_free_cast(call->ty, fn->ty->return_ty))
+  {
+    remark_missed("tail-calls", call->tok,
+                  "'%s' is not tail called: its return value needs a conversion", name);
+    return;
+  }
+
+  // A loop assigns the parameters wherever they are.
+  if (!strcmp(name, fn->name) && !fn->ty->is_variadic)
+  {
+    remark("tail-calls", call->tok, "tail recursion turned into a loop");
+    make_loop(node, call);
+    nloops++;
+    return;
+  }
+
+  // Arguments after the sixth are passed on the stack. The callee can
+  // find them where ours were, if there is room.
+  int nargs = 0;
+  for (Node *arg = call->args; arg; arg = arg->next)
+    nargs++;
+  int nparams = 0;
+  for (Obj *param = fn->params; param; param = param->next)
+    nparams++;
+  if (nargs > 6 && nargs > nparams)
+  {
+    remark_missed("tail-calls", call->tok,
+                  "'%s' is not tail called: its stack arguments don't fit in ours", name);
+    return;
+  }
+
+  remark("tail-calls", call->tok, "tail call to '%s' emitted as a jump", name);
+  node->lhs = call;
+  node->tail_call = true;
+  njumps++;
+}
+
+// Turns the call statement that ends a void function into a return.
+static void tail_stmt(Node *node)
+{
+  switch (node->kind)
+  {
+  case ND_BLOCK:
+    for (Node *n = node->body; n; n = n->next)
+      if (!n->next)
+        tail_stmt(n);
+    return;
+  case ND_IF:
+    tail_stmt(node->then);
+    if (node->els)
+      tail_stmt(node->els);
+    return;
+  case ND_LABEL:
+    tail_stmt(node->lhs);
+    return;
+  case ND_EXPR_STMT:
+    if (node->lhs->kind == ND_FUNCALL)
+      node->kind = ND_RETURN;
+    return;
+  }
+}
+
+static void find_tail_calls(Node *node)
+{
+  if (!node)
+    return;
+
+  if (node->kind == ND_RETURN)
+  {
+    tail_return(node);
+    return;
+  }
+
+  // f(); return;
+  bool is_void = (fn->ty->return_ty->kind == TY_VOID);
+  for (Node *n = node->body; n; n = n->next)
+    if (is_void && n->kind == ND_EXPR_STMT && n->lhs->kind == ND_FUNCALL && n->next &&
+        n->next->kind == ND_RETURN && !n->next->lhs)
+      n->kind = ND_RETURN;
+
+  Node *kids[] = {node->lhs, node->rhs, node->cond, node->then,
+                  node->els, node->init, node->inc};
+  for (int i = 0; i < sizeof(kids) / sizeof(*kids); i++)
+    find_tail_calls(kids[i]);
+  for (Node *n = node->body; n; n = n->next)
+    find_tail_calls(n);
+}
+
+void eliminate_tail_calls(Obj *prog)
+{
+  nloops = njumps = 0;
+
+  for (Obj *obj = prog; obj; obj = obj->next)
+  {
+    if (!obj->is_function || !obj->is_definition)
+      continue;
+    fn = obj;
+    entry = NULL;
+    addr_taken = fn->va_area || any_node(fn->body, takes_addr, NULL);
+
+    if (fn->ty->return_ty->kind == TY_VOID)
+      tail_stmt(fn->body);
+    find_tail_calls(fn->body);
+
+    if (entry)
+    {
+      Node *label = new_node(ND_LABEL, fn->body->tok);
+      label->label = entry;
+      label->unique_label = entry;
+      label->lhs = new_node(ND_BLOCK, fn->body->tok);
+      label->next = fn->body->body;
+      fn->body->body = label;
+    }
+  }
+
+  count_stat("tail-loops", "calls", nloops);
+  count_stat("tail-jumps", "calls", njumps);
+}
@@ -0,0 +1,105 @@
+#include "test.h"
+
+long weigh10(long a, long b, long c, long d, long e, long f, long g, long h,
+             long i, long j);
+typedef struct {
+  int gp_offset;
+  int fp_offset;
+  void *overflow_arg_area;
+  void *reg_save_area;
+} __va_elem;
+
+typedef __va_elem va_list[1];
+
+int add_all(int n, ...);
+int sprintf(char *buf, char *fmt, ...);
+int vsprintf(char *buf, char *fmt, va_list ap);
+int strcmp(char *p, char *q);
+
+int sum8(int a, int b, int c, int d, int e, int f, int g, int h) {
+  return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8;
+}
+
+long mix10(char a, short b, int c, long d, char e, short f, char g, short h,
+           int i, long j) {
+  return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8 + i * 9 +
+         j * 10;
+}
+
+static int last7(int a, int b, int c, int d, int e, int f, int g) { return g; }
+
+int bump7(int a, int b, int c, int d, int e, int f, int g) {
+  int *p = &g;
+  *p += a;
+  return g;
+}
+
+int deref9(int a, int b, int c, int d, int e, int f, int g, int h, int *p) {
+  return *p + h;
+}
+
+int count_args(int a, int b, int c, int d, int e, int f, int g, int h, int i) {
+  if (a == 0)
+    return b + c + d + e + f + g + h + i;
+  return count_args(a - 1, b, c, d, e, f, g, h, i + 1);
+}
+
+long sum16(long a, long b, long c, long d, long e, long f, long g, long h,
+           long i, long j, long k, long l, long m, long n, long o, long p) {
+  return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8 + i * 9 +
+         j * 10 + k * 11 + l * 12 + m * 13 + n * 14 + o * 15 + p * 16;
+}
+
+int id(int x) { return x; }
+
+char *fmt(char *buf, char *fmt, ...) {
+  va_list ap;
+  *ap = *(__va_elem *)__va_area__;
+  vsprintf(buf, fmt, ap);
+  return buf;
+}
+
+int g1 = 3;
+long g2 = 100;
+
+int main() {
+  int x = 2;
+  long y = -5;
+
+  ASSERT(204, sum8(1, 2, 3, 4, 5, 6, 7, 8));
+  ASSERT(204, sum8(x - 1, x, x + 1, 4, 5, 6, 7, 8));
+  ASSERT(224, sum8(1, sum8(0, 0, 0, 0, 0, 0, 0, 1), 3, 4, 5, 6, 7,
+                   sum8(1, 0, 0, 0, 0, 0, 0, 1) / 9 + 8));
+  ASSERT(88, sum8(g1, x, g1, x, g1, x, g1, x));
+
+  ASSERT(385, weigh10(1, 2, 3, 4, 5, 6, 7, 8, 9, 10));
+  ASSERT(379, weigh10(y, 2, 3, 4, 5, 6, 7, 8, 9, 10));
+  ASSERT(10295, weigh10(1, 2, 3, 4, 5, 6, 7, 8, 9, weigh10(1, 0, 0, 0, 0, 0, 0, 0, 0, g2)));
+
+  ASSERT(-123, mix10(-1, -2, -3, -4, -5, -6, -7, -8, 9, 0));
+  ASSERT(1, mix10(1, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+  ASSERT(1, mix10(0, 0, 0, 0, 0, 0, 0, 0, 0, (long)1 << 40) == (long)10 << 40);
+
+  ASSERT(7, last7(1, 2, 3, 4, 5, 6, 7));
+  ASSERT(2, last7(1, 2, 3, 4, 5, 6, x));
+
+  ASSERT(43, bump7(1, 0, 0, 0, 0, 0, 42));
+  ASSERT(12, deref9(0, 0, 0, 0, 0, 0, 0, 5, &g1 + 0) + 4);
+  ASSERT(45, count_args(10, 1, 2, 3, 4, 5, 6, 7, 7));
+
+  // More arguments than registers to hold them at once
+  ASSERT(1768, sum16(x + 1, x + 2, x + 3, x + 4, x + 5, x + 6, x + 7, x + 8, x + 9,
+                     x + 10, x + 11, x + 12, x + 13, x + 14, x + 15, x + 16));
+  ASSERT(1496, sum16(id(1), id(2), id(3), id(4), id(5), id(6), id(7), id(8), id(9),
+                     id(10), id(11), id(12), id(13), id(14), id(15), id(16)));
+  ASSERT(1624, sum16(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                     sum16(1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1) + x * 4 - 1));
+  ASSERT(0, ({ char buf[100]; sprintf(buf, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d", id(1), id(2), id(3), id(4), id(5), id(6), id(7), id(8), id(9), id(10), id(11), id(12), id(13), id(14), id(15)); strcmp("1 2 3 4 5 6 7 8 9 10 11 12 13 14 15", buf); }));
+
+  ASSERT(55, add_all(10, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10));
+  ASSERT(0, ({ char buf[100]; sprintf(buf, "%d %d %d %d %d %d %d %s", 1, 2, 3, 4, 5, 6, 7, "x"); strcmp("1 2 3 4 5 6 7 x", buf); }));
+  ASSERT(0, ({ char buf[100]; fmt(buf, "%d %d %d %d %d %d %ld", 1, 2, 3, 4, 5, 6, y); strcmp("1 2 3 4 5 6 -5", buf); }));
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include "test.h"
+
+int cnt;
+
+int tick(int x) { cnt++; return x; }
+
+int cmp_lt(int a, int b) { if (a < b) return 1; return 0; }
+int cmp_le(long a, long b) { if (a <= b) return 1; return 0; }
+int cmp_gt(int a, int b) { if (a > b) return 1; return 0; }
+int ge_imm(int a) { if (a >= 5) return 1; return 0; }
+int imm_lt(int a) { if (3 < a) return 1; return 0; }
+int ptr_eq(int *p, int *q) { if (p == q) return 1; return 0; }
+int not_zero(long x) { if (!x) return 1; return 0; }
+int char_cond(char c) { if (c) return 1; return 0; }
+
+int and3(int a, int b, int c) { if (a < b && b < c && c != 10) return 1; return 0; }
+int or3(int a, int b, int c) { if (a == 1 || b == 2 || c == 3) return 1; return 0; }
+int mixed(int a, int b) { if ((a > 0 && b > 0) || !(a != -1 || b != -1)) return 1; return 0; }
+int not_and(int a, int b) { if (!(a && b)) return 1; return 0; }
+
+int count_loop(int n) {
+  int s = 0;
+  for (int i = 0; i < n && s < 100; i++)
+    s += i;
+  return s;
+}
+
+int do_loop(int n) {
+  int i = 0;
+  do
+    i++;
+  while (i < n || i == 3);
+  return i;
+}
+
+int while_not(int n) {
+  int i = 0;
+  while (!(i >= n))
+    i++;
+  return i;
+}
+
+int main() {
+  ASSERT(1, cmp_lt(2, 3));
+  ASSERT(0, cmp_lt(3, 3));
+  ASSERT(1, cmp_lt(-1, 0));
+  ASSERT(1, cmp_le(3, 3));
+  ASSERT(0, cmp_le(4294967296, 1));
+  ASSERT(1, cmp_le(-4294967296, 1));
+  ASSERT(1, cmp_gt(4, 3));
+  ASSERT(0, cmp_gt(3, 3));
+  ASSERT(1, ge_imm(5));
+  ASSERT(0, ge_imm(4));
+  ASSERT(1, imm_lt(4));
+  ASSERT(0, imm_lt(3));
+  ASSERT(1, ptr_eq(&cnt, &cnt));
+  ASSERT(0, ptr_eq(&cnt, 0));
+  ASSERT(1, not_zero(0));
+  ASSERT(0, not_zero(4294967296));
+  ASSERT(1, char_cond(-1));
+  ASSERT(0, char_cond(0));
+
+  ASSERT(1, and3(1, 2, 3));
+  ASSERT(0, and3(1, 2, 10));
+  ASSERT(0, and3(2, 1, 3));
+  ASSERT(1, or3(0, 0, 3));
+  ASSERT(1, or3(1, 0, 0));
+  ASSERT(0, or3(0, 0, 0));
+  ASSERT(1, mixed(1, 1));
+  ASSERT(1, mixed(-1, -1));
+  ASSERT(0, mixed(-1, 1));
+  ASSERT(1, not_and(0, 1));
+  ASSERT(0, not_and(1, 1));
+
+  ASSERT(1, ({ cnt = 0; int x = tick(0) && tick(1); cnt == 1 && x == 0; }));
+  ASSERT(1, ({ cnt = 0; int x = tick(1) || tick(1); cnt == 1 && x == 1; }));
+  ASSERT(1, ({ cnt = 0; int x = tick(1) && tick(2); cnt == 2 && x == 1; }));
+  ASSERT(1, ({ cnt = 0; if (tick(0) || tick(0) || tick(5)) cnt += 10; cnt; }) == 13);
+  ASSERT(2, ({ int x = 0, y = -1; if ((x = 2, x > 1)) y = x; y; }));
+  ASSERT(7, ({ int x; if (1 && 2) x = 7; else x = 8; x; }));
+  ASSERT(8, ({ int x; if (0 || !5) x = 7; else x = 8; x; }));
+
+  ASSERT(5, 2 < 3 && 4 ? 5 : 6);
+  ASSERT(6, ({ int a = 3; a < 3 || a > 3 ? 5 : 6; }));
+  ASSERT(105, count_loop(20));
+  ASSERT(10, count_loop(5));
+  ASSERT(4, do_loop(3));
+  ASSERT(1, do_loop(0));
+  ASSERT(6, while_not(6));
+
+  printf("OK\n");
+  return 0;
+}
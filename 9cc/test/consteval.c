@@ -0,0 +1,152 @@
+#include "test.h"
+
+static int table_size(int bits) {
+  int n = 1;
+  while (bits--)
+    n *= 2;
+  return n + 1;
+}
+
+static int crc_entry(int c) {
+  int r = c;
+  for (int i = 0; i < 8; i++)
+    r = (r & 1) ? (r >> 1) ^ 0x6db88320 : r >> 1;
+  return r;
+}
+
+static int fib(int n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+
+static int sieve(int n) {
+  char composite[100] = {};
+  int count = 0;
+  for (int i = 2; i < n; i++) {
+    if (composite[i])
+      continue;
+    count++;
+    for (int j = i * i; j < n; j += i)
+      composite[j] = 1;
+  }
+  return count;
+}
+
+struct Point {
+  int x;
+  int y;
+};
+
+static void move(struct Point *p, int dx) { p->x += dx; }
+
+static int manhattan(int x, int y) {
+  struct Point p = {x, y};
+  struct Point q = p;
+  move(&q, 3);
+  return q.x + (q.y < 0 ? -q.y : q.y) + p.x;
+}
+
+static int length(char *s) {
+  int n = 0;
+  while (s[n])
+    n++;
+  return n;
+}
+
+static int days(int month) {
+  int n = 0;
+  switch (month) {
+  case 2:
+    n = 28;
+    break;
+  case 4:
+  case 6:
+  case 9:
+  case 11:
+    n = 30;
+    break;
+  default:
+    n = 31;
+  }
+  return n;
+}
+
+static int collatz(long n) {
+  int steps = 0;
+again:
+  if (n == 1)
+    return steps;
+  steps++;
+  n = (n % 2) ? 3 * n + 1 : n / 2;
+  goto again;
+}
+
+static int digits(int n) {
+  int d = 0;
+  do {
+    d++;
+    n /= 10;
+  } while (n);
+  return d;
+}
+
+static char narrow(int x) { return x * 3; }
+static long wide(int x) { return (long)x << 40; }
+static int safe_div(int a, int b) { return b ? a / b : -1; }
+
+int calls;
+static int counted(int x) {
+  calls++;
+  return x + 1;
+}
+
+static int spin(int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += i & 3;
+  return s;
+}
+
+static const int size = table_size(4);
+static int crc[4] = {crc_entry(0), crc_entry(1), crc_entry(2), crc_entry(3)};
+int fibs[] = {fib(10), fib(15) * 2, sizeof(int) + fib(3)};
+int base = 7;
+int scaled = manhattan(base, -2) + 1;
+int name_len = length("hello");
+
+int main() {
+  ASSERT(17, size);
+  ASSERT(0, crc[0]);
+  ASSERT(906440854, crc[1]);
+  ASSERT(1812881708, crc[2]);
+  ASSERT(1510560186, crc[3]);
+  ASSERT(55, fibs[0]);
+  ASSERT(1220, fibs[1]);
+  ASSERT(6, fibs[2]);
+  ASSERT(20, scaled);
+  ASSERT(5, name_len);
+
+  ASSERT(1025, table_size(10));
+  ASSERT(6765, fib(20));
+  ASSERT(25, sieve(100));
+  ASSERT(15, manhattan(2, -8));
+  ASSERT(5, length("hello"));
+  ASSERT(28, days(2));
+  ASSERT(30, days(9));
+  ASSERT(31, days(12));
+  ASSERT(111, collatz(27));
+  ASSERT(4, digits(1234));
+  ASSERT(44, narrow(100));
+  ASSERT(1, wide(3) == (long)3 << 40);
+  ASSERT(-1, safe_div(1, 0));
+  ASSERT(-3, safe_div(-7, 2));
+
+  calls = 0;
+  ASSERT(3, counted(2));
+  ASSERT(1, calls);
+
+  ASSERT(3000000, spin(2000000));
+
+  int n = 6;
+  ASSERT(8, fib(n));
+
+  printf("OK\n");
+  return 0;
+}
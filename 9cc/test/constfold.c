@@ -0,0 +1,54 @@
+#include "test.h"
+
+int calls;
+int side_effect() { calls++; return 1; }
+
+int main() {
+  ASSERT(4096, ({ int x=1; x * (4 * 1024); }));
+  ASSERT(40, ({ int x=10; sizeof(int) * x; }));
+  ASSERT(-1, (char)255);
+  ASSERT(255, (short)255);
+  ASSERT(131585, (int)8590066177);
+  ASSERT(-2147483648, 1 << 31);
+  ASSERT(-8, -16 >> 1);
+  ASSERT(-3, -7 / 2);
+  ASSERT(-1, -7 % 2);
+  ASSERT(0, 1073741824 * 100 / 100);
+  ASSERT(1, 3 < 5 && 5 <= 5);
+
+  ASSERT(7, ({ int x=7; x + 0; }));
+  ASSERT(7, ({ int x=7; 0 + x; }));
+  ASSERT(7, ({ int x=7; x * 1; }));
+  ASSERT(7, ({ int x=7; x / 1; }));
+  ASSERT(0, ({ int x=7; x * 0; }));
+  ASSERT(1, ({ calls=0; side_effect() * 0; calls; }));
+  ASSERT(3, ({ int a[3]={1,2,3}; int *p=a+2; *(p + 0); }));
+
+  ASSERT(0, ({ calls=0; 0 && side_effect(); }));
+  ASSERT(0, ({ calls=0; 0 && side_effect(); calls; }));
+  ASSERT(1, ({ calls=0; 1 || side_effect(); }));
+  ASSERT(1, ({ calls=0; 1 && side_effect(); }));
+  ASSERT(1, ({ calls=0; 1 && side_effect(); calls; }));
+  ASSERT(0, ({ int *p=0; 1 && p; }));
+
+  ASSERT(3, ({ int x; if (0) x=2; else x=3; x; }));
+  ASSERT(2, ({ int x; if (1) x=2; else x=3; x; }));
+  ASSERT(5, ({ int x=5; if (0) x=2; x; }));
+  ASSERT(0, ({ calls=0; if (0 && side_effect()) side_effect(); calls; }));
+  ASSERT(3, ({ int x=1; x ? 3 : 4; }));
+  ASSERT(4, ({ int x=0 ? 3 : 4; x; }));
+
+  ASSERT(10, ({ int i=0; while (1) { if (i==10) break; i++; } i; }));
+  ASSERT(0, ({ int i=0; while (0) i++; i; }));
+  ASSERT(3, ({ int i=3; for (int j=0; 0; j++) i++; i; }));
+  ASSERT(1, ({ int i=0; do i++; while (0); i; }));
+  ASSERT(2, ({ int i=0; do { i++; if (i<2) continue; break; } while (1); i; }));
+  ASSERT(1, ({ int i=0; do { i++; continue; i=5; } while (0); i; }));
+
+  ASSERT(2, ({ int x=0; goto a; if (0) { a: x=2; } x; }));
+  ASSERT(7, ({ int x=1; switch (x) { case 0: if (0) { case 1: x=7; } } x; }));
+  ASSERT(3, ({ int x=0; goto b; x=1; b: x+=3; x; }));
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,146 @@
+#include "test.h"
+
+// Each check compares multiplication, division and modulo by a
+// constant, which are strength-reduced, with the same operations on
+// a variable, which use imul and idiv.
+
+int xs[] = {0, 1, -1, 2, -2, 3, -3, 7, -7, 9, -9, 10, -10, 15, -15, 16, -16, 17, -17,
+            99, -99, 100, -100, 1000, -1000, 1023, -1023, 1024, -1024, 65535, -65536,
+            123456789, -123456789, 1073741823, -1073741824, 2147483647, -2147483647};
+
+long ls[] = {0, 1, -1, 7, -7, 10, -10, 1024, -1025, 2147483647, -2147483648,
+             4294967296, -4294967296, 1000000000000, -999999999999, 4611686018427387903,
+             -4611686018427387904, 9223372036854775807, -9223372036854775807};
+
+int mul32(int x, int y) { return x * y; }
+int div32(int x, int y) { return x / y; }
+int mod32(int x, int y) { return x % y; }
+long mul64(long x, long y) { return x * y; }
+long div64(long x, long y) { return x / y; }
+long mod64(long x, long y) { return x % y; }
+
+#define CHECK32(name, d)                                \
+  int name(void) {                                      \
+    int bad = 0;                                        \
+    for (int i = 0; i < sizeof(xs) / sizeof(*xs); i++) { \
+      int x = xs[i];                                    \
+      bad += x * d != mul32(x, d);                      \
+      bad += x / d != div32(x, d);                      \
+      bad += x % d != mod32(x, d);                      \
+    }                                                   \
+    return bad;                                         \
+  }
+
+#define CHECK64(name, d)                                \
+  int name(void) {                                      \
+    int bad = 0;                                        \
+    for (int i = 0; i < sizeof(ls) / sizeof(*ls); i++) { \
+      long x = ls[i];                                   \
+      bad += x * d != mul64(x, d);                      \
+      bad += x / d != div64(x, d);                      \
+      bad += x % d != mod64(x, d);                      \
+    }                                                   \
+    return bad;                                         \
+  }
+
+CHECK32(i1, 1)
+CHECK32(in1, -1)
+CHECK32(i2, 2)
+CHECK32(in2, -2)
+CHECK32(i3, 3)
+CHECK32(in3, -3)
+CHECK32(i5, 5)
+CHECK32(i6, 6)
+CHECK32(i7, 7)
+CHECK32(in7, -7)
+CHECK32(i9, 9)
+CHECK32(i10, 10)
+CHECK32(in10, -10)
+CHECK32(i16, 16)
+CHECK32(in16, -16)
+CHECK32(i25, 25)
+CHECK32(i45, 45)
+CHECK32(i100, 100)
+CHECK32(i641, 641)
+CHECK32(i1000, 1000)
+CHECK32(i1024, 1024)
+CHECK32(i65537, 65537)
+CHECK32(i2p30, 1073741824)
+CHECK32(imax, 2147483647)
+CHECK32(inmax, -2147483647)
+
+CHECK64(l2, 2)
+CHECK64(l3, 3)
+CHECK64(ln3, -3)
+CHECK64(l7, 7)
+CHECK64(l10, 10)
+CHECK64(ln10, -10)
+CHECK64(l16, 16)
+CHECK64(ln16, -16)
+CHECK64(l40, 40)
+CHECK64(l1000, 1000)
+CHECK64(l2p31, 2147483648)
+CHECK64(l2p40, 1099511627776)
+CHECK64(ln2p40, -1099511627776)
+CHECK64(l1e12, 1000000000000)
+CHECK64(lmax, 9223372036854775807)
+
+int main() {
+  ASSERT(0, i1());
+  ASSERT(0, in1());
+  ASSERT(0, i2());
+  ASSERT(0, in2());
+  ASSERT(0, i3());
+  ASSERT(0, in3());
+  ASSERT(0, i5());
+  ASSERT(0, i6());
+  ASSERT(0, i7());
+  ASSERT(0, in7());
+  ASSERT(0, i9());
+  ASSERT(0, i10());
+  ASSERT(0, in10());
+  ASSERT(0, i16());
+  ASSERT(0, in16());
+  ASSERT(0, i25());
+  ASSERT(0, i45());
+  ASSERT(0, i100());
+  ASSERT(0, i641());
+  ASSERT(0, i1000());
+  ASSERT(0, i1024());
+  ASSERT(0, i65537());
+  ASSERT(0, i2p30());
+  ASSERT(0, imax());
+  ASSERT(0, inmax());
+
+  ASSERT(0, l2());
+  ASSERT(0, l3());
+  ASSERT(0, ln3());
+  ASSERT(0, l7());
+  ASSERT(0, l10());
+  ASSERT(0, ln10());
+  ASSERT(0, l16());
+  ASSERT(0, ln16());
+  ASSERT(0, l40());
+  ASSERT(0, l1000());
+  ASSERT(0, l2p31());
+  ASSERT(0, l2p40());
+  ASSERT(0, ln2p40());
+  ASSERT(0, l1e12());
+  ASSERT(0, lmax());
+
+  ASSERT(-2, -7 / 3 + ({ int x = -7; x / 3 - x / 3; }));
+  ASSERT(-2, ({ int x = -7; x / 3; }));
+  ASSERT(-1, ({ int x = -7; x % 3; }));
+  ASSERT(-3, ({ int x = -25; x / 8; }));
+  ASSERT(-1, ({ int x = -25; x % 8; }));
+  ASSERT(3, ({ int x = -25; x / -8; }));
+  ASSERT(-1, ({ int x = -25; x % -8; }));
+  ASSERT(-12345678, ({ long x = -123456789; x / 10; }));
+  ASSERT(-9, ({ long x = -123456789; x % 10; }));
+  ASSERT(5, ({ char c = -11; -c / 2; }));
+  ASSERT(-5, ({ short s = -11; s / 2; }));
+  ASSERT(-33, ({ int a[3] = {-100, 5, 7}; a[0] / 3; }));
+
+  printf("OK\n");
+  return 0;
+}
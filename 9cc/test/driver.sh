@@ -22,4 +22,183 @@ check -o
 ./9cc --help 2>&1 | grep -q cc
 check --help
 
+# --emit-ir
+echo 'int main() { return 3; }' > $tmp/foo.c
+./9cc --emit-ir $tmp/foo.c | grep -q 'ret v'
+check --emit-ir
+
+# -fno-tree-regs
+echo 'int f(int a, int b) { return (a + b) * (a - b); }' > $tmp/foo.c
+./9cc -o- $tmp/foo.c | grep -q 'push rax' && exit 1
+./9cc -fno-tree-regs -o- $tmp/foo.c | grep -q 'push rax'
+check -fno-tree-regs
+
+# -O
+echo 'int f(int a, int b) { return (a + b) * (a - b); }' > $tmp/foo.c
+./9cc -O0 -o- $tmp/foo.c | grep -q 'push rax'
+check -O0
+./9cc -O1 -o- $tmp/foo.c | grep -q '.L.bb' && exit 1
+./9cc -O2 -o- $tmp/foo.c | grep -q '.L.bb'
+check -O2
+
+# --pass-stats
+./9cc --pass-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q '^fold '
+./9cc -fno-fold --pass-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q '^fold ' && exit 1
+./9cc -O2 --pass-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q '^regalloc '
+check --pass-stats
+
+# -f<pass>
+./9cc -fno-such-pass -o /dev/null $tmp/foo.c 2>&1 | grep -q 'unknown argument'
+check -f
+
+# -fno-isel
+echo 'int f(int *a, int i) { return a[i]; }' > $tmp/foo.c
+./9cc -fno-isel -o- $tmp/foo.c | grep -q 'rdi\*4' && exit 1
+./9cc -o- $tmp/foo.c | grep -q 'dword ptr \[rax + rdi\*4\]'
+check -fno-isel
+
+# --peephole-stats
+echo 'int main() { return 3; }' > $tmp/foo.c
+./9cc --peephole-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q 'push-pop'
+check --peephole-stats
+
+# -fno-peephole
+echo 'int f(int x) { return x; } int main() { return f(3); }' > $tmp/foo.c
+./9cc -fno-inline -o- $tmp/foo.c | grep -q 'mov rax, 0' && exit 1
+./9cc -fno-inline -fno-peephole -o- $tmp/foo.c | grep -q 'mov rax, 0'
+check -fno-peephole
+
+# -fno-branch-fusion
+echo 'int f(int a, int b) { if (a < b) return 1; return 0; }' > $tmp/foo.c
+./9cc -o- $tmp/foo.c | grep -q 'setl' && exit 1
+./9cc -O2 -o- $tmp/foo.c | grep -q 'setl' && exit 1
+./9cc -fno-branch-fusion -o- $tmp/foo.c | grep -q 'setl'
+check -fno-branch-fusion
+
+# -fno-branchless
+echo 'int f(int a, int b) { return a < b ? a : b; }' > $tmp/foo.c
+./9cc -o- $tmp/foo.c | grep -q 'cmovl'
+./9cc -O2 -o- $tmp/foo.c | grep -q 'cmovl'
+./9cc -fno-branchless -o- $tmp/foo.c | grep -q 'cmov' && exit 1
+./9cc -fno-branchless -o- $tmp/foo.c | grep -q 'jge'
+check -fno-branchless
+
+# -fno-ext
+echo 'long f(int *a, int i) { return a[i]; }' > $tmp/foo.c
+./9cc -o- $tmp/foo.c | grep -q 'movsxd r.., e..$' && exit 1
+./9cc -fno-ext -o- $tmp/foo.c | grep -q 'movsxd r.., e..$'
+check -fno-ext
+
+# -fno-strength-reduce
+echo 'int f(int x) { return x / 10 + x % 8 + x * 9; }' > $tmp/foo.c
+./9cc -o- $tmp/foo.c | grep -q 'idiv\|imul .*, 9' && exit 1
+./9cc -O2 -o- $tmp/foo.c | grep -q 'idiv\|imul .*, 9' && exit 1
+./9cc -fno-strength-reduce -o- $tmp/foo.c | grep -q 'idiv'
+check -fno-strength-reduce
+
+# -fno-loop-rotate
+echo 'int f(int n) { int s = 0; for (int i = 0; i < n; i++) s += i; return s; }' > $tmp/foo.c
+./9cc -o- $tmp/foo.c | grep -q 'jmp .L.begin' && exit 1
+./9cc -o- $tmp/foo.c | grep -q 'jl .L.begin'
+./9cc -fno-loop-rotate -o- $tmp/foo.c | grep -q 'jmp .L.begin'
+check -fno-loop-rotate
+
+# -falign-loops
+./9cc -O1 -o- $tmp/foo.c | grep -q 'p2align' && exit 1
+./9cc -O2 -fno-align-loops -o- $tmp/foo.c | grep -q 'p2align' && exit 1
+./9cc -O2 -o- $tmp/foo.c | grep -q 'p2align'
+./9cc -O1 -falign-loops -o- $tmp/foo.c | grep -q 'p2align'
+check -falign-loops
+
+# -fno-licm
+echo 'int f(int *a, int n, int k) { int s = 0; for (int i = 0; i < n; i++) s += a[i] * (n * k); return s; }' > $tmp/foo.c
+./9cc -O2 -fno-licm --pass-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q '^licm' && exit 1
+./9cc -O2 -fno-unroll --pass-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q '^licm-hoisted .* 1  exprs'
+check -fno-licm
+
+# -fno-unroll
+echo 'int f(int *a) { int s = 0; for (int i = 0; i < 4; i++) s += a[i]; return s; }' > $tmp/foo.c
+./9cc -fno-unroll -o- $tmp/foo.c | grep -q '.L.begin'
+./9cc -o- $tmp/foo.c | grep -q '.L.begin' && exit 1
+./9cc --pass-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q '^unroll-full .* 1  loops'
+check -fno-unroll
+
+# -fno-ivopts
+echo 'int f(int *a, int n) { int s = 0; for (int i = 0; i < n; i++) s += a[i]; return s; }' > $tmp/foo.c
+./9cc -O2 -fno-ivopts --pass-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q '^iv-' && exit 1
+./9cc -O2 -fno-unroll --pass-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q '^iv-removed .* 1  ivs'
+check -fno-ivopts
+
+# -fvectorize
+echo 'void f(int *a, int *b, int n) { for (int i = 0; i < n; i++) a[i] = b[i] + 1; }' > $tmp/foo.c
+./9cc -O2 -fno-vectorize -o- $tmp/foo.c | grep -q 'xmm' && exit 1
+./9cc -O2 -mavx2 -o- $tmp/foo.c | grep -q 'ymm'
+./9cc -O2 -Rpass=vectorize -o /dev/null $tmp/foo.c 2>&1 | grep -q 'remark: vectorized loop (4 x int), 1 runtime alias check'
+check -fvectorize
+
+# -Rpass-missed
+echo 'int g(int x); void f(int *a, int n) { for (int i = 0; i < n; i++) a[i] = g(n); }' > $tmp/foo.c
+./9cc -O2 -o /dev/null $tmp/foo.c 2>&1 | grep -q 'remark' && exit 1
+./9cc -O2 -Rpass-missed=all -o /dev/null $tmp/foo.c 2>&1 | grep -q 'loop not vectorized: function call \[-Rpass-missed=vectorize\]'
+check -Rpass-missed
+
+# -floop-idiom
+echo 'void f(int *a, int n) { int i; for (i = 0; i < n; i++) a[i] = 0; }' > $tmp/foo.c
+./9cc -fno-loop-idiom -o- $tmp/foo.c | grep -q 'rep stosb' && exit 1
+./9cc -o- $tmp/foo.c | grep -q 'rep stosb'
+./9cc -O2 -Rpass=loop-idiom -o /dev/null $tmp/foo.c 2>&1 | grep -q 'remark: loop replaced by memset'
+check -floop-idiom
+
+# -fprefetch-loop-arrays
+echo 'long f(long *a, long n) { long s; s = 0; for (long i = 0; i < n; i++) s += a[i * 8] + a[i]; return s; }' > $tmp/foo.c
+./9cc -O2 -o- $tmp/foo.c | grep -q 'prefetch' && exit 1
+./9cc -O2 -fprefetch-loop-arrays -o- $tmp/foo.c | grep -q 'prefetcht0'
+./9cc -O3 -Rpass=prefetch-loop-arrays -o /dev/null $tmp/foo.c 2>&1 | grep -q 'remark: prefetching'
+check -fprefetch-loop-arrays
+
+# -finline
+echo 'static int f(int x) { return x + 1; } __attribute__((noinline)) static int h(int x) { return x; } int g(int y) { return f(y) + h(y); }' > $tmp/foo.c
+./9cc -o- $tmp/foo.c | grep -q 'call f' && exit 1
+./9cc -fno-inline -o- $tmp/foo.c | grep -q 'call f'
+./9cc -Rpass-missed=inline -o /dev/null $tmp/foo.c 2>&1 | grep -q "remark: 'h' not inlined into 'g': noinline attribute"
+./9cc -Rpass=inline -o /dev/null $tmp/foo.c 2>&1 | grep -q "remark: 'f' inlined into 'g'"
+check -finline
+
+# -ftail-calls
+echo 'int g(int x); int f(int x) { return g(x + 1); } int h(int n, int a) { if (n == 0) return a; return h(n - 1, a + n); }' > $tmp/foo.c
+./9cc -o- $tmp/foo.c | grep -q 'call' && exit 1
+./9cc -O2 -o- $tmp/foo.c | grep -q 'call' && exit 1
+./9cc -fno-tail-calls -o- $tmp/foo.c | grep -q 'call h'
+./9cc -O2 -o- $tmp/foo.c | grep -q 'jmp g'
+./9cc -Rpass=tail-calls -o /dev/null $tmp/foo.c 2>&1 | grep -q 'remark: tail recursion turned into a loop'
+echo 'int g(int a, int b, int c, int d, int e, int f, int x); int f(int a, int b, int c, int d, int e, int f) { return g(a, b, c, d, e, f, 1); }' > $tmp/foo.c
+./9cc -Rpass-missed=tail-calls -o /dev/null $tmp/foo.c 2>&1 | grep -q "stack arguments don't fit"
+check -ftail-calls
+
+# -fspecialize
+echo '__attribute__((noinline)) static int f(int x, int m) { if (m) return x * 3; return x + 1; } int g(int y) { return f(y, 1) + f(y, 0); }' > $tmp/foo.c
+./9cc -O1 -o- $tmp/foo.c | grep -q 'constprop' && exit 1
+./9cc -O2 -fno-specialize -o- $tmp/foo.c | grep -q 'constprop' && exit 1
+./9cc -O2 -fspecialize-budget=0 -o- $tmp/foo.c | grep -q 'constprop' && exit 1
+./9cc -O2 -o- $tmp/foo.c | grep -q 'call f.constprop.1'
+./9cc -O2 -Rpass=specialize -o /dev/null $tmp/foo.c 2>&1 | grep -q "remark: call to 'f' redirected to 'f.constprop.0' (m=1)"
+check -fspecialize
+
+# -fconsteval
+echo '__attribute__((noinline)) static int f(int n) { int s = 0; for (int i = 0; i < n; i++) s += i; return s; } int x = f(3); int g(void) { return f(10) + 1; }' > $tmp/foo.c
+./9cc -o- $tmp/foo.c | grep -q 'call f' && exit 1
+./9cc -fconsteval-steps=50 -o /dev/null $tmp/foo.c 2>&1 | grep -q "call to 'f' cannot be evaluated at compile time: it takes more than 50 steps"
+./9cc -fconsteval-steps=150 -o- $tmp/foo.c | grep -q 'call f'
+./9cc -fno-consteval -o- $tmp/foo.c | grep -q 'call f'
+./9cc -O0 -o- $tmp/foo.c | grep -q '.byte 3'
+./9cc -Rpass=consteval -o /dev/null $tmp/foo.c 2>&1 | grep -q "remark: call to 'f' evaluated to 45"
+check -fconsteval
+
+# -fipa-ra
+echo '__attribute__((noinline)) static int f(int x) { return x * 3 + 1; } int g(int y) { int a = y * 5; return f(y) + a; }' > $tmp/foo.c
+./9cc -O2 -o- $tmp/foo.c | grep -q 'rbx' && exit 1
+./9cc -O2 --pass-stats -o /dev/null $tmp/foo.c 2>&1 | grep -q 'private-convention .* 1  functions'
+./9cc -O2 -fno-ipa-ra -o- $tmp/foo.c | grep -q 'rbx'
+check -fipa-ra
+
 echo OK
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "test.h"
+
+char gc = -3;
+short gsh = -300;
+int gi = -5;
+
+long int_to_long(int x) { return x; }
+long char_to_long(char c) { return c; }
+long short_to_long(short s) { return s; }
+long mask(int x) { return x & 255; }
+long mask_neg(int x) { return x & -256; }
+long cmp(int x, int y) { return x < y; }
+long trunc(long x) { return (int)x; }
+long trunc_char(long x) { return (char)x; }
+int char_of(int x) { return (char)x; }
+int short_of(int x) { return (short)x; }
+char ret_char(int x) { return x; }
+long call_char(int x) { return ret_char(x); }
+long idx(int *a, int i) { return a[i - 1]; }
+
+void store_char(char *p, int x) { *p = x + 1; }
+void store_short(short *p, long x) { *p = x * 3; }
+void store_int(int *p, long x) { *p = x; }
+void store_long(long *p, int x) { *p = x; }
+
+int main() {
+  ASSERT(-7, int_to_long(-7));
+  ASSERT(-1, char_to_long(255));
+  ASSERT(-2, short_to_long(65534));
+  ASSERT(-3, ({ long x = gc; x; }));
+  ASSERT(-300, ({ long x = gsh; x; }));
+  ASSERT(-5, ({ long x = gi; x; }));
+  ASSERT(251, mask(-5));
+  ASSERT(-256, mask_neg(-5));
+  ASSERT(1, cmp(-1, 0));
+  ASSERT(0, cmp(0, -1));
+  ASSERT(1, trunc(4294967297));
+  ASSERT(-1, trunc(4294967295));
+  ASSERT(-1, trunc_char(511));
+  ASSERT(-128, char_of(128));
+  ASSERT(-32768, short_of(32768));
+  ASSERT(-1, call_char(255));
+  ASSERT(30, ({ int a[4] = {10, 20, 30, 40}; idx(a, 3); }));
+  ASSERT(10, ({ int a[4] = {10, 20, 30, 40}; idx(a + 2, -1); }));
+
+  ASSERT(-128, ({ char c; store_char(&c, 127); c; }));
+  ASSERT(32765, ({ short s; store_short(&s, 32767 + 65536); s; }));
+  ASSERT(-32765, ({ short s; store_short(&s, -32767 - 65536); s; }));
+  ASSERT(-1, ({ int i; store_int(&i, 4294967295); i; }));
+  ASSERT(-1, ({ long l; store_long(&l, -1); l; }));
+  ASSERT(1, ({ long l; store_long(&l, -1); l < 0; }));
+  ASSERT(-56, ({ char c = 100; c = c + 100; c; }));
+  ASSERT(-56, ({ char c = 100; long l = c = c + 100; l; }));
+  ASSERT(200, ({ char c = 100; int i = c + 100; i; }));
+  ASSERT(-4294967296, ({ int i = -1; long l = i; l * 4294967296; }));
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,189 @@
+#include "test.h"
+
+struct P {
+  int x;
+  char tag;
+  long y;
+};
+
+char g1[40];
+char g2[40];
+
+int zero(int *a, int from, int to) {
+  int i;
+  for (i = from; i < to; i++)
+    a[i] = 0;
+  return i;
+}
+
+void fill(char *s, int n) {
+  for (int i = 0; i < n; i++)
+    s[i] = 'x';
+}
+
+void minus_one(long *a, long n) {
+  for (long i = 0; i <= n; i++)
+    a[i] = -1;
+}
+
+void shorts(short *a, int n) {
+  for (int i = 0; i < n; i++)
+    a[i] = 257;
+}
+
+void not_uniform(short *a, int n) {
+  for (int i = 0; i < n; i++)
+    a[i] = 258;
+}
+
+void nulls(char **p, int n) {
+  for (int i = 0; i < n; i++)
+    p[i] = 0;
+}
+
+void copy(int *dst, int *src, int n) {
+  for (int i = 0; i < n; i++)
+    dst[i] = src[i];
+}
+
+void copy_points(struct P *dst, struct P *src, int n) {
+  for (int i = 0; i < n; i++)
+    dst[i] = src[i];
+}
+
+void copy_globals(void) {
+  for (int i = 0; i < 40; i++)
+    g1[i] = g2[i];
+}
+
+int len(char *p) {
+  char *start = p;
+  while (*p)
+    p++;
+  return p - start;
+}
+
+int len_index(char *s) {
+  int n = 0;
+  while (s[n] != '\0')
+    n++;
+  return n;
+}
+
+long len_from(char *s, long i) {
+  for (; s[i + 1]; i++)
+    ;
+  return i;
+}
+
+int main() {
+  int a[50];
+  char s[80];
+  long l[10];
+  short h[10];
+  char *p[5];
+  struct P x[4] = {{1, 'a', 10}, {2, 'b', 20}, {3, 'c', 30}, {4, 'd', 40}};
+  struct P y[4];
+
+  for (int i = 0; i < 50; i++)
+    a[i] = i + 1;
+  ASSERT(45, zero(a, 5, 45));
+  ASSERT(5, a[4]);
+  ASSERT(0, a[5]);
+  ASSERT(0, a[44]);
+  ASSERT(46, a[45]);
+  ASSERT(47, zero(a, 47, 3));
+  ASSERT(48, a[47]);
+  ASSERT(0, zero(a, 0, -5));
+
+  for (int n = 0; n < 40; n++) {
+    for (int i = 0; i < 80; i++)
+      s[i] = 0;
+    fill(s + 1, n);
+    ASSERT(0, s[0]);
+    ASSERT(n, len(s + 1));
+    ASSERT(0, s[n + 1]);
+  }
+
+  minus_one(l, 3);
+  ASSERT(-1, l[3]);
+  ASSERT(-1, l[0]);
+  l[5] = 9;
+  minus_one(l, -1);
+  ASSERT(9, l[5]);
+
+  shorts(h, 10);
+  ASSERT(257, h[9]);
+  not_uniform(h, 3);
+  ASSERT(258, h[2]);
+  ASSERT(257, h[3]);
+
+  p[4] = s;
+  nulls(p, 4);
+  ASSERT(0, (long)p[3]);
+  ASSERT(1, p[4] == s);
+
+  // Constant sizes
+  for (int i = 0; i < 50; i++)
+    a[i] = 5;
+  for (int i = 1; i < 4; i++)
+    a[i] = 0;
+  ASSERT(5, a[0]);
+  ASSERT(0, a[3]);
+  ASSERT(5, a[4]);
+  for (int i = 0; i <= 40; i++)
+    a[i] = -1;
+  ASSERT(-1, a[40]);
+  ASSERT(5, a[41]);
+  for (int i = 0; i < 7; i++)
+    s[i] = 'a';
+  ASSERT('a', s[6]);
+  ASSERT('x', s[7]);
+
+  for (int i = 0; i < 50; i++)
+    a[i] = i;
+  copy(a + 25, a, 20);
+  ASSERT(19, a[44]);
+  ASSERT(45, a[45]);
+  // The destination is ahead of the source, so the copy repeats the
+  // first two elements like the loop does.
+  copy(a + 2, a, 10);
+  ASSERT(0, a[10]);
+  ASSERT(1, a[11]);
+  ASSERT(12, a[12]);
+  for (int i = 0; i < 50; i++)
+    a[i] = i;
+  copy(a, a + 1, 10);
+  ASSERT(10, a[9]);
+  ASSERT(10, a[10]);
+  copy(a, a + 30, 0);
+  ASSERT(1, a[0]);
+
+  copy_points(y, x, 4);
+  ASSERT(4, y[3].x);
+  ASSERT('c', y[2].tag);
+  ASSERT(20, y[1].y);
+  copy_points(x + 1, x, 3);
+  ASSERT(1, x[3].x);
+  ASSERT('a', x[2].tag);
+
+  for (int i = 0; i < 40; i++)
+    g2[i] = i;
+  copy_globals();
+  ASSERT(39, g1[39]);
+
+  ASSERT(0, len(""));
+  ASSERT(5, len("hello"));
+  ASSERT(3, len_index("abc"));
+  ASSERT(0, len_index(""));
+  ASSERT(4, len_from("hello", 0));
+  ASSERT(4, len_from("hello", 2));
+  for (int i = 0; i < 79; i++)
+    s[i] = 'a' + i % 26;
+  s[79] = 0;
+  for (int i = 0; i < 79; i++)
+    ASSERT(79 - i, len(s + i));
+
+  printf("OK\n");
+  return 0;
+}
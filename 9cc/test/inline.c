@@ -0,0 +1,147 @@
+#include "test.h"
+
+struct P {
+  int x;
+  int y;
+};
+
+static int get_x(struct P *p) { return p->x; }
+static int sq(int x) { return x * x; }
+static int add3(int a, int b, int c) { return a + b + c; }
+
+static int sign(int x) {
+  if (x < 0)
+    return -1;
+  if (x == 0)
+    return 0;
+  return 1;
+}
+
+static int sum_to(int n) {
+  int s = 0;
+  for (int i = 1; i <= n; i++) {
+    if (i == 7)
+      continue;
+    if (i > 100)
+      break;
+    s += i;
+  }
+  return s;
+}
+
+static int classify(int x) {
+  switch (x) {
+  case 1:
+    return 10;
+  case 2:
+  case 3:
+    return 20;
+  default:
+    break;
+  }
+  return 30;
+}
+
+static int find(int *a, int n, int x) {
+  for (int i = 0; i < n; i++)
+    if (a[i] == x)
+      goto found;
+  return -1;
+found:
+  return 1;
+}
+
+static int counter(void) {
+  static int n;
+  return ++n;
+}
+
+static void bump(int *p) {
+  if (!p)
+    return;
+  (*p)++;
+}
+
+static int modify(int x) {
+  x = x * 2;
+  return x;
+}
+
+static int fact(int n) {
+  if (n <= 1)
+    return 1;
+  return n * fact(n - 1);
+}
+
+static int is_even(int n);
+static int is_odd(int n) { return n == 0 ? 0 : is_even(n - 1); }
+static int is_even(int n) { return n == 0 ? 1 : is_odd(n - 1); }
+
+static int twice(int x) { return add3(x, x, 0); }
+
+static int neg(int x) { return -x; }
+
+__attribute__((noinline)) static int never(int x) { return x + 1; }
+
+static inline __attribute__((always_inline)) int big(int x) {
+  int s = 0;
+  for (int i = 0; i < x; i++)
+    s += i * i + sign(i - 3) + classify(i) + sum_to(i) + sq(i) + get_x(&(struct P){i, 0});
+  return s;
+}
+
+int side;
+static int next_side(void) { return ++side; }
+
+int main() {
+  struct P p = {3, 4};
+  ASSERT(3, get_x(&p));
+  ASSERT(49, sq(7));
+  ASSERT(6, add3(1, 2, 3));
+  ASSERT(9, sq(add3(1, 1, 1)));
+  ASSERT(-1, sign(-5));
+  ASSERT(0, sign(0));
+  ASSERT(1, sign(8));
+  ASSERT(1 + 0 + 1, sign(1) + sign(0) + sign(2));
+  ASSERT(48, sum_to(10));
+  ASSERT(5050 - 7, sum_to(200));
+  ASSERT(10, classify(1));
+  ASSERT(20, classify(2));
+  ASSERT(20, classify(3));
+  ASSERT(30, classify(4));
+  ASSERT(60, classify(1) + classify(3) + classify(9));
+
+  int a[5] = {1, 2, 3, 4, 5};
+  ASSERT(1, find(a, 5, 4));
+  ASSERT(-1, find(a, 5, 9));
+  ASSERT(0, find(a, 5, 9) + find(a, 5, 1));
+
+  ASSERT(1, counter());
+  ASSERT(2, counter());
+  ASSERT(7, counter() + counter());
+
+  int n = 5;
+  bump(&n);
+  bump(0);
+  ASSERT(6, n);
+  ASSERT(14, modify(n + 1));
+  ASSERT(6, n);
+
+  ASSERT(120, fact(5));
+  ASSERT(1, is_even(10));
+  ASSERT(1, is_odd(7));
+  ASSERT(14, twice(7));
+  void *fp = neg;
+  ASSERT(1, fp != 0);
+  ASSERT(-4, neg(4));
+  ASSERT(5, never(4));
+  ASSERT(big(6), ({ int s = 0; for (int i = 0; i < 6; i++) s += i * i + sign(i - 3) + classify(i) + sum_to(i) + sq(i) + i; s; }));
+
+  side = 0;
+  ASSERT(4, sq(next_side() + 1));
+  ASSERT(1, side);
+  ASSERT(9, ({ int x = 3; sq(x); }));
+
+  printf("OK\n");
+  return 0;
+}
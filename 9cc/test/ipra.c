@@ -0,0 +1,128 @@
+#include "test.h"
+
+#define NOINLINE __attribute__((noinline))
+
+NOINLINE static int add3(int a, int b, int c) { return a + b + c; }
+NOINLINE static int second(int a, int b, int c) { return b * 2; }
+NOINLINE static int leaf(int x) { return x * 3 + 1; }
+
+NOINLINE static int keep(int x) {
+  int a = x + 1;
+  int b = x + 2;
+  int c = leaf(x);
+  return a * 100 + b * 10 + c;
+}
+
+NOINLINE static int many(int a, int b, int c, int d, int e, int f) {
+  return a - b + c - d + e - f;
+}
+
+NOINLINE static int swap_args(int a, int b, int c, int d, int e, int f) {
+  return many(f, e, d, c, b, a) + many(b, a, d, c, f, e);
+}
+
+NOINLINE static int busy(int a, int b, int c, int d, int e, int f) {
+  int s = 0;
+  for (int i = 0; i < a; i++)
+    s += leaf(i) + b + c + d + e + f;
+  return s;
+}
+
+struct S8 {
+  int x;
+  int y;
+};
+struct S12 {
+  int a;
+  int b;
+  int c;
+};
+struct S16 {
+  long lo;
+  long hi;
+};
+struct S3 {
+  char a;
+  char b;
+  char c;
+};
+
+NOINLINE static struct S8 make8(int x, int y) {
+  struct S8 s = {x, y};
+  return s;
+}
+
+NOINLINE static struct S12 make12(int a) {
+  struct S12 s = {a, a * 2, a * 3};
+  return s;
+}
+
+NOINLINE static struct S16 make16(long lo, long hi) {
+  struct S16 s = {lo, hi};
+  return s;
+}
+
+NOINLINE static struct S3 make3(int a) {
+  struct S3 s = {a, a + 1, a + 2};
+  return s;
+}
+
+static int is_odd(int n);
+NOINLINE static int is_even(int n) { return n == 0 ? 1 : is_odd(n - 1); }
+NOINLINE static int is_odd(int n) { return n == 0 ? 0 : is_even(n - 1); }
+
+NOINLINE static int sum_to(int n) { return n == 0 ? 0 : n + sum_to(n - 1); }
+
+NOINLINE static int twice(int x) { return x * 2; }
+void *twice_addr = twice;
+
+NOINLINE static void set(int *p, int v) { *p = v; }
+
+int main() {
+  // Variables keep the calls from being evaluated at compile time.
+  int one = 1, two = 2, three = 3, four = 4, five = 5, six = 6;
+
+  ASSERT(6, add3(one, two, three));
+  ASSERT(10, second(one, five, 9));
+  ASSERT(10, second(add3(one, one, one), five, leaf(two)));
+  ASSERT(686, keep(five));
+  ASSERT(-3, many(one, two, three, four, five, six));
+  ASSERT(6, swap_args(one, two, three, four, five, six));
+  ASSERT(57, busy(three, one, two, three, four, five));
+
+  int x = 7;
+  int y = leaf(x) + leaf(x + 1) + x;
+  ASSERT(54, y);
+
+  struct S8 s8 = make8(three, four);
+  ASSERT(3, s8.x);
+  ASSERT(4, s8.y);
+
+  struct S12 s12 = make12(five);
+  ASSERT(5, s12.a);
+  ASSERT(10, s12.b);
+  ASSERT(15, s12.c);
+
+  struct S16 s16 = make16((long)one << 40, -two);
+  ASSERT(1, s16.lo == (long)1 << 40);
+  ASSERT(-2, s16.hi);
+
+  struct S3 s3 = make3(five * 2);
+  ASSERT(10, s3.a);
+  ASSERT(11, s3.b);
+  ASSERT(12, s3.c);
+
+  ASSERT(1, is_even(five * 2));
+  ASSERT(1, is_odd(six + 1));
+  ASSERT(55, sum_to(five * 2));
+
+  ASSERT(1, twice_addr != 0);
+  ASSERT(8, twice(four));
+
+  int v = 0;
+  set(&v, 42);
+  ASSERT(42, v);
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include "test.h"
+
+struct P { char c; short s; int x; long l; int arr[4]; };
+
+int g[10];
+long gl[10];
+struct P gp[3];
+
+int id(int x) { return x; }
+
+int load_index(int *a, int i) { return a[i]; }
+int load_disp(int *a, long i) { return *(a + i*2 + 3); }
+int load_neg(int *a) { return a[-2]; }
+long load_long(long *a, int i) { return a[i+1]; }
+int load_member(struct P *p, int i) { return p[i].arr[i] + p[i].x; }
+int load_global(int i) { return g[i] + g[i+1] + gp[i].arr[2]; }
+char load_char(char *s, int i) { return s[i]; }
+short load_short(short *s, int i) { return s[i]; }
+
+int *addr(int *a, int i) { return &a[i+2]; }
+int lea_int(int x, int y) { return x + y*4 + 8; }
+long lea_long(long x, long y) { return x + y*8 - 3; }
+int lea_shift(int x, int y) { return (y << 2) + x + 1; }
+
+int rmw(int *a, int i, int x) {
+  a[i] += x;
+  a[i+1] -= 3;
+  a[i+2] ^= x;
+  a[i+3] |= 8;
+  a[i+3] &= ~1;
+  return a[i] + a[i+1] + a[i+2] + a[i+3];
+}
+
+int rmw_narrow(void) {
+  char c[2] = {100, 0};
+  short s = 30000;
+  c[0] += 100;
+  c[1] -= 1;
+  s += 10000;
+  return c[0] * 1000 + c[1] + s;
+}
+
+long rmw_ptr(long *p) {
+  p += 2;
+  p -= 1;
+  return *p;
+}
+
+// The index and the base both need every register, so one of them
+// goes through the stack.
+int deep_index(int *a, int i) {
+  return a[((i+1)*(i+2) - (i+3)*(i+4) + (i+5)*(i+6) - (i+7)*(i+8) + 16) / 4
+           + id(0)] + a[((i+1)*(i+2) + (i+3)*(i+4)) % 4];
+}
+
+int imm_ops(int x) {
+  return (3 < x) * 1000 + (x <= 5) * 100 + (7 - x) * 10 + (x << 3) - (x >> 1) + (x & 6) + (x | 1) + (x ^ 2);
+}
+
+long imm_long(long x) { return (x * 3) + (x >> 33) + (x << 2) + (x == 4294967296); }
+
+int main() {
+  int a[16];
+  for (int i = 0; i < 16; i++)
+    a[i] = i * 10;
+  long l[4] = {11, 22, 33, 44};
+  struct P p[3];
+  for (int i = 0; i < 3; i++) {
+    p[i].x = i + 100;
+    for (int j = 0; j < 4; j++)
+      p[i].arr[j] = i * 10 + j;
+  }
+  for (int i = 0; i < 10; i++)
+    g[i] = i * i;
+  gp[1].arr[2] = 7;
+
+  ASSERT(30, load_index(a, 3));
+  ASSERT(70, load_disp(a, 2));
+  ASSERT(40, load_neg(a + 6));
+  ASSERT(44, load_long(l, 2));
+  ASSERT(124, load_member(p, 2));
+  ASSERT(12, load_global(1));
+  ASSERT(-5, load_char("ab\373c", 2));
+  ASSERT(-300, ({ short s[2] = {1, -300}; load_short(s, 1); }));
+
+  ASSERT(50, *addr(a, 3));
+  ASSERT(32, lea_int(4, 5));
+  ASSERT(77, lea_long(40, 5));
+  ASSERT(-2147483641, lea_int(2147483647, 0));
+  ASSERT(22, lea_shift(1, 5));
+
+  ASSERT(99, rmw(a, 1, 5));
+  ASSERT(15, a[1]);
+  ASSERT(17, a[2]);
+  ASSERT(27, a[3]);
+  ASSERT(40, a[4]);
+
+  ASSERT(-81537, rmw_narrow());
+  ASSERT(22, rmw_ptr(l));
+  ASSERT(30, ({ int x = 3; x *= 10; x; }));
+  ASSERT(5, ({ int x = 3; x += 2; }));
+  ASSERT(44, ({ char c = 300; c; }));
+  ASSERT(1, ({ _Bool b = 256; b; }));
+  ASSERT(7, ({ gl[3] = 7; gl[3]; }));
+  ASSERT(9, ({ gl[3] += 2; gl[3]; }));
+
+  ASSERT(17, deep_index(a, 0));
+  ASSERT(1175, imm_ops(4));
+  ASSERT(175, imm_ops(-1));
+  ASSERT(30064771073, imm_long(4294967296));
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include "test.h"
+
+struct P {
+  int x;
+  int y;
+  char tag;
+};
+
+int g[16];
+
+int hist(char *s, int n, int *h) {
+  for (int i = 0; i < n; i++)
+    h[s[i]]++;
+  return h['a'] * 100 + h['b'] * 10 + h['c'];
+}
+
+long prefix(long *a, int n) {
+  for (int i = 1; i < n; i++)
+    a[i] += a[i - 1];
+  return a[n - 1];
+}
+
+int count_digits(char *s) {
+  int n = 0;
+  for (int i = 0; s[i]; i++)
+    if ('0' <= s[i] && s[i] <= '9')
+      n++;
+  return n;
+}
+
+int weighted(int *a, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += i * a[i];
+  return s;
+}
+
+int last_index(int *a, int n) {
+  int i;
+  for (i = 0; i < n; i++)
+    a[i] = 0;
+  return i;
+}
+
+int reversed(int *a, int n) {
+  int s = 0;
+  for (int i = n - 1; i >= 0; i--)
+    s = s * 10 + a[i];
+  return s;
+}
+
+int mirrored(int *a, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s = s * 10 + a[n - 1 - i];
+  return s;
+}
+
+int strided(int *a, int n) {
+  int s = 0;
+  for (int i = 0; i <= n; i += 3)
+    s += a[2 * i + 1];
+  return s;
+}
+
+int swapped(int *a, int n) {
+  int s = 0;
+  for (int i = 0; n > i; i++)
+    s += a[i];
+  return s;
+}
+
+int not_equal(int *a, int n) {
+  int s = 0;
+  for (int i = 0; i != n; i++)
+    s += a[i];
+  return s;
+}
+
+int points(struct P *p, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += p[i].x * p[i].y + p[i].tag;
+  return s;
+}
+
+long long_iv(long *a, long from, long to) {
+  long s = 0;
+  for (long i = from; i < to; i++)
+    s += a[i];
+  return s;
+}
+
+int matrix(int m[][4], int rows) {
+  int s = 0;
+  for (int i = 0; i < rows; i++)
+    for (int j = 0; j < 4; j++)
+      s += m[i][j] * (j + 1);
+  return s;
+}
+
+int global_copy(int *a, int n) {
+  for (int i = 0; i < n; i++)
+    g[i] = a[i] * 2;
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += g[i];
+  return s;
+}
+
+int main() {
+  int a[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+  int h[128] = {};
+  long b[] = {1, 2, 3, 4, 5};
+  struct P p[] = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+  int m[3][4] = {{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}};
+
+  ASSERT(321, hist("abcaabcaa", 6, h));
+  ASSERT(15, prefix(b, 5));
+  ASSERT(10, b[3]);
+  ASSERT(1, prefix(b, 1));
+  ASSERT(4, count_digits("a1b22c3"));
+  ASSERT(0, count_digits(""));
+  ASSERT(40, weighted(a, 5));
+  ASSERT(76, reversed(a + 5, 2));
+  ASSERT(0, reversed(a, 0));
+  ASSERT(876, mirrored(a + 5, 3));
+  ASSERT(2 + 8, strided(a, 5));
+  ASSERT(2, strided(a, 0));
+  ASSERT(6 + 7 + 8, swapped(a + 5, 3));
+  ASSERT(6 + 7, not_equal(a + 5, 2));
+  ASSERT(2 + 3 + 20 + 6 + 56 + 9, points(p, 3));
+  ASSERT(6 + 10 + 15, long_iv(b, 2, 5));
+  ASSERT(0, long_iv(b, 3, 3));
+  ASSERT(1 + 4 + 9 + 16 + 5 + 12 + 21 + 32 + 9 + 20 + 33 + 48, matrix(m, 3));
+  ASSERT(0, matrix(m, 0));
+  ASSERT(2 * (6 + 7 + 8 + 9), global_copy(a + 5, 4));
+  ASSERT(5, last_index(a, 5));
+  ASSERT(0, a[4]);
+  ASSERT(6, a[5]);
+  ASSERT(0, last_index(a, -3));
+
+  printf("OK\n");
+  return 0;
+}
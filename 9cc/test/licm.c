@@ -0,0 +1,191 @@
+#include "test.h"
+
+int g[10];
+int gx;
+
+struct S {
+  long len;
+  int *data;
+};
+
+void bump(void) { gx++; }
+
+int stride_sum(int *a, int n, int stride) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += a[i] * (n * stride);
+  return s;
+}
+
+void clear(struct S *s) {
+  for (long i = 0; i < s->len; i++)
+    s->data[i] = 0;
+}
+
+int store_through(int *p, int *q, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    *q = i;
+    s += *p;
+  }
+  return s;
+}
+
+int store_byte(int *p, char *q, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    *q = i;
+    s += *p;
+  }
+  return s;
+}
+
+int store_global(int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    g[i] = i;
+    s += g[3];
+  }
+  return s;
+}
+
+int call_global(int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    bump();
+    s += gx;
+  }
+  return s;
+}
+
+int store_local_array(int n) {
+  int a[4] = {1, 2, 3, 4};
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    a[i % 4] = 10;
+    s += a[1];
+  }
+  return s;
+}
+
+int store_escaped(int n) {
+  int x = 1;
+  int *p = &x;
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    *p = i;
+    s += x;
+  }
+  return s;
+}
+
+int walk_frame(int n) {
+  int x = 0;
+  int y = 5;
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    *(&x + 1) = i;
+    s += y;
+  }
+  return s;
+}
+
+int member(struct S *s, int n) {
+  long t = 0;
+  for (int i = 0; i < n; i++) {
+    s->len = i;
+    t += s->len + (s->data != 0);
+  }
+  return t;
+}
+
+int null_guard(int *p, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    if (p)
+      s += *p;
+  return s;
+}
+
+int early_exit(int *p, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    if (!p)
+      break;
+    s += *p;
+  }
+  return s;
+}
+
+int div_guard(int x, int d, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    if (d)
+      s += x / d;
+  return s;
+}
+
+int nested(int *a, int n, int m) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < m; j++)
+      s += a[j] * (n + m) + g[2];
+  return s;
+}
+
+int g0, g1, g2, g3, g4, g5, g6, g7;
+
+// After unrolling, every copy of the body computes the same invariants.
+int deep(int n, int k, int *a, int m) {
+  if (n == 0)
+    return 0;
+  int s = 0;
+  for (int i = 0; i < m; i++) {
+    int x = a[i];
+    if (x < g0 + k)
+      s += g1;
+    if (x > g2 - k)
+      s -= g3;
+    if (x == g4 * k)
+      s ^= g5;
+    if (x != g6)
+      s += g7 * k;
+  }
+  return s + deep(n - 1, k, a, m) % 1000;
+}
+
+int main() {
+  int a[] = {1, 2, 3, 4, 5};
+  ASSERT(150, stride_sum(a, 5, 2));
+
+  int data[] = {1, 2, 3, 4};
+  struct S s = {3, data};
+  clear(&s);
+  ASSERT(4, data[0] + data[1] + data[2] + data[3]);
+
+  int v = 7;
+  ASSERT(10, store_through(&v, &v, 5));
+  ASSERT(35, ({ int w = 7; store_through(&w, &v, 5); }));
+  ASSERT(4, v);
+  ASSERT(10, ({ int w = 7; store_byte(&w, (char *)&w, 5); }));
+  ASSERT(6, store_global(5));
+  ASSERT(15, call_global(5));
+  ASSERT(42, store_local_array(5));
+  ASSERT(10, store_escaped(5));
+  ASSERT(10, walk_frame(5));
+  ASSERT(15, member(&s, 5));
+  ASSERT(0, null_guard(0, 5));
+  ASSERT(35, null_guard(&v + 0 * (v = 7), 5));
+  ASSERT(0, early_exit(0, 5));
+  ASSERT(0, div_guard(5, 0, 3));
+  ASSERT(6, div_guard(5, 2, 3));
+  ASSERT(72, ({ g[2] = 2; int b[] = {1, 2, 3}; nested(b, 2, 3); }));
+
+  g0 = 1, g1 = 2, g2 = 3, g3 = 4, g4 = 5, g5 = 6, g6 = 7, g7 = 8;
+  int d[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+  ASSERT(792, deep(1, 7, d, 16));
+  ASSERT(1240, deep(12345, 7, d, 16));
+
+  printf("OK\n");
+  return 0;
+}
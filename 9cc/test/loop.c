@@ -0,0 +1,103 @@
+#include "test.h"
+
+int ncalls;
+
+int below(int i, int n) {
+  ncalls++;
+  return i < n;
+}
+
+int count_evals(int n) {
+  int k = 0;
+  ncalls = 0;
+  for (int i = 0; below(i, n); i++)
+    k++;
+  return k * 100 + ncalls;
+}
+
+int count_continue(int n) {
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    if (i % 3)
+      continue;
+    k++;
+  }
+  return k;
+}
+
+int count_break(int n) {
+  int i = 0;
+  for (; i < n; i++)
+    if (i * i > 50)
+      break;
+  return i;
+}
+
+int side_effect_cond(int n) {
+  int i = 0, k = 0;
+  while (i++ < n)
+    k += i;
+  return k * 100 + i;
+}
+
+int compound_cond(int *a, int n) {
+  int i = 0;
+  while (i < n && a[i] != 0 || i == 1)
+    i++;
+  return i;
+}
+
+int stmt_expr_cond(int n) {
+  int i = 0;
+  while (({ int j = 0; for (; j < 2; j++); i < n * j; }))
+    i++;
+  return i;
+}
+
+int goto_body(int n) {
+  int k = 0;
+  int i = n;
+  goto in;
+  for (i = 0; i < n; i++) {
+  in:
+    k++;
+  }
+  return k;
+}
+
+int nested(int n) {
+  int k = 0;
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < i; j++)
+      for (int l = j; l < i; l++)
+        k++;
+  return k;
+}
+
+int main() {
+  ASSERT(0, count_evals(0) / 100);
+  ASSERT(1, count_evals(0) % 100);
+  ASSERT(5, count_evals(5) / 100);
+  ASSERT(6, count_evals(5) % 100);
+  ASSERT(4, count_continue(10));
+  ASSERT(0, count_continue(0));
+  ASSERT(8, count_break(100));
+  ASSERT(3, count_break(3));
+  ASSERT(1506, side_effect_cond(5));
+  ASSERT(1, side_effect_cond(0));
+  ASSERT(3, ({ int a[] = {1, 2, 3, 0, 5}; compound_cond(a, 5); }));
+  ASSERT(2, ({ int a[] = {5, 0, 0}; compound_cond(a, 3); }));
+  ASSERT(0, ({ int a[] = {0}; compound_cond(a, 0); }));
+  ASSERT(10, stmt_expr_cond(5));
+  ASSERT(0, stmt_expr_cond(0));
+  ASSERT(1, goto_body(0));
+  ASSERT(1, goto_body(5));
+  ASSERT(20, nested(5));
+  ASSERT(0, ({ int k = 0; for (int i = 0; 0; i++) k++; k; }));
+  ASSERT(7, ({ int k = 0; for (;;) if (++k == 7) break; k; }));
+  ASSERT(7, ({ int k = 0; while (1) if (++k == 7) break; k; }));
+  ASSERT(3, ({ int k = 0; do k++; while (k < 3); k; }));
+
+  printf("OK\n");
+  return 0;
+}
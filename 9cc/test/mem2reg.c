@@ -0,0 +1,66 @@
+#include "test.h"
+
+int fib(int n) {
+  int a=0, b=1;
+  for (int i=0; i<n; i++) {
+    int t=a+b;
+    a=b;
+    b=t;
+  }
+  return a;
+}
+
+int rot(int a, int b, int c) { return a*100 + b*10 + c; }
+int rotate(int a, int b, int c) { return rot(b, c, a); }
+int swap(int a, int b) { return rot(b, a, 0); }
+int narrow(char c, short s, long l) { return c + s + l; }
+int out_param(int *p) { *p = 7; return 1; }
+int escape(int x) { int y = x; out_param(&x); return x + y; }
+int escape_loop(int *a, int n) {
+  int k;
+  out_param(&k);
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += a[i] * k;
+  return s + k;
+}
+int walk_ptr() { int x = 3; int y = 5; int *p = &x; y++; return p[1]; }
+
+char gb = 16;
+int truncated_char() { char l = gb << 4; return l; }
+int truncated_short() { short s = gb << 12; return s; }
+int wrapped_char(int x) { char c = x; c++; return c; }
+
+int collatz(long n) {
+  int steps=0;
+  while (n != 1) {
+    if (n % 2)
+      n = n*3 + 1;
+    else
+      n = n / 2;
+    steps++;
+  }
+  return steps;
+}
+
+int main() {
+  ASSERT(55, fib(10));
+  ASSERT(0, fib(0));
+  ASSERT(231, rotate(1, 2, 3));
+  ASSERT(210, swap(1, 2));
+  ASSERT(-1, narrow(-128, 127, 0));
+  ASSERT(10, escape(3));
+  ASSERT(49, ({ int a[3] = {1, 2, 3}; escape_loop(a, 3); }));
+  ASSERT(6, walk_ptr());
+  ASSERT(111, collatz(27));
+  ASSERT(0, truncated_char());
+  ASSERT(0, truncated_short());
+  ASSERT(-128, wrapped_char(127));
+  ASSERT(6, ({ int x=1; if (x) x=6; else x=7; x; }));
+  ASSERT(3, ({ int i=0, j=0; do { j=i; i++; } while (i<3); i; }));
+  ASSERT(9, ({ int s=0; for (int i=0; i<3; i++) for (int j=0; j<3; j++) s++; s; }));
+  ASSERT(4, ({ int x=3; int a[2]={1,1}; x + a[1]; }));
+
+  printf("OK\n");
+  return 0;
+}
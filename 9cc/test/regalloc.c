@@ -0,0 +1,47 @@
+#include "test.h"
+
+int sub6(int a, int b, int c, int d, int e, int f) { return a - b * 2 + c * 3 - d * 4 + e * 5 - f * 6; }
+int id(int x) { return x; }
+
+int pressure(int n) {
+  int a=n+1, b=n+2, c=n+3, d=n+4, e=n+5, f=n+6, g=n+7, h=n+8;
+  int i=n+9, j=n+10, k=n+11, l=n+12, m=n+13, o=n+14, p=n+15, q=n+16;
+  return (a*b + c*d + e*f + g*h) - (i*j + k*l + m*o + p*q) + a+b+c+d+e+f+g+h+i+j+k+l+m+o+p+q;
+}
+
+int across_calls(int n) {
+  int x = n * 2;
+  int y = id(x) + n;
+  int z = id(y) + x;
+  return id(z) + x + y + z + n;
+}
+
+// Left-deep trees keep every right operand live until the end.
+int spills(int n) { return (((((((((((((((((((n*1 + n*2) + n*3) + n*4) + n*5) + n*6) + n*7) + n*8) + n*9) + n*10) + n*11) + n*12) + n*13) + n*14) + n*15) + n*16) + n*17) + n*18) + n*19) + n*20); }
+int spills_across_calls(int n) { return (((((((((((id(1)*n + id(2)*n) + id(3)*n) + id(4)*n) + id(5)*n) + id(6)*n) + id(7)*n) + id(8)*n) + id(9)*n) + id(10)*n) + id(11)*n) + id(12)*n); }
+
+long divmod(long a, long b, int s) {
+  long q = a / b;
+  long r = a % b;
+  int t = s << 3;
+  return q * 1000 + r * 10 + (t >> 1) + a + b;
+}
+
+int main() {
+  ASSERT(-21, sub6(1, 2, 3, 4, 5, 6));
+  ASSERT(12, ({ int a=1, b=2, c=3, d=4, e=5, f=6; sub6(b, c, d, e, f, a); }));
+  ASSERT(-12, ({ int a=1, b=2, c=3, d=4, e=5, f=6; sub6(f, a, b, c, d, e); }));
+  ASSERT(0, ({ int a=1, b=2, c=3, d=4, e=5, f=6; sub6(b, a, d, c, f, e); }));
+  ASSERT(-6, ({ int a=1, b=2, c=3; sub6(a, a, b, b, c, c); }));
+  ASSERT(-408, pressure(0));
+  ASSERT(-888, pressure(10));
+  ASSERT(630, spills(3));
+  ASSERT(-780, spills_across_calls(-10));
+  ASSERT(64, across_calls(4));
+  ASSERT(6108, divmod(47, 7, 1));
+  ASSERT(-6082, divmod(-47, 7, 2));
+  ASSERT(55, ({ int s=0; for (int i=0; i<=10; i++) s += id(i); s; }));
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include "test.h"
+
+struct S { int a; long b; };
+
+int g = 7;
+struct S gsv = {3, 4};
+
+int min(int a, int b) { return a < b ? a : b; }
+int max(int a, int b) { return a > b ? a : b; }
+long lmin(long a, long b) { return a <= b ? a : b; }
+int *pmax(int *p, int *q) { return p < q ? q : p; }
+char cmax(char a, char b) { return a > b ? a : b; }
+int sel(int f, int a, int b) { return f ? a : b; }
+int nsel(long f, int a, int b) { return !f ? a : b; }
+int cnt(int x) { return x == 3 ? 10 : 2; }
+int cnt2(int x) { return !(x <= 3) ? 1 : 0; }
+int cnt3(int x) { return x < 0 ? -1 : 0; }
+long big(int x) { return x ? 4294967296 : -1; }
+int arith(int x, int y) { return x < y ? x * 2 + 1 : y - x; }
+int glob(int x) { return x ? g : gsv.a; }
+long member(int x) { struct S s = {3, 4}; return x > 1 ? s.b : s.a; }
+int deref(int *p) { return p ? *p : -1; }
+
+int main() {
+  ASSERT(3, min(3, 5));
+  ASSERT(-5, min(3, -5));
+  ASSERT(5, max(3, 5));
+  ASSERT(3, max(3, -5));
+  ASSERT(-4294967296, lmin(-4294967296, 1));
+  ASSERT(1, lmin(4294967296, 1));
+  ASSERT(1, ({ int a[2]; pmax(a, a + 1) == a + 1; }));
+  ASSERT(1, ({ int a[2]; pmax(a + 1, a) == a + 1; }));
+  ASSERT(-3, cmax(-3, -100));
+  ASSERT(100, cmax(-3, 100));
+  ASSERT(8, sel(1, 8, 9));
+  ASSERT(9, sel(0, 8, 9));
+  ASSERT(8, nsel(0, 8, 9));
+  ASSERT(9, nsel(4294967296, 8, 9));
+  ASSERT(10, cnt(3));
+  ASSERT(2, cnt(4));
+  ASSERT(1, cnt2(4));
+  ASSERT(0, cnt2(3));
+  ASSERT(-1, cnt3(-8));
+  ASSERT(0, cnt3(8));
+  ASSERT(4294967296, big(1));
+  ASSERT(-1, big(0));
+  ASSERT(7, arith(3, 4));
+  ASSERT(-1, arith(5, 4));
+  ASSERT(7, glob(1));
+  ASSERT(3, glob(0));
+  ASSERT(4, member(2));
+  ASSERT(3, member(1));
+  ASSERT(-1, deref(0));
+  ASSERT(7, deref(&g));
+
+  ASSERT(5, ({ int i = 4; i++ < 5 ? i : 0; }));
+  ASSERT(0, ({ int i = 5; i++ < 5 ? i : 0; }));
+  ASSERT(6, ({ int i = 5, j = 0; j = i > 3 ? i + 1 : i - 1; j; }));
+  ASSERT(2, ({ int x = 5; x < 0 ? 0 : x > 2 ? 2 : x; }));
+  ASSERT(0, ({ int x = -5; x < 0 ? 0 : x > 2 ? 2 : x; }));
+  ASSERT(1, ({ int x = 1; x < 0 ? 0 : x > 2 ? 2 : x; }));
+  ASSERT(3, ({ int x = 1, y = 2; x && y ? x + y : 0; }));
+
+  printf("OK\n");
+  return 0;
+}
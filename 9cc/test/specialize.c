@@ -0,0 +1,97 @@
+#include "test.h"
+
+// Most functions are noinline, so that the calls are specialized rather
+// than inlined.
+
+enum { LAX, STRICT };
+
+__attribute__((noinline)) static int scale(int x, int size) {
+  if (size == 1)
+    return x;
+  if (size == 2)
+    return x * 2;
+  return x * size;
+}
+
+static int count(char *s, int mode) {
+  int n = 0;
+  for (; *s; s++) {
+    if (*s == ' ' && mode == STRICT)
+      return -1;
+    n++;
+  }
+  return n;
+}
+
+__attribute__((noinline)) static int sum_to(int n, int step) {
+  if (n <= 0)
+    return 0;
+  return n + sum_to(n - step, step);
+}
+
+// The clone calls itself rather than the original.
+__attribute__((noinline)) static int depth(int n, int mode) {
+  if (n == 0)
+    return 0;
+  return depth(n - 1, mode) + (mode == STRICT ? 2 : 1);
+}
+
+__attribute__((noinline)) static int bump(int x, int by) {
+  by = by * 2;
+  return x + by;
+}
+
+__attribute__((noinline)) static int via_ptr(int x, int by) {
+  int *p = &by;
+  if (by > 2)
+    return x + *p;
+  return x;
+}
+
+__attribute__((noinline)) static int narrow(char c, int x) { return c > 0 ? x + c : x - c; }
+__attribute__((noinline)) static int truth(_Bool b, int x) { return b * x; }
+
+__attribute__((noinline)) static int shift(int x, int n) { return x << n; }
+
+static void *fp = scale;
+
+int main() {
+  ASSERT(3, scale(3, 1));
+  ASSERT(6, scale(3, 2));
+  ASSERT(12, scale(3, 4));
+  ASSERT(24, scale(3, 8));
+  ASSERT(48, scale(3, 16));
+  ASSERT(96, scale(3, 32));
+  ASSERT(12, scale(3, 1 << 2));
+  ASSERT(-3, scale(3, -1));
+  ASSERT(3 * sizeof(long), scale(3, sizeof(long)));
+  int k = 5;
+  ASSERT(15, scale(3, k));
+
+  ASSERT(-1, count("a b", STRICT));
+  ASSERT(3, count("a b", LAX));
+  ASSERT(3, count("abc", STRICT));
+
+  ASSERT(55, sum_to(10, 1));
+  ASSERT(30, sum_to(10, 2));
+  ASSERT(22, sum_to(10, 3));
+
+  ASSERT(20, depth(10, STRICT));
+  ASSERT(10, depth(10, LAX));
+  ASSERT(10, depth(k * 2, LAX));
+
+  ASSERT(7, bump(3, 2));
+  ASSERT(6, via_ptr(3, 3));
+  ASSERT(3, via_ptr(3, 1));
+
+  ASSERT(50, narrow(300, 6));
+  ASSERT(10, narrow(-4, 6));
+  ASSERT(6, truth(2, 6));
+  ASSERT(0, truth(0, 6));
+  ASSERT(40, shift(5, 3));
+
+  ASSERT(1, fp != 0);
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,142 @@
+#include "test.h"
+
+// Each of these recurses 10 million times, which overflows the stack
+// unless the recursion is a loop or the calls are jumps.
+
+static long sum(long n, long acc) {
+  if (n == 0)
+    return acc;
+  return sum(n - 1, acc + n);
+}
+
+__attribute__((noinline)) int is_odd(long n);
+__attribute__((noinline)) int is_even(long n) {
+  if (n == 0)
+    return 1;
+  return is_odd(n - 1);
+}
+__attribute__((noinline)) int is_odd(long n) {
+  if (n == 0)
+    return 0;
+  return is_even(n - 1);
+}
+
+long count;
+
+void walk(long n) {
+  if (n == 0)
+    return;
+  count++;
+  walk(n - 1);
+}
+
+void walk2(long n) {
+  if (n == 0)
+    return;
+  count++;
+  if (n % 2)
+    walk2(n - 1);
+  else {
+    walk2(n - 1);
+    return;
+  }
+}
+
+// A state machine where every state calls the next one
+int state_a(char *s, int n);
+int state_b(char *s, int n);
+
+int state_a(char *s, int n) {
+  if (!*s)
+    return n;
+  if (*s == 'b')
+    return state_b(s + 1, n + 1);
+  return state_a(s + 1, n);
+}
+
+int state_b(char *s, int n) {
+  if (!*s)
+    return n;
+  if (*s == 'a')
+    return state_a(s + 1, n);
+  return state_b(s + 1, n);
+}
+
+// The arguments read parameters that are assigned before them.
+int gcd(int a, int b) {
+  if (b == 0)
+    return a;
+  return gcd(b, a % b);
+}
+
+int rotate(int a, int b, int c, int n) {
+  if (n == 0)
+    return a * 100 + b * 10 + c;
+  return rotate(b, c, a, n - 1);
+}
+
+// Parameters beyond the sixth are on the stack.
+long sum8(long n, long a, long b, long c, long d, long e, long f, long acc) {
+  if (n == 0)
+    return acc + a + b + c + d + e + f;
+  return sum8(n - 1, a, b, c, d, e, f + 1, acc + n);
+}
+
+// The callees' stack arguments take the place of the callers'.
+long sib8(long n, long a, long b, long c, long d, long e, long f, long acc);
+__attribute__((noinline)) long sib7(long n, long a, long b, long c, long d, long e, long f) {
+  return n + a + b + c + d + e + f;
+}
+__attribute__((noinline)) long mut8(long n, long a, long b, long c, long d, long e, long f, long acc) {
+  if (n == 0)
+    return sib7(acc, a, b, c, d, e, f);
+  return sib8(n - 1, f, e, d, c, b, a, acc + n);
+}
+__attribute__((noinline)) long sib8(long n, long a, long b, long c, long d, long e, long f, long acc) {
+  if (n == 0)
+    return acc * 2 + a + b + c + d + e + f;
+  return mut8(n - 1, a, b, c, d, e, f + 1, acc + n);
+}
+
+// The callee may use the caller's variables.
+int deref(int n, int *p) {
+  int x = n;
+  if (n == 0)
+    return *p;
+  return deref(n - 1, &x);
+}
+
+// The return value needs to be extended.
+char low(int x) { return x; }
+int low_int(int x) { return low(x); }
+
+int main() {
+  ASSERT(-2004260032, sum(10000000, 0));
+  ASSERT(11641, sum(10000000, 0) >> 32);
+  ASSERT(1, is_even(10000000));
+  ASSERT(0, is_odd(10000000));
+  ASSERT(1, is_odd(10000001));
+
+  count = 0;
+  walk(10000000);
+  ASSERT(10000000, count);
+  count = 0;
+  walk2(10000000);
+  ASSERT(10000000, count);
+
+  ASSERT(2, state_a("abxaab", 0));
+  ASSERT(0, state_a("", 0));
+  ASSERT(2, state_b("bbab", 1));
+
+  ASSERT(21, gcd(1071, 462));
+  ASSERT(312, rotate(1, 2, 3, 2));
+  ASSERT(123, rotate(1, 2, 3, 3));
+  ASSERT(1, sum8(10000000, 1, 2, 3, 4, 5, 6, 0) == 50000015000021);
+  ASSERT(1, mut8(10000000, 1, 2, 3, 4, 5, 6, 0) == 50000010000021);
+  ASSERT(37, mut8(1, 1, 2, 3, 4, 5, 6, 7));
+  ASSERT(1, deref(5, 0));
+  ASSERT(44, low_int(300));
+
+  printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include "test.h"
+
+int id(int x) { return x; }
+
+int balanced(int x0, int x1, int x2, int x3) { return (((((((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))) ^ ((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))))) + (((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))) ^ ((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))))) - ((((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3)))) ^ ((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))))) + (((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))) ^ ((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))))))) ^ (((((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))) ^ ((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))))) + (((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))) ^ ((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))))) - ((((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))) ^ ((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3))))) + (((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3)))) ^ ((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))))))) + ((((((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))) ^ ((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))))) + (((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))) ^ ((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3)))))) - ((((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))) ^ ((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))))) + (((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))) ^ ((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3))))))) ^ (((((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3)))) ^ ((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))))) + (((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))) ^ ((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))))) - ((((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))) ^ ((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))))) + (((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))) ^ ((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))))))))); }
+int div0(int x0, int x1, int x2, int x3) { return (x1 / x3); }
+int div1(int x0, int x1, int x2, int x3) { return ((x0 ^ x2) + (x1 / x3)); }
+int div2(int x0, int x1, int x2, int x3) { return (((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) + (x1 / x3))); }
+int div3(int x0, int x1, int x2, int x3) { return ((((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))) + (((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x1 / x3)))); }
+int div4(int x0, int x1, int x2, int x3) { return (((((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2))) - (((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0)))) + ((((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2))) + (((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x1 / x3))))); }
+int div5(int x0, int x1, int x2, int x3) { return ((((((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x0 ^ x2))) - (((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) * (x2 - x0)))) ^ ((((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2))) - (((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0))))) + (((((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2))) - (((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0)))) + ((((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))) + (((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x1 / x3)))))); }
+int div6(int x0, int x1, int x2, int x3) { return (((((((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2))) - (((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0)))) ^ ((((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2))) - (((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))))) + (((((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))) - (((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0)))) ^ ((((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2))) - (((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0)))))) + ((((((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x0 ^ x2))) - (((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) * (x2 - x0)))) ^ ((((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2))) - (((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0))))) + (((((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2))) - (((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0)))) + ((((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))) + (((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x1 / x3))))))); }
+int div7(int x0, int x1, int x2, int x3) { return ((((((((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2))) - (((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0)))) ^ ((((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2))) - (((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))))) + (((((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))) - (((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0)))) ^ ((((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2))) - (((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0)))))) - ((((((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x0 ^ x2))) - (((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) * (x2 - x0)))) ^ ((((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2))) - (((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0))))) + (((((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2))) - (((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0)))) ^ ((((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))) - (((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0))))))) + (((((((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2))) - (((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0)))) ^ ((((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x0 ^ x2))) - (((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) * (x2 - x0))))) + (((((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2))) - (((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0)))) ^ ((((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2))) - (((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0)))))) + ((((((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))) - (((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0)))) ^ ((((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2))) - (((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0))))) + (((((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x0 ^ x2))) - (((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) * (x2 - x0)))) + ((((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2))) + (((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) + (x1 / x3)))))))); }
+int mod0(int x0, int x1, int x2, int x3) { return (x1 % x3); }
+int mod1(int x0, int x1, int x2, int x3) { return ((x1 + x3) + (x1 % x3)); }
+int mod2(int x0, int x1, int x2, int x3) { return (((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x1 % x3))); }
+int mod3(int x0, int x1, int x2, int x3) { return ((((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))) + (((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) + (x1 % x3)))); }
+int mod4(int x0, int x1, int x2, int x3) { return (((((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))) - (((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1)))) + ((((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))) + (((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) + (x1 % x3))))); }
+int mod5(int x0, int x1, int x2, int x3) { return ((((((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))) - (((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1)))) ^ ((((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))) - (((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))))) + (((((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))) - (((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1)))) + ((((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))) + (((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) + (x1 % x3)))))); }
+int mod6(int x0, int x1, int x2, int x3) { return (((((((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))) - (((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1)))) ^ ((((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))) - (((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))))) + (((((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))) - (((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1)))) ^ ((((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3))) - (((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1)))))) + ((((((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))) - (((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1)))) ^ ((((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))) - (((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))))) + (((((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))) - (((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1)))) + ((((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))) + (((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) + (x1 % x3))))))); }
+int mod7(int x0, int x1, int x2, int x3) { return ((((((((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))) - (((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1)))) ^ ((((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))) - (((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))))) + (((((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))) - (((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1)))) ^ ((((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3))) - (((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1)))))) - ((((((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))) - (((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1)))) ^ ((((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))) - (((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))))) + (((((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))) - (((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1)))) ^ ((((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))) - (((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))))))) + (((((((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3))) - (((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1)))) ^ ((((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))) - (((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))))) + (((((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))) - (((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1)))) ^ ((((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))) - (((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1)))))) + ((((((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))) - (((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1)))) ^ ((((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3))) - (((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))))) + (((((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))) - (((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1)))) + ((((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))) + (((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x1 % x3)))))))); }
+int shl0(int x0, int x1, int x2, int x3) { return (x1 << x3); }
+int shl1(int x0, int x1, int x2, int x3) { return ((x2 * x0) + (x1 << x3)); }
+int shl2(int x0, int x1, int x2, int x3) { return (((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) + (x1 << x3))); }
+int shl3(int x0, int x1, int x2, int x3) { return ((((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0))) + (((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x1 << x3)))); }
+int shl4(int x0, int x1, int x2, int x3) { return (((((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))) - (((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2)))) + ((((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0))) + (((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) + (x1 << x3))))); }
+int shl5(int x0, int x1, int x2, int x3) { return ((((((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0))) - (((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2)))) ^ ((((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))) - (((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))))) + (((((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0))) - (((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2)))) + ((((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0))) + (((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x1 << x3)))))); }
+int shl6(int x0, int x1, int x2, int x3) { return (((((((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))) - (((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2)))) ^ ((((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0))) - (((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2))))) + (((((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0))) - (((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x0 ^ x2)))) ^ ((((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) * (x2 - x0))) - (((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2)))))) + ((((((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0))) - (((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2)))) ^ ((((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))) - (((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))))) + (((((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0))) - (((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2)))) + ((((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0))) + (((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x1 << x3))))))); }
+int shl7(int x0, int x1, int x2, int x3) { return ((((((((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))) - (((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2)))) ^ ((((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0))) - (((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2))))) + (((((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0))) - (((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x0 ^ x2)))) ^ ((((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) * (x2 - x0))) - (((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2)))))) - ((((((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0))) - (((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2)))) ^ ((((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))) - (((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2))))) + (((((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0))) - (((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2)))) ^ ((((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0))) - (((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x0 ^ x2))))))) + (((((((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) * (x2 - x0))) - (((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2)))) ^ ((((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0))) - (((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2))))) + (((((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))) - (((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) * (x0 - x2)))) ^ ((((x3 * x1) - (x3 + x1)) + ((x2 - x0) + (x2 + x0))) - (((x1 + x3) + (x1 ^ x3)) + ((x0 + x2) ^ (x0 * x2)))))) + ((((((x3 ^ x1) * (x3 - x1)) + ((x2 * x0) - (x2 + x0))) - (((x1 - x3) + (x1 + x3)) + ((x0 + x2) + (x0 ^ x2)))) ^ ((((x3 + x1) ^ (x3 * x1)) + ((x2 ^ x0) * (x2 - x0))) - (((x1 * x3) - (x1 + x3)) + ((x0 - x2) + (x0 + x2))))) + (((((x3 + x1) + (x3 ^ x1)) + ((x2 + x0) ^ (x2 * x0))) - (((x1 ^ x3) * (x1 - x3)) + ((x0 * x2) - (x0 + x2)))) + ((((x3 - x1) + (x3 + x1)) + ((x2 + x0) + (x2 ^ x0))) + (((x1 + x3) ^ (x1 * x3)) + ((x0 ^ x2) + (x1 << x3)))))))); }
+int sar0(int x0, int x1, int x2, int x3) { return (x1 >> x3); }
+int sar1(int x0, int x1, int x2, int x3) { return ((x3 + x1) + (x1 >> x3)); }
+int sar2(int x0, int x1, int x2, int x3) { return (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) + (x1 >> x3))); }
+int sar3(int x0, int x1, int x2, int x3) { return ((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) + (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) + (x1 >> x3)))); }
+int sar4(int x0, int x1, int x2, int x3) { return (((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))) + ((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) + (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 >> x3))))); }
+int sar5(int x0, int x1, int x2, int x3) { return ((((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))) ^ ((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))))) + (((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))) + ((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) + (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) + (x1 >> x3)))))); }
+int sar6(int x0, int x1, int x2, int x3) { return (((((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))) ^ ((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3))))) + (((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3)))) ^ ((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))))) + ((((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))) ^ ((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))))) + (((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))) + ((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) + (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) + (x1 >> x3))))))); }
+int sar7(int x0, int x1, int x2, int x3) { return ((((((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))) ^ ((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3))))) + (((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3)))) ^ ((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))))) - ((((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))) ^ ((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))))) + (((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))) ^ ((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))))))) + (((((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))) ^ ((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))))) + (((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))) ^ ((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))))) + ((((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3)))) ^ ((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))))) + (((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))) + ((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) + (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 >> x3)))))))); }
+long ldiv7(long x0, long x1, long x2, long x3) { return ((((((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))) ^ ((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3))))) + (((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))) ^ ((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))))) - ((((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3)))) ^ ((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3))))) + (((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))) ^ ((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3))))))) + (((((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))) ^ ((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))))) + (((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))) ^ ((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) - (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) ^ (x1 * x3)))))) + ((((((x0 ^ x2) * (x0 - x2)) + ((x3 * x1) - (x3 + x1))) - (((x2 - x0) + (x2 + x0)) + ((x1 + x3) + (x1 ^ x3)))) ^ ((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3))))) + (((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3)))) + ((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) + (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) + (x1 / x3)))))))); }
+int calls(int x0, int x1, int x2, int x3) { return ((((((x0 + x2) ^ (x0 * x2)) + ((x3 ^ x1) * (x3 - x1))) - (((x2 * x0) - (x2 + x0)) + ((x1 - x3) + (x1 + x3)))) ^ ((((x0 + x2) + (x0 ^ x2)) + ((x3 + x1) ^ (x3 * x1))) - (((x2 ^ x0) * (x2 - x0)) + ((x1 * x3) - (x1 + x3))))) + (((((x0 - x2) + (x0 + x2)) + ((x3 + x1) + (x3 ^ x1))) - (((x2 + x0) ^ (x2 * x0)) + ((x1 ^ x3) * (x1 - x3)))) + ((((x0 * x2) - (x0 + x2)) + ((x3 - x1) + (x3 + x1))) + (((x2 + x0) + (x2 ^ x0)) + ((x1 + x3) + (x1 + id(x0) * x3)))))); }
+
+int main() {
+  ASSERT(-144, balanced(3, -7, 11, 2));
+  ASSERT(91885, balanced(-100, 5, 9, 3));
+  ASSERT(-3, div0(3, -7, 11, 2));
+  ASSERT(1, div0(-100, 5, 9, 3));
+  ASSERT(5, div1(3, -7, 11, 2));
+  ASSERT(-106, div1(-100, 5, 9, 3));
+  ASSERT(14, div2(3, -7, 11, 2));
+  ASSERT(-99, div2(-100, 5, 9, 3));
+  ASSERT(-59, div3(3, -7, 11, 2));
+  ASSERT(11787, div3(-100, 5, 9, 3));
+  ASSERT(39, div4(3, -7, 11, 2));
+  ASSERT(-2073, div4(-100, 5, 9, 3));
+  ASSERT(82, div5(3, -7, 11, 2));
+  ASSERT(834, div5(-100, 5, 9, 3));
+  ASSERT(-45, div6(3, -7, 11, 2));
+  ASSERT(13470, div6(-100, 5, 9, 3));
+  ASSERT(-450, div7(3, -7, 11, 2));
+  ASSERT(70101, div7(-100, 5, 9, 3));
+  ASSERT(-1, mod0(3, -7, 11, 2));
+  ASSERT(2, mod0(-100, 5, 9, 3));
+  ASSERT(-6, mod1(3, -7, 11, 2));
+  ASSERT(10, mod1(-100, 5, 9, 3));
+  ASSERT(0, mod2(3, -7, 11, 2));
+  ASSERT(-190, mod2(-100, 5, 9, 3));
+  ASSERT(53, mod3(3, -7, 11, 2));
+  ASSERT(1025, mod3(-100, 5, 9, 3));
+  ASSERT(21, mod4(3, -7, 11, 2));
+  ASSERT(13289, mod4(-100, 5, 9, 3));
+  ASSERT(283, mod5(3, -7, 11, 2));
+  ASSERT(-22042, mod5(-100, 5, 9, 3));
+  ASSERT(308, mod6(3, -7, 11, 2));
+  ASSERT(-32132, mod6(-100, 5, 9, 3));
+  ASSERT(-31, mod7(3, -7, 11, 2));
+  ASSERT(-20102, mod7(-100, 5, 9, 3));
+  ASSERT(-28, shl0(3, -7, 11, 2));
+  ASSERT(40, shl0(-100, 5, 9, 3));
+  ASSERT(5, shl1(3, -7, 11, 2));
+  ASSERT(-860, shl1(-100, 5, 9, 3));
+  ASSERT(50, shl2(3, -7, 11, 2));
+  ASSERT(-848, shl2(-100, 5, 9, 3));
+  ASSERT(-54, shl3(3, -7, 11, 2));
+  ASSERT(-862, shl3(-100, 5, 9, 3));
+  ASSERT(70, shl4(3, -7, 11, 2));
+  ASSERT(-11874, shl4(-100, 5, 9, 3));
+  ASSERT(-154, shl5(3, -7, 11, 2));
+  ASSERT(-12414, shl5(-100, 5, 9, 3));
+  ASSERT(-335, shl6(3, -7, 11, 2));
+  ASSERT(11224, shl6(-100, 5, 9, 3));
+  ASSERT(-439, shl7(3, -7, 11, 2));
+  ASSERT(47758, shl7(-100, 5, 9, 3));
+  ASSERT(-2, sar0(3, -7, 11, 2));
+  ASSERT(0, sar0(-100, 5, 9, 3));
+  ASSERT(-7, sar1(3, -7, 11, 2));
+  ASSERT(8, sar1(-100, 5, 9, 3));
+  ASSERT(15, sar2(3, -7, 11, 2));
+  ASSERT(-190, sar2(-100, 5, 9, 3));
+  ASSERT(79, sar3(3, -7, 11, 2));
+  ASSERT(-11839, sar3(-100, 5, 9, 3));
+  ASSERT(-75, sar4(3, -7, 11, 2));
+  ASSERT(11804, sar4(-100, 5, 9, 3));
+  ASSERT(159, sar5(3, -7, 11, 2));
+  ASSERT(-22121, sar5(-100, 5, 9, 3));
+  ASSERT(317, sar6(3, -7, 11, 2));
+  ASSERT(-21287, sar6(-100, 5, 9, 3));
+  ASSERT(234, sar7(3, -7, 11, 2));
+  ASSERT(15806, sar7(-100, 5, 9, 3));
+  ASSERT(225, ldiv7(3, -7, 11, 2));
+  ASSERT(71344, ldiv7(-100, 5, 9, 3));
+  ASSERT(-36, calls(3, -7, 11, 2));
+  ASSERT(8318, calls(-100, 5, 9, 3));
+  ASSERT(1, ({ int a=3, b=4; (a*b - (a+b)) / (b-a) % 4; }));
+  ASSERT(-4, ({ int a=8; long b=2; -(a >> b) << 1; }));
+
+  printf("OK\n");
+  return 0;
+}
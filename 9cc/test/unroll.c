@@ -0,0 +1,195 @@
+#include "test.h"
+
+int g[20];
+
+int sum_const(int *a) {
+  int s = 0;
+  for (int i = 0; i < 4; i++)
+    s += a[i];
+  return s;
+}
+
+int sum_inclusive(void) {
+  int s = 0;
+  for (int i = 2; i <= 10; i += 3)
+    s = s * 10 + i;
+  return s;
+}
+
+int zero_trip(void) {
+  int s = 7;
+  for (int i = 5; i < 3; i++)
+    s++;
+  return s;
+}
+
+int live_out(void) {
+  int i;
+  int s = 0;
+  for (i = 0; i < 10; i += 4)
+    s += i;
+  return i * 100 + s;
+}
+
+int const_break(int k) {
+  int i;
+  for (i = 0; i < 8; i++)
+    if (i == k)
+      break;
+  return i;
+}
+
+int const_continue(void) {
+  int s = 0;
+  for (int i = 0; i < 6; i++) {
+    if (i % 2)
+      continue;
+    s += i;
+  }
+  return s;
+}
+
+int nested_const(void) {
+  int s = 0;
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) {
+      if (j == 2)
+        break;
+      s += i * 10 + j;
+    }
+  return s;
+}
+
+int sum_n(int *a, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += a[i];
+  return s;
+}
+
+int sum_step(int *a, int from, int n) {
+  int s = 0;
+  for (int i = from; i <= n; i += 3)
+    s += a[i];
+  return s;
+}
+
+int find(int *a, int n, int x) {
+  int i;
+  for (i = 0; i < n; i++)
+    if (a[i] == x)
+      break;
+  return i;
+}
+
+int odd_sum(int *a, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++) {
+    if (a[i] % 2 == 0)
+      continue;
+    s += a[i];
+  }
+  return s;
+}
+
+long count_long(long from, long to) {
+  long s = 0;
+  for (long i = from; i < to; i++)
+    s++;
+  return s;
+}
+
+int count_int(int from, int to) {
+  int s = 0;
+  for (int i = from; i <= to; i++)
+    s++;
+  return s;
+}
+
+int fill(int n) {
+  for (int i = 0; i < n; i++)
+    g[i] = i * i;
+  int s = 0;
+  for (int i = 0; i < 20; i++)
+    s += g[i];
+  return s;
+}
+
+int pragma_partial(int n) {
+  int s = 0;
+#pragma unroll(3)
+  for (int i = 0; i < n; i++)
+    s = s * 2 + 1;
+  return s;
+}
+
+int pragma_full(void) {
+  int s = 0;
+#pragma GCC unroll 32
+  for (int i = 0; i < 30; i++)
+    s += i;
+  return s;
+}
+
+int pragma_nounroll(void) {
+  int s = 0;
+#pragma nounroll
+  for (int i = 0; i < 4; i++)
+    s += i;
+  return s;
+}
+
+// The break of the partially unrolled inner loop jumps past its
+// remainder loop, and the outer loop is unrolled fully around both.
+int gv = 3;
+int nested_break(int a) {
+  int s = 0;
+  for (long i = 0; i < 1; i += 1) {
+    for (int j = 0; j < 16; j += 1) {
+      if (gv < 8 ? gv - a : a)
+        break;
+      s++;
+    }
+  }
+  return s;
+}
+
+int main() {
+  int a[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+
+  ASSERT(10, sum_const(a));
+  ASSERT(258, sum_inclusive());
+  ASSERT(7, zero_trip());
+  ASSERT(1212, live_out());
+  ASSERT(3, const_break(3));
+  ASSERT(8, const_break(9));
+  ASSERT(6, const_continue());
+  ASSERT(63, nested_const());
+
+  for (int n = 0; n <= 13; n++)
+    ASSERT(n * (n + 1) / 2, sum_n(a, n));
+  ASSERT(0, sum_n(a, -5));
+  ASSERT(1 + 4 + 7 + 10 + 13, sum_step(a, 0, 12));
+  ASSERT(2 + 5 + 8 + 11, sum_step(a, 1, 11));
+  ASSERT(0, sum_step(a, 5, 4));
+  ASSERT(6, find(a, 13, 7));
+  ASSERT(13, find(a, 13, 99));
+  ASSERT(49, odd_sum(a, 13));
+  ASSERT(10, count_long(-5, 5));
+  ASSERT(0, count_long(5, -5));
+  ASSERT(3, count_long(9223372036854775804, 9223372036854775807));
+  ASSERT(20, count_long(-9223372036854775807 - 1, -9223372036854775807 + 19));
+  ASSERT(3, count_int(2147483644, 2147483646));
+  ASSERT(9, count_int(-2147483647 - 1, -2147483647 + 7));
+  ASSERT(285, fill(10));
+  ASSERT(2470, fill(20));
+  ASSERT(127, pragma_partial(7));
+  ASSERT(0, pragma_partial(0));
+  ASSERT(435, pragma_full());
+  ASSERT(6, pragma_nounroll());
+  ASSERT(16, nested_break(3));
+  ASSERT(0, nested_break(1));
+
+  printf("OK\n");
+  return 0;
+}
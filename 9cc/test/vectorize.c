@@ -0,0 +1,211 @@
+#include "test.h"
+
+int g1[40];
+int g2[40];
+
+void add(int *p, int *a, int *b, int n) {
+  for (int i = 0; i < n; i++)
+    p[i] = a[i] + b[i];
+}
+
+int sum(int *a, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += a[i];
+  return s;
+}
+
+int sum_n(int *a, int n) {
+  for (int i = 0; i < n; i++)
+    a[i] = i + 1;
+  return sum(a, n);
+}
+
+int reductions(int *a, int n) {
+  int d = 1000;
+  int x = 0;
+  int m = -1;
+  int o = 0;
+  for (int i = 0; i < n; i++) {
+    d -= a[i];
+    x ^= a[i];
+    m &= a[i] | 64;
+    o |= a[i];
+  }
+  return d * 1000000 + x * 10000 + m * 100 + o;
+}
+
+char char_sum(char *s, int n) {
+  char c = 0;
+  for (int i = 0; i < n; i++)
+    c += s[i];
+  return c;
+}
+
+void xor_chars(char *s, int n, int k) {
+  for (int i = 0; i < n; i++)
+    s[i] ^= k;
+}
+
+void scale(short *a, int n, int k) {
+  for (int i = 0; i < n; i++)
+    a[i] = a[i] * k - 1;
+}
+
+// Conversions to _Bool compare with 0.
+void bool_inc(_Bool *d, _Bool *s, int n) {
+  for (int i = 0; i < n; i++)
+    d[i] = s[i] + 1;
+}
+
+void char_to_bool(_Bool *d, char *s, int n) {
+  for (int i = 0; i < n; i++)
+    d[i] = s[i];
+}
+
+long long_sum(long *a, long from, long to) {
+  long s = 0;
+  for (long i = from; i <= to; i++)
+    s += a[i];
+  return s;
+}
+
+void negate(int *p, int *a, int n) {
+  for (int i = 0; i < n; i++)
+    p[i] = -a[i] + ~a[i];
+}
+
+void shift_up(int *a, int n) {
+  for (int i = 0; i < n; i++)
+    a[i + 1] = a[i] + 1;
+}
+
+void shift_down(int *a, int n) {
+  for (int i = 0; i < n; i++)
+    a[i] = a[i + 1] + 1;
+}
+
+void globals(int n) {
+  for (int i = 0; i < n; i++)
+    g1[i] = g2[i + 1] + g2[i] + 5;
+}
+
+int few(int *a) {
+  int s = 0;
+  for (int i = 0; i < 3; i++)
+    s += a[i];
+  return s;
+}
+
+int main() {
+  int a[40], b[40], c[40];
+  char s[50];
+  short h[30];
+  long l[20];
+
+  for (int i = 0; i < 40; i++) {
+    a[i] = i;
+    b[i] = 100 * i;
+  }
+  add(c, a, b, 37);
+  ASSERT(0, c[0]);
+  ASSERT(3636, c[36]);
+  ASSERT(101 * 666, sum(c, 37));
+  for (int n = 0; n <= 20; n++)
+    ASSERT(n * (n + 1) / 2, sum_n(c, n));
+  ASSERT(0, sum(c, -3));
+
+  // The destination overlaps a source one element ahead, so the
+  // vector loop must not run.
+  for (int i = 0; i < 40; i++)
+    c[i] = 1;
+  add(c + 1, c, c, 20);
+  ASSERT(1 << 20, c[20]);
+  // One element behind is safe.
+  for (int i = 0; i < 40; i++)
+    c[i] = i;
+  add(c, c + 1, c + 1, 20);
+  ASSERT(2, c[0]);
+  ASSERT(40, c[19]);
+  ASSERT(20, c[20]);
+
+  for (int i = 0; i < 40; i++)
+    a[i] = i * 3;
+  int d = 1000, x = 0, m = -1, o = 0;
+  for (int i = 0; i < 23; i++) {
+    d -= a[i];
+    x ^= a[i];
+    m &= a[i] | 64;
+    o |= a[i];
+  }
+  ASSERT(d * 1000000 + x * 10000 + m * 100 + o, reductions(a, 23));
+
+  for (int i = 0; i < 50; i++)
+    s[i] = i * 7;
+  int cs = 0;
+  for (int i = 0; i < 45; i++)
+    cs += s[i];
+  ASSERT((char)cs, char_sum(s, 45));
+  xor_chars(s, 45, 0x41);
+  ASSERT(0x41, s[0]);
+  ASSERT((char)((44 * 7) ^ 0x41), s[44]);
+  ASSERT((char)(45 * 7), s[45]);
+
+  for (int i = 0; i < 30; i++)
+    h[i] = i * 1000;
+  scale(h, 29, 3);
+  ASSERT(-1, h[0]);
+  ASSERT((short)(28000 * 3 - 1), h[28]);
+  ASSERT(29000, h[29]);
+
+  for (int i = 0; i < 20; i++)
+    l[i] = i * 10000000000;
+  ASSERT(150000000000, long_sum(l, 0, 5));
+  ASSERT(0, long_sum(l, 5, 4));
+  ASSERT(190000000000, long_sum(l, 19, 19));
+
+  for (int i = 0; i < 40; i++)
+    a[i] = i;
+  negate(c, a, 11);
+  ASSERT(-1, c[0]);
+  ASSERT(-21, c[10]);
+
+  for (int i = 0; i < 40; i++)
+    a[i] = 0;
+  shift_up(a, 10);
+  ASSERT(10, a[10]);
+  for (int i = 0; i < 40; i++)
+    a[i] = i;
+  shift_down(a, 10);
+  ASSERT(2, a[0]);
+  ASSERT(11, a[9]);
+  ASSERT(10, a[10]);
+
+  for (int i = 0; i < 40; i++)
+    g2[i] = i;
+  globals(39);
+  ASSERT(1 + 0 + 5, g1[0]);
+  ASSERT(39 + 38 + 5, g1[38]);
+  ASSERT(0, g1[39]);
+
+  ASSERT(2 + 3 + 4, few(a));
+
+  _Bool b1[40], b2[40];
+  char c1[40];
+  for (int i = 0; i < 40; i++) {
+    b1[i] = i % 3;
+    c1[i] = i % 4 * 2;
+  }
+  bool_inc(b2, b1, 40);
+  ASSERT(1, b2[0]);
+  ASSERT(1, b2[1]);
+  ASSERT(1, b2[37]);
+  char_to_bool(b2, c1, 40);
+  ASSERT(0, b2[0]);
+  ASSERT(1, b2[1]);
+  ASSERT(1, b2[2]);
+  ASSERT(1, b2[39]);
+
+  printf("OK\n");
+  return 0;
+}
@@ -6,6 +6,9 @@ static char *current_filename;
 // Input string
 static char *current_input;
 
+// Text of a #pragma line that is attached to the next token
+static char *pending_pragma;
+
 //
 // tokenizer
 //
@@ -69,6 +72,20 @@ void error_tok(Token *tok, char *fmt, ...)
   exit(1);
 }
 
+// Reports a message that is not an error, such as an optimization
+// remark, in the following format.
+//
+// foo.c:10: remark: <message>
+void note_tok(Token *tok, char *kind, char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "%s:%d: %s: ", current_filename, tok->line_no, kind);
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+}
+
 // Consumes the current token if it matches `op`.
 bool equal(Token *tok, char *op)
 {
@@ -101,6 +118,8 @@ static Token *new_token(TokenKind kind, char *start, char *end)
   tok->kind = kind;
   tok->loc = start;
   tok->len = end - start;
+  tok->pragma = pending_pragma;
+  pending_pragma = NULL;
   return tok;
 }
 
@@ -196,6 +215,8 @@ static bool is_keyword(Token *tok)
       "_Alignas",
       "do",
       "signed",
+      "inline",
+      "const",
   };
 
   for (int i = 0; i < sizeof(kw) / sizeof(*kw); i++)
@@ -381,6 +402,29 @@ static void add_line_numbers(Token *tok)
   } while (*p++);
 }
 
+static bool at_bol(char *p)
+{
+  while (p > current_input && (p[-1] == ' ' || p[-1] == '\t'))
+    p--;
+  return p == current_input || p[-1] == '\n';
+}
+
+// The input has already been preprocessed, so the only directives
+// left are #pragma lines and line markers. Pragmas are kept for the
+// parser, e.g. "#pragma unroll" for the loop that follows it.
+static char *skip_directive(char *p)
+{
+  char *start = ++p;
+  while (*p && *p != '\n')
+    p++;
+
+  while (*start == ' ' || *start == '\t')
+    start++;
+  if (startswith(start, "pragma") && (start[6] == ' ' || start[6] == '\t'))
+    pending_pragma = strndup(start + 7, p - start - 7);
+  return p;
+}
+
 // Tokenize a given string and returns new tokens.
 static Token *tokenize(char *filename, char *p)
 {
@@ -417,6 +461,13 @@ static Token *tokenize(char *filename, char *p)
       continue;
     }
 
+    // Directive line
+    if (*p == '#' && at_bol(p))
+    {
+      p = skip_directive(p);
+      continue;
+    }
+
     // Numeric literal
     if (isdigit(*p))
     {
@@ -0,0 +1,609 @@
+#include "9cc.h"
+
+//
+// Loop unrolling
+//
+// This AST pass unrolls counted "for" loops of the form
+//
+//   for (init; i < n; i += c) body      (or i <= n)
+//
+// where i is an int or long local that the body doesn't assign, c is
+// a positive constant and n doesn't change in the loop.
+//
+// If the start value and n are constants and the trip count is small,
+// the loop is replaced by copies of the body with i replaced by its
+// value in each iteration, which the folder then simplifies.
+//
+// Otherwise, an innermost loop is unrolled by 2, 4 or 8. The unrolled
+// loop runs while at least that many iterations remain, and the
+// original loop runs the rest:
+//
+//   init;
+//   for (; n - i > 3c; ) { body; i += c; body; i += c; ... }
+//   for (; i < n; i += c) body
+//
+// Copies must not grow the function beyond a budget, except when
+// "#pragma unroll" asks for it.
+//
+
+// Maximum number of iterations of a fully unrolled loop
+#define FULL_TRIP_LIMIT 16
+
+// Maximum number of nodes of a fully unrolled loop
+#define FULL_BUDGET 256
+
+// Maximum number of nodes of the body of a partially unrolled loop
+#define PARTIAL_BUDGET 128
+
+// Maximum number of copies "#pragma unroll" may ask for
+#define PRAGMA_LIMIT 1024
+
+static int nfull;
+static int npartial;
+
+static Node *new_node(NodeKind kind, Token *tok)
+{
+  Node *node = calloc(1, sizeof(Node));
+  node->kind = kind;
+  node->tok = tok;
+  return node;
+}
+
+static Node *new_num(int64_t val, Type *ty, Token *tok)
+{
+  Node *node = new_node(ND_NUM, tok);
+  node->val = (ty->size == 4) ? (int32_t)val : val;
+  node->ty = ty;
+  return node;
+}
+
+static Node *new_binary(NodeKind kind, Node *lhs, Node *rhs, Token *tok)
+{
+  Node *node = new_node(kind, tok);
+  node->lhs = lhs;
+  node->rhs = rhs;
+  return node;
+}
+
+static Node *new_var(Obj *var, Token *tok)
+{
+  Node *node = new_node(ND_VAR, tok);
+  node->var = var;
+  node->ty = var->ty;
+  return node;
+}
+
+static Node *new_label(char *label, Token *tok)
+{
+  Node *node = new_node(ND_LABEL, tok);
+  node->label = label;
+  node->unique_label = label;
+  node->lhs = new_node(ND_BLOCK, tok);
+  return node;
+}
+
+static Node *assign_stmt(Obj *var, int64_t val, Token *tok)
+{
+  Node *node = new_binary(ND_ASSIGN, new_var(var, tok), new_num(val, var->ty, tok), tok);
+  node->ty = var->ty;
+  return new_binary(ND_EXPR_STMT, node, NULL, tok);
+}
+
+static bool is_scalar(Type *ty)
+{
+  return ty->kind != TY_ARRAY && ty->kind != TY_STRUCT && ty->kind != TY_UNION;
+}
+
+// Calls `fn` on every node of a tree until it returns true.
+bool any_node(Node *node, bool (*fn)(Node *, void *), void *arg)
+{
+  if (!node)
+    return false;
+  if (fn(node, arg))
+    return true;
+
+  Node *kids[] = {node->lhs, node->rhs, node->cond, node->then,
+                  node->els, node->init, node->inc};
+  for (int i = 0; i < sizeof(kids) / sizeof(*kids); i++)
+    if (any_node(kids[i], fn, arg))
+      return true;
+  for (Node *n = node->body; n; n = n->next)
+    if (any_node(n, fn, arg))
+      return true;
+  for (Node *n = node->args; n; n = n->next)
+    if (any_node(n, fn, arg))
+      return true;
+  return false;
+}
+
+static bool is_assign_to(Node *node, void *var)
+{
+  return node->kind == ND_ASSIGN && node->lhs->kind == ND_VAR && node->lhs->var == var;
+}
+
+static bool is_use_of(Node *node, void *var)
+{
+  return node->kind == ND_VAR && node->var == var;
+}
+
+static bool is_scalar_addr(Node *node, void *arg)
+{
+  return node->kind == ND_ADDR && node->lhs->kind == ND_VAR &&
+         node->lhs->var->is_local && is_scalar(node->lhs->var->ty);
+}
+
+static bool is_jump_target(Node *node, void *arg)
+{
+  return node->kind == ND_LABEL || node->kind == ND_CASE || node->kind == ND_SWITCH;
+}
+
+static bool is_goto(Node *node, void *label)
+{
+  return node->kind == ND_GOTO && node->unique_label == label;
+}
+
+static bool is_loop(Node *node, void *arg)
+{
+  return node->kind == ND_FOR || node->kind == ND_DO;
+}
+
+static bool count_node(Node *node, void *arg)
+{
+  (*(int *)arg)++;
+  return false;
+}
+
+static int count_nodes(Node *node)
+{
+  int n = 0;
+  any_node(node, count_node, &n);
+  return n;
+}
+
+static Node *skip_casts(Node *node)
+{
+  while (node->kind == ND_CAST && node->ty->size >= node->lhs->ty->size &&
+         is_integer(node->lhs->ty))
+    node = node->lhs;
+  return node;
+}
+
+// Returns true if an expression has the same value in every iteration
+// of a loop with the given body.
+static bool is_invariant(Node *node, Node *body)
+{
+  switch (node->kind)
+  {
+  case ND_NUM:
+    return true;
+  case ND_VAR:
+    return node->var->is_local && is_scalar(node->var->ty) &&
+           !any_node(body, is_assign_to, node->var);
+  case ND_CAST:
+  case ND_NEG:
+    return is_invariant(node->lhs, body);
+  case ND_ADD:
+  case ND_SUB:
+  case ND_MUL:
+    return is_invariant(node->lhs, body) && is_invariant(node->rhs, body);
+  }
+  return false;
+}
+
+// Finds the value that `init` leaves in `var`. Returns false if it
+// does something we don't understand with it.
+static bool start_value(Node *node, Obj *var, CountedLoop *c)
+{
+  if (!node)
+    return true;
+
+  switch (node->kind)
+  {
+  case ND_BLOCK:
+    for (Node *n = node->body; n; n = n->next)
+      if (!start_value(n, var, c))
+        return false;
+    return true;
+  case ND_EXPR_STMT:
+    return start_value(node->lhs, var, c);
+  case ND_COMMA:
+    return start_value(node->lhs, var, c) && start_value(node->rhs, var, c);
+  case ND_MEMZERO:
+    if (node->var == var)
+    {
+      c->has_start = true;
+      c->start = 0;
+    }
+    return true;
+  case ND_ASSIGN:
+    if (is_assign_to(node, var))
+    {
+      if (any_node(node->rhs, is_assign_to, var))
+        return false;
+      c->has_start = (node->rhs->kind == ND_NUM);
+      c->start = node->rhs->val;
+      return true;
+    }
+    break;
+  }
+  return !any_node(node, is_assign_to, var);
+}
+
+// Matches `i = i + c`, the form of i++, ++i and i += c after
+// parsing, possibly as the value of `(i = i + c) - c` for i++.
+static bool match_inc(Node *node, CountedLoop *c)
+{
+  node = skip_casts(node);
+  if (node->kind == ND_ADD && node->rhs->kind == ND_NUM)
+    node = skip_casts(node->lhs);
+  if (node->kind != ND_ASSIGN || node->lhs->kind != ND_VAR)
+    return false;
+
+  Node *add = skip_casts(node->rhs);
+  if (add->kind != ND_ADD)
+    return false;
+  Node *lhs = skip_casts(add->lhs);
+  if (lhs->kind != ND_VAR || lhs->var != node->lhs->var)
+    return false;
+  Node *num = skip_casts(add->rhs);
+  if (num->kind != ND_NUM || num->val <= 0)
+    return false;
+
+  c->var = node->lhs->var;
+  c->step = num->val;
+  c->inc = node;
+  return true;
+}
+
+// Matches a counted loop. The vectorizer uses this too.
+bool match_counted_loop(Node *node, CountedLoop *c)
+{
+  *c = (CountedLoop){.loop = node};
+  if (!node->cond || !node->inc || !match_inc(node->inc, c))
+    return false;
+
+  Obj *var = c->var;
+  if (!var->is_local || (var->ty->kind != TY_INT && var->ty->kind != TY_LONG))
+    return false;
+
+  Node *cond = node->cond;
+  if ((cond->kind != ND_LT && cond->kind != ND_LE) || cond->lhs->ty->size < var->ty->size)
+    return false;
+  Node *lhs = skip_casts(cond->lhs);
+  if (lhs->kind != ND_VAR || lhs->var != var)
+    return false;
+  c->inclusive = (cond->kind == ND_LE);
+  c->limit = cond->rhs;
+
+  Node *body = node->then;
+  if (any_node(body, is_assign_to, var) || any_node(body, is_jump_target, NULL))
+    return false;
+  if (!is_invariant(c->limit, body) || any_node(c->limit, is_use_of, var))
+    return false;
+  return start_value(node->init, var, c);
+}
+
+//
+// Copying loop bodies
+//
+// Labels must be unique, so loops inside a copy get new break and
+// continue labels, and jumps to them are redirected. A "continue" of
+// the unrolled loop jumps to the end of its own copy.
+//
+// All loops in a body are renamed before anything is copied, because
+// a jump may come before the loop whose label it targets: the break
+// of a partially unrolled loop jumps past the remainder loop that
+// follows it.
+//
+
+typedef struct LabelMap LabelMap;
+struct LabelMap
+{
+  LabelMap *next;
+  char *from;
+  char *to;
+};
+
+static LabelMap *labels;
+
+// If set, uses of `subst_var` are replaced by `subst_val`.
+static Obj *subst_var;
+static int64_t subst_val;
+
+static char *rename_label(char *label)
+{
+  LabelMap *m = calloc(1, sizeof(LabelMap));
+  m->from = label;
+  m->to = new_unique_name();
+  m->next = labels;
+  labels = m;
+  return m->to;
+}
+
+static char *map_label(char *label)
+{
+  for (LabelMap *m = labels; m; m = m->next)
+    if (m->from == label)
+      return m->to;
+  return label;
+}
+
+static bool rename_loop(Node *node, void *arg)
+{
+  if (node->kind == ND_FOR || node->kind == ND_DO)
+  {
+    rename_label(node->brk_label);
+    rename_label(node->cont_label);
+  }
+  return false;
+}
+
+// Returns the new name of a loop label, renaming it if the loop was
+// not seen by rename_loop().
+static char *loop_label(char *label)
+{
+  char *to = map_label(label);
+  return (to != label) ? to : rename_label(label);
+}
+
+Node *copy_node(Node *node)
+{
+  if (!node)
+    return NULL;
+
+  if (node->kind == ND_VAR && node->var == subst_var)
+    return new_num(subst_val, node->ty, node->tok);
+
+  Node *n = calloc(1, sizeof(Node));
+  *n = *node;
+  n->next = NULL;
+
+  if (node->kind == ND_FOR || node->kind == ND_DO)
+  {
+    n->brk_label = loop_label(node->brk_label);
+    n->cont_label = loop_label(node->cont_label);
+  }
+  if (node->kind == ND_GOTO)
+    n->unique_label = map_label(node->unique_label);
+
+  n->lhs = copy_node(node->lhs);
+  n->rhs = copy_node(node->rhs);
+  n->cond = copy_node(node->cond);
+  n->then = copy_node(node->then);
+  n->els = copy_node(node->els);
+  n->init = copy_node(node->init);
+  n->inc = copy_node(node->inc);
+
+  Node head = {};
+  Node *cur = &head;
+  for (Node *m = node->body; m; m = m->next)
+    cur = cur->next = copy_node(m);
+  n->body = head.next;
+
+  head.next = NULL;
+  cur = &head;
+  for (Node *m = node->args; m; m = m->next)
+    cur = cur->next = copy_node(m);
+  n->args = head.next;
+  return n;
+}
+
+// Appends a folded copy of the loop body to `cur`. If the body has
+// "continue", it jumps to a label at the end of the copy.
+static Node *add_copy(Node *cur, Node *loop, bool has_continue)
+{
+  labels = NULL;
+  char *cont = has_continue ? rename_label(loop->cont_label) : NULL;
+  any_node(loop->then, rename_loop, NULL);
+
+  cur = cur->next = fold_stmt(copy_node(loop->then));
+  cur->next = NULL;
+  if (cont)
+    cur = cur->next = new_label(cont, loop->tok);
+  return cur;
+}
+
+//
+// Unrolling
+//
+
+static int64_t trip_count(CountedLoop *c)
+{
+  int64_t limit = skip_casts(c->limit)->val;
+  if (c->inclusive)
+    limit++;
+  if (limit <= c->start)
+    return 0;
+  return (limit - c->start + c->step - 1) / c->step;
+}
+
+static Node *unroll_full(CountedLoop *c, int64_t trip)
+{
+  Node *loop = c->loop;
+  Token *tok = loop->tok;
+  bool has_break = any_node(loop->then, is_goto, loop->brk_label);
+  bool has_continue = any_node(loop->then, is_goto, loop->cont_label);
+
+  // A variable declared in the loop is dead after it.
+  bool live_out = !(loop->init && loop->init->kind == ND_BLOCK);
+
+  Node head = {};
+  Node *cur = &head;
+  if (loop->init)
+    cur = cur->next = loop->init;
+
+  subst_var = c->var;
+  for (int64_t k = 0; k < trip; k++)
+  {
+    subst_val = c->start + k * c->step;
+    if (live_out && has_break && k > 0)
+      cur = cur->next = assign_stmt(c->var, subst_val, tok);
+    cur = add_copy(cur, loop, has_continue);
+  }
+  subst_var = NULL;
+
+  if (live_out)
+    cur = cur->next = assign_stmt(c->var, c->start + trip * c->step, tok);
+  if (has_break)
+    cur = cur->next = new_label(loop->brk_label, tok);
+
+  Node *block = new_node(ND_BLOCK, tok);
+  block->body = head.next;
+  nfull++;
+  return block;
+}
+
+// Builds the condition that at least `factor` more iterations remain:
+// n - i > (factor - 1) * c, or >= for `<=` loops. An int is widened so
+// that the subtraction can't overflow. With longs, it is computed only
+// if i < n, and if it overflows, the remaining iterations run in the
+// original loop.
+Node *remaining_cond(CountedLoop *c, int factor)
+{
+  Node *cond = c->loop->cond;
+  Token *tok = cond->tok;
+  NodeKind kind = c->inclusive ? ND_LE : ND_LT;
+  Node *k = new_num((factor - 1) * c->step, ty_long, tok);
+
+  if (cond->lhs->ty->size == 4)
+  {
+    Node *n = new_cast(copy_node(cond->rhs), ty_long);
+    Node *i = new_cast(copy_node(cond->lhs), ty_long);
+    Node *node = new_binary(kind, k, new_binary(ND_SUB, n, i, tok), tok);
+    add_type(node);
+    return node;
+  }
+
+  Node *diff = new_binary(ND_SUB, copy_node(cond->rhs), copy_node(cond->lhs), tok);
+  Node *node = new_binary(ND_LOGAND, copy_node(cond), new_binary(kind, k, diff, tok), tok);
+  add_type(node);
+  return node;
+}
+
+static Node *unroll_partial(CountedLoop *c, int factor)
+{
+  Node *loop = c->loop;
+  Token *tok = loop->tok;
+  bool has_continue = any_node(loop->then, is_goto, loop->cont_label);
+
+  Node head = {};
+  Node *cur = &head;
+  for (int k = 0; k < factor; k++)
+  {
+    cur = add_copy(cur, loop, has_continue);
+    cur = cur->next = new_binary(ND_EXPR_STMT, copy_node(c->inc), NULL, tok);
+  }
+
+  Node *main = new_node(ND_FOR, tok);
+  main->cond = remaining_cond(c, factor);
+  main->then = new_node(ND_BLOCK, tok);
+  main->then->body = head.next;
+  main->brk_label = new_unique_name();
+  main->cont_label = new_unique_name();
+  main->unroll = 1;
+
+  Node *block = new_node(ND_BLOCK, tok);
+  if (loop->init)
+  {
+    block->body = loop->init;
+    loop->init->next = main;
+    loop->init = NULL;
+  }
+  else
+  {
+    block->body = main;
+  }
+  main->next = loop;
+  loop->next = NULL;
+  loop->unroll = 1;
+  npartial++;
+  return block;
+}
+
+// Frame walks like `*(&x+1)` may change any local, so functions that
+// take the address of a scalar local are left alone (see mem2reg.c).
+static bool frame_walk;
+
+static Node *unroll_loop(Node *node)
+{
+  if (node->unroll == 1 || frame_walk)
+    return node;
+
+  CountedLoop c;
+  if (!match_counted_loop(node, &c))
+    return node;
+
+  int size = count_nodes(node->then) + count_nodes(node->inc);
+  bool constant = c.has_start && skip_casts(c.limit)->kind == ND_NUM;
+
+  if (constant)
+  {
+    int64_t trip = trip_count(&c);
+    if (node->unroll == -1 && trip <= PRAGMA_LIMIT)
+      return unroll_full(&c, trip);
+    if (node->unroll > 1 && trip <= node->unroll)
+      return unroll_full(&c, trip);
+    if (!node->unroll && trip <= FULL_TRIP_LIMIT && trip * size <= FULL_BUDGET)
+      return unroll_full(&c, trip);
+    if (trip < 2)
+      return node;
+  }
+
+  if (node->unroll > 1)
+    return unroll_partial(&c, MIN(node->unroll, PRAGMA_LIMIT));
+  if (any_node(node->then, is_loop, NULL))
+    return node;
+
+  for (int factor = 8; factor > 1; factor /= 2)
+    if (factor * size <= PARTIAL_BUDGET)
+      return unroll_partial(&c, factor);
+  return node;
+}
+
+static Node *unroll_stmt(Node *node)
+{
+  if (!node)
+    return NULL;
+
+  switch (node->kind)
+  {
+  case ND_BLOCK:
+    for (Node **p = &node->body; *p; p = &(*p)->next)
+    {
+      Node *next = (*p)->next;
+      *p = unroll_stmt(*p);
+      (*p)->next = next;
+    }
+    return node;
+  case ND_IF:
+    node->then = unroll_stmt(node->then);
+    node->els = unroll_stmt(node->els);
+    return node;
+  case ND_FOR:
+    node->then = unroll_stmt(node->then);
+    return unroll_loop(node);
+  case ND_DO:
+  case ND_SWITCH:
+    node->then = unroll_stmt(node->then);
+    return node;
+  case ND_CASE:
+  case ND_LABEL:
+    node->lhs = unroll_stmt(node->lhs);
+    return node;
+  }
+  return node;
+}
+
+void unroll_loops(Obj *prog)
+{
+  nfull = npartial = 0;
+  for (Obj *fn = prog; fn; fn = fn->next)
+  {
+    if (!fn->is_function || !fn->is_definition)
+      continue;
+    frame_walk = any_node(fn->body, is_scalar_addr, NULL);
+    fn->body = unroll_stmt(fn->body);
+  }
+  count_stat("unroll-full", "loops", nfull);
+  count_stat("unroll-part", "loops", npartial);
+}
@@ -0,0 +1,954 @@
+#include "9cc.h"
+
+//
+// Loop vectorization
+//
+// This AST pass rewrites innermost counted loops with a step of 1
+// whose body is a list of statements of the forms
+//
+//   p[i + k] = x;        (or p[i + k] op= x)
+//   s = s op x;          (op is +, -, ^, & or |)
+//
+// so that each iteration processes VF elements with SSE2 instructions,
+// or AVX2 with -mavx2. All elements must have the same size, and VF
+// is the vector width divided by that size. x may load p[i + k], use
+// variables that don't change in the loop and constants, and combine
+// them with +, -, &, |, ^, ~ and unary -, and * for shorts (or ints
+// with AVX2). These operations only depend on the low bytes of their
+// operands, so C's int arithmetic on chars gives the same chars when
+// it is done on bytes.
+//
+// A reduction keeps a vector of partial results in a register and
+// combines its lanes after the loop. Pointers that may point into the
+// same array are checked for overlap before the loop, and if they do
+// overlap or fewer than VF iterations remain, the original loop runs
+// the rest:
+//
+//   init;
+//   if (no overlap) {
+//     v15 = splat(x); v14 = 0; ...
+//     for (; n - i > VF - 1; ) { vector body; i += VF; }
+//     s = s op reduce(v14); ...
+//   }
+//   for (; i < n; i++) body
+//
+// -Rpass=vectorize and -Rpass-missed=vectorize report which loops are
+// vectorized and why the others are not.
+//
+
+// Number of vector registers
+#define NUM_VREGS 16
+
+// Maximum number of memory accesses in a loop body
+#define MAX_ACCESSES 16
+
+// Maximum number of pointer pairs checked for overlap at run time
+#define MAX_CHECKS 8
+
+// A load or store of base[i + off / es], in the order they happen
+typedef struct
+{
+  Node *base; // pointer or array variable
+  int64_t off;
+  bool is_store;
+} Access;
+
+// Reduction `s = s op x`
+typedef struct
+{
+  Obj *var;
+  NodeKind op;
+  int vreg;
+} Reduction;
+
+// Loop-invariant value in every lane of a register
+typedef struct
+{
+  Node *expr;
+  int vreg;
+} Splat;
+
+static int nvectorized;
+static int nrejected;
+
+// Frame walks like `*(&x+1)` may change any local (see unroll.c).
+static bool frame_walk;
+
+// The loop being vectorized
+static CountedLoop loop;
+static Node *body;
+static int es;       // element size
+static char *reason; // why the loop can't be vectorized
+
+static Access accs[MAX_ACCESSES];
+static int naccs;
+static Reduction reds[NUM_VREGS];
+static int nreds;
+static Splat splats[NUM_VREGS];
+static int nsplats;
+static int nscratch; // registers the body needs for intermediate values
+
+// The temporary that holds the address in `p[i] op= x` (see to_assign()
+// in parse.c)
+static Obj *tmp_var;
+static Node *tmp_addr;
+
+static Node *new_node(NodeKind kind, Token *tok)
+{
+  Node *node = calloc(1, sizeof(Node));
+  node->kind = kind;
+  node->tok = tok;
+  return node;
+}
+
+static Node *new_binary(NodeKind kind, Node *lhs, Node *rhs, Token *tok)
+{
+  Node *node = new_node(kind, tok);
+  node->lhs = lhs;
+  node->rhs = rhs;
+  return node;
+}
+
+static Node *new_num(int64_t val, Type *ty, Token *tok)
+{
+  Node *node = new_node(ND_NUM, tok);
+  node->val = val;
+  node->ty = ty;
+  return node;
+}
+
+static Node *new_var(Obj *var, Token *tok)
+{
+  Node *node = new_node(ND_VAR, tok);
+  node->var = var;
+  node->ty = var->ty;
+  return node;
+}
+
+static Type *elem_type(int size)
+{
+  switch (size)
+  {
+  case 1:
+    return ty_char;
+  case 2:
+    return ty_short;
+  case 4:
+    return ty_int;
+  }
+  return ty_long;
+}
+
+// Vector nodes have the type of their elements.
+static Node *new_vnode(NodeKind kind, Token *tok)
+{
+  Node *node = new_node(kind, tok);
+  node->ty = elem_type(es);
+  return node;
+}
+
+static Node *new_vreg(int vreg, Token *tok)
+{
+  Node *node = new_vnode(ND_VREG, tok);
+  node->vreg = vreg;
+  return node;
+}
+
+static Node *new_vop(NodeKind op, Node *lhs, Node *rhs, Token *tok)
+{
+  Node *node = new_vnode(ND_VOP, tok);
+  node->vop = op;
+  node->lhs = lhs;
+  node->rhs = rhs;
+  return node;
+}
+
+static Node *new_vset(int vreg, Node *val, Token *tok)
+{
+  Node *node = new_vnode(ND_VSET, tok);
+  node->vreg = vreg;
+  node->lhs = val;
+  return node;
+}
+
+static Node *expr_stmt(Node *expr)
+{
+  add_type(expr);
+  return new_binary(ND_EXPR_STMT, expr, NULL, expr->tok);
+}
+
+static bool reject(char *msg)
+{
+  if (!reason)
+    reason = msg;
+  return false;
+}
+
+static bool is_assign_to(Node *node, void *var)
+{
+  return node->kind == ND_ASSIGN && node->lhs->kind == ND_VAR && node->lhs->var == var;
+}
+
+static bool is_use_of(Node *node, void *var)
+{
+  return node->kind == ND_VAR && node->var == var;
+}
+
+static bool is_scalar_addr(Node *node, void *arg)
+{
+  return node->kind == ND_ADDR && node->lhs->kind == ND_VAR &&
+         node->lhs->var->is_local && node->lhs->var->ty->kind != TY_ARRAY &&
+         node->lhs->var->ty->kind != TY_STRUCT && node->lhs->var->ty->kind != TY_UNION;
+}
+
+static bool is_loop(Node *node, void *arg)
+{
+  return node->kind == ND_FOR || node->kind == ND_DO;
+}
+
+// Returns true if converting or storing an integer to `ty` keeps its
+// low bytes. A conversion to _Bool compares it with 0 instead.
+static bool is_truncation(Type *ty)
+{
+  return is_integer(ty) && ty->kind != TY_BOOL;
+}
+
+// Skips integer conversions that keep the low `es` bytes of a value.
+static Node *skip_casts(Node *node)
+{
+  while (node->kind == ND_CAST && is_truncation(node->ty) &&
+         is_integer(node->lhs->ty) && node->ty->size >= es)
+    node = node->lhs;
+  return node;
+}
+
+static bool set_size(int size)
+{
+  if (es && es != size)
+    return reject("mixed element sizes");
+  es = size;
+  return true;
+}
+
+//
+// Memory accesses
+//
+
+// Matches an integer expression `i * coef + off`.
+static bool linear(Node *node, int64_t *coef, int64_t *off)
+{
+  int64_t c1, o1, c2, o2;
+
+  switch (node->kind)
+  {
+  case ND_NUM:
+    *coef = 0;
+    *off = node->val;
+    return true;
+  case ND_VAR:
+    *coef = 1;
+    *off = 0;
+    return node->var == loop.var;
+  case ND_CAST:
+    return node->ty->size >= node->lhs->ty->size && is_integer(node->lhs->ty) &&
+           node->ty->kind != TY_BOOL &&
+           linear(node->lhs, coef, off);
+  case ND_ADD:
+  case ND_SUB:
+    if (!linear(node->lhs, &c1, &o1) || !linear(node->rhs, &c2, &o2))
+      return false;
+    if (node->kind == ND_SUB)
+    {
+      c2 = -c2;
+      o2 = -o2;
+    }
+    *coef = c1 + c2;
+    *off = o1 + o2;
+    return true;
+  case ND_MUL:
+    if (!linear(node->lhs, &c1, &o1) || !linear(node->rhs, &c2, &o2) || (c1 && c2))
+      return false;
+    *coef = c1 * o2 + c2 * o1;
+    *off = o1 * o2;
+    return true;
+  }
+  return false;
+}
+
+// Splits an address into `base + i * coef + off`, where base is a
+// variable. Pointer arithmetic has already scaled the index.
+static bool split_addr(Node *node, Node **base, int64_t *coef, int64_t *off)
+{
+  switch (node->kind)
+  {
+  case ND_VAR:
+    *base = node;
+    *coef = *off = 0;
+    return true;
+  case ND_CAST:
+    return node->lhs->ty->base && split_addr(node->lhs, base, coef, off);
+  case ND_ADD:
+  case ND_SUB:
+  {
+    int64_t c, o;
+    if (!node->ty->base || !linear(node->rhs, &c, &o) ||
+        !split_addr(node->lhs, base, coef, off))
+      return false;
+    if (node->kind == ND_SUB)
+    {
+      c = -c;
+      o = -o;
+    }
+    *coef += c;
+    *off += o;
+    return true;
+  }
+  }
+  return false;
+}
+
+// Records a load or store and returns the address for the vector
+// code.
+static Node *add_access(Node *addr, bool is_store)
+{
+  if (addr->kind == ND_VAR && addr->var == tmp_var)
+    addr = tmp_addr;
+
+  Access *acc = &accs[naccs];
+  int64_t coef;
+  if (!split_addr(addr, &acc->base, &coef, &acc->off))
+  {
+    reject("complex address");
+    return NULL;
+  }
+  if (coef != es)
+  {
+    reject("non-unit stride");
+    return NULL;
+  }
+
+  Obj *var = acc->base->var;
+  if (var->ty->kind != TY_ARRAY)
+  {
+    if (!var->is_local)
+    {
+      reject("global variable");
+      return NULL;
+    }
+    if (any_node(body, is_assign_to, var))
+    {
+      reject("pointer changes in the loop");
+      return NULL;
+    }
+  }
+
+  if (naccs == MAX_ACCESSES)
+  {
+    reject("too many memory accesses");
+    return NULL;
+  }
+  acc->is_store = is_store;
+  naccs++;
+  return copy_node(addr);
+}
+
+//
+// Vector expressions
+//
+
+// Returns true if an integer expression has the same value in every
+// iteration, so that it can be computed once before the loop.
+static bool is_invariant(Node *node)
+{
+  if (!is_integer(node->ty))
+    return false;
+
+  switch (node->kind)
+  {
+  case ND_NUM:
+    return true;
+  case ND_VAR:
+    return node->var->is_local && node->var != loop.var &&
+           !any_node(body, is_assign_to, node->var);
+  case ND_CAST:
+  case ND_NEG:
+  case ND_BITNOT:
+    return is_invariant(node->lhs);
+  case ND_ADD:
+  case ND_SUB:
+  case ND_MUL:
+  case ND_BITAND:
+  case ND_BITOR:
+  case ND_BITXOR:
+    return is_invariant(node->lhs) && is_invariant(node->rhs);
+  }
+  return false;
+}
+
+static bool same_expr(Node *x, Node *y)
+{
+  if (x->kind != y->kind || x->ty->size != y->ty->size)
+    return false;
+  if (x->kind == ND_NUM)
+    return x->val == y->val;
+  if (x->kind == ND_VAR)
+    return x->var == y->var;
+  if (x->kind == ND_CAST)
+    return same_expr(x->lhs, y->lhs);
+  return false;
+}
+
+// Allocates a register below the ones already taken.
+static int reserve_vreg(void)
+{
+  // Keep two registers for intermediate values.
+  if (nsplats + nreds == NUM_VREGS - 2)
+  {
+    reject("too many vector registers");
+    return -1;
+  }
+  return NUM_VREGS - 1 - nsplats - nreds;
+}
+
+// Returns a register with `expr` in every lane.
+static Node *splat(Node *expr)
+{
+  for (int i = 0; i < nsplats; i++)
+    if (same_expr(splats[i].expr, expr))
+      return new_vreg(splats[i].vreg, expr->tok);
+
+  int vreg = reserve_vreg();
+  if (vreg < 0)
+    return NULL;
+  splats[nsplats++] = (Splat){expr, vreg};
+  return new_vreg(vreg, expr->tok);
+}
+
+static Node *vec_value(Node *node);
+
+static Node *vec_binary(NodeKind op, Node *lhs, Node *rhs, Token *tok)
+{
+  Node *l = vec_value(lhs);
+  Node *r = l ? vec_value(rhs) : NULL;
+  return r ? new_vop(op, l, r, tok) : NULL;
+}
+
+// Converts the value of an expression in one iteration to a vector
+// of its values in VF iterations. Returns NULL if it can't.
+static Node *vec_value(Node *node)
+{
+  Token *tok = node->tok;
+
+  if (!is_integer(node->ty))
+  {
+    reject("unsupported type");
+    return NULL;
+  }
+  if (is_invariant(node))
+    return splat(node);
+
+  switch (node->kind)
+  {
+  case ND_VAR:
+    if (node->var == loop.var)
+      reject("loop index used as a value");
+    else if (!node->var->is_local)
+      reject("global variable");
+    else
+      reject("scalar assigned in the loop");
+    return NULL;
+  case ND_DEREF:
+  {
+    if (node->ty->size != es)
+    {
+      reject("mixed element sizes");
+      return NULL;
+    }
+    Node *addr = add_access(node->lhs, false);
+    if (!addr)
+      return NULL;
+    Node *load = new_vnode(ND_VLOAD, tok);
+    load->lhs = addr;
+    return load;
+  }
+  case ND_CAST:
+    if (!is_integer(node->lhs->ty) || !is_truncation(node->ty))
+    {
+      reject("unsupported type");
+      return NULL;
+    }
+    if (node->ty->size < es)
+    {
+      reject("narrowing conversion");
+      return NULL;
+    }
+    return vec_value(node->lhs);
+  case ND_NEG:
+    return vec_binary(ND_SUB, new_num(0, ty_int, tok), node->lhs, tok);
+  case ND_BITNOT:
+    return vec_binary(ND_BITXOR, node->lhs, new_num(-1, ty_int, tok), tok);
+  case ND_MUL:
+    if (es != 2 && !(es == 4 && opt_avx2))
+    {
+      reject("unsupported multiplication");
+      return NULL;
+    }
+    return vec_binary(ND_MUL, node->lhs, node->rhs, tok);
+  case ND_ADD:
+  case ND_SUB:
+  case ND_BITAND:
+  case ND_BITOR:
+  case ND_BITXOR:
+    return vec_binary(node->kind, node->lhs, node->rhs, tok);
+  case ND_FUNCALL:
+    reject("function call");
+    return NULL;
+  }
+  reject("unsupported operation");
+  return NULL;
+}
+
+// Number of registers needed for intermediate values of a vector
+// expression (see gen_vexpr() in codegen.c)
+static int scratch_regs(Node *node)
+{
+  switch (node->kind)
+  {
+  case ND_VREG:
+    return 0;
+  case ND_VOP:
+    return MAX(MAX(scratch_regs(node->lhs), 1), scratch_regs(node->rhs) + 1);
+  }
+  return 1;
+}
+
+//
+// Statements
+//
+
+// *p = x
+static Node *vec_store(Node *node)
+{
+  Node *lhs = node->lhs;
+  if (!is_truncation(lhs->ty))
+  {
+    reject("unsupported type");
+    return NULL;
+  }
+  if (!set_size(lhs->ty->size))
+    return NULL;
+
+  // The store happens after the loads of the value.
+  Node *val = vec_value(node->rhs);
+  Node *addr = val ? add_access(lhs->lhs, true) : NULL;
+  if (!addr)
+    return NULL;
+
+  nscratch = MAX(nscratch, scratch_regs(val));
+  Node *store = new_vnode(ND_VSTORE, node->tok);
+  store->lhs = addr;
+  store->rhs = val;
+  return store;
+}
+
+// s = s op x
+static Node *vec_reduction(Node *node)
+{
+  Obj *var = node->lhs->var;
+  if (!var->is_local)
+  {
+    reject("global variable");
+    return NULL;
+  }
+  if (!is_truncation(var->ty) || !set_size(var->ty->size))
+  {
+    reject("unsupported type");
+    return NULL;
+  }
+
+  Node *op = skip_casts(node->rhs);
+  Node *x = NULL;
+
+  switch (op->kind)
+  {
+  case ND_ADD:
+  case ND_BITAND:
+  case ND_BITOR:
+  case ND_BITXOR:
+    if (is_use_of(skip_casts(op->rhs), var))
+      x = op->lhs;
+    // fallthrough
+  case ND_SUB:
+    if (is_use_of(skip_casts(op->lhs), var))
+      x = op->rhs;
+  }
+  if (!x)
+  {
+    reject("scalar assigned in the loop");
+    return NULL;
+  }
+
+  for (int i = 0; i < nreds; i++)
+    if (reds[i].var == var)
+      x = NULL;
+  if (!x || any_node(x, is_use_of, var))
+  {
+    reject("dependence between iterations");
+    return NULL;
+  }
+
+  int vreg = reserve_vreg();
+  if (vreg < 0)
+    return NULL;
+  reds[nreds++] = (Reduction){var, op->kind, vreg};
+
+  Node *val = vec_value(x);
+  if (!val)
+    return NULL;
+
+  // A difference is a sum that is subtracted after the loop.
+  nscratch = MAX(nscratch, scratch_regs(val));
+  NodeKind vop = (op->kind == ND_SUB) ? ND_ADD : op->kind;
+  return new_vset(vreg, new_vop(vop, new_vreg(vreg, node->tok), val, node->tok),
+                  node->tok);
+}
+
+static Node *vec_stmt(Node *node)
+{
+  if (node->kind == ND_MEMSET || node->kind == ND_MEMCPY)
+  {
+    reject("unsupported statement");
+    return NULL;
+  }
+  if (node->kind != ND_EXPR_STMT)
+  {
+    reject("control flow in the loop");
+    return NULL;
+  }
+
+  // `p[i] op= x` is `tmp = &p[i], *tmp = *tmp op x`.
+  Node *expr = node->lhs;
+  tmp_var = NULL;
+  if (expr->kind == ND_COMMA && expr->lhs->kind == ND_ASSIGN &&
+      expr->lhs->lhs->kind == ND_VAR)
+  {
+    Node *addr = expr->lhs->rhs;
+    while (addr->kind == ND_CAST && addr->lhs->ty->base)
+      addr = addr->lhs;
+    if (addr->kind != ND_ADDR || addr->lhs->kind != ND_DEREF)
+    {
+      reject("unsupported statement");
+      return NULL;
+    }
+    tmp_var = expr->lhs->lhs->var;
+    tmp_addr = addr->lhs->lhs;
+    expr = expr->rhs;
+  }
+
+  if (expr->kind == ND_ASSIGN && expr->lhs->kind == ND_DEREF)
+    return vec_store(expr);
+  if (expr->kind == ND_ASSIGN && expr->lhs->kind == ND_VAR)
+    return vec_reduction(expr);
+  if (expr->kind == ND_FUNCALL)
+    reject("function call");
+  else
+    reject("unsupported statement");
+  return NULL;
+}
+
+//
+// Dependences
+//
+// The vector loop runs each statement for VF iterations before the
+// next statement, so an access G that comes after an access F in the
+// body moves before F of the following iterations. If G and F touch
+// the same element in iterations j and j' > j, the result changes.
+// With d the distance in bytes from F to G in the same iteration,
+// that happens if d = (j' - j) * es for 0 < j' - j < VF, and accesses
+// that overlap partially are caught by 0 < d < VF * es.
+//
+
+// Appends the condition that the distance from f to g is safe.
+static Node *add_check(Node *cond, Access *f, Access *g, int vf)
+{
+  Token *tok = loop.loop->tok;
+  Node *d = new_binary(ND_SUB, new_cast(copy_node(g->base), ty_long),
+                       new_cast(copy_node(f->base), ty_long), tok);
+  d = new_binary(ND_ADD, d, new_num(g->off - f->off, ty_long, tok), tok);
+  Node *before = new_binary(ND_LE, d, new_num(0, ty_long, tok), tok);
+  Node *after = new_binary(ND_LE, new_num(vf * es, ty_long, tok), copy_node(d), tok);
+  Node *check = new_binary(ND_LOGOR, before, after, tok);
+  return cond ? new_binary(ND_LOGAND, cond, check, tok) : check;
+}
+
+// Returns the condition under which the accesses don't depend on each
+// other, or NULL if they never do. Sets `reason` if they always may.
+static Node *check_deps(int vf, int *nchecks)
+{
+  Node *cond = NULL;
+  *nchecks = 0;
+
+  for (int i = 0; i < naccs; i++)
+  {
+    for (int j = i + 1; j < naccs; j++)
+    {
+      Access *f = &accs[i];
+      Access *g = &accs[j];
+      if (!f->is_store && !g->is_store)
+        continue;
+
+      Obj *fv = f->base->var;
+      Obj *gv = g->base->var;
+      if (fv == gv)
+      {
+        int64_t d = g->off - f->off;
+        if (0 < d && d < vf * es)
+        {
+          reject("dependence between iterations");
+          return NULL;
+        }
+        continue;
+      }
+
+      // Distinct arrays don't overlap.
+      if (fv->ty->kind == TY_ARRAY && gv->ty->kind == TY_ARRAY)
+        continue;
+
+      if (*nchecks == MAX_CHECKS)
+      {
+        reject("too many pointers to check for overlap");
+        return NULL;
+      }
+      cond = add_check(cond, f, g, vf);
+      (*nchecks)++;
+    }
+  }
+  if (cond)
+    add_type(cond);
+  return cond;
+}
+
+//
+// Rewriting
+//
+
+static Node *new_block(Node *stmts, Token *tok)
+{
+  Node *node = new_node(ND_BLOCK, tok);
+  node->body = stmts;
+  return node;
+}
+
+static Node *rewrite(Node *vbody, Node *checks, int vf)
+{
+  Node *node = loop.loop;
+  Token *tok = node->tok;
+
+  // i = i + VF
+  Node *inc = new_binary(ND_ADD, new_var(loop.var, tok), new_num(vf, ty_int, tok), tok);
+  Node *cur = vbody;
+  while (cur->next)
+    cur = cur->next;
+  cur->next = expr_stmt(new_binary(ND_ASSIGN, new_var(loop.var, tok), inc, tok));
+
+  Node *vloop = new_node(ND_FOR, tok);
+  vloop->cond = remaining_cond(&loop, vf);
+  vloop->then = new_block(vbody, tok);
+  vloop->brk_label = new_unique_name();
+  vloop->cont_label = new_unique_name();
+  vloop->unroll = 1;
+
+  Node head = {};
+  cur = &head;
+  for (int i = 0; i < nsplats; i++)
+  {
+    Node *expr = copy_node(splats[i].expr);
+    if (expr->ty->size < es)
+      expr = new_cast(expr, ty_long);
+    Node *val = new_vnode(ND_VSPLAT, tok);
+    val->lhs = expr;
+    cur = cur->next = new_vset(splats[i].vreg, val, tok);
+  }
+  for (int i = 0; i < nreds; i++)
+  {
+    Node *val = new_vnode(ND_VSPLAT, tok);
+    val->lhs = new_num((reds[i].op == ND_BITAND) ? -1 : 0, ty_int, tok);
+    cur = cur->next = new_vset(reds[i].vreg, val, tok);
+  }
+
+  cur = cur->next = vloop;
+
+  for (int i = 0; i < nreds; i++)
+  {
+    Reduction *red = &reds[i];
+    Node *sum = new_vnode(ND_VREDUCE, tok);
+    sum->vreg = red->vreg;
+    sum->vop = (red->op == ND_SUB) ? ND_ADD : red->op;
+    Node *val = new_binary(red->op, new_var(red->var, tok), sum, tok);
+    cur = cur->next = expr_stmt(new_binary(ND_ASSIGN, new_var(red->var, tok), val, tok));
+  }
+  cur = cur->next = new_vnode(ND_VEND, tok);
+
+  Node *vec = new_block(head.next, tok);
+  if (checks)
+  {
+    Node *guard = new_node(ND_IF, tok);
+    guard->cond = checks;
+    guard->then = vec;
+    vec = guard;
+  }
+
+  // The original loop runs the remaining iterations.
+  Node *block = new_node(ND_BLOCK, tok);
+  if (node->init)
+  {
+    block->body = node->init;
+    node->init->next = vec;
+    node->init = NULL;
+  }
+  else
+  {
+    block->body = vec;
+  }
+  vec->next = node;
+  node->next = NULL;
+  node->unroll = 1;
+  return block;
+}
+
+static int64_t trip_count(void)
+{
+  int64_t limit = skip_casts(loop.limit)->val + loop.inclusive;
+  return (limit <= loop.start) ? 0 : limit - loop.start;
+}
+
+// Returns the vectorized loop, or NULL and the reason in `reason`.
+static Node *try_vectorize(Node *node)
+{
+  if (frame_walk)
+  {
+    reject("address of a local variable is taken");
+    return NULL;
+  }
+  if (any_node(node->then, is_loop, NULL))
+  {
+    reject("not an innermost loop");
+    return NULL;
+  }
+  if (!match_counted_loop(node, &loop))
+  {
+    reject("not a counted loop");
+    return NULL;
+  }
+  if (loop.step != 1)
+  {
+    reject("step is not 1");
+    return NULL;
+  }
+
+  body = node->then;
+  es = naccs = nreds = nsplats = nscratch = 0;
+
+  Node *stmts = (body->kind == ND_BLOCK) ? body->body : body;
+  Node head = {};
+  Node *cur = &head;
+  for (Node *n = stmts; n; n = (body->kind == ND_BLOCK) ? n->next : NULL)
+  {
+    cur = cur->next = vec_stmt(n);
+    if (!cur)
+      return NULL;
+  }
+  if (!head.next)
+  {
+    reject("empty loop");
+    return NULL;
+  }
+
+  if (nscratch + nsplats + nreds > NUM_VREGS)
+  {
+    reject("too many vector registers");
+    return NULL;
+  }
+
+  int vf = (opt_avx2 ? 32 : 16) / es;
+  if (loop.has_start && skip_casts(loop.limit)->kind == ND_NUM && trip_count() < vf)
+  {
+    reject("too few iterations");
+    return NULL;
+  }
+
+  int nchecks;
+  Node *checks = check_deps(vf, &nchecks);
+  if (reason)
+    return NULL;
+
+  static char *names[] = {[1] = "char", [2] = "short", [4] = "int", [8] = "long"};
+  if (nchecks)
+    remark("vectorize", node->tok, "vectorized loop (%d x %s), %d runtime alias check%s",
+           vf, names[es], nchecks, (nchecks > 1) ? "s" : "");
+  else
+    remark("vectorize", node->tok, "vectorized loop (%d x %s)", vf, names[es]);
+  return rewrite(head.next, checks, vf);
+}
+
+static Node *vectorize_loop(Node *node)
+{
+  reason = NULL;
+  Node *vec = try_vectorize(node);
+  if (vec)
+  {
+    nvectorized++;
+    return vec;
+  }
+  remark_missed("vectorize", node->tok, "loop not vectorized: %s", reason);
+  nrejected++;
+  return node;
+}
+
+static Node *vectorize_stmt(Node *node)
+{
+  if (!node)
+    return NULL;
+
+  switch (node->kind)
+  {
+  case ND_BLOCK:
+    for (Node **p = &node->body; *p; p = &(*p)->next)
+    {
+      Node *next = (*p)->next;
+      *p = vectorize_stmt(*p);
+      (*p)->next = next;
+    }
+    return node;
+  case ND_IF:
+    node->then = vectorize_stmt(node->then);
+    node->els = vectorize_stmt(node->els);
+    return node;
+  case ND_FOR:
+    node->then = vectorize_stmt(node->then);
+    return vectorize_loop(node);
+  case ND_DO:
+  case ND_SWITCH:
+    node->then = vectorize_stmt(node->then);
+    return node;
+  case ND_CASE:
+  case ND_LABEL:
+    node->lhs = vectorize_stmt(node->lhs);
+    return node;
+  }
+  return node;
+}
+
+void vectorize(Obj *prog)
+{
+  nvectorized = nrejected = 0;
+  for (Obj *fn = prog; fn; fn = fn->next)
+  {
+    if (!fn->is_function || !fn->is_definition)
+      continue;
+    frame_walk = any_node(fn->body, is_scalar_addr, NULL);
+    fn->body = vectorize_stmt(fn->body);
+  }
+  count_stat("vectorized", "loops", nvectorized);
+  count_stat("vec-rejected", "loops", nrejected);
+}